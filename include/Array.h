@@ -29,6 +29,7 @@
 #include <vector>
 #include <algorithm>
 #include <iostream>
+#include <type_traits>
 
 template<int N>
 inline std::array<int, N> calc_strides(const std::array<int, N>& dims)
@@ -240,4 +241,114 @@ class Array
         std::array<int, N> strides;
         std::array<int, N> offsets;
 };
+
+// Copy an array into a new array of another element type, for instance to change the precision.
+template<typename TO, typename FROM, int N>
+inline Array<TO, N> convert_array(const Array<FROM, N>& array)
+{
+    return Array<TO, N>(std::vector<TO>(array.v().begin(), array.v().end()), array.get_dims());
+}
+
+// Non-owning view on memory that is owned elsewhere, for instance by a numpy array
+// or a host model. Indexing follows Array: Fortran ordering, starting at 1.
+template<typename T, int N>
+class Array_view
+{
+    public:
+        // Create an empty view.
+        Array_view() :
+            data(nullptr),
+            dims({}),
+            ncells(0),
+            strides({})
+        {}
+
+        // Create a view on contiguous memory.
+        Array_view(T* data, const std::array<int, N>& dims) :
+            data(data),
+            dims(dims),
+            ncells(product<N>(dims)),
+            strides(calc_strides<N>(dims))
+        {}
+
+        // Create a view on strided memory, strides are in elements.
+        Array_view(T* data, const std::array<int, N>& dims, const std::array<int, N>& strides) :
+            data(data),
+            dims(dims),
+            ncells(product<N>(dims)),
+            strides(strides)
+        {}
+
+        // Views on the full extent of an Array, these allow passing an Array where a view is expected.
+        Array_view(Array<T, N>& array) :
+            Array_view(array.ptr(), array.get_dims())
+        {}
+
+        Array_view(const Array<T, N>& array) :
+            Array_view(const_cast<T*>(array.ptr()), array.get_dims())
+        {}
+
+        inline std::array<int, N> get_dims() const { return dims; }
+        inline std::array<int, N> get_strides() const { return strides; }
+
+        inline T* ptr() { return data; }
+        inline const T* ptr() const { return data; }
+
+        inline int size() const { return ncells; }
+        inline int dim(const int i) const { return dims[i-1]; }
+        inline bool is_empty() const { return ncells == 0; }
+
+        inline bool is_contiguous() const
+        {
+            return strides == calc_strides<N>(dims);
+        }
+
+        inline T& operator()(const std::array<int, N>& indices)
+        {
+            return data[calc_index<N>(indices, strides, {})];
+        }
+
+        inline T operator()(const std::array<int, N>& indices) const
+        {
+            return data[calc_index<N>(indices, strides, {})];
+        }
+
+        // Copy a subset into a new Array, with the same spreading of unit dimensions as Array::subset.
+        inline Array<typename std::remove_const<T>::type, N> subset(
+                const std::array<std::pair<int, int>, N> ranges) const
+        {
+            std::array<int, N> subdims;
+            std::array<bool, N> do_spread;
+
+            for (int i=0; i<N; ++i)
+            {
+                subdims[i] = ranges[i].second - ranges[i].first + 1;
+                do_spread[i] = (dims[i] == 1);
+            }
+
+            Array<typename std::remove_const<T>::type, N> a_sub(subdims);
+            const std::array<int, N> substrides = calc_strides<N>(subdims);
+
+            for (int i=0; i<a_sub.size(); ++i)
+            {
+                std::array<int, N> index;
+                int ic = i;
+                for (int n=N-1; n>0; --n)
+                {
+                    index[n] = do_spread[n] ? 1 : ic / substrides[n] + ranges[n].first;
+                    ic %= substrides[n];
+                }
+                index[0] = do_spread[0] ? 1 : ic + ranges[0].first;
+                a_sub.ptr()[i] = (*this)(index);
+            }
+
+            return a_sub;
+        }
+
+    private:
+        T* data;
+        std::array<int, N> dims;
+        int ncells;
+        std::array<int, N> strides;
+};
 #endif
@@ -46,12 +46,12 @@ class Cloud_optics : public Optical_props<TF>
         void cloud_optics(
                 const Array<TF,2>& clwp, const Array<TF,2>& ciwp,
                 const Array<TF,2>& reliq, const Array<TF,2>& reice,
-                Optical_props_1scl<TF>& optical_props);
+                Optical_props_1scl<TF>& optical_props) const;
 
         void cloud_optics(
                 const Array<TF,2>& clwp, const Array<TF,2>& ciwp,
                 const Array<TF,2>& reliq, const Array<TF,2>& reice,
-                Optical_props_2str<TF>& optical_props);
+                Optical_props_2str<TF>& optical_props) const;
 
     private:
         int liq_nsteps;
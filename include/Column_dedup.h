@@ -0,0 +1,90 @@
+/*
+ * This file is part of a C++ interface to the Radiative Transfer for Energetics (RTE)
+ * and Rapid Radiative Transfer Model for GCM applications Parallel (RRTMGP).
+ *
+ * The original code is found at https://github.com/earth-system-radiation/rte-rrtmgp.
+ *
+ * Contacts: Robert Pincus and Eli Mlawer
+ * email: rrtmgp@aer.com
+ *
+ * Copyright 2015-2020,  Atmospheric and Environmental Research and
+ * Regents of the University of Colorado.  All right reserved.
+ *
+ * This C++ interface can be downloaded from https://github.com/earth-system-radiation/rte-rrtmgp-cpp
+ *
+ * Contact: Chiel van Heerwaarden
+ * email: chiel.vanheerwaarden@wur.nl
+ *
+ * Copyright 2020, Wageningen University & Research.
+ *
+ * Use and duplication is permitted under the terms of the
+ * BSD 3-clause license, see http://opensource.org/licenses/BSD-3-Clause
+ *
+ */
+
+
+#ifndef COLUMN_DEDUP_H
+#define COLUMN_DEDUP_H
+
+#include <cstdint>
+#include <vector>
+
+#include "Array.h"
+
+template<typename TF> class Gas_concs;
+
+// Detection of columns with an identical input state, such that only the unique columns
+// are solved and their results are copied to the duplicates. All inputs of the solver
+// are added first, after which find_unique() groups the columns.
+//
+// With a quantization of zero only bit-identical columns are merged. Otherwise, the values are
+// binned on a logarithmic grid with a relative bin width of the quantization, and columns that
+// fall in the same bins for all inputs are merged (near-duplicates).
+template<typename TF>
+class Column_dedup
+{
+    public:
+        Column_dedup(const int n_col, const TF quantization=TF(0.));
+
+        // Inputs with the columns in the first dimension. Inputs that are spread
+        // over all columns (a first dimension of 1) do not distinguish columns.
+        void add(const Array_view<TF,2>& data);
+        void add(const Array_view<TF,1>& data);
+
+        // Inputs with the columns in the second dimension, such as the surface emissivity.
+        void add_dim2(const Array_view<TF,2>& data);
+
+        // The volume mixing ratios of all gases.
+        void add(const Gas_concs<TF>& gas_concs);
+
+        void find_unique();
+
+        int get_n_col() const { return n_col; }
+        int get_n_unique() const { return unique_cols.size(); }
+
+        // Number of columns per unique column, 1 if there are no duplicates.
+        double get_dedup_ratio() const { return unique_cols.empty() ? 1. : double(n_col) / unique_cols.size(); }
+
+        // The first column of each group of duplicates, starting at 1.
+        const std::vector<int>& get_unique_cols() const { return unique_cols; }
+
+        // The index of each column in the unique columns, starting at 1.
+        const std::vector<int>& get_unique_index() const { return unique_index; }
+
+        // Copy the results of the unique columns into all columns. Empty arrays are skipped.
+        template<int N>
+        void expand(Array_view<TF,N> out, const Array<TF,N>& in) const;
+
+    private:
+        uint64_t key(const TF value) const;
+
+        const int n_col;
+        const TF quantization;
+
+        // The keys of the values of all inputs, n_key per column.
+        std::vector<std::vector<uint64_t>> keys;
+
+        std::vector<int> unique_cols;
+        std::vector<int> unique_index;
+};
+#endif
@@ -0,0 +1,55 @@
+/*
+ * This file is part of a C++ interface to the Radiative Transfer for Energetics (RTE)
+ * and Rapid Radiative Transfer Model for GCM applications Parallel (RRTMGP).
+ *
+ * The original code is found at https://github.com/earth-system-radiation/rte-rrtmgp.
+ *
+ * Contacts: Robert Pincus and Eli Mlawer
+ * email: rrtmgp@aer.com
+ *
+ * Copyright 2015-2020,  Atmospheric and Environmental Research and
+ * Regents of the University of Colorado.  All right reserved.
+ *
+ * This C++ interface can be downloaded from https://github.com/earth-system-radiation/rte-rrtmgp-cpp
+ *
+ * Contact: Chiel van Heerwaarden
+ * email: chiel.vanheerwaarden@wur.nl
+ *
+ * Copyright 2020, Wageningen University & Research.
+ *
+ * Use and duplication is permitted under the terms of the
+ * BSD 3-clause license, see http://opensource.org/licenses/BSD-3-Clause
+ *
+ */
+
+
+#ifndef CPU_DISPATCH_H
+#define CPU_DISPATCH_H
+
+#include <string>
+
+// Runtime selection of the instruction set of the hand-vectorized kernels, such that one binary
+// that is built for the lowest common CPU still runs at the full vector width of each node.
+//
+// Functions marked DISPATCH_KERNEL are compiled once per instruction set, and on the first call
+// the loader binds the variant for the CPU (GCC function multiversioning with target_clones).
+// Marked functions are not inlined, so only whole loops should be marked, not the functions that
+// they call per element. Other compilers build one variant for the flags of the build, for the
+// Intel compiler -ax does the same dispatch. Define NO_CPU_DISPATCH to disable it.
+#if defined(__GNUC__) && !defined(__clang__) && !defined(__INTEL_COMPILER) \
+        && defined(__x86_64__) && defined(__linux__) && !defined(NO_CPU_DISPATCH)
+#define CPU_DISPATCH
+#define DISPATCH_KERNEL __attribute__((target_clones("avx512f", "avx2", "sse4.2", "default")))
+#else
+#define DISPATCH_KERNEL
+#endif
+
+namespace Cpu_dispatch
+{
+    // Instruction set of the variant of the DISPATCH_KERNEL functions that runs on this CPU.
+    std::string get_variant();
+
+    // Print the variant that the DISPATCH_KERNEL functions use on this CPU.
+    void print_variant();
+}
+#endif
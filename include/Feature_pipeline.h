@@ -0,0 +1,85 @@
+/*
+ * This file is part of a C++ interface to the Radiative Transfer for Energetics (RTE)
+ * and Rapid Radiative Transfer Model for GCM applications Parallel (RRTMGP).
+ *
+ * The original code is found at https://github.com/earth-system-radiation/rte-rrtmgp.
+ *
+ * Contacts: Robert Pincus and Eli Mlawer
+ * email: rrtmgp@aer.com
+ *
+ * Copyright 2015-2020,  Atmospheric and Environmental Research and
+ * Regents of the University of Colorado.  All right reserved.
+ *
+ * This C++ interface can be downloaded from https://github.com/earth-system-radiation/rte-rrtmgp-cpp
+ *
+ * Contact: Chiel van Heerwaarden
+ * email: chiel.vanheerwaarden@wur.nl
+ *
+ * Copyright 2020, Wageningen University & Research.
+ *
+ * Use and duplication is permitted under the terms of the
+ * BSD 3-clause license, see http://opensource.org/licenses/BSD-3-Clause
+ *
+ */
+
+
+#ifndef FEATURE_PIPELINE_H
+#define FEATURE_PIPELINE_H
+
+#include <string>
+#include <vector>
+
+template<typename TF> class Gas_concs;
+
+// Assembly of the inputs of the gas optics networks from the atmospheric state.
+//
+// Each input is a list of features, such as "log(h2o)", "play", "tlay" or "tlev+1". A feature
+// names a gas or one of the fields play, tlay, plev and tlev, optionally wrapped in log(). The
+// level fields take an offset that selects the level below (+0, the default) or above (+1) the
+// layer. A feature that occurs in several inputs is computed once and copied to all of them, and
+// the features of one field are assembled back to back, such that each field is streamed from
+// memory once.
+template<typename TF>
+class Feature_pipeline
+{
+    public:
+        // Add a network input with the given features, returns the index of the input.
+        int add_input(const std::vector<std::string>& features);
+
+        int get_n_features(const int i_input) const { return features.at(i_input).size(); }
+        const std::vector<std::string>& get_features(const int i_input) const { return features.at(i_input); }
+
+        // Write the features of the layers lay_s to lay_e of all columns into the inputs, which are
+        // feature-major with the (col, lay) pairs of the batch as the fastest varying dimension.
+        // If dp is given, the layer thicknesses of these layers are written into it at (col, lay),
+        // in the same pass over the layers as the pressure features.
+        void assemble(
+                const TF* play, const TF* plev,
+                const TF* tlay, const TF* tlev,
+                const Gas_concs<TF>& gas_desc,
+                const int ncol, const int lay_s, const int lay_e,
+                const std::vector<float*>& inputs,
+                float* dp=nullptr) const;
+
+    private:
+        enum class Source { Gas, Play, Plev, Tlay, Tlev };
+
+        struct Target
+        {
+            int i_input;
+            int i_feature;
+        };
+
+        struct Channel
+        {
+            Source source;
+            std::string gas_name;
+            bool log;
+            int lev_offset;
+            std::vector<Target> targets;
+        };
+
+        std::vector<std::vector<std::string>> features;
+        std::vector<Channel> channels;
+};
+#endif
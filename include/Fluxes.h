@@ -72,6 +72,21 @@ class Fluxes_broadband : public Fluxes<TF>
                 const std::unique_ptr<Optical_props_arry<TF>>& optical_props,
                 const BOOL_TYPE top_at_1);
 
+        // Reduce g-point fluxes that can be stored in another precision, the sum is accumulated in TF.
+        // If the g-point fluxes are in TF, this is the reduction above without spectral discretization.
+        template<typename TF_gpt>
+        void reduce(
+                const Array<TF_gpt,3>& gpt_flux_up,
+                const Array<TF_gpt,3>& gpt_flux_dn,
+                const BOOL_TYPE top_at_1);
+
+        template<typename TF_gpt>
+        void reduce(
+                const Array<TF_gpt,3>& gpt_flux_up,
+                const Array<TF_gpt,3>& gpt_flux_dn,
+                const Array<TF_gpt,3>& gpt_flux_dn_dir,
+                const BOOL_TYPE top_at_1);
+
         Array<TF,2>& get_flux_up    () { return flux_up;     }
         Array<TF,2>& get_flux_dn    () { return flux_dn;     }
         Array<TF,2>& get_flux_dn_dir() { return flux_dn_dir; }
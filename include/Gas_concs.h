@@ -27,10 +27,12 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include "define_bool.h"
 
 template<typename, int> class Array;
+template<typename, int> class Array_view;
 
 template<typename TF>
 class Gas_concs
@@ -38,11 +40,21 @@ class Gas_concs
     public:
         Gas_concs() {}
         Gas_concs(const Gas_concs& gas_concs_ref, const int start, const int size);
+        Gas_concs(const Gas_concs& gas_concs_ref, const std::vector<int>& cols);
+
+        // Copy the concentrations of a set of another precision.
+        template<typename TF_ref>
+        explicit Gas_concs(const Gas_concs<TF_ref>& gas_concs_ref);
 
         // Insert new gas into the map.
         void set_vmr(const std::string& name, const TF data);
         void set_vmr(const std::string& name, const Array<TF,1>& data);
         void set_vmr(const std::string& name, const Array<TF,2>& data);
+        void set_vmr(const std::string& name, const Array_view<TF,2>& data);
+
+        // Insert or update a gas from the columns col_s to col_e of viewed memory, which may be strided.
+        // The array of the gas is reused if it has the right shape.
+        void set_vmr(const std::string& name, const Array_view<TF,2>& data, const int col_s, const int col_e);
 
         // Insert new gas into the map.
         // void get_vmr(const std::string& name, Array<TF,2>& data) const;
@@ -51,7 +63,15 @@ class Gas_concs
         // Check if gas exists in map.
         BOOL_TYPE exists(const std::string& name) const;
 
+        // Names of all gases in the map.
+        std::vector<std::string> get_gas_names() const;
+
+        // Copy the columns col_s to col_e into gas_concs_sub. The arrays of gas_concs_sub are
+        // reused if they have the right shape, so repeated copies of equal blocks do not allocate.
+        void get_subset(Gas_concs& gas_concs_sub, const int col_s, const int col_e) const;
+
     private:
+        template<typename> friend class Gas_concs;
         std::map<std::string, Array<TF,2>> gas_concs_map;
 };
 #endif
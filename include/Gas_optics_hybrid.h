@@ -0,0 +1,114 @@
+/*
+ * This file is part of a C++ interface to the Radiative Transfer for Energetics (RTE)
+ * and Rapid Radiative Transfer Model for GCM applications Parallel (RRTMGP).
+ *
+ * The original code is found at https://github.com/earth-system-radiation/rte-rrtmgp.
+ *
+ * Contacts: Robert Pincus and Eli Mlawer
+ * email: rrtmgp@aer.com
+ *
+ * Copyright 2015-2020,  Atmospheric and Environmental Research and
+ * Regents of the University of Colorado.  All right reserved.
+ *
+ * This C++ interface can be downloaded from https://github.com/earth-system-radiation/rte-rrtmgp-cpp
+ *
+ * Contact: Chiel van Heerwaarden
+ * email: chiel.vanheerwaarden@wur.nl
+ *
+ * Copyright 2020, Wageningen University & Research.
+ *
+ * Use and duplication is permitted under the terms of the
+ * BSD 3-clause license, see http://opensource.org/licenses/BSD-3-Clause
+ *
+ */
+
+#ifndef GAS_OPTICS_HYBRID_H
+#define GAS_OPTICS_HYBRID_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "Array.h"
+#include "Gas_optics.h"
+#include "Gas_optics_nn.h"
+#include "Gas_optics_rrtmgp.h"
+
+// Forward declarations.
+template<typename TF> class Optical_props_arry;
+template<typename TF> class Gas_concs;
+template<typename TF> class Source_func_lw;
+
+// Gas optics that use the neural networks for the columns of which all inputs are within
+// the training envelope of the networks, and RRTMGP for the remaining columns.
+template<typename TF>
+class Gas_optics_hybrid : public Gas_optics<TF>
+{
+    public:
+        Gas_optics_hybrid(
+                std::unique_ptr<Gas_optics_nn<TF>> gas_optics_nn,
+                std::unique_ptr<Gas_optics_rrtmgp<TF>> gas_optics_rrtmgp,
+                const TF n_sigma);
+
+        // Longwave variant.
+        void gas_optics(
+                const Array<TF,2>& play,
+                const Array<TF,2>& plev,
+                const Array<TF,2>& tlay,
+                const Array<TF,1>& tsfc,
+                const Gas_concs<TF>& gas_desc,
+                std::unique_ptr<Optical_props_arry<TF>>& optical_props,
+                Source_func_lw<TF>& sources,
+                const Array<TF,2>& col_dry,
+                const Array<TF,2>& tlev) const;
+
+        // Shortwave variant.
+        void gas_optics(
+                const Array<TF,2>& play,
+                const Array<TF,2>& plev,
+                const Array<TF,2>& tlay,
+                const Gas_concs<TF>& gas_desc,
+                std::unique_ptr<Optical_props_arry<TF>>& optical_props,
+                Array<TF,2>& toa_src,
+                const Array<TF,2>& col_dry) const;
+
+        bool source_is_internal() const { return gas_optics_rrtmgp->source_is_internal(); }
+        bool source_is_external() const { return gas_optics_rrtmgp->source_is_external(); }
+
+        TF get_press_ref_min() const { return gas_optics_rrtmgp->get_press_ref_min(); }
+        TF get_press_ref_max() const { return gas_optics_rrtmgp->get_press_ref_max(); }
+
+        TF get_temp_min() const { return gas_optics_rrtmgp->get_temp_min(); }
+        TF get_temp_max() const { return gas_optics_rrtmgp->get_temp_max(); }
+
+        TF get_tsi() const { return gas_optics_rrtmgp->get_tsi(); }
+
+        // Statistics over all calls since construction or the last reset.
+        TF get_nn_column_fraction() const;
+        TF get_rrtmgp_column_fraction() const;
+        TF get_out_of_envelope_layer_fraction() const;
+        void reset_stats();
+
+        void set_thread_pool(Thread_pool* thread_pool) { gas_optics_nn->set_thread_pool(thread_pool); }
+
+    private:
+        // Split the columns over the networks and RRTMGP.
+        void classify_columns(
+                const Array<TF,2>& play,
+                const Array<TF,2>& tlay,
+                const Array<TF,2>& tlev,
+                const Gas_concs<TF>& gas_desc,
+                std::vector<int>& cols_nn,
+                std::vector<int>& cols_rrtmgp) const;
+
+        std::unique_ptr<Gas_optics_nn<TF>> gas_optics_nn;
+        std::unique_ptr<Gas_optics_rrtmgp<TF>> gas_optics_rrtmgp;
+
+        const TF n_sigma;
+
+        mutable std::atomic<long long> n_col_nn;
+        mutable std::atomic<long long> n_col_total;
+        mutable std::atomic<long long> n_lay_out;
+        mutable std::atomic<long long> n_lay_total;
+};
+#endif
@@ -2,10 +2,12 @@
 #define GAS_OPTICS_NN_H
 
 #include <string>
+#include <vector>
 #include "Array.h"
 #include "Netcdf_interface.h"
 #include <Network.h>
 #include "Gas_optics.h"
+#include "Feature_pipeline.h"
 
 #define restrict __restrict__
 // Forward declarations.
@@ -13,6 +15,7 @@ template<typename TF> class Optical_props;
 template<typename TF> class Optical_props_arry;
 template<typename TF> class Gas_concs;
 template<typename TF> class Source_func_lw;
+class Thread_pool;
 
 template<typename TF>
 class Gas_optics_nn : public Gas_optics<TF>
@@ -73,6 +76,20 @@ class Gas_optics_nn : public Gas_optics<TF>
 
         TF get_tsi() const;
 
+        // Flag the columns of which the network inputs of all layers are within n_sigma standard
+        // deviations of the training data, returns the number of layers outside of this envelope.
+        int check_envelope(
+                const Array<TF,2>& play,
+                const Array<TF,2>& tlay,
+                const Array<TF,2>& tlev,
+                const Gas_concs<TF>& gas_desc,
+                const TF n_sigma,
+                std::vector<int>& col_in_envelope) const;
+
+        // Split the batches of the networks over the threads of the pool, which must outlive
+        // the gas optics. The pool can be shared by gas optics that run concurrently.
+        void set_thread_pool(Thread_pool* thread_pool) { this->thread_pool = thread_pool; }
+
     private:
         const TF press_ref_trop = 9948.431564193395; //network is trained on this boundary, so it is hardcoded
         Array<std::string,1> gas_names;
@@ -110,6 +127,9 @@ class Gas_optics_nn : public Gas_optics<TF>
                 std::unique_ptr<Optical_props_arry<TF>>& optical_props,
                 const bool lower_atm, const bool upper_atm) const;
 
+        void initialize_sfc_factor(
+                const Netcdf_file& nc_wgth);
+
         void lay2sfc_factor(
                 const Array<TF,2>& tlay,
                 const Array<TF,1>& tsfc,
@@ -123,6 +143,12 @@ class Gas_optics_nn : public Gas_optics<TF>
         Array<TF,1> solar_source_sunspot;
         Array<TF,1> solar_source;
 
+        // Per band fit of the ratio of surface and surface layer source:
+        // ((coef_sfc*tsfc - 1) / (coef_lay*tlay - 1))^exponent.
+        Array<TF,1> sfc_factor_coef_sfc;
+        Array<TF,1> sfc_factor_coef_lay;
+        Array<TF,1> sfc_factor_exponent;
+
         Network tsw_network;
         Network ssa_network;
         Network tlw_network;
@@ -132,10 +158,18 @@ class Gas_optics_nn : public Gas_optics<TF>
         int n_layer1;
         int n_layer2;
         int n_layer3;
-        int n_o3;
+
+        // Inputs of the optical depth networks, of which the SSA network shares the one of
+        // the TSW network, and of the Planck network.
+        Feature_pipeline<TF> features;
+        int i_input_tau;
+        int i_input_plk;
 
         int idx_tropo;
+        bool is_longwave;
         bool lower_atm;
         bool upper_atm;
+
+        Thread_pool* thread_pool = nullptr;
 };
 #endif
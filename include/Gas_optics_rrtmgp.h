@@ -25,7 +25,10 @@
 #ifndef GAS_OPTICS_RRTMGP_H
 #define GAS_OPTICS_RRTMGP_H
 
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include "Array.h"
 #include "Gas_optics.h"
@@ -160,7 +163,74 @@ class Gas_optics_rrtmgp : public Gas_optics<TF>
                 Array<TF,2>& toa_src,
                 const Array<TF,2>& col_dry) const;
 
+        // Longwave variant for multiple gas scenarios of the same pressure and temperature, such as
+        // the RFMIP perturbation experiments. The part of the interpolation that depends on pressure
+        // and temperature only is computed once, the remainder per scenario.
+        void gas_optics_scenarios(
+                const Array<TF,2>& play,
+                const Array<TF,2>& plev,
+                const Array<TF,2>& tlay,
+                const Array<TF,1>& tsfc,
+                const std::vector<Gas_concs<TF>>& gas_descs,
+                std::vector<std::unique_ptr<Optical_props_arry<TF>>>& optical_props,
+                std::vector<Source_func_lw<TF>>& sources,
+                const std::vector<Array<TF,2>>& col_dry,
+                const Array<TF,2>& tlev) const;
+
+        // Shortwave variant for multiple gas scenarios of the same pressure and temperature.
+        void gas_optics_scenarios(
+                const Array<TF,2>& play,
+                const Array<TF,2>& plev,
+                const Array<TF,2>& tlay,
+                const std::vector<Gas_concs<TF>>& gas_descs,
+                std::vector<std::unique_ptr<Optical_props_arry<TF>>>& optical_props,
+                Array<TF,2>& toa_src,
+                const std::vector<Array<TF,2>>& col_dry) const;
+
+        // Reuse the pressure part of the interpolation (jpress, tropo and the pressure weights)
+        // for layer pressures that deviate at most the relative tolerance from those of a previous
+        // call. The cache holds the pressures of up to max_entries previous calls, such that it
+        // covers all column blocks of a fixed grid. The gas optics then use the C++ interpolation.
+        void enable_pressure_cache(const TF tolerance_rel=TF(0.), const int max_entries=64);
+        void disable_pressure_cache() { pressure_cache.reset(); }
+
+        long get_pressure_cache_hits() const { return pressure_cache ? pressure_cache->n_hit : 0; }
+        long get_pressure_cache_misses() const { return pressure_cache ? pressure_cache->n_miss : 0; }
+
     private:
+        // Interpolation indices and weights that depend on pressure and temperature only.
+        struct Interpolation_pt
+        {
+            Array<int,2> jtemp;
+            Array<int,2> jpress;
+            Array<BOOL_TYPE,2> tropo;
+            Array<TF,2> ftemp;
+            Array<TF,2> fpress;
+        };
+
+        // Pressure part of the interpolation, with the layer pressures it was computed for.
+        struct Interpolation_p
+        {
+            Array<TF,2> play;
+            Array<int,2> jpress;
+            Array<BOOL_TYPE,2> tropo;
+            Array<TF,2> fpress;
+        };
+
+        struct Pressure_cache
+        {
+            TF tolerance_rel;
+            int max_entries;
+            // Entries are shared, such that a lookup compares and copies them without the lock.
+            std::vector<std::shared_ptr<const Interpolation_p>> entries;
+            int i_next = 0; // The entry that is compared first, the one after the last hit.
+            long n_hit = 0;
+            long n_miss = 0;
+            std::mutex mutex;
+        };
+
+        std::unique_ptr<Pressure_cache> pressure_cache;
+
         Array<TF,2> totplnk;
         Array<TF,4> planck_frac;
         TF totplnk_delta;
@@ -260,7 +330,14 @@ class Gas_optics_rrtmgp : public Gas_optics<TF>
                 Array<int,4>& jeta,
                 Array<BOOL_TYPE,2>& tropo,
                 Array<TF,6>& fmajor,
-                const Array<TF,2>& col_dry) const;
+                const Array<TF,2>& col_dry,
+                const Interpolation_pt* interpolation_pt_shared=nullptr) const;
+
+        Interpolation_pt interpolation_pt(
+                const Array<TF,2>& play, const Array<TF,2>& tlay) const;
+
+        Interpolation_p interpolation_p(const Array<TF,2>& play) const;
+        bool find_pressure_cache(const Array<TF,2>& play, Interpolation_pt& interp) const;
 
         void combine_and_reorder(
                 const Array<TF,3>& tau,
@@ -5,15 +5,39 @@
 #include <algorithm>
 #include <string>
 #include <fstream>
+#include <functional>
 #include <vector>
 #include <iostream>
 
+class Thread_pool;
+
+// Weights in block compressed sparse row format. The nonzero blocks of n_block_row by n_block_col
+// weights are stored one after the other, row-major within a block, with the block column of each
+// block in block_col. The blocks of block row i are block_row_start[i] to block_row_start[i+1].
+struct Block_sparse_weights
+{
+    int n_block_row = 0;
+    int n_block_col = 0;
+    std::vector<float> values;
+    std::vector<int> block_col;
+    std::vector<int> block_row_start;
+
+    bool is_set() const { return !block_row_start.empty(); }
+};
+
 class Network
 {
     public:
+        // Receives the denormalized outputs of output neuron i_out for the n_batch batch elements
+        // starting at j_start. For a range of batch elements it is called once per output neuron, in
+        // ascending order, and the outputs are only valid during the call. With a thread pool, the
+        // ranges are tiles of the batch, of which the epilogues are called concurrently.
+        using Output_epilogue = std::function<void(const int i_out, const float* outputs, const int j_start, const int n_batch)>;
+
+        // With a thread pool, the batch is split into cache-sized tiles that are computed in parallel.
         void inference(
             float* inputs,
-            float* outputs,
+            const Output_epilogue& epilogue,
             const int n_batch,
             const int lower_atmos,
             const int do_exp,
@@ -21,7 +45,43 @@ class Network
             const int n_layers,
             const int n_layer1,
             const int n_layer2,
-            const int n_layer3) const;
+            const int n_layer3,
+            Thread_pool* thread_pool=nullptr) const;
+
+        // One inference of a grouped call, with the arguments of inference().
+        struct Problem
+        {
+            const Network* network;
+            float* inputs;
+            Output_epilogue epilogue;
+            int n_batch;
+            int lower_atmos;
+            int do_exp;
+            int do_norm;
+        };
+
+        // Run the inferences of networks with the same hidden layers together, such that small problems
+        // do not run at a poor efficiency on their own. Without a thread pool, the GEMMs of each layer of
+        // all problems are a single grouped BLAS call, with a pool the tiles of all problems are split over
+        // its threads. The inputs are normalized before any network runs, such that a problem without
+        // normalization can share the input of a problem that normalizes it. The epilogues of different
+        // problems are called in any order, and with a pool concurrently.
+        static void inference_group(
+            const std::vector<Problem>& problems,
+            const int n_layers,
+            const int n_layer1,
+            const int n_layer2,
+            const int n_layer3,
+            Thread_pool* thread_pool=nullptr);
+
+        // Clear the flag of each batch element that has an input outside of
+        // n_sigma standard deviations of the mean of the training data.
+        void check_envelope(
+            const float* inputs,
+            int* in_envelope,
+            const int n_batch,
+            const int lower_atmos,
+            const float n_sigma) const;
 
         Network ();
 
@@ -60,6 +120,16 @@ class Network
         std::vector<float> layer3_wgth_upper;
         std::vector<float> layer3_bias_upper;
 
+        //weights of pruned networks, that replace the dense weights if set
+        Block_sparse_weights output_sparse_lower;
+        Block_sparse_weights output_sparse_upper;
+        Block_sparse_weights layer1_sparse_lower;
+        Block_sparse_weights layer1_sparse_upper;
+        Block_sparse_weights layer2_sparse_lower;
+        Block_sparse_weights layer2_sparse_upper;
+        Block_sparse_weights layer3_sparse_lower;
+        Block_sparse_weights layer3_sparse_upper;
+
         //means and standard deviations to (de)normalize inputs and optical properties
         std::vector<float> mean_input_lower;
         std::vector<float> stdev_input_lower;
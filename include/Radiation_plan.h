@@ -0,0 +1,244 @@
+/*
+ * This file is part of a C++ interface to the Radiative Transfer for Energetics (RTE)
+ * and Rapid Radiative Transfer Model for GCM applications Parallel (RRTMGP).
+ *
+ * The original code is found at https://github.com/earth-system-radiation/rte-rrtmgp.
+ *
+ * Contacts: Robert Pincus and Eli Mlawer
+ * email: rrtmgp@aer.com
+ *
+ * Copyright 2015-2020,  Atmospheric and Environmental Research and
+ * Regents of the University of Colorado.  All right reserved.
+ *
+ * This C++ interface can be downloaded from https://github.com/earth-system-radiation/rte-rrtmgp-cpp
+ *
+ * Contact: Chiel van Heerwaarden
+ * email: chiel.vanheerwaarden@wur.nl
+ *
+ * Copyright 2020, Wageningen University & Research.
+ *
+ * Use and duplication is permitted under the terms of the
+ * BSD 3-clause license, see http://opensource.org/licenses/BSD-3-Clause
+ *
+ */
+
+
+#ifndef RADIATION_PLAN_H
+#define RADIATION_PLAN_H
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Array.h"
+
+template<typename> class Gas_optics;
+template<typename> class Cloud_optics;
+template<typename> class Gas_concs;
+
+// Plans for repeated radiation solves on a fixed grid, in the spirit of FFTW plans.
+//
+// make_plan() takes all decisions that only depend on the grid: the column block size, which is
+// optionally measured, and the allocation of the optical properties, sources and g-point fluxes
+// of every block. execute() then only copies the inputs block by block into these workspaces,
+// runs the gas optics, cloud optics and solver, and writes the broadband fluxes into the outputs.
+//
+// A plan holds n_workspaces workspaces. execute() is const and takes a free workspace for the
+// duration of the call, so up to n_workspaces threads can execute the same plan at once, and
+// further callers wait until a workspace is returned.
+
+enum class Plan_rigor { Estimate, Measure };
+
+struct Radiation_plan_options
+{
+    // Columns per block. If zero, the block size is estimated or measured, depending on rigor.
+    int n_col_block = 0;
+
+    // Number of execute() calls that can run concurrently on the plan.
+    int n_workspaces = 1;
+
+    // Measure selects the block size by timing a set of candidates on the tuning inputs.
+    Plan_rigor rigor = Plan_rigor::Estimate;
+    int n_measure_repeat = 3;
+
+    bool switch_cloud_optics = false;
+};
+
+// The inputs are views on arrays owned by the caller, with the same shapes as in the solvers of
+// the test code. The cloud properties are only read if the plan has cloud optics. The gases are
+// taken from gas_concs, or if that is null, from the views in gas_vmr, which have the shape
+// (n_col, n_lay), or (1, n_lay) for gases that are equal in all columns, or (1, 1) for constants.
+// All shapes are checked against the plan before solving, empty outputs are skipped.
+template<typename TF>
+struct Radiation_inputs_lw
+{
+    const Gas_concs<TF>* gas_concs = nullptr;
+    std::map<std::string, Array_view<TF,2>> gas_vmr;
+    Array_view<TF,2> p_lay, p_lev;
+    Array_view<TF,2> t_lay, t_lev;
+    Array_view<TF,2> col_dry; // Computed from the water vapor if empty.
+    Array_view<TF,1> t_sfc;
+    Array_view<TF,2> emis_sfc;
+    Array_view<TF,2> lwp, iwp;
+    Array_view<TF,2> rel, rei;
+};
+
+template<typename TF>
+struct Radiation_outputs_lw
+{
+    Array_view<TF,2> flux_up, flux_dn, flux_net;
+};
+
+template<typename TF>
+struct Radiation_inputs_sw
+{
+    const Gas_concs<TF>* gas_concs = nullptr;
+    std::map<std::string, Array_view<TF,2>> gas_vmr;
+    Array_view<TF,2> p_lay, p_lev;
+    Array_view<TF,2> t_lay, t_lev;
+    Array_view<TF,2> col_dry; // Computed from the water vapor if empty.
+    Array_view<TF,2> sfc_alb_dir, sfc_alb_dif;
+    Array_view<TF,1> tsi_scaling, mu0;
+    Array_view<TF,2> lwp, iwp;
+    Array_view<TF,2> rel, rei;
+};
+
+template<typename TF>
+struct Radiation_outputs_sw
+{
+    Array_view<TF,2> flux_up, flux_dn, flux_dn_dir, flux_net;
+};
+
+// Fixed set of workspaces that are handed out to one caller at a time.
+template<typename T>
+class Workspace_pool
+{
+    public:
+        void add(std::unique_ptr<T> workspace)
+        {
+            free_workspaces.push_back(workspace.get());
+            workspaces.push_back(std::move(workspace));
+        }
+
+        T& acquire()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            available.wait(lock, [&]{ return !free_workspaces.empty(); });
+            T* workspace = free_workspaces.back();
+            free_workspaces.pop_back();
+            return *workspace;
+        }
+
+        void release(T& workspace)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                free_workspaces.push_back(&workspace);
+            }
+            available.notify_one();
+        }
+
+        int size() const { return workspaces.size(); }
+
+    private:
+        std::vector<std::unique_ptr<T>> workspaces;
+        std::vector<T*> free_workspaces;
+        std::mutex mutex;
+        std::condition_variable available;
+};
+
+template<typename TF>
+class Radiation_plan_lw
+{
+    public:
+        // The gas and cloud optics must outlive the plan. cloud_optics may be null if the options
+        // do not enable clouds. Measuring the block size requires tuning_inputs with n_col columns.
+        static std::unique_ptr<Radiation_plan_lw<TF>> make_plan(
+                const Gas_optics<TF>& kdist,
+                const Cloud_optics<TF>* cloud_optics,
+                const int n_col, const int n_lay,
+                const Radiation_plan_options& options,
+                const Radiation_inputs_lw<TF>* tuning_inputs=nullptr);
+
+        ~Radiation_plan_lw();
+
+        void execute(const Radiation_inputs_lw<TF>& inputs, Radiation_outputs_lw<TF>& outputs) const;
+
+        int get_n_col() const { return n_col; }
+        int get_n_lay() const { return n_lay; }
+        int get_n_col_block() const { return n_col_block; }
+        int get_n_workspaces() const { return workspaces->size(); }
+
+        struct Workspace;
+
+    private:
+        Radiation_plan_lw(
+                const Gas_optics<TF>& kdist, const Cloud_optics<TF>* cloud_optics,
+                const int n_col, const int n_lay, const bool switch_cloud_optics);
+
+        void solve(
+                Workspace& workspace, const int n_col_solve,
+                const Radiation_inputs_lw<TF>& inputs, Radiation_outputs_lw<TF>& outputs) const;
+
+        std::unique_ptr<Workspace> make_workspace(const int n_col_block, const int n_col_solve) const;
+
+        const Gas_optics<TF>& kdist;
+        const Cloud_optics<TF>* cloud_optics;
+
+        const int n_col;
+        const int n_lay;
+        const bool switch_cloud_optics;
+        int n_col_block;
+
+        std::unique_ptr<Workspace_pool<Workspace>> workspaces;
+};
+
+template<typename TF>
+class Radiation_plan_sw
+{
+    public:
+        // The gas and cloud optics must outlive the plan. cloud_optics may be null if the options
+        // do not enable clouds. Measuring the block size requires tuning_inputs with n_col columns.
+        static std::unique_ptr<Radiation_plan_sw<TF>> make_plan(
+                const Gas_optics<TF>& kdist,
+                const Cloud_optics<TF>* cloud_optics,
+                const int n_col, const int n_lay,
+                const Radiation_plan_options& options,
+                const Radiation_inputs_sw<TF>* tuning_inputs=nullptr);
+
+        ~Radiation_plan_sw();
+
+        void execute(const Radiation_inputs_sw<TF>& inputs, Radiation_outputs_sw<TF>& outputs) const;
+
+        int get_n_col() const { return n_col; }
+        int get_n_lay() const { return n_lay; }
+        int get_n_col_block() const { return n_col_block; }
+        int get_n_workspaces() const { return workspaces->size(); }
+
+        struct Workspace;
+
+    private:
+        Radiation_plan_sw(
+                const Gas_optics<TF>& kdist, const Cloud_optics<TF>* cloud_optics,
+                const int n_col, const int n_lay, const bool switch_cloud_optics);
+
+        void solve(
+                Workspace& workspace, const int n_col_solve,
+                const Radiation_inputs_sw<TF>& inputs, Radiation_outputs_sw<TF>& outputs) const;
+
+        std::unique_ptr<Workspace> make_workspace(const int n_col_block, const int n_col_solve) const;
+
+        const Gas_optics<TF>& kdist;
+        const Cloud_optics<TF>* cloud_optics;
+
+        const int n_col;
+        const int n_lay;
+        const bool switch_cloud_optics;
+        int n_col_block;
+
+        std::unique_ptr<Workspace_pool<Workspace>> workspaces;
+};
+#endif
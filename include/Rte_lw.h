@@ -48,6 +48,19 @@ class Rte_lw
                 Array<TF,3>& gpt_flux_dn,
                 const int n_gauss_angles);
 
+        // As above, and return the derivative of the upward g-point fluxes to the surface temperature,
+        // computed from the surface source Jacobian of the sources.
+        static void rte_lw(
+                const std::unique_ptr<Optical_props_arry<TF>>& optical_props,
+                const BOOL_TYPE top_at_1,
+                const Source_func_lw<TF>& sources,
+                const Array<TF,2>& sfc_emis,
+                const Array<TF,2>& inc_flux,
+                Array<TF,3>& gpt_flux_up,
+                Array<TF,3>& gpt_flux_dn,
+                Array<TF,3>& gpt_flux_up_jac,
+                const int n_gauss_angles);
+
         static void expand_and_transpose(
                 const std::unique_ptr<Optical_props_arry<TF>>& ops,
                 const Array<TF,2> arr_in,
@@ -26,6 +26,7 @@
 #define RTE_SW_H
 
 #include <memory>
+#include <vector>
 #include "define_bool.h"
 
 // Forward declarations.
@@ -49,6 +50,37 @@ class Rte_sw
                 Array<TF,3>& gpt_flux_dn,
                 Array<TF,3>& gpt_flux_dir);
 
+        // Solve the fluxes for several pairs of surface albedos. The layer reflectance and transmittance,
+        // the direct beam and the sources of scattered direct radiation do not depend on the surface and
+        // are computed once, only the adding pass is repeated for each scenario. The direct flux is
+        // independent of the surface albedo and therefore returned once.
+        static void rte_sw_albedos(
+                const std::unique_ptr<Optical_props_arry<TF>>& optical_props,
+                const BOOL_TYPE top_at_1,
+                const Array<TF,1>& mu0,
+                const Array<TF,2>& inc_flux_dir,
+                const std::vector<Array<TF,2>>& sfc_alb_dir,
+                const std::vector<Array<TF,2>>& sfc_alb_dif,
+                const Array<TF,2>& inc_flux_dif,
+                std::vector<Array<TF,3>>& gpt_flux_up,
+                std::vector<Array<TF,3>>& gpt_flux_dn,
+                Array<TF,3>& gpt_flux_dir);
+
+        // Solve the fluxes for several cosines of the solar zenith angle. The diffuse reflectance and
+        // transmittance of the layers do not depend on the angle and are computed once, the direct beam,
+        // its sources and the adding pass are computed for each angle. Scenario i uses mu0[i].
+        static void rte_sw_mu0s(
+                const std::unique_ptr<Optical_props_arry<TF>>& optical_props,
+                const BOOL_TYPE top_at_1,
+                const std::vector<Array<TF,1>>& mu0,
+                const Array<TF,2>& inc_flux_dir,
+                const Array<TF,2>& sfc_alb_dir,
+                const Array<TF,2>& sfc_alb_dif,
+                const Array<TF,2>& inc_flux_dif,
+                std::vector<Array<TF,3>>& gpt_flux_up,
+                std::vector<Array<TF,3>>& gpt_flux_dn,
+                std::vector<Array<TF,3>>& gpt_flux_dir);
+
         static void expand_and_transpose(
                 const std::unique_ptr<Optical_props_arry<TF>>& ops,
                 const Array<TF,2> arr_in,
@@ -46,15 +46,31 @@ class Source_func_lw : public Optical_props<TF>
                 const Source_func_lw<TF>& sources_sub,
                 const int col_s, const int col_e);
 
+        // Store the sources at the bottom and top level of each layer separately, for gas optics
+        // that give these independently, such as the networks. The Planck function of the levels
+        // and the Planck fractions are released.
+        void split_lev_source();
+        bool lev_source_is_split() const { return lev_source_inc.size() > 0; }
+
+        // Write the sources at the top (inc) and the bottom (dec) level of each layer for the
+        // g-points gpt_s to gpt_e into arrays of shape (n_col, n_lay, gpt_e-gpt_s+1).
+        void derive_lev_source(
+                const int gpt_s, const int gpt_e,
+                TF* lev_source_inc_out, TF* lev_source_dec_out) const;
+
         Array<TF,2>& get_sfc_source()     { return sfc_source;     }
         Array<TF,2>& get_sfc_source_jac() { return sfc_source_jac; }
         Array<TF,3>& get_lay_source()     { return lay_source;     }
+        Array<TF,3>& get_lev_source()     { return lev_source;     }
+        Array<TF,3>& get_pfrac()          { return pfrac;          }
         Array<TF,3>& get_lev_source_inc() { return lev_source_inc; }
         Array<TF,3>& get_lev_source_dec() { return lev_source_dec; }
 
         const Array<TF,2>& get_sfc_source()     const { return sfc_source;     }
         const Array<TF,2>& get_sfc_source_jac() const { return sfc_source_jac; }
         const Array<TF,3>& get_lay_source()     const { return lay_source;     }
+        const Array<TF,3>& get_lev_source()     const { return lev_source;     }
+        const Array<TF,3>& get_pfrac()          const { return pfrac;          }
         const Array<TF,3>& get_lev_source_inc() const { return lev_source_inc; }
         const Array<TF,3>& get_lev_source_dec() const { return lev_source_dec; }
 
@@ -62,6 +78,13 @@ class Source_func_lw : public Optical_props<TF>
         Array<TF,2> sfc_source;
         Array<TF,2> sfc_source_jac;
         Array<TF,3> lay_source;
+
+        // Planck function of the levels (n_col, n_lay+1, n_bnd) and the fraction of it in each
+        // g-point of the layers (n_col, n_lay, n_gpt). Their product gives the level sources.
+        Array<TF,3> lev_source;
+        Array<TF,3> pfrac;
+
+        // Level sources (n_col, n_lay, n_gpt) of the split form only.
         Array<TF,3> lev_source_inc;
         Array<TF,3> lev_source_dec;
 };
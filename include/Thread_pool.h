@@ -0,0 +1,86 @@
+/*
+ * This file is part of a C++ interface to the Radiative Transfer for Energetics (RTE)
+ * and Rapid Radiative Transfer Model for GCM applications Parallel (RRTMGP).
+ *
+ * The original code is found at https://github.com/earth-system-radiation/rte-rrtmgp.
+ *
+ * Contacts: Robert Pincus and Eli Mlawer
+ * email: rrtmgp@aer.com
+ *
+ * Copyright 2015-2020,  Atmospheric and Environmental Research and
+ * Regents of the University of Colorado.  All right reserved.
+ *
+ * This C++ interface can be downloaded from https://github.com/earth-system-radiation/rte-rrtmgp-cpp
+ *
+ * Contact: Chiel van Heerwaarden
+ * email: chiel.vanheerwaarden@wur.nl
+ *
+ * Copyright 2020, Wageningen University & Research.
+ *
+ * Use and duplication is permitted under the terms of the
+ * BSD 3-clause license, see http://opensource.org/licenses/BSD-3-Clause
+ *
+ */
+
+
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Pool of worker threads that share the tasks of parallel_for() with its caller.
+//
+// The caller of parallel_for() always works on its own tasks, and idle workers join in. Calls from
+// several threads at once, for instance one per column block, therefore share the workers without
+// starting new threads: the total number of threads never exceeds the callers plus the workers.
+// A pool of n_threads has n_threads-1 workers, such that a single caller and the workers fill
+// n_threads cores. Calls from inside a task run serially on the calling worker.
+class Thread_pool
+{
+    public:
+        explicit Thread_pool(const int n_threads);
+        ~Thread_pool();
+
+        Thread_pool(const Thread_pool&) = delete;
+        Thread_pool& operator=(const Thread_pool&) = delete;
+
+        // Run task(i_task, i_thread) for all i_task in [0, n_tasks) and wait for their completion.
+        // i_thread is 0 for the caller and 1 to n_threads-1 for the workers, and no two tasks with
+        // the same i_thread run at once within one call. The first exception of a task is rethrown.
+        void parallel_for(const int n_tasks, const std::function<void(int, int)>& task);
+
+        int get_n_threads() const { return n_threads; }
+
+    private:
+        struct Job
+        {
+            const std::function<void(int, int)>* task;
+            int n_tasks;
+            std::atomic<int> i_task_next;
+            std::atomic<int> n_tasks_done;
+            int n_workers;
+            std::exception_ptr exception;
+            std::mutex exception_mutex;
+        };
+
+        void work(const int i_thread);
+        void run_tasks(Job& job, const int i_thread);
+
+        const int n_threads;
+        std::vector<std::thread> workers;
+
+        std::mutex mutex;
+        std::condition_variable job_available;
+        std::condition_variable job_finished;
+        std::deque<Job*> jobs;
+        bool stop;
+};
+#endif
@@ -0,0 +1,146 @@
+/*
+ * This file is part of a C++ interface to the Radiative Transfer for Energetics (RTE)
+ * and Rapid Radiative Transfer Model for GCM applications Parallel (RRTMGP).
+ *
+ * The original code is found at https://github.com/earth-system-radiation/rte-rrtmgp.
+ *
+ * Contacts: Robert Pincus and Eli Mlawer
+ * email: rrtmgp@aer.com
+ *
+ * Copyright 2015-2020,  Atmospheric and Environmental Research and
+ * Regents of the University of Colorado.  All right reserved.
+ *
+ * This C++ interface can be downloaded from https://github.com/earth-system-radiation/rte-rrtmgp-cpp
+ *
+ * Contact: Chiel van Heerwaarden
+ * email: chiel.vanheerwaarden@wur.nl
+ *
+ * Copyright 2020, Wageningen University & Research.
+ *
+ * Use and duplication is permitted under the terms of the
+ * BSD 3-clause license, see http://opensource.org/licenses/BSD-3-Clause
+ *
+ */
+
+#ifndef COLUMN_KERNELS_H
+#define COLUMN_KERNELS_H
+
+#include <vector>
+
+#include "Array.h"
+
+// Gather and scatter of a selection of columns, the first dimension of the arrays.
+// Column indices start at 1, as in Array.
+namespace column_kernels
+{
+    // Copy the selected columns into a new array. Arrays with a first dimension
+    // of 1 are spread over all columns and are returned as they are.
+    template<typename T, int N>
+    inline Array<T,N> gather(const Array<T,N>& in, const std::vector<int>& cols)
+    {
+        if (in.is_empty() || in.dim(1) == 1)
+            return in;
+
+        const int ncol_in = in.dim(1);
+        const int ncol_out = cols.size();
+
+        std::array<int,N> dims_out = in.get_dims();
+        dims_out[0] = ncol_out;
+        Array<T,N> out(dims_out);
+
+        const int n_outer = in.size() / ncol_in;
+        const T* data_in = in.ptr();
+        T* data_out = out.ptr();
+
+        for (int n=0; n<n_outer; ++n)
+            for (int icol=0; icol<ncol_out; ++icol)
+                data_out[icol + n*ncol_out] = data_in[cols[icol]-1 + n*ncol_in];
+
+        return out;
+    }
+
+    // Copy the selected columns of a view, that may be strided, into a new array.
+    template<typename T, int N>
+    inline Array<typename std::remove_const<T>::type, N> gather(
+            const Array_view<T,N>& in, const std::vector<int>& cols)
+    {
+        if (in.is_empty() || in.dim(1) == 1)
+        {
+            std::array<std::pair<int, int>, N> ranges;
+            for (int i=0; i<N; ++i)
+                ranges[i] = {1, in.dim(i+1)};
+            return in.subset(ranges);
+        }
+
+        const std::array<int,N> dims_in = in.get_dims();
+        const std::array<int,N> strides_in = in.get_strides();
+        const int ncol_in = in.dim(1);
+        const int ncol_out = cols.size();
+
+        std::array<int,N> dims_out = dims_in;
+        dims_out[0] = ncol_out;
+        Array<typename std::remove_const<T>::type, N> out(dims_out);
+
+        const int n_outer = in.size() / ncol_in;
+        const T* data_in = in.ptr();
+        auto* data_out = out.ptr();
+
+        for (int n=0; n<n_outer; ++n)
+        {
+            // Memory offset of the outer index n.
+            int offset = 0;
+            int n_rem = n;
+            for (int i=1; i<N; ++i)
+            {
+                offset += (n_rem % dims_in[i]) * strides_in[i];
+                n_rem /= dims_in[i];
+            }
+
+            for (int icol=0; icol<ncol_out; ++icol)
+                data_out[icol + n*ncol_out] = data_in[(cols[icol]-1)*strides_in[0] + offset];
+        }
+
+        return out;
+    }
+
+    // Copy the selected columns of a view with the columns in the second dimension,
+    // such as the surface emissivity and albedo (band, col), into a new array. Views with
+    // a second dimension of 1 are spread over all columns and are copied as they are.
+    template<typename T>
+    inline Array<typename std::remove_const<T>::type, 2> gather_dim2(
+            const Array_view<T,2>& in, const std::vector<int>& cols)
+    {
+        if (in.is_empty() || in.dim(2) == 1)
+            return in.subset({{ {1, in.dim(1)}, {1, in.dim(2)} }});
+
+        const int n_inner = in.dim(1);
+        const int ncol_out = cols.size();
+
+        Array<typename std::remove_const<T>::type, 2> out({n_inner, ncol_out});
+        for (int icol=1; icol<=ncol_out; ++icol)
+            for (int i=1; i<=n_inner; ++i)
+                out({i, icol}) = in({i, cols[icol-1]});
+
+        return out;
+    }
+
+    // Copy all columns of in into the selected columns of out.
+    template<typename T, int N>
+    inline void scatter(Array<T,N>& out, const Array<T,N>& in, const std::vector<int>& cols)
+    {
+        if (in.is_empty())
+            return;
+
+        const int ncol_in = in.dim(1);
+        const int ncol_out = out.dim(1);
+
+        const int n_outer = in.size() / ncol_in;
+        const T* data_in = in.ptr();
+        T* data_out = out.ptr();
+
+        for (int n=0; n<n_outer; ++n)
+            for (int icol=0; icol<ncol_in; ++icol)
+                data_out[cols[icol]-1 + n*ncol_out] = data_in[icol + n*ncol_in];
+    }
+}
+#endif
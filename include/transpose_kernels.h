@@ -0,0 +1,121 @@
+/*
+ * This file is part of a C++ interface to the Radiative Transfer for Energetics (RTE)
+ * and Rapid Radiative Transfer Model for GCM applications Parallel (RRTMGP).
+ *
+ * The original code is found at https://github.com/earth-system-radiation/rte-rrtmgp.
+ *
+ * Contacts: Robert Pincus and Eli Mlawer
+ * email: rrtmgp@aer.com
+ *
+ * Copyright 2015-2020,  Atmospheric and Environmental Research and
+ * Regents of the University of Colorado.  All right reserved.
+ *
+ * This C++ interface can be downloaded from https://github.com/earth-system-radiation/rte-rrtmgp-cpp
+ *
+ * Contact: Chiel van Heerwaarden
+ * email: chiel.vanheerwaarden@wur.nl
+ *
+ * Copyright 2020, Wageningen University & Research.
+ *
+ * Use and duplication is permitted under the terms of the
+ * BSD 3-clause license, see http://opensource.org/licenses/BSD-3-Clause
+ *
+ */
+
+
+#ifndef TRANSPOSE_KERNELS_H
+#define TRANSPOSE_KERNELS_H
+
+#include <algorithm>
+#include <limits>
+
+#include "Cpu_dispatch.h"
+
+// Cache-blocked transposes, used for the reorders between the (gpt, lay, col) ordering of
+// the gas optics kernels and the (col, lay, gpt) ordering of the optical properties.
+namespace transpose_kernels
+{
+    // Width of a tile in elements. A tile pair has to fit in L1, and the rows should
+    // span whole SIMD registers such that the contiguous loads vectorize. With dispatch the
+    // tiles are sized for the widest variant, which still fit in L1 for the narrower ones.
+    template<typename TF>
+    constexpr int tile_size()
+    {
+        #if defined(__AVX512F__) || defined(CPU_DISPATCH)
+        return sizeof(TF) == 4 ? 32 : 16;
+        #elif defined(__AVX2__) || defined(__AVX__)
+        return 16;
+        #else
+        return sizeof(TF) == 4 ? 16 : 8;
+        #endif
+    }
+
+    // Transpose a (n1, n2) matrix into a (n2, n1) matrix, both Fortran-ordered with leading dimensions.
+    template<typename TF>
+    DISPATCH_KERNEL inline void transpose_2d(
+            TF* __restrict__ out, const int ld_out,
+            const TF* __restrict__ in, const int ld_in,
+            const int n1, const int n2)
+    {
+        constexpr int nt = tile_size<TF>();
+
+        for (int j0=0; j0<n2; j0+=nt)
+            for (int i0=0; i0<n1; i0+=nt)
+            {
+                const int i1 = std::min(i0+nt, n1);
+                const int j1 = std::min(j0+nt, n2);
+
+                for (int j=j0; j<j1; ++j)
+                    #pragma GCC ivdep
+                    for (int i=i0; i<i1; ++i)
+                        out[j + i*ld_out] = in[i + j*ld_in];
+            }
+    }
+
+    // Reorder a (d1, d2, d3) array into (d3, d2, d1), as reorder_123x321_kernel.
+    template<typename TF>
+    inline void reorder_123x321(
+            TF* __restrict__ out, const TF* __restrict__ in,
+            const int d1, const int d2, const int d3)
+    {
+        for (int j=0; j<d2; ++j)
+            transpose_2d(out + j*d3, d3*d2, in + j*d1, d1*d2, d1, d3);
+    }
+
+    // Sum the absorption and Rayleigh optical depths and reorder them from (ngpt, nlay, ncol)
+    // into tau, ssa and g of (ncol, nlay, ngpt), as combine_and_reorder_2str.
+    template<typename TF>
+    DISPATCH_KERNEL inline void combine_and_reorder_2str(
+            TF* __restrict__ tau, TF* __restrict__ ssa, TF* __restrict__ g,
+            const TF* __restrict__ tau_abs, const TF* __restrict__ tau_rayleigh,
+            const int ncol, const int nlay, const int ngpt)
+    {
+        constexpr int nt = tile_size<TF>();
+        constexpr TF tau_min = TF(2.)*std::numeric_limits<TF>::min();
+
+        const int ld_out = ncol*nlay;
+        const int ld_in = ngpt*nlay;
+
+        for (int ilay=0; ilay<nlay; ++ilay)
+            for (int icol0=0; icol0<ncol; icol0+=nt)
+                for (int igpt0=0; igpt0<ngpt; igpt0+=nt)
+                {
+                    const int icol1 = std::min(icol0+nt, ncol);
+                    const int igpt1 = std::min(igpt0+nt, ngpt);
+
+                    for (int icol=icol0; icol<icol1; ++icol)
+                        #pragma GCC ivdep
+                        for (int igpt=igpt0; igpt<igpt1; ++igpt)
+                        {
+                            const int idx_in = igpt + ilay*ngpt + icol*ld_in;
+                            const int idx_out = icol + ilay*ncol + igpt*ld_out;
+
+                            const TF t = tau_abs[idx_in] + tau_rayleigh[idx_in];
+                            tau[idx_out] = t;
+                            ssa[idx_out] = (t > tau_min) ? tau_rayleigh[idx_in] / t : TF(0.);
+                            g  [idx_out] = TF(0.);
+                        }
+                }
+    }
+}
+#endif
@@ -0,0 +1,100 @@
+/*
+ * This file is part of a C++ interface to the Radiative Transfer for Energetics (RTE)
+ * and Rapid Radiative Transfer Model for GCM applications Parallel (RRTMGP).
+ *
+ * The original code is found at https://github.com/earth-system-radiation/rte-rrtmgp.
+ *
+ * Contacts: Robert Pincus and Eli Mlawer
+ * email: rrtmgp@aer.com
+ *
+ * Copyright 2015-2020,  Atmospheric and Environmental Research and
+ * Regents of the University of Colorado.  All right reserved.
+ *
+ * This C++ interface can be downloaded from https://github.com/earth-system-radiation/rte-rrtmgp-cpp
+ *
+ * Contact: Chiel van Heerwaarden
+ * email: chiel.vanheerwaarden@wur.nl
+ *
+ * Copyright 2020, Wageningen University & Research.
+ *
+ * Use and duplication is permitted under the terms of the
+ * BSD 3-clause license, see http://opensource.org/licenses/BSD-3-Clause
+ *
+ */
+
+
+#ifndef VECTOR_MATH_H
+#define VECTOR_MATH_H
+
+#include <cstdint>
+#include <cstring>
+
+// Logarithm, exponential and power that vectorize without -ffast-math or a vector math library.
+// They only use arithmetic and bit operations on doubles and 64-bit integers, and are accurate
+// to a few ulp in double precision. Arguments are assumed to be finite, and positive for log and pow.
+namespace vector_math
+{
+    inline double log(const double x)
+    {
+        std::uint64_t bits;
+        std::memcpy(&bits, &x, sizeof(double));
+
+        // Split x = 2^e * m with m in [sqrt(1/2), sqrt(2)).
+        const std::uint64_t bits_shifted = bits + (UINT64_C(0x3ff0000000000000) - UINT64_C(0x3fe6a09e667f3bcd));
+        // The biased exponent is converted by placing it in the mantissa of 2^52, as vectors
+        // of 64-bit integers cannot be converted to doubles before AVX-512.
+        const std::uint64_t bits_e = (bits_shifted >> 52) | UINT64_C(0x4330000000000000);
+        double e;
+        std::memcpy(&e, &bits_e, sizeof(double));
+        e -= 4503599627370496. + 1023.;
+        const std::uint64_t bits_m = (bits_shifted & UINT64_C(0x000fffffffffffff)) + UINT64_C(0x3fe6a09e667f3bcd);
+        double m;
+        std::memcpy(&m, &bits_m, sizeof(double));
+
+        // log(m) = 2 atanh(s) with s = (m-1)/(m+1), thus |s| < 0.172.
+        const double s = (m - 1.) / (m + 1.);
+        const double s2 = s*s;
+        const double p =
+                1./3. + s2*(1./5. + s2*(1./7. + s2*(1./9. + s2*(1./11. + s2*(1./13.
+              + s2*(1./15. + s2*(1./17. + s2*(1./19. + s2*(1./21.)))))))));
+
+        constexpr double ln2_hi = 6.93147180369123816490e-01;
+        constexpr double ln2_lo = 1.90821492927058770002e-10;
+        return e*ln2_hi + (2.*s + (2.*s*s2*p + e*ln2_lo));
+    }
+
+    inline double exp(const double x)
+    {
+        // Round x/ln(2) to the nearest integer n by adding and subtracting 1.5*2^52, which leaves n
+        // in the low bits of the sum, such that no conversion from double to integer is needed.
+        constexpr double shift = 6755399441055744.;
+        constexpr double inv_ln2 = 1.44269504088896338700e+00;
+        const double n_shifted = x*inv_ln2 + shift;
+        const double n = n_shifted - shift;
+
+        constexpr double ln2_hi = 6.93147180369123816490e-01;
+        constexpr double ln2_lo = 1.90821492927058770002e-10;
+        const double r = (x - n*ln2_hi) - n*ln2_lo;
+
+        // Taylor series of exp(r) for |r| <= ln(2)/2.
+        const double p =
+                1. + r*(1. + r*(1./2. + r*(1./6. + r*(1./24. + r*(1./120. + r*(1./720.
+              + r*(1./5040. + r*(1./40320. + r*(1./362880. + r*(1./3628800.
+              + r*(1./39916800. + r*(1./479001600. + r*(1./6227020800.)))))))))))));
+
+        // Scale by 2^n, valid for results in the normal range.
+        std::uint64_t bits;
+        std::memcpy(&bits, &n_shifted, sizeof(double));
+        bits = (bits << 52) + UINT64_C(0x3ff0000000000000);
+        double scale;
+        std::memcpy(&scale, &bits, sizeof(double));
+
+        return p*scale;
+    }
+
+    inline double pow(const double x, const double y)
+    {
+        return vector_math::exp(y*vector_math::log(x));
+    }
+}
+#endif
@@ -0,0 +1,167 @@
+/*
+ * This file is part of the local radiation service that is
+ * used for the testing of the C++ interface to the RTE+RRTMGP radiation code.
+ *
+ * It is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RADIATION_SERVICE_H
+#define RADIATION_SERVICE_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Protocol of the local radiation service, see radiation_server.cpp.
+//
+// A client places its columns in a POSIX shared memory segment, which starts with a
+// Segment_header that is followed by the fields in the order of Segment_layout. It then sends
+// the name of the segment over a Unix domain socket. The server reads the inputs directly from
+// the segment, writes the fluxes back into it, and answers with the status of the solve. The
+// fields are stored as in the solvers: the column is the fastest varying dimension, so p_lay is
+// (n_col, n_lay) and flux_up is (n_col, n_lev). The surface properties have one value per
+// column, that is used in all bands.
+namespace Radiation_service
+{
+    constexpr int max_gases = 32;
+    constexpr int gas_name_length = 16;
+    constexpr int error_length = 256;
+    constexpr int segment_name_length = 64;
+
+    enum class Request_type : int { Longwave = 0, Shortwave = 1 };
+
+    struct Segment_header
+    {
+        Request_type type;
+        int n_col;
+        int n_lay;
+        int n_gas;
+        char gas_names[max_gases][gas_name_length];
+
+        // Written by the server.
+        int status;
+        char error[error_length];
+    };
+
+    struct Request_message
+    {
+        char segment_name[segment_name_length];
+    };
+
+    struct Response_message
+    {
+        int status;
+    };
+
+    enum class Field_kind { Input, Gas, Output };
+
+    struct Field
+    {
+        std::string name;
+        Field_kind kind;
+        int n_per_col; // Number of values per column: n_lay, n_lev or 1.
+        size_t offset; // Offset in values from the start of the data.
+    };
+
+    // Position of the fields in the data that follows the header.
+    class Segment_layout
+    {
+        public:
+            Segment_layout(
+                    const Request_type type, const int n_col, const int n_lay,
+                    const std::vector<std::string>& gas_names);
+
+            // Layout of the fields that are described in a header.
+            explicit Segment_layout(const Segment_header& header);
+
+            const std::vector<Field>& get_fields() const { return fields; }
+            const Field& get_field(const std::string& name) const;
+            bool has_field(const std::string& name) const;
+
+            int get_n_col() const { return n_col; }
+            int get_n_lay() const { return n_lay; }
+
+            // Size of the data, and of the segment including the header.
+            size_t get_n_values() const { return n_values; }
+            size_t get_n_bytes() const;
+
+            // The data starts at a cache line after the header.
+            static constexpr size_t header_bytes = (sizeof(Segment_header) + 63) / 64 * 64;
+
+        private:
+            void add_field(const std::string& name, const Field_kind kind, const int n_per_col);
+
+            int n_col;
+            int n_lay;
+            std::vector<Field> fields;
+            size_t n_values;
+    };
+
+    // Mapping of a shared memory segment. The segment is removed by the process that created it.
+    class Shared_segment
+    {
+        public:
+            static std::unique_ptr<Shared_segment> create(const std::string& name, const size_t n_bytes);
+            static std::unique_ptr<Shared_segment> open(const std::string& name);
+
+            ~Shared_segment();
+
+            Segment_header& get_header() { return *static_cast<Segment_header*>(address); }
+            double* get_data() { return reinterpret_cast<double*>(static_cast<char*>(address) + Segment_layout::header_bytes); }
+
+            const std::string& get_name() const { return name; }
+            size_t get_n_bytes() const { return n_bytes; }
+
+        private:
+            Shared_segment(const std::string& name, void* address, const size_t n_bytes, const bool owner);
+
+            const std::string name;
+            void* address;
+            const size_t n_bytes;
+            const bool owner;
+    };
+
+    // Blocking transfer of a fixed size message, which returns false if the peer closed the connection.
+    bool receive_message(const int socket_fd, void* message, const size_t n_bytes);
+    void send_message(const int socket_fd, const void* message, const size_t n_bytes);
+
+    // Connection to the server. prepare() sets up a segment for a request, into which the inputs
+    // are written through field() and gas(). solve() then blocks until the fluxes are available
+    // through field(). A segment can be reused for any number of solves with the same sizes.
+    class Client
+    {
+        public:
+            explicit Client(const std::string& socket_path);
+            ~Client();
+
+            Client(const Client&) = delete;
+            Client& operator=(const Client&) = delete;
+
+            void prepare(
+                    const Request_type type, const int n_col, const int n_lay,
+                    const std::vector<std::string>& gas_names);
+
+            double* field(const std::string& name);
+            double* gas(const std::string& name);
+
+            void solve();
+
+        private:
+            int socket_fd;
+            std::unique_ptr<Shared_segment> segment;
+            std::unique_ptr<Segment_layout> layout;
+    };
+}
+#endif
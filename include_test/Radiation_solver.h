@@ -20,12 +20,23 @@
 #ifndef RADIATION_SOLVER_H
 #define RADIATION_SOLVER_H
 
+#include <atomic>
+
 #include "Array.h"
 #include "Gas_concs.h"
 #include "Gas_optics_rrtmgp.h"
 #include "Gas_optics_nn.h"
+#include "Gas_optics_hybrid.h"
 #include "Cloud_optics.h"
+#include "Column_dedup.h"
 #include "Netcdf_interface.h"
+#include "Thread_pool.h"
+
+// Load the RRTMGP gas optics from a coefficient file.
+template<typename TF>
+Gas_optics_rrtmgp<TF> load_and_init_gas_optics_rrtmgp(
+        const Gas_concs<TF>& gas_concs,
+        const std::string& coef_file);
 
 template<typename TF>
 class Radiation_solver_longwave
@@ -38,26 +49,48 @@ class Radiation_solver_longwave
                 const std::string& file_name_weights,
                 Netcdf_file& input_nc,
                 const bool sw_cloud_optics,
-                const bool sw_nn_gas_optics);
+                const bool sw_nn_gas_optics,
+                const bool sw_hybrid_gas_optics=false,
+                const bool sw_float_storage=false);
 
+        // If lw_flux_up_jac is not empty, it returns the derivative of the upward broadband flux
+        // to the surface temperature (W m-2 K-1). If the clear-sky fluxes are not empty, they return
+        // the fluxes without clouds, computed from the same gas optics as the all-sky fluxes.
         void solve(
                 const bool switch_fluxes,
                 const bool switch_cloud_optics,
                 const bool switch_output_optical,
                 const bool switch_output_bnd_fluxes,
                 const Gas_concs<TF>& gas_concs,
-                const Array<TF,2>& p_lay, const Array<TF,2>& p_lev,
-                const Array<TF,2>& t_lay, const Array<TF,2>& t_lev,
-                const Array<TF,2>& col_dry,
-                const Array<TF,1>& t_sfc, const Array<TF,2>& emis_sfc,
-                const Array<TF,2>& lwp, const Array<TF,2>& iwp,
-                const Array<TF,2>& rel, const Array<TF,2>& rei,
-                Array<TF,3>& tau, Array<TF,3>& lay_source,
-                Array<TF,3>& lev_source_inc, Array<TF,3>& lev_source_dec, Array<TF,2>& sfc_source,
-                Array<TF,2>& lw_flux_up, Array<TF,2>& lw_flux_dn, Array<TF,2>& lw_flux_net,
-                Array<TF,3>& lw_bnd_flux_up, Array<TF,3>& lw_bnd_flux_dn, Array<TF,3>& lw_bnd_flux_net) const;
+                const Array_view<TF,2>& p_lay, const Array_view<TF,2>& p_lev,
+                const Array_view<TF,2>& t_lay, const Array_view<TF,2>& t_lev,
+                const Array_view<TF,2>& col_dry,
+                const Array_view<TF,1>& t_sfc, const Array_view<TF,2>& emis_sfc,
+                const Array_view<TF,2>& lwp, const Array_view<TF,2>& iwp,
+                const Array_view<TF,2>& rel, const Array_view<TF,2>& rei,
+                Array_view<TF,3> tau, Array_view<TF,3> lay_source,
+                Array_view<TF,3> lev_source_inc, Array_view<TF,3> lev_source_dec, Array_view<TF,2> sfc_source,
+                Array_view<TF,2> lw_flux_up, Array_view<TF,2> lw_flux_dn, Array_view<TF,2> lw_flux_net,
+                Array_view<TF,3> lw_bnd_flux_up, Array_view<TF,3> lw_bnd_flux_dn, Array_view<TF,3> lw_bnd_flux_net,
+                Array_view<TF,2> lw_flux_up_jac=Array_view<TF,2>(),
+                Array_view<TF,2> lw_flux_up_clear=Array_view<TF,2>(),
+                Array_view<TF,2> lw_flux_dn_clear=Array_view<TF,2>(),
+                Array_view<TF,2> lw_flux_net_clear=Array_view<TF,2>()) const;
+
+        // Update the upward and net fluxes of a solve at surface temperature t_sfc_ref to surface temperature
+        // t_sfc, to first order with the derivative lw_flux_up_jac of the upward flux to the surface temperature
+        // that is returned by solve. This is much cheaper than a solve, such that the surface fluxes can respond
+        // to the surface temperature in between solves. The downward flux does not depend on the surface temperature.
+        static void update_surface_temperature(
+                const Array_view<TF,1>& t_sfc, const Array_view<TF,1>& t_sfc_ref,
+                const Array_view<TF,2>& lw_flux_up_ref, const Array_view<TF,2>& lw_flux_dn,
+                const Array_view<TF,2>& lw_flux_up_jac,
+                Array_view<TF,2> lw_flux_up, Array_view<TF,2> lw_flux_net);
 
         int get_n_gpt() const { return this->kdist->get_ngpt(); };
+
+        // Fraction of the columns of which the gas optics are computed by the neural networks.
+        TF get_nn_column_fraction() const;
         int get_n_bnd() const { return this->kdist->get_nband(); };
 
         Array<int,2> get_band_lims_gpoint() const
@@ -66,9 +99,84 @@ class Radiation_solver_longwave
         Array<TF,2> get_band_lims_wavenumber() const
         { return this->kdist->get_band_lims_wavenumber(); }
 
+        // Whether the optical properties and sources are handed to the solver in single precision,
+        // and the g-point fluxes are stored in single precision.
+        bool has_float_storage() const { return this->sw_float_storage; }
+
+        // Gas and cloud optics in the precision of the solver, for instance to create a Radiation_plan.
+        // The cloud optics are null if the solver has none.
+        const Gas_optics<TF>& get_gas_optics() const;
+        const Cloud_optics<TF>* get_cloud_optics() const { return this->cloud_optics.get(); }
+
+        // Number of columns that are solved together in one block.
+        void set_n_col_block(const int n_col_block);
+        int get_n_col_block() const { return this->n_col_block; }
+
+        // Split the batches of the neural network gas optics over the threads of the pool. The pool
+        // must outlive the solver, and can be shared with other solvers that run concurrently.
+        void set_thread_pool(Thread_pool* thread_pool);
+
+        // Solve only the columns with a unique input state and copy their results to the duplicates.
+        // A nonzero quantization also merges columns of which all inputs differ less than this
+        // relative amount, at the cost of an error of the same relative order.
+        void set_column_dedup(const bool sw_column_dedup, const TF quantization=TF(0.));
+
+        // Number of columns per unique column in the last solve, which is 1 without column deduplication.
+        double get_dedup_ratio() const { return this->dedup_ratio; }
+
     private:
+        void solve_columns(
+                const bool switch_fluxes,
+                const bool switch_cloud_optics,
+                const bool switch_output_optical,
+                const bool switch_output_bnd_fluxes,
+                const Gas_concs<TF>& gas_concs,
+                const Array_view<TF,2>& p_lay, const Array_view<TF,2>& p_lev,
+                const Array_view<TF,2>& t_lay, const Array_view<TF,2>& t_lev,
+                const Array_view<TF,2>& col_dry,
+                const Array_view<TF,1>& t_sfc, const Array_view<TF,2>& emis_sfc,
+                const Array_view<TF,2>& lwp, const Array_view<TF,2>& iwp,
+                const Array_view<TF,2>& rel, const Array_view<TF,2>& rei,
+                Array_view<TF,3> tau, Array_view<TF,3> lay_source,
+                Array_view<TF,3> lev_source_inc, Array_view<TF,3> lev_source_dec, Array_view<TF,2> sfc_source,
+                Array_view<TF,2> lw_flux_up, Array_view<TF,2> lw_flux_dn, Array_view<TF,2> lw_flux_net,
+                Array_view<TF,3> lw_bnd_flux_up, Array_view<TF,3> lw_bnd_flux_dn, Array_view<TF,3> lw_bnd_flux_net,
+                Array_view<TF,2> lw_flux_up_jac,
+                Array_view<TF,2> lw_flux_up_clear, Array_view<TF,2> lw_flux_dn_clear,
+                Array_view<TF,2> lw_flux_net_clear) const;
+
+        template<typename TF_store>
+        void solve_stored(
+                const bool switch_fluxes,
+                const bool switch_cloud_optics,
+                const bool switch_output_optical,
+                const bool switch_output_bnd_fluxes,
+                const Gas_concs<TF>& gas_concs,
+                const Array_view<TF,2>& p_lay, const Array_view<TF,2>& p_lev,
+                const Array_view<TF,2>& t_lay, const Array_view<TF,2>& t_lev,
+                const Array_view<TF,2>& col_dry,
+                const Array_view<TF,1>& t_sfc, const Array_view<TF,2>& emis_sfc,
+                const Array_view<TF,2>& lwp, const Array_view<TF,2>& iwp,
+                const Array_view<TF,2>& rel, const Array_view<TF,2>& rei,
+                Array_view<TF,3> tau, Array_view<TF,3> lay_source,
+                Array_view<TF,3> lev_source_inc, Array_view<TF,3> lev_source_dec, Array_view<TF,2> sfc_source,
+                Array_view<TF,2> lw_flux_up, Array_view<TF,2> lw_flux_dn, Array_view<TF,2> lw_flux_net,
+                Array_view<TF,3> lw_bnd_flux_up, Array_view<TF,3> lw_bnd_flux_dn, Array_view<TF,3> lw_bnd_flux_net,
+                Array_view<TF,2> lw_flux_up_jac,
+                Array_view<TF,2> lw_flux_up_clear, Array_view<TF,2> lw_flux_dn_clear,
+                Array_view<TF,2> lw_flux_net_clear) const;
+
         std::unique_ptr<Gas_optics<TF>> kdist;
         std::unique_ptr<Cloud_optics<TF>> cloud_optics;
+
+        // Run the solver on single precision copies of the optical properties, only used if TF is double.
+        bool sw_float_storage = false;
+
+        int n_col_block = 8;
+
+        bool sw_column_dedup = false;
+        TF dedup_quantization = TF(0.);
+        mutable std::atomic<double> dedup_ratio{1.};
 };
 
 template<typename TF>
@@ -82,29 +190,40 @@ class Radiation_solver_shortwave
                 const std::string& file_name_weights,
                 Netcdf_file& input_nc,
                 const bool sw_cloud_optics,
-                const bool sw_nn_gas_optics);
+                const bool sw_nn_gas_optics,
+                const bool sw_hybrid_gas_optics=false,
+                const bool sw_float_storage=false);
 
+        // If the clear-sky fluxes are not empty, they return the fluxes without clouds,
+        // computed from the same gas optics as the all-sky fluxes.
         void solve(
                 const bool switch_fluxes,
                 const bool switch_cloud_optics,
                 const bool switch_output_optical,
                 const bool switch_output_bnd_fluxes,
                 const Gas_concs<TF>& gas_concs,
-                const Array<TF,2>& p_lay, const Array<TF,2>& p_lev,
-                const Array<TF,2>& t_lay, const Array<TF,2>& t_lev,
-                const Array<TF,2>& col_dry,
-                const Array<TF,2>& sfc_alb_dir, const Array<TF,2>& sfc_alb_dif,
-                const Array<TF,1>& tsi_scaling, const Array<TF,1>& mu0,
-                const Array<TF,2>& lwp, const Array<TF,2>& iwp,
-                const Array<TF,2>& rel, const Array<TF,2>& rei,
-                Array<TF,3>& tau, Array<TF,3>& ssa, Array<TF,3>& g,
-                Array<TF,2>& toa_src,
-                Array<TF,2>& sw_flux_up, Array<TF,2>& sw_flux_dn,
-                Array<TF,2>& sw_flux_dn_dir, Array<TF,2>& sw_flux_net,
-                Array<TF,3>& sw_bnd_flux_up, Array<TF,3>& sw_bnd_flux_dn,
-                Array<TF,3>& sw_bnd_flux_dn_dir, Array<TF,3>& sw_bnd_flux_net) const;
+                const Array_view<TF,2>& p_lay, const Array_view<TF,2>& p_lev,
+                const Array_view<TF,2>& t_lay, const Array_view<TF,2>& t_lev,
+                const Array_view<TF,2>& col_dry,
+                const Array_view<TF,2>& sfc_alb_dir, const Array_view<TF,2>& sfc_alb_dif,
+                const Array_view<TF,1>& tsi_scaling, const Array_view<TF,1>& mu0,
+                const Array_view<TF,2>& lwp, const Array_view<TF,2>& iwp,
+                const Array_view<TF,2>& rel, const Array_view<TF,2>& rei,
+                Array_view<TF,3> tau, Array_view<TF,3> ssa, Array_view<TF,3> g,
+                Array_view<TF,2> toa_src,
+                Array_view<TF,2> sw_flux_up, Array_view<TF,2> sw_flux_dn,
+                Array_view<TF,2> sw_flux_dn_dir, Array_view<TF,2> sw_flux_net,
+                Array_view<TF,3> sw_bnd_flux_up, Array_view<TF,3> sw_bnd_flux_dn,
+                Array_view<TF,3> sw_bnd_flux_dn_dir, Array_view<TF,3> sw_bnd_flux_net,
+                Array_view<TF,2> sw_flux_up_clear=Array_view<TF,2>(),
+                Array_view<TF,2> sw_flux_dn_clear=Array_view<TF,2>(),
+                Array_view<TF,2> sw_flux_dn_dir_clear=Array_view<TF,2>(),
+                Array_view<TF,2> sw_flux_net_clear=Array_view<TF,2>()) const;
 
         int get_n_gpt() const { return this->kdist->get_ngpt(); };
+
+        // Fraction of the columns of which the gas optics are computed by the neural networks.
+        TF get_nn_column_fraction() const;
         int get_n_bnd() const { return this->kdist->get_nband(); };
 
         TF get_tsi() const { return this->kdist->get_tsi(); };
@@ -115,8 +234,337 @@ class Radiation_solver_shortwave
         Array<TF,2> get_band_lims_wavenumber() const
         { return this->kdist->get_band_lims_wavenumber(); }
 
+        // Whether the optical properties and sources are handed to the solver in single precision,
+        // and the g-point fluxes are stored in single precision.
+        bool has_float_storage() const { return this->sw_float_storage; }
+
+        // Gas and cloud optics in the precision of the solver, for instance to create a Radiation_plan.
+        // The cloud optics are null if the solver has none.
+        const Gas_optics<TF>& get_gas_optics() const;
+        const Cloud_optics<TF>* get_cloud_optics() const { return this->cloud_optics.get(); }
+
+        // Number of columns that are solved together in one block.
+        void set_n_col_block(const int n_col_block);
+        int get_n_col_block() const { return this->n_col_block; }
+
+        // Split the batches of the neural network gas optics over the threads of the pool. The pool
+        // must outlive the solver, and can be shared with other solvers that run concurrently.
+        void set_thread_pool(Thread_pool* thread_pool);
+
+        // Solve only the columns with a unique input state and copy their results to the duplicates.
+        // A nonzero quantization also merges columns of which all inputs differ less than this
+        // relative amount, at the cost of an error of the same relative order.
+        void set_column_dedup(const bool sw_column_dedup, const TF quantization=TF(0.));
+
+        // Number of columns per unique column in the last solve, which is 1 without column deduplication.
+        double get_dedup_ratio() const { return this->dedup_ratio; }
+
+        // Solve the broadband fluxes for several pairs of surface albedos at once. The gas and cloud optics
+        // and the layer properties are computed once, scenario i uses sfc_alb_dir[i] and sfc_alb_dif[i] and
+        // returns its fluxes in sw_flux_up[i], sw_flux_dn[i] and sw_flux_net[i]. The direct flux does not
+        // depend on the surface and is returned once.
+        void solve_albedos(
+                const bool switch_cloud_optics,
+                const Gas_concs<TF>& gas_concs,
+                const Array_view<TF,2>& p_lay, const Array_view<TF,2>& p_lev,
+                const Array_view<TF,2>& t_lay, const Array_view<TF,2>& t_lev,
+                const Array_view<TF,2>& col_dry,
+                const std::vector<Array_view<TF,2>>& sfc_alb_dir,
+                const std::vector<Array_view<TF,2>>& sfc_alb_dif,
+                const Array_view<TF,1>& tsi_scaling, const Array_view<TF,1>& mu0,
+                const Array_view<TF,2>& lwp, const Array_view<TF,2>& iwp,
+                const Array_view<TF,2>& rel, const Array_view<TF,2>& rei,
+                std::vector<Array_view<TF,2>>& sw_flux_up, std::vector<Array_view<TF,2>>& sw_flux_dn,
+                Array_view<TF,2> sw_flux_dn_dir, std::vector<Array_view<TF,2>>& sw_flux_net) const;
+
+        // Solve the broadband fluxes for several cosines of the solar zenith angle at once. The gas and
+        // cloud optics and the diffuse layer properties are computed once, scenario i uses mu0[i] and
+        // returns its fluxes in the i-th element of the flux outputs.
+        void solve_mu0s(
+                const bool switch_cloud_optics,
+                const Gas_concs<TF>& gas_concs,
+                const Array_view<TF,2>& p_lay, const Array_view<TF,2>& p_lev,
+                const Array_view<TF,2>& t_lay, const Array_view<TF,2>& t_lev,
+                const Array_view<TF,2>& col_dry,
+                const Array_view<TF,2>& sfc_alb_dir, const Array_view<TF,2>& sfc_alb_dif,
+                const Array_view<TF,1>& tsi_scaling,
+                const std::vector<Array_view<TF,1>>& mu0,
+                const Array_view<TF,2>& lwp, const Array_view<TF,2>& iwp,
+                const Array_view<TF,2>& rel, const Array_view<TF,2>& rei,
+                std::vector<Array_view<TF,2>>& sw_flux_up, std::vector<Array_view<TF,2>>& sw_flux_dn,
+                std::vector<Array_view<TF,2>>& sw_flux_dn_dir, std::vector<Array_view<TF,2>>& sw_flux_net) const;
+
     private:
+        template<typename TF_store>
+        void solve_albedos_stored(
+                const bool switch_cloud_optics,
+                const Gas_concs<TF>& gas_concs,
+                const Array_view<TF,2>& p_lay, const Array_view<TF,2>& p_lev,
+                const Array_view<TF,2>& t_lay, const Array_view<TF,2>& col_dry,
+                const std::vector<Array_view<TF,2>>& sfc_alb_dir,
+                const std::vector<Array_view<TF,2>>& sfc_alb_dif,
+                const Array_view<TF,1>& tsi_scaling, const Array_view<TF,1>& mu0,
+                const Array_view<TF,2>& lwp, const Array_view<TF,2>& iwp,
+                const Array_view<TF,2>& rel, const Array_view<TF,2>& rei,
+                std::vector<Array_view<TF,2>>& sw_flux_up, std::vector<Array_view<TF,2>>& sw_flux_dn,
+                Array_view<TF,2> sw_flux_dn_dir, std::vector<Array_view<TF,2>>& sw_flux_net) const;
+
+        template<typename TF_store>
+        void solve_mu0s_stored(
+                const bool switch_cloud_optics,
+                const Gas_concs<TF>& gas_concs,
+                const Array_view<TF,2>& p_lay, const Array_view<TF,2>& p_lev,
+                const Array_view<TF,2>& t_lay, const Array_view<TF,2>& col_dry,
+                const Array_view<TF,2>& sfc_alb_dir, const Array_view<TF,2>& sfc_alb_dif,
+                const Array_view<TF,1>& tsi_scaling,
+                const std::vector<Array_view<TF,1>>& mu0,
+                const Array_view<TF,2>& lwp, const Array_view<TF,2>& iwp,
+                const Array_view<TF,2>& rel, const Array_view<TF,2>& rei,
+                std::vector<Array_view<TF,2>>& sw_flux_up, std::vector<Array_view<TF,2>>& sw_flux_dn,
+                std::vector<Array_view<TF,2>>& sw_flux_dn_dir, std::vector<Array_view<TF,2>>& sw_flux_net) const;
+
+        void solve_columns(
+                const bool switch_fluxes,
+                const bool switch_cloud_optics,
+                const bool switch_output_optical,
+                const bool switch_output_bnd_fluxes,
+                const Gas_concs<TF>& gas_concs,
+                const Array_view<TF,2>& p_lay, const Array_view<TF,2>& p_lev,
+                const Array_view<TF,2>& t_lay, const Array_view<TF,2>& t_lev,
+                const Array_view<TF,2>& col_dry,
+                const Array_view<TF,2>& sfc_alb_dir, const Array_view<TF,2>& sfc_alb_dif,
+                const Array_view<TF,1>& tsi_scaling, const Array_view<TF,1>& mu0,
+                const Array_view<TF,2>& lwp, const Array_view<TF,2>& iwp,
+                const Array_view<TF,2>& rel, const Array_view<TF,2>& rei,
+                Array_view<TF,3> tau, Array_view<TF,3> ssa, Array_view<TF,3> g,
+                Array_view<TF,2> toa_src,
+                Array_view<TF,2> sw_flux_up, Array_view<TF,2> sw_flux_dn,
+                Array_view<TF,2> sw_flux_dn_dir, Array_view<TF,2> sw_flux_net,
+                Array_view<TF,3> sw_bnd_flux_up, Array_view<TF,3> sw_bnd_flux_dn,
+                Array_view<TF,3> sw_bnd_flux_dn_dir, Array_view<TF,3> sw_bnd_flux_net,
+                Array_view<TF,2> sw_flux_up_clear, Array_view<TF,2> sw_flux_dn_clear,
+                Array_view<TF,2> sw_flux_dn_dir_clear, Array_view<TF,2> sw_flux_net_clear) const;
+
+        template<typename TF_store>
+        void solve_stored(
+                const bool switch_fluxes,
+                const bool switch_cloud_optics,
+                const bool switch_output_optical,
+                const bool switch_output_bnd_fluxes,
+                const Gas_concs<TF>& gas_concs,
+                const Array_view<TF,2>& p_lay, const Array_view<TF,2>& p_lev,
+                const Array_view<TF,2>& t_lay, const Array_view<TF,2>& t_lev,
+                const Array_view<TF,2>& col_dry,
+                const Array_view<TF,2>& sfc_alb_dir, const Array_view<TF,2>& sfc_alb_dif,
+                const Array_view<TF,1>& tsi_scaling, const Array_view<TF,1>& mu0,
+                const Array_view<TF,2>& lwp, const Array_view<TF,2>& iwp,
+                const Array_view<TF,2>& rel, const Array_view<TF,2>& rei,
+                Array_view<TF,3> tau, Array_view<TF,3> ssa, Array_view<TF,3> g,
+                Array_view<TF,2> toa_src,
+                Array_view<TF,2> sw_flux_up, Array_view<TF,2> sw_flux_dn,
+                Array_view<TF,2> sw_flux_dn_dir, Array_view<TF,2> sw_flux_net,
+                Array_view<TF,3> sw_bnd_flux_up, Array_view<TF,3> sw_bnd_flux_dn,
+                Array_view<TF,3> sw_bnd_flux_dn_dir, Array_view<TF,3> sw_bnd_flux_net,
+                Array_view<TF,2> sw_flux_up_clear, Array_view<TF,2> sw_flux_dn_clear,
+                Array_view<TF,2> sw_flux_dn_dir_clear, Array_view<TF,2> sw_flux_net_clear) const;
+
         std::unique_ptr<Gas_optics<TF>> kdist;
         std::unique_ptr<Cloud_optics<TF>> cloud_optics;
+
+        // Run the solver on single precision copies of the optical properties, only used if TF is double.
+        bool sw_float_storage = false;
+
+        int n_col_block = 8;
+
+        bool sw_column_dedup = false;
+        TF dedup_quantization = TF(0.);
+        mutable std::atomic<double> dedup_ratio{1.};
+};
+
+// Tolerances of the incremental solvers. A column is recomputed once any of its inputs deviates
+// more than its tolerance from the inputs at which the cached fluxes of the column were computed.
+// As the deviation is measured from the last computation rather than from the previous call,
+// the error of the reused fluxes does not grow with the number of calls.
+template<typename TF>
+struct Incremental_tolerances
+{
+    TF t_abs = TF(0.1);       // Layer, level and surface temperature (K).
+    TF p_rel = TF(1.e-3);     // Relative change of the layer and level pressure.
+    TF h2o_rel = TF(0.01);    // Relative change of the water vapor volume mixing ratio.
+    TF cloud_abs = TF(1.e-3); // Liquid and ice water path and effective radii, in the units of the input.
+    TF sfc_abs = TF(1.e-3);   // Surface emissivity and albedo.
+    TF mu0_abs = TF(1.e-3);   // Cosine of the solar zenith angle.
+    int max_age = 0;          // Recompute a column after this many reuses, 0 reuses columns indefinitely.
+};
+
+// Number of columns that are recomputed by an incremental solver.
+struct Incremental_stats
+{
+    long n_calls = 0;
+    long n_col_total = 0;
+    long n_col_recomputed = 0;
+    int n_col_last = 0;
+    int n_col_recomputed_last = 0;
+
+    double get_recomputed_fraction() const
+    { return n_col_total > 0 ? double(n_col_recomputed) / n_col_total : 0.; }
+
+    double get_recomputed_fraction_last() const
+    { return n_col_last > 0 ? double(n_col_recomputed_last) / n_col_last : 0.; }
+};
+
+// Longwave solver that recomputes only the columns of which the state changed since their fluxes
+// were last computed, and that returns the cached fluxes for the other columns. The set of gases
+// and the number of columns and layers should be the same in each call, a change of the number
+// of columns recomputes all columns. Of the gases, only water vapor enters the change metric.
+template<typename TF>
+class Radiation_solver_longwave_incremental
+{
+    public:
+        Radiation_solver_longwave_incremental(
+                const Radiation_solver_longwave<TF>& solver,
+                const Incremental_tolerances<TF>& tolerances);
+
+        void solve(
+                const bool switch_cloud_optics,
+                const Gas_concs<TF>& gas_concs,
+                const Array_view<TF,2>& p_lay, const Array_view<TF,2>& p_lev,
+                const Array_view<TF,2>& t_lay, const Array_view<TF,2>& t_lev,
+                const Array_view<TF,2>& col_dry,
+                const Array_view<TF,1>& t_sfc, const Array_view<TF,2>& emis_sfc,
+                const Array_view<TF,2>& lwp, const Array_view<TF,2>& iwp,
+                const Array_view<TF,2>& rel, const Array_view<TF,2>& rei,
+                Array_view<TF,2> lw_flux_up, Array_view<TF,2> lw_flux_dn, Array_view<TF,2> lw_flux_net);
+
+        // Forget the cached fluxes, the next call recomputes all columns.
+        void reset() { this->reference.clear(); }
+
+        const Incremental_stats& get_stats() const { return this->stats; }
+        void reset_stats() { this->stats = Incremental_stats(); }
+
+        const Incremental_tolerances<TF>& get_tolerances() const { return this->tolerances; }
+        void set_tolerances(const Incremental_tolerances<TF>& tolerances) { this->tolerances = tolerances; }
+
+    private:
+        const Radiation_solver_longwave<TF>& solver;
+        Incremental_tolerances<TF> tolerances;
+        Incremental_stats stats;
+
+        // Inputs at which the cached fluxes were computed, and the number of reuses per column.
+        std::vector<Array<TF,2>> reference;
+        std::vector<int> age;
+
+        Array<TF,2> flux_up;
+        Array<TF,2> flux_dn;
+        Array<TF,2> flux_net;
+};
+
+// Shortwave counterpart of the incremental longwave solver. The fluxes scale linearly with
+// the TSI scaling, therefore a change of the TSI scaling rescales the cached fluxes rather than
+// triggering a recomputation.
+template<typename TF>
+class Radiation_solver_shortwave_incremental
+{
+    public:
+        Radiation_solver_shortwave_incremental(
+                const Radiation_solver_shortwave<TF>& solver,
+                const Incremental_tolerances<TF>& tolerances);
+
+        void solve(
+                const bool switch_cloud_optics,
+                const Gas_concs<TF>& gas_concs,
+                const Array_view<TF,2>& p_lay, const Array_view<TF,2>& p_lev,
+                const Array_view<TF,2>& t_lay, const Array_view<TF,2>& t_lev,
+                const Array_view<TF,2>& col_dry,
+                const Array_view<TF,2>& sfc_alb_dir, const Array_view<TF,2>& sfc_alb_dif,
+                const Array_view<TF,1>& tsi_scaling, const Array_view<TF,1>& mu0,
+                const Array_view<TF,2>& lwp, const Array_view<TF,2>& iwp,
+                const Array_view<TF,2>& rel, const Array_view<TF,2>& rei,
+                Array_view<TF,2> sw_flux_up, Array_view<TF,2> sw_flux_dn,
+                Array_view<TF,2> sw_flux_dn_dir, Array_view<TF,2> sw_flux_net);
+
+        // Forget the cached fluxes, the next call recomputes all columns.
+        void reset() { this->reference.clear(); }
+
+        const Incremental_stats& get_stats() const { return this->stats; }
+        void reset_stats() { this->stats = Incremental_stats(); }
+
+        const Incremental_tolerances<TF>& get_tolerances() const { return this->tolerances; }
+        void set_tolerances(const Incremental_tolerances<TF>& tolerances) { this->tolerances = tolerances; }
+
+    private:
+        const Radiation_solver_shortwave<TF>& solver;
+        Incremental_tolerances<TF> tolerances;
+        Incremental_stats stats;
+
+        std::vector<Array<TF,2>> reference;
+        std::vector<int> age;
+
+        // TSI scaling at which the cached fluxes were computed.
+        std::vector<TF> tsi_scaling_ref;
+
+        Array<TF,2> flux_up;
+        Array<TF,2> flux_dn;
+        Array<TF,2> flux_dn_dir;
+        Array<TF,2> flux_net;
+};
+
+// Floating point precision of a stage of the mixed precision solver.
+enum class Precision { Single, Double };
+
+// Precision of the gas optics, of the solver that computes the g-point fluxes,
+// and of the reduction of the g-point fluxes into broadband fluxes.
+struct Precision_config
+{
+    Precision gas_optics;
+    Precision solver;
+    Precision fluxes;
+};
+
+// Clear-sky longwave solver with RRTMGP gas optics, of which the precision is chosen per stage.
+// The interface is in double precision, the data is converted in between stages of different precision.
+class Radiation_solver_longwave_mixed
+{
+    public:
+        Radiation_solver_longwave_mixed(
+                const Gas_concs<double>& gas_concs,
+                const std::string& file_name_gas,
+                const Precision_config& precision);
+
+        void solve(
+                const Gas_concs<double>& gas_concs,
+                const Array<double,2>& p_lay, const Array<double,2>& p_lev,
+                const Array<double,2>& t_lay, const Array<double,2>& t_lev,
+                const Array<double,1>& t_sfc, const Array<double,2>& emis_sfc,
+                Array<double,2>& lw_flux_up, Array<double,2>& lw_flux_dn, Array<double,2>& lw_flux_net) const;
+
+        Precision_config get_precision() const { return this->precision; }
+
+        int get_n_bnd() const;
+        int get_n_gpt() const;
+
+        // Number of columns that are solved together in one block.
+        void set_n_col_block(const int n_col_block);
+        int get_n_col_block() const { return this->n_col_block; }
+
+    private:
+        template<typename TF_gas, typename TF_rte, typename TF_flux>
+        void solve_stages(
+                const Gas_concs<double>& gas_concs,
+                const Array<double,2>& p_lay, const Array<double,2>& p_lev,
+                const Array<double,2>& t_lay, const Array<double,2>& t_lev,
+                const Array<double,1>& t_sfc, const Array<double,2>& emis_sfc,
+                Array<double,2>& lw_flux_up, Array<double,2>& lw_flux_dn, Array<double,2>& lw_flux_net) const;
+
+        template<typename TF>
+        const Gas_optics_rrtmgp<TF>& get_kdist() const;
+
+        Precision_config precision;
+
+        // Only the gas optics of the precision of the gas optics stage is loaded.
+        std::unique_ptr<Gas_optics_rrtmgp<float>> kdist_float;
+        std::unique_ptr<Gas_optics_rrtmgp<double>> kdist_double;
+
+        int n_col_block = 8;
 };
 #endif
@@ -0,0 +1,102 @@
+/*
+ * This file is part of the C and Fortran interface to the solvers that are
+ * used for the testing of the C++ interface to the RTE+RRTMGP radiation code.
+ *
+ * It is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RADIATION_SOLVER_C_H
+#define RADIATION_SOLVER_C_H
+
+// C interface for host models that own their state. A solver is created once for a fixed number
+// of columns and layers. The host then registers its arrays by pointer, shape and stride, after
+// which each solve reads the inputs from and writes the fluxes into these arrays, without copies.
+//
+// Arrays are indexed as in Fortran: the first dimension is the fastest varying, and the strides
+// are given in elements per dimension. The shapes follow the C++ solvers, for instance p_lay is
+// (n_col, n_lay), emis_sfc is (n_bnd, n_col), and the gases are (n_col, n_lay) or (1, n_lay).
+//
+// The fields of the longwave solver are p_lay, p_lev, t_lay, t_lev, col_dry, t_sfc, emis_sfc,
+// lwp, iwp, rel and rei as inputs, and flux_up, flux_dn and flux_net as outputs. The shortwave
+// solver has p_lay, p_lev, t_lay, t_lev, col_dry, sfc_alb_dir, sfc_alb_dif, tsi_scaling, mu0,
+// lwp, iwp, rel and rei as inputs, and flux_up, flux_dn, flux_dn_dir and flux_net as outputs.
+// col_dry and the outputs are optional, and the cloud fields are only needed with cloud optics.
+// The shapes are checked on registration, and a solve fails if a required field is missing.
+//
+// All functions except the destroy functions return 0 on success. After a failure,
+// rrtmgp_last_error() returns the message of the calling thread.
+
+#ifdef FLOAT_SINGLE_RRTMGP
+typedef float rrtmgp_real;
+#else
+typedef double rrtmgp_real;
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct Rrtmgp_lw Rrtmgp_lw;
+typedef struct Rrtmgp_sw Rrtmgp_sw;
+
+// The gas names are separated by spaces, for instance "h2o co2 o3 n2o ch4 o2 n2". The input file
+// provides the reference profile of the neural network gas optics, and is opened in any case.
+int rrtmgp_lw_create(
+        Rrtmgp_lw** solver,
+        const char* gas_names,
+        const char* file_name_gas, const char* file_name_cloud,
+        const char* file_name_weights, const char* file_name_input,
+        int n_col, int n_lay,
+        int switch_cloud_optics, int switch_nn_gas_optics,
+        int n_col_block);
+
+int rrtmgp_lw_register(
+        Rrtmgp_lw* solver, const char* name, rrtmgp_real* data,
+        int n_dims, const int* dims, const int* strides);
+
+int rrtmgp_lw_register_gas(
+        Rrtmgp_lw* solver, const char* name, rrtmgp_real* data,
+        const int* dims, const int* strides);
+
+int rrtmgp_lw_solve(Rrtmgp_lw* solver);
+
+void rrtmgp_lw_destroy(Rrtmgp_lw* solver);
+
+int rrtmgp_sw_create(
+        Rrtmgp_sw** solver,
+        const char* gas_names,
+        const char* file_name_gas, const char* file_name_cloud,
+        const char* file_name_weights, const char* file_name_input,
+        int n_col, int n_lay,
+        int switch_cloud_optics, int switch_nn_gas_optics,
+        int n_col_block);
+
+int rrtmgp_sw_register(
+        Rrtmgp_sw* solver, const char* name, rrtmgp_real* data,
+        int n_dims, const int* dims, const int* strides);
+
+int rrtmgp_sw_register_gas(
+        Rrtmgp_sw* solver, const char* name, rrtmgp_real* data,
+        const int* dims, const int* strides);
+
+int rrtmgp_sw_solve(Rrtmgp_sw* solver);
+
+void rrtmgp_sw_destroy(Rrtmgp_sw* solver);
+
+const char* rrtmgp_last_error(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
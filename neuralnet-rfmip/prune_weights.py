@@ -0,0 +1,159 @@
+import argparse
+import os
+import re
+import shutil
+import subprocess
+
+import numpy as np
+import netCDF4 as nc
+
+
+# Magnitude pruning of the weights of the gas optics networks into block-sparse matrices.
+#
+# Of each weight matrix of a hidden or output layer, the blocks with the smallest L2 norm are
+# removed until the requested fraction of the blocks is zero. The remaining blocks are stored in
+# block compressed sparse row format, which Network reads instead of the dense matrix (see
+# Network.h); all other variables are copied. The input layers are not pruned.
+#
+# With --check, test_rte_rrtmgp is run in --run_dir with the original and the pruned weights
+# linked as weights.nc, and the sparsity is lowered in steps of --sparsity_step until the
+# largest difference in the longwave and shortwave fluxes is below --max_flux_error.
+# The block-sparse kernels themselves are checked against the dense form by bench_nn_check.
+#
+# Example: python prune_weights.py weights_32_64_128.nc weights_32_64_128_pruned.nc --sparsity 0.8 --check
+parser = argparse.ArgumentParser()
+parser.add_argument('file_in')
+parser.add_argument('file_out')
+parser.add_argument('--sparsity', type=float, default=0.75)
+parser.add_argument('--block_shape', type=int, nargs=2, default=[4, 4])
+parser.add_argument('--check', action='store_true')
+parser.add_argument('--run_dir', default='../rfmip')
+parser.add_argument('--max_flux_error', type=float, default=0.5)
+parser.add_argument('--sparsity_step', type=float, default=0.05)
+args = parser.parse_args()
+
+
+def prune_blocks(wgth, block_shape, sparsity):
+    n_row, n_col = wgth.shape
+    n_block_row, n_block_col = block_shape
+
+    # Blocks as (block row, block col, row in block, col in block).
+    blocks = wgth.reshape(n_row//n_block_row, n_block_row, n_col//n_block_col, n_block_col).transpose(0, 2, 1, 3)
+    norms = np.sqrt((blocks**2).sum(axis=(2, 3)))
+
+    n_keep = max(1, int(round((1.-sparsity) * norms.size)))
+    keep = np.zeros(norms.shape, dtype=bool)
+    keep.flat[np.argsort(norms, axis=None)[::-1][:n_keep]] = True
+
+    # np.nonzero returns the blocks ordered by block row and then by block column.
+    i_block_row, i_block_col = np.nonzero(keep)
+    values = blocks[i_block_row, i_block_col]
+    block_row_start = np.concatenate(([0], np.cumsum(keep.sum(axis=1))))
+
+    return values, i_block_col, block_row_start
+
+
+def is_prunable(name, var, block_shape):
+    # The input layer (wgth1) is small and all of its inputs matter, unless it is also the output layer.
+    match = re.fullmatch(r'wgth(\d)_(lower|upper)', name)
+    if match is None or var.ndim != 2:
+        return False
+    n_row, n_col = var.shape
+    is_input_layer = (match.group(1) == '1') and (n_col < 16)
+    return (not is_input_layer) and (n_row % block_shape[0] == 0) and (n_col % block_shape[1] == 0)
+
+
+def copy_group(group_in, group_out, block_shape, sparsity, stats):
+    group_out.setncatts({ attr: group_in.getncattr(attr) for attr in group_in.ncattrs() })
+
+    for name, dim in group_in.dimensions.items():
+        group_out.createDimension(name, None if dim.isunlimited() else len(dim))
+
+    for name, var in group_in.variables.items():
+        if is_prunable(name, var, block_shape):
+            values, block_col, block_row_start = prune_blocks(var[:], block_shape, sparsity)
+
+            group_out.createDimension('nshape_{}'.format(name), 2)
+            group_out.createDimension('nblock_{}'.format(name), values.shape[0])
+            group_out.createDimension('nblock_row_start_{}'.format(name), block_row_start.size)
+            group_out.createDimension('nblock_row_{}'.format(name), block_shape[0])
+            group_out.createDimension('nblock_col_{}'.format(name), block_shape[1])
+
+            nc_shape = group_out.createVariable('{}_block_shape'.format(name), 'i4', ('nshape_{}'.format(name),))
+            nc_values = group_out.createVariable('{}_values'.format(name), 'f4',
+                    ('nblock_{}'.format(name), 'nblock_row_{}'.format(name), 'nblock_col_{}'.format(name)))
+            nc_block_col = group_out.createVariable('{}_block_col'.format(name), 'i4', ('nblock_{}'.format(name),))
+            nc_block_row_start = group_out.createVariable(
+                    '{}_block_row_start'.format(name), 'i4', ('nblock_row_start_{}'.format(name),))
+
+            nc_shape[:] = block_shape
+            nc_values[:] = values
+            nc_block_col[:] = block_col
+            nc_block_row_start[:] = block_row_start
+
+            stats.append((group_in.path, name, var.size, values.size))
+        else:
+            var_out = group_out.createVariable(name, var.datatype, var.dimensions)
+            var_out.setncatts({ attr: var.getncattr(attr) for attr in var.ncattrs() })
+            var_out[:] = var[:]
+
+    for name, group in group_in.groups.items():
+        copy_group(group, group_out.createGroup(name), block_shape, sparsity, stats)
+
+
+def prune_file(file_in, file_out, block_shape, sparsity):
+    stats = []
+    with nc.Dataset(file_in, 'r') as nc_in, nc.Dataset(file_out, 'w', format='NETCDF4') as nc_out:
+        copy_group(nc_in, nc_out, block_shape, sparsity, stats)
+
+    n_total = sum(s[2] for s in stats)
+    n_kept = sum(s[3] for s in stats)
+    for path, name, n_dense, n_sparse in stats:
+        print('{:>10} {:>12}: {:8d} of {:8d} weights kept'.format(path, name, n_sparse, n_dense))
+    print('Sparsity {:.2f}: {} of {} weights of the pruned layers kept'.format(sparsity, n_kept, n_total))
+
+
+def run_fluxes(weights_file):
+    # Run the solver with the given weights, and return its fluxes.
+    link = os.path.join(args.run_dir, 'weights.nc')
+    if os.path.lexists(link):
+        os.remove(link)
+    os.symlink(os.path.abspath(weights_file), link)
+
+    subprocess.run(['./test_rte_rrtmgp', '--nn-gas-optics'], cwd=args.run_dir, check=True, stdout=subprocess.DEVNULL)
+
+    with nc.Dataset(os.path.join(args.run_dir, 'rte_rrtmgp_output.nc'), 'r') as nc_file:
+        return { name: nc_file.variables[name][:] for name in ['lw_flux_up', 'lw_flux_dn', 'sw_flux_up', 'sw_flux_dn'] }
+
+
+if not args.check:
+    prune_file(args.file_in, args.file_out, args.block_shape, args.sparsity)
+else:
+    # The original weights.nc of the run directory is restored afterwards.
+    link = os.path.join(args.run_dir, 'weights.nc')
+    link_backup = link + '.prune_backup'
+    if os.path.lexists(link):
+        shutil.move(link, link_backup)
+
+    try:
+        fluxes_ref = run_fluxes(args.file_in)
+
+        sparsity = args.sparsity
+        while True:
+            prune_file(args.file_in, args.file_out, args.block_shape, sparsity)
+            fluxes = run_fluxes(args.file_out)
+
+            flux_error = max(np.abs(fluxes[name] - fluxes_ref[name]).max() for name in fluxes)
+            print('Sparsity {:.2f}: maximum flux difference {:.3f} W m-2'.format(sparsity, flux_error))
+
+            if flux_error <= args.max_flux_error:
+                break
+
+            sparsity -= args.sparsity_step
+            if sparsity <= 0.:
+                raise RuntimeError('No sparsity meets a maximum flux difference of {} W m-2'.format(args.max_flux_error))
+    finally:
+        if os.path.lexists(link):
+            os.remove(link)
+        if os.path.lexists(link_backup):
+            shutil.move(link_backup, link)
@@ -0,0 +1,60 @@
+import netCDF4 as nc
+import numpy as np
+import timeit
+import argparse
+import radiation
+
+
+# Throughput benchmark of the longwave solver, driving many solves from Python threads.
+parser = argparse.ArgumentParser()
+parser.add_argument('--n_cases', type=int, default=16)
+parser.add_argument('--n_threads', type=int, nargs='+', default=[1, 2, 4, 8])
+parser.add_argument('--n_col_block', type=int, default=8)
+parser.add_argument('--nn_gas_optics', action='store_true')
+args = parser.parse_args()
+
+
+# Read the input data.
+nc_file = nc.Dataset('rte_rrtmgp_input.nc', 'r')
+
+gas_concs = radiation.Gas_concs_wrapper()
+for gas in ['h2o', 'co2', 'o3', 'n2o', 'ch4', 'o2', 'n2']:
+    gas_concs.set_vmr(gas.encode(), nc_file.variables['vmr_{}'.format(gas)][:])
+
+inputs = dict(
+        p_lay = nc_file.variables['p_lay'][:],
+        p_lev = nc_file.variables['p_lev'][:],
+        t_lay = nc_file.variables['t_lay'][:],
+        t_lev = nc_file.variables['t_lev'][:],
+        t_sfc = nc_file.variables['t_sfc'][:],
+        emis_sfc = nc_file.variables['emis_sfc'][:])
+
+nc_file.close()
+
+# Convert once to contiguous arrays in the precision of the build, such that the solves below run on views.
+inputs = { k: np.ascontiguousarray(v, dtype=radiation.float_type) for k, v in inputs.items() }
+n_col = inputs['p_lay'].shape[1]
+
+
+# Initialize the solver.
+rad = radiation.Radiation_solver_longwave_wrapper(
+        gas_concs, b'coefficients_lw.nc',
+        file_name_weights=b'weights.nc', file_name_input=b'rte_rrtmgp_input.nc',
+        nn_gas_optics=args.nn_gas_optics)
+rad.n_col_block = args.n_col_block
+
+cases = [ (gas_concs, inputs) for i in range(args.n_cases) ]
+
+
+# Solve the radiation fluxes for all cases, with an increasing number of threads.
+for n_threads in args.n_threads:
+    start = timeit.default_timer()
+    out = rad.solve_batch(cases, n_threads)
+    end = timeit.default_timer()
+
+    print('Threads: {:3d}, duration: {:8.3f} s, throughput: {:10.1f} columns/s'.format(
+        n_threads, end-start, args.n_cases*n_col/(end-start)))
+
+# The fluxes of all cases should be identical.
+for o in out[1:]:
+    assert(np.array_equal(o['lw_flux_up'], out[0]['lw_flux_up']))
@@ -1,10 +1,12 @@
 # distutils: language = c++
+# cython: language_level = 3
 import cython
 from libcpp.string cimport string as std_string
 from libcpp cimport bool
 import numpy as np
 cimport numpy as np
 import numbers
+from concurrent.futures import ThreadPoolExecutor
 
 
 cdef extern from *:
@@ -13,210 +15,382 @@ cdef extern from *:
     ctypedef int d3 "3"
 
 
-cdef extern from "<array>" namespace "std":
-    cdef cppclass array[T, ND]:
-        array() except+
+# Floating point type of the library build, single if it is configured with FLOAT_TYPE=single (see setup.py).
+cdef extern from *:
+    """
+    #ifdef FLOAT_SINGLE_RRTMGP
+    #define FLOAT_TYPE float
+    #else
+    #define FLOAT_TYPE double
+    #endif
+    """
+    ctypedef double Float "FLOAT_TYPE"
+
+float_type = np.float32 if sizeof(Float) == 4 else np.float64
+
+
+cdef extern from "<array>":
+    cdef cppclass std_array "std::array"[T, ND]:
+        std_array() except+
         int& operator[](size_t)
 
 
 cdef extern from "../include/Array.h":
     cdef cppclass Array[T, ND]:
         Array() except+
-        void set_dims(const array[int, ND]&) except +
-        T& operator()(const array[int, ND]&)
         T* ptr()
 
+    cdef cppclass Array_view[T, ND]:
+        Array_view() except +
+        Array_view(T*, const std_array[int, ND]&) except +
+
 
 cdef extern from "../include/Gas_concs.h":
     cdef cppclass Gas_concs[TF]:
-        Gas_concs()
+        Gas_concs() except +
         void set_vmr(const std_string&, const TF) except +
-        void set_vmr(const std_string&, const Array[TF,d1]&) except +
-        void set_vmr(const std_string&, const Array[TF,d2]&) except +
+        void set_vmr(const std_string&, const Array_view[TF,d2]&) except +
+
+
+cdef extern from "../include_test/Netcdf_interface.h":
+    ctypedef enum Netcdf_mode "Netcdf_mode":
+        Netcdf_mode_read "Netcdf_mode::Read"
+
+    cdef cppclass Netcdf_file:
+        Netcdf_file(const std_string&, Netcdf_mode) except +
 
 
 cdef extern from "../include_test/Radiation_solver.h":
     cdef cppclass Radiation_solver_longwave[TF]:
-        Radiation_solver_longwave(const Gas_concs[TF]&, const std_string&) except +
+        Radiation_solver_longwave(
+                const Gas_concs[TF]&,
+                const std_string&, const std_string&, const std_string&,
+                Netcdf_file&,
+                const bool, const bool, const bool, const bool) except +
+
         void solve(
-                const bool sw_output_optical,
-                const bool sw_output_bnd_fluxes,
+                const bool switch_fluxes,
+                const bool switch_cloud_optics,
+                const bool switch_output_optical,
+                const bool switch_output_bnd_fluxes,
                 const Gas_concs[TF]& gas_concs,
-                const Array[TF,d2]& p_lay, const Array[TF,d2]& p_lev,
-                const Array[TF,d2]& t_lay, const Array[TF,d2]& t_lev,
-                const Array[TF,d2]& col_dry,
-                const Array[TF,d1]& t_sfc, const Array[TF,d2]& emis_sfc,
-                Array[TF,d3]& tau, Array[TF,d3]& lay_source,
-                Array[TF,d3]& lev_source_inc, Array[TF,d3]& lev_source_dec, Array[TF,d2]& sfc_source,
-                Array[TF,d2]& lw_flux_up, Array[TF,d2]& lw_flux_dn, Array[TF,d2]& lw_flux_net,
-                Array[TF,d3]& lw_bnd_flux_up, Array[TF,d3]& lw_bnd_flux_dn, Array[TF,d3]& lw_bnd_flux_net);
+                const Array_view[TF,d2]& p_lay, const Array_view[TF,d2]& p_lev,
+                const Array_view[TF,d2]& t_lay, const Array_view[TF,d2]& t_lev,
+                const Array_view[TF,d2]& col_dry,
+                const Array_view[TF,d1]& t_sfc, const Array_view[TF,d2]& emis_sfc,
+                const Array_view[TF,d2]& lwp, const Array_view[TF,d2]& iwp,
+                const Array_view[TF,d2]& rel, const Array_view[TF,d2]& rei,
+                Array_view[TF,d3] tau, Array_view[TF,d3] lay_source,
+                Array_view[TF,d3] lev_source_inc, Array_view[TF,d3] lev_source_dec, Array_view[TF,d2] sfc_source,
+                Array_view[TF,d2] lw_flux_up, Array_view[TF,d2] lw_flux_dn, Array_view[TF,d2] lw_flux_net,
+                Array_view[TF,d3] lw_bnd_flux_up, Array_view[TF,d3] lw_bnd_flux_dn,
+                Array_view[TF,d3] lw_bnd_flux_net) except + nogil
+
+        int get_n_gpt()
+        int get_n_bnd()
+        TF get_nn_column_fraction()
+        void set_n_col_block(const int) except +
+        int get_n_col_block()
+
+    cdef cppclass Radiation_solver_shortwave[TF]:
+        Radiation_solver_shortwave(
+                const Gas_concs[TF]&,
+                const std_string&, const std_string&, const std_string&,
+                Netcdf_file&,
+                const bool, const bool, const bool, const bool) except +
 
-# ctypedef fused float_t:
-#     cython.float
-#     cython.double
-
-cdef copy_raw(double* a_in, double* a_out, int n):
-    for i in range(n):
-        a_out[i] = a_in[i]
+        void solve(
+                const bool switch_fluxes,
+                const bool switch_cloud_optics,
+                const bool switch_output_optical,
+                const bool switch_output_bnd_fluxes,
+                const Gas_concs[TF]& gas_concs,
+                const Array_view[TF,d2]& p_lay, const Array_view[TF,d2]& p_lev,
+                const Array_view[TF,d2]& t_lay, const Array_view[TF,d2]& t_lev,
+                const Array_view[TF,d2]& col_dry,
+                const Array_view[TF,d2]& sfc_alb_dir, const Array_view[TF,d2]& sfc_alb_dif,
+                const Array_view[TF,d1]& tsi_scaling, const Array_view[TF,d1]& mu0,
+                const Array_view[TF,d2]& lwp, const Array_view[TF,d2]& iwp,
+                const Array_view[TF,d2]& rel, const Array_view[TF,d2]& rei,
+                Array_view[TF,d3] tau, Array_view[TF,d3] ssa, Array_view[TF,d3] g,
+                Array_view[TF,d2] toa_src,
+                Array_view[TF,d2] sw_flux_up, Array_view[TF,d2] sw_flux_dn,
+                Array_view[TF,d2] sw_flux_dn_dir, Array_view[TF,d2] sw_flux_net,
+                Array_view[TF,d3] sw_bnd_flux_up, Array_view[TF,d3] sw_bnd_flux_dn,
+                Array_view[TF,d3] sw_bnd_flux_dn_dir, Array_view[TF,d3] sw_bnd_flux_net) except + nogil
+
+        int get_n_gpt()
+        int get_n_bnd()
+        TF get_nn_column_fraction()
+        void set_n_col_block(const int) except +
+        int get_n_col_block()
+
+
+def zeros(shape):
+    return np.zeros(shape, dtype=float_type)
+
+
+# Numpy arrays are C-ordered, Array is Fortran-ordered, thus the dimensions are reversed
+# and the memory of the numpy array is used as is.
+def as_buffer(a, shape=None):
+    if a is None:
+        return zeros((0,)*len(shape)) if shape is not None else None
+    return np.ascontiguousarray(a, dtype=float_type)
+
+
+cdef Array_view[Float,d1] view_1d(Float[::1] a):
+    cdef std_array[int,d1] dims
+    if a.shape[0] == 0:
+        return Array_view[Float,d1]()
+    dims[0] = a.shape[0]
+    return Array_view[Float,d1](&a[0], dims)
+
+
+cdef Array_view[Float,d2] view_2d(Float[:, ::1] a):
+    cdef std_array[int,d2] dims
+    if a.shape[0]*a.shape[1] == 0:
+        return Array_view[Float,d2]()
+    dims[0], dims[1] = a.shape[1], a.shape[0]
+    return Array_view[Float,d2](&a[0,0], dims)
+
+
+cdef Array_view[Float,d3] view_3d(Float[:, :, ::1] a):
+    cdef std_array[int,d3] dims
+    if a.shape[0]*a.shape[1]*a.shape[2] == 0:
+        return Array_view[Float,d3]()
+    dims[0], dims[1], dims[2] = a.shape[2], a.shape[1], a.shape[0]
+    return Array_view[Float,d3](&a[0,0,0], dims)
 
 
 cdef class Gas_concs_wrapper:
-    cdef Gas_concs[double] gas_concs_cpp
+    cdef Gas_concs[Float] gas_concs_cpp
 
     def set_vmr(self, gas_name, gas_conc):
         cdef std_string gas_name_cpp = gas_name
+        cdef Float[:, ::1] gas_conc_2d
 
-        cdef double gas_conc_0d
+        if isinstance(gas_conc, numbers.Number) or np.ndim(gas_conc) == 0:
+            self.gas_concs_cpp.set_vmr(gas_name_cpp, <Float>gas_conc)
+            return
 
-        cdef Array[double, d1] gas_conc_1d
-        cdef Array[double, d2] gas_conc_2d
+        gas_conc = as_buffer(gas_conc)
 
-        cdef array[int, d1] dims_1d
-        cdef array[int, d1] index_1d
+        # A profile is stored as a single column, that is spread over all columns.
+        if gas_conc.ndim == 1:
+            gas_conc = gas_conc[:, None]
+        elif gas_conc.ndim != 2:
+            raise RuntimeError('Illegal shape dimension')
 
-        cdef array[int, d2] dims_2d
-        cdef array[int, d2] index_2d
+        gas_conc_2d = gas_conc
+        self.gas_concs_cpp.set_vmr(gas_name_cpp, view_2d(gas_conc_2d))
 
-        cdef double* gas_conc_ptr
 
-        if isinstance(gas_conc, np.ndarray):
+cdef class Radiation_solver_longwave_wrapper:
+    cdef Radiation_solver_longwave[Float]* rad
 
-            if len(gas_conc.shape) == 0:
-                gas_conc_0d = gas_conc
-                self.gas_concs_cpp.set_vmr(gas_name_cpp, gas_conc_0d)
-
-            elif len(gas_conc.shape) == 1:
-                dims_1d[0] = gas_conc.shape[0]
-                gas_conc_1d.set_dims(dims_1d)
+    def __cinit__(
+            self, Gas_concs_wrapper gas_concs,
+            file_name_gas, file_name_cloud=b'', file_name_weights=b'', file_name_input=b'',
+            cloud_optics=False, nn_gas_optics=False, hybrid_gas_optics=False, float_storage=False):
+
+        # The input file is only read by the neural network gas optics.
+        cdef Netcdf_file* input_nc = new Netcdf_file(
+                file_name_input if (nn_gas_optics or hybrid_gas_optics) else file_name_gas, Netcdf_mode_read)
+        try:
+            self.rad = new Radiation_solver_longwave[Float](
+                    gas_concs.gas_concs_cpp,
+                    file_name_gas, file_name_cloud, file_name_weights,
+                    input_nc[0], cloud_optics, nn_gas_optics, hybrid_gas_optics, float_storage)
+        finally:
+            del input_nc
 
-                # Adjust for the Fortran indexing used in Array.
-                for ilev in range(gas_conc.shape[0]):
-                    index_1d[0] = ilev+1
-                    gas_conc_ptr = &gas_conc_1d(index_1d)
-                    gas_conc_ptr[0] = gas_conc[ilev]
+    def __dealloc__(self):
+        del self.rad
 
-                self.gas_concs_cpp.set_vmr(gas_name_cpp, gas_conc_1d)
+    property n_gpt:
+        def __get__(self): return self.rad.get_n_gpt()
 
-            elif len(gas_conc.shape) == 2:
-                dims_2d[0] = gas_conc.shape[1]
-                dims_2d[1] = gas_conc.shape[0]
+    property n_bnd:
+        def __get__(self): return self.rad.get_n_bnd()
 
-                gas_conc_2d.set_dims(dims_2d)
+    property nn_column_fraction:
+        def __get__(self): return self.rad.get_nn_column_fraction()
 
-                # Adjust for the Fortran indexing used in Array.
-                for ilev in range(gas_conc.shape[0]):
-                    for icol in range(gas_conc.shape[1]):
-                        index_2d[0] = icol+1
-                        index_2d[1] = ilev+1
-                        gas_conc_ptr = &gas_conc_2d(index_2d)
-                        gas_conc_ptr[0] = gas_conc[ilev, icol]
+    property n_col_block:
+        def __get__(self): return self.rad.get_n_col_block()
+        def __set__(self, int n): self.rad.set_n_col_block(n)
 
-                self.gas_concs_cpp.set_vmr(gas_name_cpp, gas_conc_2d)
+    def solve(
+            self, Gas_concs_wrapper gas_concs,
+            p_lay, p_lev, t_lay, t_lev, t_sfc, emis_sfc,
+            col_dry=None, lwp=None, iwp=None, rel=None, rei=None,
+            fluxes=True, output_optical=False, output_bnd_fluxes=False):
+        """Solve the longwave fluxes. Inputs are (nlay, ncol) shaped, as in the netCDF input,
+        the returned outputs are numpy arrays that the solver has written into directly."""
+
+        p_lay, p_lev, t_lay, t_lev, t_sfc, emis_sfc = [
+                as_buffer(a) for a in (p_lay, p_lev, t_lay, t_lev, t_sfc, emis_sfc)]
+        col_dry, lwp, iwp, rel, rei = [as_buffer(a, (0, 0)) for a in (col_dry, lwp, iwp, rel, rei)]
+
+        cdef bool switch_cloud_optics = lwp.size > 0
+        nlay, nlev, ncol = p_lay.shape[0], p_lev.shape[0], p_lay.shape[1]
+        ngpt, nbnd = self.rad.get_n_gpt(), self.rad.get_n_bnd()
+
+        shape_opt = (ngpt, nlay, ncol) if output_optical else (0, 0, 0)
+        shape_flux = (nlev, ncol) if fluxes else (0, 0)
+        shape_bnd = (nbnd, nlev, ncol) if (fluxes and output_bnd_fluxes) else (0, 0, 0)
+
+        out = dict(
+                tau=zeros(shape_opt), lay_source=zeros(shape_opt),
+                lev_source_inc=zeros(shape_opt), lev_source_dec=zeros(shape_opt),
+                sfc_source=zeros(shape_opt[::2]),
+                lw_flux_up=zeros(shape_flux), lw_flux_dn=zeros(shape_flux), lw_flux_net=zeros(shape_flux),
+                lw_bnd_flux_up=zeros(shape_bnd), lw_bnd_flux_dn=zeros(shape_bnd), lw_bnd_flux_net=zeros(shape_bnd))
+
+        # Create the views while holding the GIL, the solver runs without it.
+        cdef Array_view[Float,d2] p_lay_v = view_2d(p_lay), p_lev_v = view_2d(p_lev)
+        cdef Array_view[Float,d2] t_lay_v = view_2d(t_lay), t_lev_v = view_2d(t_lev)
+        cdef Array_view[Float,d2] col_dry_v = view_2d(col_dry)
+        cdef Array_view[Float,d1] t_sfc_v = view_1d(t_sfc)
+        cdef Array_view[Float,d2] emis_sfc_v = view_2d(emis_sfc)
+        cdef Array_view[Float,d2] lwp_v = view_2d(lwp), iwp_v = view_2d(iwp)
+        cdef Array_view[Float,d2] rel_v = view_2d(rel), rei_v = view_2d(rei)
+
+        cdef Array_view[Float,d3] tau_v = view_3d(out['tau']), lay_source_v = view_3d(out['lay_source'])
+        cdef Array_view[Float,d3] lev_source_inc_v = view_3d(out['lev_source_inc'])
+        cdef Array_view[Float,d3] lev_source_dec_v = view_3d(out['lev_source_dec'])
+        cdef Array_view[Float,d2] sfc_source_v = view_2d(out['sfc_source'])
+        cdef Array_view[Float,d2] flux_up_v = view_2d(out['lw_flux_up'])
+        cdef Array_view[Float,d2] flux_dn_v = view_2d(out['lw_flux_dn'])
+        cdef Array_view[Float,d2] flux_net_v = view_2d(out['lw_flux_net'])
+        cdef Array_view[Float,d3] bnd_flux_up_v = view_3d(out['lw_bnd_flux_up'])
+        cdef Array_view[Float,d3] bnd_flux_dn_v = view_3d(out['lw_bnd_flux_dn'])
+        cdef Array_view[Float,d3] bnd_flux_net_v = view_3d(out['lw_bnd_flux_net'])
+
+        cdef bool c_fluxes = fluxes, c_optical = output_optical, c_bnd = output_bnd_fluxes
+
+        with nogil:
+            self.rad.solve(
+                    c_fluxes, switch_cloud_optics, c_optical, c_bnd,
+                    gas_concs.gas_concs_cpp,
+                    p_lay_v, p_lev_v, t_lay_v, t_lev_v,
+                    col_dry_v, t_sfc_v, emis_sfc_v,
+                    lwp_v, iwp_v, rel_v, rei_v,
+                    tau_v, lay_source_v, lev_source_inc_v, lev_source_dec_v, sfc_source_v,
+                    flux_up_v, flux_dn_v, flux_net_v,
+                    bnd_flux_up_v, bnd_flux_dn_v, bnd_flux_net_v)
+
+        return out
+
+    def solve_batch(self, cases, n_threads=1):
+        """Solve a list of cases, each a tuple (gas_concs, kwargs for solve), with n_threads
+        concurrent solves. As the GIL is released in solve, the threads run in parallel."""
+        with ThreadPoolExecutor(max_workers=n_threads) as pool:
+            return list(pool.map(lambda case: self.solve(case[0], **case[1]), cases))
+
+
+cdef class Radiation_solver_shortwave_wrapper:
+    cdef Radiation_solver_shortwave[Float]* rad
 
-            else:
-                raise RuntimeError('Illegal shape dimension')
-        
-        else:
-            raise RuntimeError('Illegal input')
+    def __cinit__(
+            self, Gas_concs_wrapper gas_concs,
+            file_name_gas, file_name_cloud=b'', file_name_weights=b'', file_name_input=b'',
+            cloud_optics=False, nn_gas_optics=False, hybrid_gas_optics=False, float_storage=False):
+
+        # The input file is only read by the neural network gas optics.
+        cdef Netcdf_file* input_nc = new Netcdf_file(
+                file_name_input if (nn_gas_optics or hybrid_gas_optics) else file_name_gas, Netcdf_mode_read)
+        try:
+            self.rad = new Radiation_solver_shortwave[Float](
+                    gas_concs.gas_concs_cpp,
+                    file_name_gas, file_name_cloud, file_name_weights,
+                    input_nc[0], cloud_optics, nn_gas_optics, hybrid_gas_optics, float_storage)
+        finally:
+            del input_nc
 
+    def __dealloc__(self):
+        del self.rad
 
-cdef class Radiation_solver_wrapper:
-    cdef Radiation_solver_longwave[double]* rad
+    property n_gpt:
+        def __get__(self): return self.rad.get_n_gpt()
 
-    def __cinit__(
-            self, Gas_concs_wrapper gas_concs, file_name):
+    property n_bnd:
+        def __get__(self): return self.rad.get_n_bnd()
 
-        cdef std_string file_name_cpp = file_name
-        self.rad = new Radiation_solver_longwave[double](gas_concs.gas_concs_cpp, file_name_cpp)
+    property nn_column_fraction:
+        def __get__(self): return self.rad.get_nn_column_fraction()
 
-    def __dealloc__(self):
-        del self.rad
+    property n_col_block:
+        def __get__(self): return self.rad.get_n_col_block()
+        def __set__(self, int n): self.rad.set_n_col_block(n)
 
     def solve(
-            self,
-            sw_output_optical,
-            sw_output_bnd_fluxes,
-            Gas_concs_wrapper gas_concs,
-            np.ndarray[double, ndim=2, mode="c"] p_lay not None,
-            np.ndarray[double, ndim=2, mode="c"] p_lev not None,
-            np.ndarray[double, ndim=2, mode="c"] t_lay not None,
-            np.ndarray[double, ndim=2, mode="c"] t_lev not None,
-            np.ndarray[double, ndim=2, mode="c"] col_dry not None,
-            np.ndarray[double, ndim=1, mode="c"] t_sfc not None,
-            np.ndarray[double, ndim=2, mode="c"] emis_sfc not None,
-            np.ndarray[double, ndim=3, mode="c"] tau not None,
-            np.ndarray[double, ndim=3, mode="c"] lay_source not None,
-            np.ndarray[double, ndim=3, mode="c"] lev_source_inc not None,
-            np.ndarray[double, ndim=3, mode="c"] lev_source_dec not None,
-            np.ndarray[double, ndim=2, mode="c"] sfc_source not None,
-            np.ndarray[double, ndim=2, mode="c"] lw_flux_up not None,
-            np.ndarray[double, ndim=2, mode="c"] lw_flux_dn not None,
-            np.ndarray[double, ndim=2, mode="c"] lw_flux_net not None,
-            np.ndarray[double, ndim=3, mode="c"] lw_bnd_flux_up not None,
-            np.ndarray[double, ndim=3, mode="c"] lw_bnd_flux_dn not None,
-            np.ndarray[double, ndim=3, mode="c"] lw_bnd_flux_net not None):
-
-        ncol = p_lay.shape[1]
-        nlay = p_lay.shape[0]
-        nlev = p_lev.shape[0]
-
-        nbnd = emis_sfc.shape[1]
-
-        cdef Array[double,d2] p_lay_cpp, p_lev_cpp, t_lay_cpp, t_lev_cpp, col_dry_cpp
-        cdef Array[double,d1] t_sfc_cpp,
-        cdef Array[double,d2] emis_sfc_cpp
-        cdef Array[double,d3] tau_cpp, lay_source_cpp, lev_source_inc_cpp, lev_source_dec_cpp
-        cdef Array[double,d2] sfc_source_cpp
-        cdef Array[double,d2] lw_flux_up_cpp, lw_flux_dn_cpp, lw_flux_net_cpp
-        cdef Array[double,d3] lw_bnd_flux_up_cpp, lw_bnd_flux_dn_cpp, lw_bnd_flux_net_cpp
-
-        cdef array[int,d2] d_ncol_nlay
-        d_ncol_nlay[0], d_ncol_nlay[1] = ncol, nlay
-
-        cdef array[int,d2] d_ncol_nlev
-        d_ncol_nlev[0], d_ncol_nlev[1] = ncol, nlev
-
-        cdef array[int,d1] d_ncol
-        d_ncol[0] = ncol
-
-        cdef array[int,d2] d_nbnd_ncol
-        d_nbnd_ncol[0], d_nbnd_ncol[1] = nbnd, ncol
-
-        p_lay_cpp.set_dims(d_ncol_nlay)
-        p_lev_cpp.set_dims(d_ncol_nlev)
-        t_lay_cpp.set_dims(d_ncol_nlay)
-        t_lev_cpp.set_dims(d_ncol_nlev)
-        if (col_dry.size > 0):
-            col_dry_cpp.set_dims(d_ncol_nlay)
-        t_sfc_cpp.set_dims(d_ncol)
-        emis_sfc_cpp.set_dims(d_nbnd_ncol)
-        lw_flux_up_cpp.set_dims(d_ncol_nlev)
-        lw_flux_dn_cpp.set_dims(d_ncol_nlev)
-        lw_flux_net_cpp.set_dims(d_ncol_nlev)
-
-        copy_raw(&p_lay[0,0], p_lay_cpp.ptr(), p_lay.size)
-        copy_raw(&p_lev[0,0], p_lev_cpp.ptr(), p_lev.size)
-        copy_raw(&t_lay[0,0], t_lay_cpp.ptr(), t_lay.size)
-        copy_raw(&t_lev[0,0], t_lev_cpp.ptr(), t_lev.size)
-        if (col_dry.size > 0):
-            copy_raw(&col_dry[0,0], col_dry_cpp.ptr(), col_dry.size)
-        copy_raw(&t_sfc[0], t_sfc_cpp.ptr(), t_sfc.size)
-        copy_raw(&emis_sfc[0,0], emis_sfc_cpp.ptr(), emis_sfc.size)
-
-        self.rad.solve(
-                sw_output_optical,
-                sw_output_bnd_fluxes,
-                gas_concs.gas_concs_cpp,
-                p_lay_cpp, p_lev_cpp,
-                t_lay_cpp, t_lev_cpp,
-                col_dry_cpp,
-                t_sfc_cpp, emis_sfc_cpp,
-                tau_cpp, lay_source_cpp,
-                lev_source_inc_cpp, lev_source_dec_cpp, sfc_source_cpp,
-                lw_flux_up_cpp, lw_flux_dn_cpp, lw_flux_net_cpp,
-                lw_bnd_flux_up_cpp, lw_bnd_flux_dn_cpp, lw_bnd_flux_net_cpp)
-
-        copy_raw(lw_flux_up_cpp .ptr(), &lw_flux_up [0,0], lw_flux_up .size)
-        copy_raw(lw_flux_dn_cpp .ptr(), &lw_flux_dn [0,0], lw_flux_dn .size)
-        copy_raw(lw_flux_net_cpp.ptr(), &lw_flux_net[0,0], lw_flux_net.size)
-
+            self, Gas_concs_wrapper gas_concs,
+            p_lay, p_lev, t_lay, t_lev, sfc_alb_dir, sfc_alb_dif, tsi_scaling, mu0,
+            col_dry=None, lwp=None, iwp=None, rel=None, rei=None,
+            fluxes=True, output_optical=False, output_bnd_fluxes=False):
+        """Solve the shortwave fluxes. Inputs are (nlay, ncol) shaped, as in the netCDF input,
+        the returned outputs are numpy arrays that the solver has written into directly."""
+
+        p_lay, p_lev, t_lay, t_lev, sfc_alb_dir, sfc_alb_dif, tsi_scaling, mu0 = [
+                as_buffer(a) for a in (p_lay, p_lev, t_lay, t_lev, sfc_alb_dir, sfc_alb_dif, tsi_scaling, mu0)]
+        col_dry, lwp, iwp, rel, rei = [as_buffer(a, (0, 0)) for a in (col_dry, lwp, iwp, rel, rei)]
+
+        cdef bool switch_cloud_optics = lwp.size > 0
+        nlay, nlev, ncol = p_lay.shape[0], p_lev.shape[0], p_lay.shape[1]
+        ngpt, nbnd = self.rad.get_n_gpt(), self.rad.get_n_bnd()
+
+        shape_opt = (ngpt, nlay, ncol) if output_optical else (0, 0, 0)
+        shape_flux = (nlev, ncol) if fluxes else (0, 0)
+        shape_bnd = (nbnd, nlev, ncol) if (fluxes and output_bnd_fluxes) else (0, 0, 0)
+
+        out = dict(
+                tau=zeros(shape_opt), ssa=zeros(shape_opt), g=zeros(shape_opt),
+                toa_src=zeros(shape_opt[::2]),
+                sw_flux_up=zeros(shape_flux), sw_flux_dn=zeros(shape_flux),
+                sw_flux_dn_dir=zeros(shape_flux), sw_flux_net=zeros(shape_flux),
+                sw_bnd_flux_up=zeros(shape_bnd), sw_bnd_flux_dn=zeros(shape_bnd),
+                sw_bnd_flux_dn_dir=zeros(shape_bnd), sw_bnd_flux_net=zeros(shape_bnd))
+
+        # Create the views while holding the GIL, the solver runs without it.
+        cdef Array_view[Float,d2] p_lay_v = view_2d(p_lay), p_lev_v = view_2d(p_lev)
+        cdef Array_view[Float,d2] t_lay_v = view_2d(t_lay), t_lev_v = view_2d(t_lev)
+        cdef Array_view[Float,d2] col_dry_v = view_2d(col_dry)
+        cdef Array_view[Float,d2] sfc_alb_dir_v = view_2d(sfc_alb_dir), sfc_alb_dif_v = view_2d(sfc_alb_dif)
+        cdef Array_view[Float,d1] tsi_scaling_v = view_1d(tsi_scaling), mu0_v = view_1d(mu0)
+        cdef Array_view[Float,d2] lwp_v = view_2d(lwp), iwp_v = view_2d(iwp)
+        cdef Array_view[Float,d2] rel_v = view_2d(rel), rei_v = view_2d(rei)
+
+        cdef Array_view[Float,d3] tau_v = view_3d(out['tau']), ssa_v = view_3d(out['ssa']), g_v = view_3d(out['g'])
+        cdef Array_view[Float,d2] toa_src_v = view_2d(out['toa_src'])
+        cdef Array_view[Float,d2] flux_up_v = view_2d(out['sw_flux_up'])
+        cdef Array_view[Float,d2] flux_dn_v = view_2d(out['sw_flux_dn'])
+        cdef Array_view[Float,d2] flux_dn_dir_v = view_2d(out['sw_flux_dn_dir'])
+        cdef Array_view[Float,d2] flux_net_v = view_2d(out['sw_flux_net'])
+        cdef Array_view[Float,d3] bnd_flux_up_v = view_3d(out['sw_bnd_flux_up'])
+        cdef Array_view[Float,d3] bnd_flux_dn_v = view_3d(out['sw_bnd_flux_dn'])
+        cdef Array_view[Float,d3] bnd_flux_dn_dir_v = view_3d(out['sw_bnd_flux_dn_dir'])
+        cdef Array_view[Float,d3] bnd_flux_net_v = view_3d(out['sw_bnd_flux_net'])
+
+        cdef bool c_fluxes = fluxes, c_optical = output_optical, c_bnd = output_bnd_fluxes
+
+        with nogil:
+            self.rad.solve(
+                    c_fluxes, switch_cloud_optics, c_optical, c_bnd,
+                    gas_concs.gas_concs_cpp,
+                    p_lay_v, p_lev_v, t_lay_v, t_lev_v,
+                    col_dry_v,
+                    sfc_alb_dir_v, sfc_alb_dif_v,
+                    tsi_scaling_v, mu0_v,
+                    lwp_v, iwp_v, rel_v, rei_v,
+                    tau_v, ssa_v, g_v, toa_src_v,
+                    flux_up_v, flux_dn_v, flux_dn_dir_v, flux_net_v,
+                    bnd_flux_up_v, bnd_flux_dn_v, bnd_flux_dn_dir_v, bnd_flux_net_v)
+
+        return out
+
+    def solve_batch(self, cases, n_threads=1):
+        """Solve a list of cases, each a tuple (gas_concs, kwargs for solve), with n_threads
+        concurrent solves. As the GIL is released in solve, the threads run in parallel."""
+        with ThreadPoolExecutor(max_workers=n_threads) as pool:
+            return list(pool.map(lambda case: self.solve(case[0], **case[1]), cases))
@@ -7,17 +7,32 @@ from distutils.extension import Extension
 from Cython.Distutils import build_ext
 
 import numpy
+import os
+import re
+
+# Follow the precision of the library build, as set with FLOAT_TYPE in CMake.
+define_macros = []
+with open('{}/CMakeCache.txt'.format(build_folder)) as cache:
+    if re.search(r'^FLOAT_TYPE:\w+=single$', cache.read(), re.MULTILINE | re.IGNORECASE):
+        define_macros.append(('FLOAT_SINGLE_RRTMGP', None))
+
+# The library calls the kernels of both precisions, of which the single precision ones have
+# their symbols suffixed with _sp and are in a separate library, see src_fortran/CMakeLists.txt.
+kernel_libraries = ['{}/src_fortran/librte_rrtmgp_kernels.a'.format(build_folder)]
+kernel_library_sp = '{}/src_fortran/librte_rrtmgp_kernels_sp.a'.format(build_folder)
+if os.path.exists(kernel_library_sp):
+    kernel_libraries.append(kernel_library_sp)
 
 setup(
     cmdclass = {'build_ext': build_ext},
     ext_modules = [Extension('radiation',
                              sources=['radiation.pyx', '../src_test/Radiation_solver.cpp'],
                              language='c++',
-                             extra_compile_args=['-O3', '-std=c++14', '-march=native', '-DBOOL_TYPE=signed char', '-fno-wrapv'],
+                             extra_compile_args=['-O3', '-std=c++14', '-march=native', '-DBOOL_TYPE=signed char',
+                                                 '-DUSE_CBOOL', '-DRESTRICTKEYWORD=__restrict__', '-fno-wrapv'],
+                             define_macros=define_macros,
                              include_dirs=['../include', '../include_test', numpy.get_include()],
                              library_dirs=['/usr/local/Cellar/gcc/9.3.0_1/lib/gcc/9/'],
-                             libraries=['gfortran', 'netcdf'],
-                             extra_objects=[
-                                 '{}/src/librte_rrtmgp.a'.format(build_folder),
-                                 '{}/src_fortran/librte_rrtmgp_kernels.a'.format(build_folder)] )]
+                             libraries=['gfortran', 'netcdf', 'mkl_rt'],
+                             extra_objects=['{}/src/librte_rrtmgp.a'.format(build_folder)] + kernel_libraries )]
 )
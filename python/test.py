@@ -31,8 +31,8 @@ gas_concs.set_vmr(b'n2' , vmr_n2 )
 
 
 # Load the thermodynamic variables.
-p_lay = nc_file.variables['lay'][:]
-p_lev = nc_file.variables['lev'][:]
+p_lay = nc_file.variables['p_lay'][:]
+p_lev = nc_file.variables['p_lev'][:]
 t_lay = nc_file.variables['t_lay'][:]
 t_lev = nc_file.variables['t_lev'][:]
 
@@ -41,48 +41,26 @@ emis_sfc = nc_file.variables['emis_sfc'][:]
 
 nc_file.close()
 
-col_dry = np.zeros((0,0))
-
-
-# Create the output arrays.
-tau = np.zeros((0,0,0))
-lay_source = np.zeros((0,0,0))
-lev_source_inc = np.zeros((0,0,0))
-lev_source_dec = np.zeros((0,0,0))
-sfc_source = np.zeros((0,0))
-
-lw_flux_up  = np.zeros(p_lev.shape)
-lw_flux_dn  = np.zeros(p_lev.shape)
-lw_flux_net = np.zeros(p_lev.shape)
-lw_bnd_flux_up  = np.zeros((0,0,0))
-lw_bnd_flux_dn  = np.zeros((0,0,0))
-lw_bnd_flux_net = np.zeros((0,0,0))
-
 
 # Initialize the solver.
-rad = radiation.Radiation_solver_wrapper(gas_concs, b'coefficients_lw.nc')
+rad = radiation.Radiation_solver_longwave_wrapper(gas_concs, b'coefficients_lw.nc')
 
 
 # Solve the radiation fluxes.
 start = timeit.default_timer()
 
-rad.solve(
-        False,
-        False,
+out = rad.solve(
         gas_concs,
         p_lay, p_lev,
         t_lay, t_lev,
-        col_dry,
-        t_sfc, emis_sfc,
-        tau, lay_source,
-        lev_source_inc, lev_source_dec,
-        sfc_source,
-        lw_flux_up, lw_flux_dn, lw_flux_net,
-        lw_bnd_flux_up, lw_bnd_flux_dn, lw_bnd_flux_net)
+        t_sfc, emis_sfc)
 
 end = timeit.default_timer()
 print('Duration: {} s'.format(end-start))
 
+lw_flux_up = out['lw_flux_up']
+lw_flux_dn = out['lw_flux_dn']
+
 
 # Plot some output.
 plt.figure()
@@ -6,3 +6,8 @@ ln -sf ../rte-rrtmgp/rrtmgp/data/rrtmgp-data-lw-g256-2018-12-04.nc coefficients_
 ln -sf ../rte-rrtmgp/examples/rfmip-clear-sky/stage_files.py
 ln -sf ../rte-rrtmgp/examples/rfmip-clear-sky/compare-to-reference.py .
 ln -sf ../build/test_rte_rrtmgp .
+ln -sf ../build/bench_scenarios .
+ln -sf ../build/bench_sun_angles .
+ln -sf ../build/radiation_server .
+ln -sf ../build/bench_service .
+ln -sf ../build/bench_nn_threads .
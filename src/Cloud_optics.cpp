@@ -22,7 +22,10 @@
  *
  */
 
+#include <limits>
+
 #include "Cloud_optics.h"
+#include "Cpu_dispatch.h"
 
 template<typename TF>
 Cloud_optics<TF>::Cloud_optics(
@@ -68,7 +71,7 @@ Cloud_optics<TF>::Cloud_optics(
 }
 
 template<typename TF>
-void compute_all_from_table(
+DISPATCH_KERNEL void compute_all_from_table(
         const int ncol, const int nlay, const int nbnd, const Array<BOOL_TYPE,2>& mask,
         const Array<TF,2>& cwp, const Array<TF,2>& re,
         const int nsteps, const TF step_size, const TF offset,
@@ -110,7 +113,7 @@ template<typename TF>
 void Cloud_optics<TF>::cloud_optics(
         const Array<TF,2>& clwp, const Array<TF,2>& ciwp,
         const Array<TF,2>& reliq, const Array<TF,2>& reice,
-        Optical_props_2str<TF>& optical_props)
+        Optical_props_2str<TF>& optical_props) const
 {
     const int ncol = clwp.dim(1);
     const int nlay = clwp.dim(2);
@@ -175,7 +178,7 @@ template<typename TF>
 void Cloud_optics<TF>::cloud_optics(
         const Array<TF,2>& clwp, const Array<TF,2>& ciwp,
         const Array<TF,2>& reliq, const Array<TF,2>& reice,
-        Optical_props_1scl<TF>& optical_props)
+        Optical_props_1scl<TF>& optical_props) const
 {
     const int ncol = clwp.dim(1);
     const int nlay = clwp.dim(2);
@@ -230,8 +233,5 @@ void Cloud_optics<TF>::cloud_optics(
             }
 }
 
-#ifdef FLOAT_SINGLE_RRTMGP
 template class Cloud_optics<float>;
-#else
 template class Cloud_optics<double>;
-#endif
@@ -0,0 +1,198 @@
+/*
+ * This file is part of a C++ interface to the Radiative Transfer for Energetics (RTE)
+ * and Rapid Radiative Transfer Model for GCM applications Parallel (RRTMGP).
+ *
+ * The original code is found at https://github.com/earth-system-radiation/rte-rrtmgp.
+ *
+ * Contacts: Robert Pincus and Eli Mlawer
+ * email: rrtmgp@aer.com
+ *
+ * Copyright 2015-2020,  Atmospheric and Environmental Research and
+ * Regents of the University of Colorado.  All right reserved.
+ *
+ * This C++ interface can be downloaded from https://github.com/earth-system-radiation/rte-rrtmgp-cpp
+ *
+ * Contact: Chiel van Heerwaarden
+ * email: chiel.vanheerwaarden@wur.nl
+ *
+ * Copyright 2020, Wageningen University & Research.
+ *
+ * Use and duplication is permitted under the terms of the
+ * BSD 3-clause license, see http://opensource.org/licenses/BSD-3-Clause
+ *
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "Column_dedup.h"
+#include "Gas_concs.h"
+
+namespace
+{
+    // FNV-1a hash of the keys of a column.
+    uint64_t hash_keys(const std::vector<uint64_t>& keys)
+    {
+        uint64_t hash = 14695981039346656037ULL;
+        for (const uint64_t key : keys)
+        {
+            hash ^= key;
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    template<typename TF>
+    uint64_t bit_pattern(const TF value)
+    {
+        // Both signed zeros map onto the same key.
+        const TF value_no_neg_zero = (value == TF(0.)) ? TF(0.) : value;
+
+        uint64_t bits = 0;
+        std::memcpy(&bits, &value_no_neg_zero, sizeof(TF));
+        return bits;
+    }
+}
+
+template<typename TF>
+Column_dedup<TF>::Column_dedup(const int n_col, const TF quantization) :
+    n_col(n_col), quantization(quantization), keys(n_col)
+{
+    if (quantization < TF(0.))
+        throw std::runtime_error("The quantization of the column deduplication cannot be negative");
+}
+
+template<typename TF>
+uint64_t Column_dedup<TF>::key(const TF value) const
+{
+    if (quantization == TF(0.) || value == TF(0.) || !std::isfinite(value))
+        return bit_pattern(value);
+
+    // Index of the logarithmic bin, with the sign in the lowest bit. The keys of nonzero values
+    // are offset to keep them apart from the bit pattern of zero.
+    const int64_t bin = std::llround(std::log(std::abs(value)) / std::log1p(quantization));
+    return (uint64_t(bin) << 1 | (value < TF(0.))) + 1;
+}
+
+template<typename TF>
+void Column_dedup<TF>::add(const Array_view<TF,2>& data)
+{
+    if (data.is_empty() || data.dim(1) == 1)
+        return;
+
+    if (data.dim(1) != n_col)
+        throw std::runtime_error("Inputs of the column deduplication should have all columns in the first dimension");
+
+    for (int j=1; j<=data.dim(2); ++j)
+        for (int icol=1; icol<=n_col; ++icol)
+            keys[icol-1].push_back(key(data({icol, j})));
+}
+
+template<typename TF>
+void Column_dedup<TF>::add(const Array_view<TF,1>& data)
+{
+    if (data.is_empty() || data.dim(1) == 1)
+        return;
+
+    if (data.dim(1) != n_col)
+        throw std::runtime_error("Inputs of the column deduplication should have all columns in the first dimension");
+
+    for (int icol=1; icol<=n_col; ++icol)
+        keys[icol-1].push_back(key(data({icol})));
+}
+
+template<typename TF>
+void Column_dedup<TF>::add_dim2(const Array_view<TF,2>& data)
+{
+    if (data.is_empty() || data.dim(2) == 1)
+        return;
+
+    if (data.dim(2) != n_col)
+        throw std::runtime_error("Inputs of the column deduplication should have all columns in the second dimension");
+
+    for (int icol=1; icol<=n_col; ++icol)
+        for (int i=1; i<=data.dim(1); ++i)
+            keys[icol-1].push_back(key(data({i, icol})));
+}
+
+template<typename TF>
+void Column_dedup<TF>::add(const Gas_concs<TF>& gas_concs)
+{
+    for (const std::string& name : gas_concs.get_gas_names())
+        add(gas_concs.get_vmr(name));
+}
+
+template<typename TF>
+void Column_dedup<TF>::find_unique()
+{
+    unique_cols.clear();
+    unique_index.resize(n_col);
+
+    // Buckets of unique columns with the same hash, which are compared key by key.
+    std::unordered_map<uint64_t, std::vector<int>> buckets;
+    buckets.reserve(n_col);
+
+    for (int icol=1; icol<=n_col; ++icol)
+    {
+        std::vector<int>& bucket = buckets[hash_keys(keys[icol-1])];
+
+        auto it = std::find_if(bucket.begin(), bucket.end(),
+                [&](const int iuniq) { return keys[unique_cols[iuniq-1]-1] == keys[icol-1]; });
+
+        if (it != bucket.end())
+            unique_index[icol-1] = *it;
+        else
+        {
+            unique_cols.push_back(icol);
+            unique_index[icol-1] = unique_cols.size();
+            bucket.push_back(unique_cols.size());
+        }
+    }
+
+    // The keys are not needed anymore.
+    keys = std::vector<std::vector<uint64_t>>(n_col);
+}
+
+template<typename TF>
+template<int N>
+void Column_dedup<TF>::expand(Array_view<TF,N> out, const Array<TF,N>& in) const
+{
+    if (out.is_empty())
+        return;
+
+    if (out.dim(1) != n_col || in.dim(1) != get_n_unique())
+        throw std::runtime_error("Arrays of the column deduplication do not match the number of columns");
+
+    const std::array<int,N> dims = out.get_dims();
+    const std::array<int,N> strides = out.get_strides();
+    const int n_unique = get_n_unique();
+    const int n_outer = out.size() / n_col;
+
+    for (int n=0; n<n_outer; ++n)
+    {
+        int offset = 0;
+        int n_rem = n;
+        for (int i=1; i<N; ++i)
+        {
+            offset += (n_rem % dims[i]) * strides[i];
+            n_rem /= dims[i];
+        }
+
+        for (int icol=0; icol<n_col; ++icol)
+            out.ptr()[icol*strides[0] + offset] = in.ptr()[unique_index[icol]-1 + n*n_unique];
+    }
+}
+
+template class Column_dedup<float>;
+template void Column_dedup<float>::expand<1>(Array_view<float,1>, const Array<float,1>&) const;
+template void Column_dedup<float>::expand<2>(Array_view<float,2>, const Array<float,2>&) const;
+template void Column_dedup<float>::expand<3>(Array_view<float,3>, const Array<float,3>&) const;
+
+template class Column_dedup<double>;
+template void Column_dedup<double>::expand<1>(Array_view<double,1>, const Array<double,1>&) const;
+template void Column_dedup<double>::expand<2>(Array_view<double,2>, const Array<double,2>&) const;
+template void Column_dedup<double>::expand<3>(Array_view<double,3>, const Array<double,3>&) const;
@@ -0,0 +1,57 @@
+/*
+ * This file is part of a C++ interface to the Radiative Transfer for Energetics (RTE)
+ * and Rapid Radiative Transfer Model for GCM applications Parallel (RRTMGP).
+ *
+ * The original code is found at https://github.com/earth-system-radiation/rte-rrtmgp.
+ *
+ * Contacts: Robert Pincus and Eli Mlawer
+ * email: rrtmgp@aer.com
+ *
+ * Copyright 2015-2020,  Atmospheric and Environmental Research and
+ * Regents of the University of Colorado.  All right reserved.
+ *
+ * This C++ interface can be downloaded from https://github.com/earth-system-radiation/rte-rrtmgp-cpp
+ *
+ * Contact: Chiel van Heerwaarden
+ * email: chiel.vanheerwaarden@wur.nl
+ *
+ * Copyright 2020, Wageningen University & Research.
+ *
+ * Use and duplication is permitted under the terms of the
+ * BSD 3-clause license, see http://opensource.org/licenses/BSD-3-Clause
+ *
+ */
+
+
+#include "Cpu_dispatch.h"
+#include "Status.h"
+
+namespace Cpu_dispatch
+{
+    // The checks are in the order of priority of the target_clones resolver.
+    std::string get_variant()
+    {
+        #ifdef CPU_DISPATCH
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f"))
+            return "avx512f";
+        if (__builtin_cpu_supports("avx2"))
+            return "avx2";
+        if (__builtin_cpu_supports("sse4.2"))
+            return "sse4.2";
+        return "default";
+        #else
+        return "build flags";
+        #endif
+    }
+
+    // All DISPATCH_KERNEL functions have the same clones, so the resolver binds the same variant for each.
+    void print_variant()
+    {
+        #ifdef CPU_DISPATCH
+        Status::print_message("Vectorized kernels: " + get_variant() + " (runtime dispatch)");
+        #else
+        Status::print_message("Vectorized kernels: " + get_variant());
+        #endif
+    }
+}
@@ -0,0 +1,241 @@
+/*
+ * This file is part of a C++ interface to the Radiative Transfer for Energetics (RTE)
+ * and Rapid Radiative Transfer Model for GCM applications Parallel (RRTMGP).
+ *
+ * The original code is found at https://github.com/earth-system-radiation/rte-rrtmgp.
+ *
+ * Contacts: Robert Pincus and Eli Mlawer
+ * email: rrtmgp@aer.com
+ *
+ * Copyright 2015-2020,  Atmospheric and Environmental Research and
+ * Regents of the University of Colorado.  All right reserved.
+ *
+ * This C++ interface can be downloaded from https://github.com/earth-system-radiation/rte-rrtmgp-cpp
+ *
+ * Contact: Chiel van Heerwaarden
+ * email: chiel.vanheerwaarden@wur.nl
+ *
+ * Copyright 2020, Wageningen University & Research.
+ *
+ * Use and duplication is permitted under the terms of the
+ * BSD 3-clause license, see http://opensource.org/licenses/BSD-3-Clause
+ *
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <boost/algorithm/string.hpp>
+
+#include "Array.h"
+#include "Cpu_dispatch.h"
+#include "Feature_pipeline.h"
+#include "Gas_concs.h"
+
+#define restrict __restrict__
+
+namespace
+{
+    // Approximation of the logarithm that the networks are trained with, which vectorizes.
+    inline float logarithm(float x)
+    {
+        x = std::sqrt(x);
+        x = std::sqrt(x);
+        x = std::sqrt(x);
+        x = std::sqrt(x);
+        x = (x-1.0f) * 16.0f;
+        return x;
+    }
+
+    template<typename TF>
+    DISPATCH_KERNEL void transform_row(
+            const TF* restrict const row, float* restrict const out,
+            const int ncol, const bool log)
+    {
+        if (log)
+        {
+            #pragma ivdep
+            for (int icol=0; icol<ncol; ++icol)
+                out[icol] = logarithm(row[icol]);
+        }
+        else
+        {
+            #pragma ivdep
+            for (int icol=0; icol<ncol; ++icol)
+                out[icol] = row[icol];
+        }
+    }
+
+    // Layer thicknesses of one layer row from the pressures of the levels below and above.
+    template<typename TF>
+    DISPATCH_KERNEL void thickness_row(
+            const TF* restrict const lev_bot, const TF* restrict const lev_top,
+            float* restrict const dp, const int ncol)
+    {
+        #pragma ivdep
+        for (int icol=0; icol<ncol; ++icol)
+            dp[icol] = std::abs(lev_bot[icol] - lev_top[icol]);
+    }
+}
+
+template<typename TF>
+int Feature_pipeline<TF>::add_input(const std::vector<std::string>& features_input)
+{
+    if (features_input.empty())
+        throw std::runtime_error("Network input has no features");
+
+    const int i_input = this->features.size();
+
+    for (size_t i_feature=0; i_feature<features_input.size(); ++i_feature)
+    {
+        std::string name = boost::trim_copy(features_input[i_feature]);
+
+        Channel channel;
+        channel.log = false;
+        channel.lev_offset = 0;
+
+        if (name.size() > 5 && name.compare(0, 4, "log(") == 0 && name.back() == ')')
+        {
+            channel.log = true;
+            name = boost::trim_copy(name.substr(4, name.size()-5));
+        }
+
+        const size_t i_plus = name.find('+');
+        if (i_plus != std::string::npos)
+        {
+            const std::string offset = name.substr(i_plus+1);
+            if (offset != "0" && offset != "1")
+                throw std::runtime_error("Feature " + features_input[i_feature] + " has an invalid level offset");
+            channel.lev_offset = std::stoi(offset);
+            name = name.substr(0, i_plus);
+        }
+
+        if (name == "play")
+            channel.source = Source::Play;
+        else if (name == "plev")
+            channel.source = Source::Plev;
+        else if (name == "tlay")
+            channel.source = Source::Tlay;
+        else if (name == "tlev")
+            channel.source = Source::Tlev;
+        else if (!name.empty())
+        {
+            channel.source = Source::Gas;
+            channel.gas_name = name;
+        }
+        else
+            throw std::runtime_error("Feature " + features_input[i_feature] + " has no source");
+
+        if (channel.lev_offset != 0 && channel.source != Source::Plev && channel.source != Source::Tlev)
+            throw std::runtime_error("Feature " + features_input[i_feature] + " is not on levels and cannot have an offset");
+
+        const Target target = {i_input, int(i_feature)};
+
+        auto it = std::find_if(this->channels.begin(), this->channels.end(), [&](const Channel& c)
+        {
+            return c.source == channel.source && c.gas_name == channel.gas_name
+                && c.log == channel.log && c.lev_offset == channel.lev_offset;
+        });
+
+        if (it != this->channels.end())
+            it->targets.push_back(target);
+        else
+        {
+            channel.targets.push_back(target);
+            this->channels.push_back(std::move(channel));
+        }
+    }
+
+    // Channels of the same field are adjacent, such that its rows are still in cache for the next.
+    std::stable_sort(this->channels.begin(), this->channels.end(), [](const Channel& a, const Channel& b)
+    {
+        return (a.source != b.source) ? (a.source < b.source) : (a.gas_name < b.gas_name);
+    });
+
+    this->features.push_back(features_input);
+    return i_input;
+}
+
+template<typename TF>
+void Feature_pipeline<TF>::assemble(
+        const TF* play, const TF* plev,
+        const TF* tlay, const TF* tlev,
+        const Gas_concs<TF>& gas_desc,
+        const int ncol, const int lay_s, const int lay_e,
+        const std::vector<float*>& inputs,
+        float* dp) const
+{
+    if (inputs.size() != this->features.size())
+        throw std::runtime_error("Number of inputs does not match the feature pipeline");
+
+    if (dp && !plev)
+        throw std::runtime_error("Layer thicknesses need the level pressures");
+
+    const int nbatch = ncol*(lay_e-lay_s);
+
+    // The layer thicknesses are computed in the layer loop of the first pressure channel, or of the
+    // first channel if the inputs have no pressure.
+    const Channel* channel_dp = nullptr;
+    if (dp)
+    {
+        auto it = std::find_if(this->channels.begin(), this->channels.end(), [](const Channel& c)
+        {
+            return c.source == Source::Play || c.source == Source::Plev;
+        });
+        channel_dp = (it != this->channels.end()) ? &(*it) : &this->channels.front();
+    }
+
+    for (const Channel& channel : this->channels)
+    {
+        // Gases can be constant over the columns, the layers, or both.
+        const TF* src = nullptr;
+        int ncol_src = ncol;
+        bool const_lay = false;
+
+        switch (channel.source)
+        {
+            case Source::Play: src = play; break;
+            case Source::Plev: src = plev; break;
+            case Source::Tlay: src = tlay; break;
+            case Source::Tlev: src = tlev; break;
+            case Source::Gas:
+            {
+                const Array<TF,2>& vmr = gas_desc.get_vmr(channel.gas_name);
+                src = vmr.ptr();
+                ncol_src = vmr.dim(1);
+                const_lay = (vmr.dim(2) == 1);
+                break;
+            }
+        }
+
+        if (!src)
+            throw std::runtime_error("Feature pipeline needs a field that is not given");
+
+        const Target& first = channel.targets.front();
+
+        for (int ilay=lay_s; ilay<lay_e; ++ilay)
+        {
+            const TF* row = &src[(const_lay ? 0 : ilay+channel.lev_offset) * ncol_src];
+            float* out = &inputs[first.i_input][first.i_feature*nbatch + (ilay-lay_s)*ncol];
+
+            if (ncol_src == 1)
+            {
+                float value;
+                transform_row(row, &value, 1, channel.log);
+                std::fill(out, out+ncol, value);
+            }
+            else
+                transform_row(row, out, ncol, channel.log);
+
+            for (auto it=channel.targets.begin()+1; it!=channel.targets.end(); ++it)
+                std::copy(out, out+ncol, &inputs[it->i_input][it->i_feature*nbatch + (ilay-lay_s)*ncol]);
+
+            if (&channel == channel_dp)
+                thickness_row(&plev[ilay*ncol], &plev[(ilay+1)*ncol], &dp[ilay*ncol], ncol);
+        }
+    }
+}
+
+template class Feature_pipeline<float>;
+template class Feature_pipeline<double>;
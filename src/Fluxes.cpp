@@ -82,6 +82,77 @@ namespace rrtmgp_kernel_launcher
     }
 }
 
+namespace
+{
+    // Sum the g-point fluxes, accumulating in the precision of the broadband flux.
+    template<typename TF, typename TF_gpt>
+    void sum_broadband_widened(const Array<TF_gpt,3>& spectral_flux, Array<TF,2>& broadband_flux)
+    {
+        const int ncell = broadband_flux.size();
+        const int ngpt = spectral_flux.dim(3);
+
+        const TF_gpt* __restrict__ flux_in = spectral_flux.ptr();
+        TF* __restrict__ flux_out = broadband_flux.ptr();
+
+        std::fill(flux_out, flux_out + ncell, TF(0.));
+
+        for (int igpt=0; igpt<ngpt; ++igpt)
+            for (int i=0; i<ncell; ++i)
+                flux_out[i] += flux_in[i + igpt*ncell];
+    }
+
+    // G-point fluxes in the precision of the broadband fluxes go through the reduction
+    // of Fluxes_broadband, with the same kernels and top_at_1 as a reduce without storage.
+    template<typename TF>
+    void reduce_stored(
+            Fluxes_broadband<TF>& fluxes,
+            const Array<TF,3>& gpt_flux_up, const Array<TF,3>& gpt_flux_dn,
+            const BOOL_TYPE top_at_1)
+    {
+        fluxes.Fluxes_broadband<TF>::reduce(
+                gpt_flux_up, gpt_flux_dn, std::unique_ptr<Optical_props_arry<TF>>(), top_at_1);
+    }
+
+    template<typename TF>
+    void reduce_stored(
+            Fluxes_broadband<TF>& fluxes,
+            const Array<TF,3>& gpt_flux_up, const Array<TF,3>& gpt_flux_dn, const Array<TF,3>& gpt_flux_dn_dir,
+            const BOOL_TYPE top_at_1)
+    {
+        fluxes.Fluxes_broadband<TF>::reduce(
+                gpt_flux_up, gpt_flux_dn, gpt_flux_dn_dir, std::unique_ptr<Optical_props_arry<TF>>(), top_at_1);
+    }
+
+    // G-point fluxes in another precision are summed in the precision of the broadband fluxes. As in
+    // the reduction of Fluxes_broadband, top_at_1 leaves the broadband and net fluxes unchanged,
+    // because they are sums over the g-points and the difference of the downward and upward flux.
+    template<typename TF, typename TF_gpt>
+    void reduce_stored(
+            Fluxes_broadband<TF>& fluxes,
+            const Array<TF_gpt,3>& gpt_flux_up, const Array<TF_gpt,3>& gpt_flux_dn,
+            const BOOL_TYPE top_at_1)
+    {
+        const int ncol = gpt_flux_up.dim(1);
+        const int nlev = gpt_flux_up.dim(2);
+
+        sum_broadband_widened(gpt_flux_up, fluxes.get_flux_up());
+        sum_broadband_widened(gpt_flux_dn, fluxes.get_flux_dn());
+
+        rrtmgp_kernel_launcher::net_broadband(
+                ncol, nlev, fluxes.get_flux_dn(), fluxes.get_flux_up(), fluxes.get_flux_net());
+    }
+
+    template<typename TF, typename TF_gpt>
+    void reduce_stored(
+            Fluxes_broadband<TF>& fluxes,
+            const Array<TF_gpt,3>& gpt_flux_up, const Array<TF_gpt,3>& gpt_flux_dn, const Array<TF_gpt,3>& gpt_flux_dn_dir,
+            const BOOL_TYPE top_at_1)
+    {
+        reduce_stored(fluxes, gpt_flux_up, gpt_flux_dn, top_at_1);
+        sum_broadband_widened(gpt_flux_dn_dir, fluxes.get_flux_dn_dir());
+    }
+}
+
 template<typename TF>
 Fluxes_broadband<TF>::Fluxes_broadband(const int ncol, const int nlev) :
     flux_up    ({ncol, nlev}),
@@ -128,6 +199,24 @@ void Fluxes_broadband<TF>::reduce(
             gpt_flux_dn_dir, this->flux_dn_dir);
 }
 
+template<typename TF>
+template<typename TF_gpt>
+void Fluxes_broadband<TF>::reduce(
+    const Array<TF_gpt,3>& gpt_flux_up, const Array<TF_gpt,3>& gpt_flux_dn,
+    const BOOL_TYPE top_at_1)
+{
+    reduce_stored(*this, gpt_flux_up, gpt_flux_dn, top_at_1);
+}
+
+template<typename TF>
+template<typename TF_gpt>
+void Fluxes_broadband<TF>::reduce(
+    const Array<TF_gpt,3>& gpt_flux_up, const Array<TF_gpt,3>& gpt_flux_dn, const Array<TF_gpt,3>& gpt_flux_dn_dir,
+    const BOOL_TYPE top_at_1)
+{
+    reduce_stored(*this, gpt_flux_up, gpt_flux_dn, gpt_flux_dn_dir, top_at_1);
+}
+
 template<typename TF>
 Fluxes_byband<TF>::Fluxes_byband(const int ncol, const int nlev, const int nbnd) :
     Fluxes_broadband<TF>(ncol, nlev),
@@ -195,10 +284,20 @@ void Fluxes_byband<TF>::reduce(
             gpt_flux_dn_dir, this->bnd_flux_dn_dir);
 }
 
-#ifdef FLOAT_SINGLE_RRTMGP
 template class Fluxes_broadband<float>;
 template class Fluxes_byband<float>;
-#else
 template class Fluxes_broadband<double>;
 template class Fluxes_byband<double>;
-#endif
+
+template void Fluxes_broadband<float>::reduce(
+        const Array<float,3>&, const Array<float,3>&, const BOOL_TYPE);
+template void Fluxes_broadband<float>::reduce(
+        const Array<float,3>&, const Array<float,3>&, const Array<float,3>&, const BOOL_TYPE);
+template void Fluxes_broadband<double>::reduce(
+        const Array<float,3>&, const Array<float,3>&, const BOOL_TYPE);
+template void Fluxes_broadband<double>::reduce(
+        const Array<float,3>&, const Array<float,3>&, const Array<float,3>&, const BOOL_TYPE);
+template void Fluxes_broadband<double>::reduce(
+        const Array<double,3>&, const Array<double,3>&, const BOOL_TYPE);
+template void Fluxes_broadband<double>::reduce(
+        const Array<double,3>&, const Array<double,3>&, const Array<double,3>&, const BOOL_TYPE);
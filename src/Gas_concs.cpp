@@ -24,6 +24,7 @@
 
 #include "Gas_concs.h"
 #include "Array.h"
+#include "column_kernels.h"
 
 template<typename TF>
 Gas_concs<TF>::Gas_concs(const Gas_concs& gas_concs_ref, const int start, const int size)
@@ -41,6 +42,22 @@ Gas_concs<TF>::Gas_concs(const Gas_concs& gas_concs_ref, const int start, const
     }
 }
 
+// Gather the columns with the given indices, starting at 1.
+template<typename TF>
+Gas_concs<TF>::Gas_concs(const Gas_concs& gas_concs_ref, const std::vector<int>& cols)
+{
+    for (auto& g : gas_concs_ref.gas_concs_map)
+        this->gas_concs_map.emplace(g.first, column_kernels::gather(g.second, cols));
+}
+
+template<typename TF>
+template<typename TF_ref>
+Gas_concs<TF>::Gas_concs(const Gas_concs<TF_ref>& gas_concs_ref)
+{
+    for (auto& g : gas_concs_ref.gas_concs_map)
+        this->gas_concs_map.emplace(g.first, convert_array<TF>(g.second));
+}
+
 // Insert new gas into the map or update the value.
 template<typename TF>
 void Gas_concs<TF>::set_vmr(const std::string& name, const TF data)
@@ -76,6 +93,52 @@ void Gas_concs<TF>::set_vmr(const std::string& name, const Array<TF,2>& data_2d)
         gas_concs_map.emplace(name, data_2d);
 }
 
+// Insert new gas into the map or update the value, copying the viewed memory in a single pass.
+template<typename TF>
+void Gas_concs<TF>::set_vmr(const std::string& name, const Array_view<TF,2>& data)
+{
+    if (!data.is_contiguous())
+        throw std::runtime_error("Gas concentrations can only be set from contiguous memory");
+
+    Array<TF,2> data_2d(std::vector<TF>(data.ptr(), data.ptr() + data.size()), data.get_dims());
+
+    if (this->exists(name))
+        gas_concs_map.at(name) = std::move(data_2d);
+    else
+        gas_concs_map.emplace(name, std::move(data_2d));
+}
+
+template<typename TF>
+void Gas_concs<TF>::get_subset(Gas_concs& gas_concs_sub, const int col_s, const int col_e) const
+{
+    for (auto& g : this->gas_concs_map)
+        gas_concs_sub.set_vmr(g.first, Array_view<TF,2>(g.second), col_s, col_e);
+}
+
+// Insert new gas into the map or update the value, copying the columns col_s to col_e.
+template<typename TF>
+void Gas_concs<TF>::set_vmr(const std::string& name, const Array_view<TF,2>& data, const int col_s, const int col_e)
+{
+    const int n_col_data = data.dim(1);
+    const int n_lay = data.dim(2);
+
+    // Columns that are constant in the data stay constant in the map.
+    const std::array<int,2> dims = {(n_col_data == 1) ? 1 : col_e-col_s+1, n_lay};
+
+    auto it = gas_concs_map.find(name);
+    if (it == gas_concs_map.end())
+        it = gas_concs_map.emplace(name, Array<TF,2>(dims)).first;
+    else if (it->second.get_dims() != dims)
+        it->second = Array<TF,2>(dims);
+
+    Array<TF,2>& vmr = it->second;
+    const int col_offset = (n_col_data == 1) ? 0 : col_s-1;
+
+    for (int ilay=1; ilay<=n_lay; ++ilay)
+        for (int icol=1; icol<=dims[0]; ++icol)
+            vmr({icol, ilay}) = data({icol+col_offset, ilay});
+}
+
 // Get gas from map.
 template<typename TF>
 const Array<TF,2>& Gas_concs<TF>::get_vmr(const std::string& name) const
@@ -90,8 +153,16 @@ BOOL_TYPE Gas_concs<TF>::exists(const std::string& name) const
     return gas_concs_map.count(name) != 0;
 }
 
-#ifdef FLOAT_SINGLE_RRTMGP
+template<typename TF>
+std::vector<std::string> Gas_concs<TF>::get_gas_names() const
+{
+    std::vector<std::string> names;
+    for (auto& g : gas_concs_map)
+        names.push_back(g.first);
+    return names;
+}
+
 template class Gas_concs<float>;
-#else
 template class Gas_concs<double>;
-#endif
+template Gas_concs<float>::Gas_concs(const Gas_concs<double>&);
+template Gas_concs<double>::Gas_concs(const Gas_concs<float>&);
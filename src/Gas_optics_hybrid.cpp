@@ -0,0 +1,261 @@
+/*
+ * This file is part of a C++ interface to the Radiative Transfer for Energetics (RTE)
+ * and Rapid Radiative Transfer Model for GCM applications Parallel (RRTMGP).
+ *
+ * The original code is found at https://github.com/earth-system-radiation/rte-rrtmgp.
+ *
+ * Contacts: Robert Pincus and Eli Mlawer
+ * email: rrtmgp@aer.com
+ *
+ * Copyright 2015-2020,  Atmospheric and Environmental Research and
+ * Regents of the University of Colorado.  All right reserved.
+ *
+ * This C++ interface can be downloaded from https://github.com/earth-system-radiation/rte-rrtmgp-cpp
+ *
+ * Contact: Chiel van Heerwaarden
+ * email: chiel.vanheerwaarden@wur.nl
+ *
+ * Copyright 2020, Wageningen University & Research.
+ *
+ * Use and duplication is permitted under the terms of the
+ * BSD 3-clause license, see http://opensource.org/licenses/BSD-3-Clause
+ *
+ */
+
+#include "Gas_optics_hybrid.h"
+#include "Gas_concs.h"
+#include "Optical_props.h"
+#include "Source_functions.h"
+#include "column_kernels.h"
+
+namespace
+{
+    // Compute the longwave optical properties and sources of a selection of columns
+    // with the given gas optics and store them in the full arrays.
+    template<typename TF>
+    void gas_optics_subset(
+            const Gas_optics<TF>& kdist,
+            const std::vector<int>& cols,
+            const Array<TF,2>& play,
+            const Array<TF,2>& plev,
+            const Array<TF,2>& tlay,
+            const Array<TF,1>& tsfc,
+            const Gas_concs<TF>& gas_desc,
+            std::unique_ptr<Optical_props_arry<TF>>& optical_props,
+            Source_func_lw<TF>& sources,
+            const Array<TF,2>& col_dry,
+            const Array<TF,2>& tlev)
+    {
+        const int ncol_sub = cols.size();
+        const int nlay = play.dim(2);
+
+        Gas_concs<TF> gas_desc_sub(gas_desc, cols);
+        std::unique_ptr<Optical_props_arry<TF>> optical_props_sub =
+                std::make_unique<Optical_props_1scl<TF>>(ncol_sub, nlay, kdist);
+        Source_func_lw<TF> sources_sub(ncol_sub, nlay, kdist);
+
+        // The columns of the networks have split level sources, so all columns get them.
+        sources.split_lev_source();
+        sources_sub.split_lev_source();
+
+        kdist.gas_optics(
+                column_kernels::gather(play, cols),
+                column_kernels::gather(plev, cols),
+                column_kernels::gather(tlay, cols),
+                column_kernels::gather(tsfc, cols),
+                gas_desc_sub,
+                optical_props_sub,
+                sources_sub,
+                column_kernels::gather(col_dry, cols),
+                column_kernels::gather(tlev, cols));
+
+        column_kernels::scatter(optical_props->get_tau(), optical_props_sub->get_tau(), cols);
+        column_kernels::scatter(sources.get_lay_source(), sources_sub.get_lay_source(), cols);
+        column_kernels::scatter(sources.get_lev_source_inc(), sources_sub.get_lev_source_inc(), cols);
+        column_kernels::scatter(sources.get_lev_source_dec(), sources_sub.get_lev_source_dec(), cols);
+        column_kernels::scatter(sources.get_sfc_source(), sources_sub.get_sfc_source(), cols);
+        column_kernels::scatter(sources.get_sfc_source_jac(), sources_sub.get_sfc_source_jac(), cols);
+    }
+
+    // Shortwave variant.
+    template<typename TF>
+    void gas_optics_subset(
+            const Gas_optics<TF>& kdist,
+            const std::vector<int>& cols,
+            const Array<TF,2>& play,
+            const Array<TF,2>& plev,
+            const Array<TF,2>& tlay,
+            const Gas_concs<TF>& gas_desc,
+            std::unique_ptr<Optical_props_arry<TF>>& optical_props,
+            Array<TF,2>& toa_src,
+            const Array<TF,2>& col_dry)
+    {
+        const int ncol_sub = cols.size();
+        const int nlay = play.dim(2);
+
+        Gas_concs<TF> gas_desc_sub(gas_desc, cols);
+        std::unique_ptr<Optical_props_arry<TF>> optical_props_sub =
+                std::make_unique<Optical_props_2str<TF>>(ncol_sub, nlay, kdist);
+        Array<TF,2> toa_src_sub({ncol_sub, kdist.get_ngpt()});
+
+        kdist.gas_optics(
+                column_kernels::gather(play, cols),
+                column_kernels::gather(plev, cols),
+                column_kernels::gather(tlay, cols),
+                gas_desc_sub,
+                optical_props_sub,
+                toa_src_sub,
+                column_kernels::gather(col_dry, cols));
+
+        column_kernels::scatter(optical_props->get_tau(), optical_props_sub->get_tau(), cols);
+        column_kernels::scatter(optical_props->get_ssa(), optical_props_sub->get_ssa(), cols);
+        column_kernels::scatter(optical_props->get_g  (), optical_props_sub->get_g  (), cols);
+        column_kernels::scatter(toa_src, toa_src_sub, cols);
+    }
+}
+
+template<typename TF>
+Gas_optics_hybrid<TF>::Gas_optics_hybrid(
+        std::unique_ptr<Gas_optics_nn<TF>> gas_optics_nn,
+        std::unique_ptr<Gas_optics_rrtmgp<TF>> gas_optics_rrtmgp,
+        const TF n_sigma) :
+    Gas_optics<TF>(gas_optics_rrtmgp->get_band_lims_wavenumber(), gas_optics_rrtmgp->get_band_lims_gpoint()),
+    gas_optics_nn(std::move(gas_optics_nn)),
+    gas_optics_rrtmgp(std::move(gas_optics_rrtmgp)),
+    n_sigma(n_sigma),
+    n_col_nn(0), n_col_total(0), n_lay_out(0), n_lay_total(0)
+{
+    if (this->gas_optics_nn->get_ngpt() != this->gas_optics_rrtmgp->get_ngpt()
+            || this->gas_optics_nn->get_nband() != this->gas_optics_rrtmgp->get_nband())
+        throw std::runtime_error("Neural network and RRTMGP gas optics have different spectral discretizations");
+}
+
+template<typename TF>
+void Gas_optics_hybrid<TF>::classify_columns(
+        const Array<TF,2>& play,
+        const Array<TF,2>& tlay,
+        const Array<TF,2>& tlev,
+        const Gas_concs<TF>& gas_desc,
+        std::vector<int>& cols_nn,
+        std::vector<int>& cols_rrtmgp) const
+{
+    const int ncol = play.dim(1);
+    const int nlay = play.dim(2);
+
+    std::vector<int> col_in_envelope;
+    const int n_out = gas_optics_nn->check_envelope(
+            play, tlay, tlev, gas_desc, this->n_sigma, col_in_envelope);
+
+    for (int icol=1; icol<=ncol; ++icol)
+    {
+        if (col_in_envelope[icol-1])
+            cols_nn.push_back(icol);
+        else
+            cols_rrtmgp.push_back(icol);
+    }
+
+    n_col_nn += cols_nn.size();
+    n_col_total += ncol;
+    n_lay_out += n_out;
+    n_lay_total += ncol*nlay;
+}
+
+// Gas optics solver longwave variant.
+template<typename TF>
+void Gas_optics_hybrid<TF>::gas_optics(
+        const Array<TF,2>& play,
+        const Array<TF,2>& plev,
+        const Array<TF,2>& tlay,
+        const Array<TF,1>& tsfc,
+        const Gas_concs<TF>& gas_desc,
+        std::unique_ptr<Optical_props_arry<TF>>& optical_props,
+        Source_func_lw<TF>& sources,
+        const Array<TF,2>& col_dry,
+        const Array<TF,2>& tlev) const
+{
+    std::vector<int> cols_nn;
+    std::vector<int> cols_rrtmgp;
+    classify_columns(play, tlay, tlev, gas_desc, cols_nn, cols_rrtmgp);
+
+    // Avoid the gather and scatter if all columns go to one of the two.
+    if (cols_rrtmgp.empty())
+        gas_optics_nn->gas_optics(
+                play, plev, tlay, tsfc, gas_desc, optical_props, sources, col_dry, tlev);
+    else if (cols_nn.empty())
+        gas_optics_rrtmgp->gas_optics(
+                play, plev, tlay, tsfc, gas_desc, optical_props, sources, col_dry, tlev);
+    else
+    {
+        gas_optics_subset(
+                *gas_optics_nn, cols_nn,
+                play, plev, tlay, tsfc, gas_desc, optical_props, sources, col_dry, tlev);
+        gas_optics_subset(
+                *gas_optics_rrtmgp, cols_rrtmgp,
+                play, plev, tlay, tsfc, gas_desc, optical_props, sources, col_dry, tlev);
+    }
+}
+
+// Gas optics solver shortwave variant.
+template<typename TF>
+void Gas_optics_hybrid<TF>::gas_optics(
+        const Array<TF,2>& play,
+        const Array<TF,2>& plev,
+        const Array<TF,2>& tlay,
+        const Gas_concs<TF>& gas_desc,
+        std::unique_ptr<Optical_props_arry<TF>>& optical_props,
+        Array<TF,2>& toa_src,
+        const Array<TF,2>& col_dry) const
+{
+    std::vector<int> cols_nn;
+    std::vector<int> cols_rrtmgp;
+    classify_columns(play, tlay, Array<TF,2>(), gas_desc, cols_nn, cols_rrtmgp);
+
+    if (cols_rrtmgp.empty())
+        gas_optics_nn->gas_optics(
+                play, plev, tlay, gas_desc, optical_props, toa_src, col_dry);
+    else if (cols_nn.empty())
+        gas_optics_rrtmgp->gas_optics(
+                play, plev, tlay, gas_desc, optical_props, toa_src, col_dry);
+    else
+    {
+        gas_optics_subset(
+                *gas_optics_nn, cols_nn,
+                play, plev, tlay, gas_desc, optical_props, toa_src, col_dry);
+        gas_optics_subset(
+                *gas_optics_rrtmgp, cols_rrtmgp,
+                play, plev, tlay, gas_desc, optical_props, toa_src, col_dry);
+    }
+}
+
+template<typename TF>
+TF Gas_optics_hybrid<TF>::get_nn_column_fraction() const
+{
+    const long long n_total = n_col_total;
+    return (n_total > 0) ? TF(n_col_nn) / TF(n_total) : TF(0.);
+}
+
+template<typename TF>
+TF Gas_optics_hybrid<TF>::get_rrtmgp_column_fraction() const
+{
+    const long long n_total = n_col_total;
+    return (n_total > 0) ? TF(1.) - get_nn_column_fraction() : TF(0.);
+}
+
+template<typename TF>
+TF Gas_optics_hybrid<TF>::get_out_of_envelope_layer_fraction() const
+{
+    const long long n_total = n_lay_total;
+    return (n_total > 0) ? TF(n_lay_out) / TF(n_total) : TF(0.);
+}
+
+template<typename TF>
+void Gas_optics_hybrid<TF>::reset_stats()
+{
+    n_col_nn = 0;
+    n_col_total = 0;
+    n_lay_out = 0;
+    n_lay_total = 0;
+}
+
+template class Gas_optics_hybrid<float>;
+template class Gas_optics_hybrid<double>;
@@ -1,10 +1,15 @@
+#include <algorithm>
 #include <cmath>
+#include <map>
 #include <numeric>
 #include <chrono>
 #include <boost/algorithm/string.hpp>
 #include "Gas_concs.h"
 #include "Netcdf_interface.h"
 #include "Gas_optics_nn.h"
+#include "Cpu_dispatch.h"
+#include "vector_math.h"
+#include "Thread_pool.h"
 #include "Array.h"
 #include "Status.h"
 #include "Optical_props.h"
@@ -17,88 +22,124 @@
 
 namespace
 {
-    inline float logarithm(float x)
+    // Features of the network input of a group in the weights file. The file can list them in a
+    // char variable features(nfeature, nchar), otherwise the features of the original networks are used.
+    std::vector<std::string> read_features(
+            const Netcdf_group& grp, const std::vector<std::string>& features_default)
     {
-        x = std::sqrt(x);
-        x = std::sqrt(x);
-        x = std::sqrt(x);
-        x = std::sqrt(x);
-        x = (x-1.0f) * 16.0f;
-        return x;
+        if (!grp.variable_exists("features"))
+            return features_default;
+
+        const std::map<std::string, int> dims = grp.get_variable_dimensions("features");
+        if (dims.size() != 2 || dims.count("nchar") == 0)
+            throw std::runtime_error("Features in the weights file must have dimensions (nfeature, nchar)");
+
+        const int n_char = dims.at("nchar");
+        int n_feature = 0;
+        for (const auto& dim : dims)
+            if (dim.first != "nchar")
+                n_feature = dim.second;
+
+        const std::vector<char> features_char = grp.get_variable<char>("features", {n_feature, n_char});
+
+        std::vector<std::string> features;
+        for (int i=0; i<n_feature; ++i)
+        {
+            std::string feature(features_char.begin() + i*n_char, features_char.begin() + (i+1)*n_char);
+            feature.erase(std::find(feature.begin(), feature.end(), '\0'), feature.end());
+            boost::trim(feature);
+            features.push_back(feature);
+        }
+
+        return features;
     }
- 
+
+    // Ratio of the surface source to the source of the surface layer of one band, which is a power
+    // law in the temperatures, and its derivative to the surface temperature. The power is evaluated
+    // in double precision with vector_math::pow, as std::pow does not vectorize.
+    template<typename TF>
+    DISPATCH_KERNEL void compute_sfc_factor(
+            const TF* restrict const t_sfc, const TF* restrict const t_lay,
+            TF* restrict const factor, TF* restrict const factor_jac,
+            const TF coef_sfc, const TF coef_lay, const TF exponent, const int ncol)
+    {
+        #pragma ivdep
+        for (int icol=0; icol<ncol; ++icol)
+        {
+            factor[icol] = TF(vector_math::pow(
+                    double((coef_sfc*t_sfc[icol] - TF(1.)) / (coef_lay*t_lay[icol] - TF(1.))), double(exponent)));
+            factor_jac[icol] = factor[icol] * exponent*coef_sfc / (coef_sfc*t_sfc[icol] - TF(1.));
+        }
+    }
+
+    // Buffers of the network inputs and layer thicknesses, kept per thread and reused between
+    // calls, such that the batch size is not limited by the stack and calls can run concurrently.
+    struct Nn_workspace
+    {
+        std::vector<float> dp;
+        std::vector<float> input;
+        std::vector<float> input_plk;
+    };
+
+    Nn_workspace& get_workspace()
+    {
+        thread_local Nn_workspace workspace;
+        return workspace;
+    }
+
+    // The epilogues below receive the network output of one g-point for a range of batch elements,
+    // which count the (col, lay) pairs from layer n_bot upward, and write it directly at its
+    // (col, lay, gpt) position.
     template<typename TF>
-    void copy_arrays_tau(
-                 const float* restrict const data_in,
+    Network::Output_epilogue tau_epilogue(
                  const float* restrict const data_dp,
                  TF* restrict const data_out,
                  const int n_col, const int n_bot,
-                 const int n_top, const int n_gpt,
                  const int n_lay)
     {
-        const float* dp_temp = &data_dp[n_col*n_bot];
-        const int n_sub = n_top-n_bot;
-        for (int i=0; i<n_gpt; ++i)
+        return [=](const int i_gpt, const float* restrict const data_in, const int j_start, const int n_batch)
         {
-            const int outidx = i*n_lay*n_col + n_bot*n_col;
-            const float* in_temp = &data_in[i*n_sub*n_col];
-            TF* out_temp = &data_out[outidx];
-            #pragma ivdep            
-            for (int j=0; j<n_col*n_sub; ++j)
-                out_temp[j] = in_temp[j] * dp_temp[j];
-        }
+            const float* dp_temp = &data_dp[n_col*n_bot + j_start];
+            TF* out_temp = &data_out[i_gpt*n_lay*n_col + n_bot*n_col + j_start];
+            #pragma ivdep
+            for (int j=0; j<n_batch; ++j)
+                out_temp[j] = data_in[j] * dp_temp[j];
+        };
     }
 
     template<typename TF>
-    void copy_arrays_ssa(
-                 const float* restrict const data_in,
+    Network::Output_epilogue ssa_epilogue(
                  TF* restrict const data_out,
                  const int n_col, const int n_bot,
-                 const int n_top, const int n_gpt,
-                 const int nlay)
+                 const int n_lay)
     {
-        const int n_sub = n_top-n_bot;
-        for (int i=0; i<n_gpt; ++i)
+        return [=](const int i_gpt, const float* restrict const data_in, const int j_start, const int n_batch)
         {
-            const int outidx = i*nlay*n_col+n_bot*n_col;
-            const float* in_temp = &data_in[i*n_sub*n_col];
-            TF* out_temp = &data_out[outidx];
-            #pragma ivdep            
-            for (int j=0; j<n_col*n_sub; ++j)
-            {
-                out_temp[j] = in_temp[j]; 
-            }             
-        }
+            TF* out_temp = &data_out[i_gpt*n_lay*n_col + n_bot*n_col + j_start];
+            #pragma ivdep
+            for (int j=0; j<n_batch; ++j)
+                out_temp[j] = data_in[j];
+        };
     }
 
+    // The network predicts the layer source and the source at the upper (inc) and lower (dec) level
+    // of each layer, in this order, which are stored as they are.
     template<typename TF>
-    void copy_arrays_plk(
-                 const float* restrict const data_in,
-                 TF* restrict const data_out1,
-                 TF* restrict const data_out2,
-                 TF* restrict const data_out3,
+    Network::Output_epilogue plk_epilogue(
+                 TF* restrict const lay_src,
+                 TF* restrict const lev_src_inc,
+                 TF* restrict const lev_src_dec,
                  const int n_col, const int n_bot,
-                 const int n_top, const int n_gpt,
-                 const int nlay)
+                 const int n_gpt, const int n_lay)
     {
-        const int n_sub = n_top-n_bot;
-        for (int i=0; i<n_gpt; ++i)
+        return [=](const int i_out, const float* restrict const data_in, const int j_start, const int n_batch)
         {
-            const int outidx = i*nlay*n_col+n_bot*n_col;
-            const float* in_temp1 = &data_in[i*n_sub*n_col];
-            const float* in_temp2 = &data_in[(i+n_gpt)*n_sub*n_col];
-            const float* in_temp3 = &data_in[(i+n_gpt+n_gpt)*n_sub*n_col];
-            TF* out_temp1= &data_out1[outidx];
-            TF* out_temp2= &data_out2[outidx];
-            TF* out_temp3= &data_out3[outidx];
-            #pragma ivdep           
-            for (int j=0; j<n_col*n_sub; ++j)
-            {
-                out_temp1[j] = in_temp1[j];
-                out_temp2[j] = in_temp2[j];
-                out_temp3[j] = in_temp3[j];
-            }
-        }
+            TF* const data_out = (i_out < n_gpt) ? lay_src : (i_out < 2*n_gpt) ? lev_src_inc : lev_src_dec;
+            TF* out_temp = &data_out[(i_out % n_gpt)*n_lay*n_col + n_bot*n_col + j_start];
+            #pragma ivdep
+            for (int j=0; j<n_batch; ++j)
+                out_temp[j] = data_in[j];
+        };
     }
 }
        
@@ -159,6 +200,9 @@ void Gas_optics_nn<TF>::gas_optics(
     const int ngpt = this->get_ngpt();
     const int nband = this->get_nband();
 
+    // The Planck network predicts the sources at the bottom and top level of each layer independently.
+    sources.split_lev_source();
+
     compute_tau_sources_nn(
             this->tlw_network, this->plk_network,
             ncol, nlay, ngpt, nband, this->idx_tropo,
@@ -229,6 +273,70 @@ TF Gas_optics_nn<TF>::get_tsi() const
     return tsi;
 }
 
+template<typename TF>
+int Gas_optics_nn<TF>::check_envelope(
+        const Array<TF,2>& play,
+        const Array<TF,2>& tlay,
+        const Array<TF,2>& tlev,
+        const Gas_concs<TF>& gas_desc,
+        const TF n_sigma,
+        std::vector<int>& col_in_envelope) const
+{
+    const int ncol = play.dim(1);
+    const int nlay = play.dim(2);
+
+    col_in_envelope.assign(ncol, 1);
+    int n_out = 0;
+
+    std::vector<float> input_tau;
+    std::vector<float> input_plk;
+    std::vector<int> in_envelope;
+
+    for (int lower=1; lower>=0; --lower)
+    {
+        const int lay_s = lower ? 0 : this->idx_tropo;
+        const int lay_e = lower ? this->idx_tropo : nlay;
+        const int nbatch = ncol*(lay_e-lay_s);
+
+        if (nbatch == 0)
+            continue;
+
+        in_envelope.assign(nbatch, 1);
+
+        // The inputs are constructed as in the inference.
+        input_tau.resize(nbatch*this->features.get_n_features(this->i_input_tau));
+
+        if (this->is_longwave)
+        {
+            input_plk.resize(nbatch*this->features.get_n_features(this->i_input_plk));
+            this->features.assemble(
+                    play.ptr(), nullptr, tlay.ptr(), tlev.ptr(), gas_desc,
+                    ncol, lay_s, lay_e, {input_tau.data(), input_plk.data()});
+
+            this->tlw_network.check_envelope(input_tau.data(), in_envelope.data(), nbatch, lower, n_sigma);
+            this->plk_network.check_envelope(input_plk.data(), in_envelope.data(), nbatch, lower, n_sigma);
+        }
+        else
+        {
+            this->features.assemble(
+                    play.ptr(), nullptr, tlay.ptr(), nullptr, gas_desc,
+                    ncol, lay_s, lay_e, {input_tau.data()});
+
+            this->tsw_network.check_envelope(input_tau.data(), in_envelope.data(), nbatch, lower, n_sigma);
+            this->ssa_network.check_envelope(input_tau.data(), in_envelope.data(), nbatch, lower, n_sigma);
+        }
+
+        for (int idx=0; idx<nbatch; ++idx)
+            if (!in_envelope[idx])
+            {
+                col_in_envelope[idx % ncol] = 0;
+                ++n_out;
+            }
+    }
+
+    return n_out;
+}
+
 template<typename TF>
 void Gas_optics_nn<TF>::initialize_networks(
         const std::string& wgth_file,
@@ -260,34 +368,56 @@ void Gas_optics_nn<TF>::initialize_networks(
     const int n_out_lw = nc_wgth.get_dimension_size("nout_lw");
     const int n_o3 = nc_wgth.get_dimension_size("ngases");
 
-    const int n_in = 3 + n_o3;
     const int n_gpt = this->get_ngpt();
 
+    std::vector<std::string> features_default = {"log(" + this->gas_names({1}) + ")"};
+    if (n_o3 == 1)
+        features_default.push_back("log(" + this->gas_names({3}) + ")");
+    features_default.insert(features_default.end(), {"log(play)", "tlay"});
+
     if (n_gpt == n_out_lw)
     {
+        // The Planck network has the temperatures of the levels below and above the layer extra.
+        std::vector<std::string> features_plk_default = features_default;
+        features_plk_default.insert(features_plk_default.end(), {"tlev", "tlev+1"});
+
         const int n_out_plk = n_out_lw * 3;
-        const int n_in_plk  = n_in + 2;
         Netcdf_group tlwnc = nc_wgth.get_group("TLW");
+        const std::vector<std::string> features_tlw = read_features(tlwnc, features_default);
         this->tlw_network = Network(tlwnc,
                                     n_layers, n_layer1, n_layer2, n_layer3,
-                                    n_out_lw, n_in);
+                                    n_out_lw, features_tlw.size());
 
         Netcdf_group plknc = nc_wgth.get_group("Planck");
+        const std::vector<std::string> features_plk = read_features(plknc, features_plk_default);
         this->plk_network = Network(plknc,
                                     n_layers, n_layer1, n_layer2, n_layer3,
-                                    n_out_plk, n_in_plk);
+                                    n_out_plk, features_plk.size());
+
+        this->i_input_tau = this->features.add_input(features_tlw);
+        this->i_input_plk = this->features.add_input(features_plk);
+
+        initialize_sfc_factor(nc_wgth);
+        this->is_longwave = true;
     }
     else if (n_gpt == n_out_sw)
     {
         Netcdf_group tswnc = nc_wgth.get_group("TSW");
+        const std::vector<std::string> features_tsw = read_features(tswnc, features_default);
         this->tsw_network = Network(tswnc,
                                    n_layers, n_layer1, n_layer2, n_layer3,
-                                   n_out_sw, n_in);
+                                   n_out_sw, features_tsw.size());
 
+        // The SSA network reuses the input of the TSW network after its normalization.
         Netcdf_group ssanc = nc_wgth.get_group("SSA");
+        if (read_features(ssanc, features_tsw) != features_tsw)
+            throw std::runtime_error("The SSA network must have the same features as the TSW network");
         this->ssa_network = Network(ssanc,
                                     n_layers, n_layer1, n_layer2, n_layer3,
-                                    n_out_sw, n_in);
+                                    n_out_sw, features_tsw.size());
+
+        this->i_input_tau = this->features.add_input(features_tsw);
+        this->is_longwave = false;
     }
     else
     {
@@ -298,7 +428,48 @@ void Gas_optics_nn<TF>::initialize_networks(
     this->n_layer1 = n_layer1;
     this->n_layer2 = n_layer2;
     this->n_layer3 = n_layer3;
-    this->n_o3 = n_o3;
+}
+
+template<typename TF>
+void Gas_optics_nn<TF>::initialize_sfc_factor(
+        const Netcdf_file& nc_wgth)
+{
+    const int n_bnd = this->get_nband();
+
+    if (nc_wgth.variable_exists("sfc_factor_exponent"))
+    {
+        this->sfc_factor_coef_sfc.set_dims({n_bnd});
+        this->sfc_factor_coef_lay.set_dims({n_bnd});
+        this->sfc_factor_exponent.set_dims({n_bnd});
+
+        this->sfc_factor_coef_sfc = nc_wgth.get_variable<TF>("sfc_factor_coef_sfc", {n_bnd});
+        this->sfc_factor_coef_lay = nc_wgth.get_variable<TF>("sfc_factor_coef_lay", {n_bnd});
+        this->sfc_factor_exponent = nc_wgth.get_variable<TF>("sfc_factor_exponent", {n_bnd});
+    }
+    else
+    {
+        if (n_bnd != 16)
+            throw std::runtime_error("Weights file has no surface source factor tables and the default ones require 16 bands");
+
+        // Numbers are fitted from the longwave coefficients file.
+        this->sfc_factor_coef_sfc = Array<TF,1>(
+                {0.0131757912608200, 0.0092778215915162, 0.0081221064580734, 0.0078298195508505,
+                 0.0076928950299874, 0.0075653865084563, 0.0074522945371839, 0.0074105017545267,
+                 0.0074119101719575, 0.0073401394763094, 0.0074075710256119, 0.0073542571820469,
+                 0.0073059753467312, 0.0072946170050561, 0.0073266552903883, 0.0074129528692143}, {n_bnd});
+
+        this->sfc_factor_coef_lay = Array<TF,1>(
+                {0.01317579126081997, 0.00927782159151618, 0.00812210645807336, 0.00782981955085045,
+                 0.00769289502998736, 0.00756538650845630, 0.00745229453718388, 0.00741050175452665,
+                 0.00741191017195750, 0.00734013947630943, 0.00740757102561185, 0.00735425718204687,
+                 0.00730597534673117, 0.00729461700505611, 0.00732665529038828, 0.00741295286921425}, {n_bnd});
+
+        this->sfc_factor_exponent = Array<TF,1>(
+                {1.1209724347746475, 1.4149505728750649, 1.7153859296550862, 1.9129486781120648,
+                 2.121924616912191,  2.4434431185689567, 2.7504289450500714, 2.9950297268205865,
+                 3.3798218227597565, 3.760811429547177,  4.267112286396149,  5.037348344205931,
+                 5.629568565488524,  6.032163655628699,  6.566161469007115,  7.579678774748928}, {n_bnd});
+    }
 }
 
 template<typename TF>
@@ -310,38 +481,44 @@ void Gas_optics_nn<TF>::lay2sfc_factor(
         const int nlay,
         const int nband) const
 {
-    Array<TF,1> sfc_factor({nband});
+    const TF* restrict const t_sfc = tsfc.ptr();
+    const TF* restrict const t_lay = tlay.ptr(); // Surface layer is the first layer.
+    const TF* restrict const src_layer = sources.get_lay_source().ptr();
+    TF* restrict const src_sfc = sources.get_sfc_source().ptr();
+    TF* restrict const src_sfc_jac = sources.get_sfc_source_jac().ptr();
+
+    const Array<int,2> band2gpt = this->get_band_lims_gpoint();
+
+    // Compute the factor for all bands over contiguous columns, such that the pow vectorizes.
+    std::vector<TF> sfc_factor(ncol*nband);
+    std::vector<TF> sfc_factor_jac(ncol*nband);
+
+    for (int iband=0; iband<nband; ++iband)
+        compute_sfc_factor(
+                t_sfc, t_lay, &sfc_factor[iband*ncol], &sfc_factor_jac[iband*ncol],
+                this->sfc_factor_coef_sfc({iband+1}), this->sfc_factor_coef_lay({iband+1}),
+                this->sfc_factor_exponent({iband+1}), ncol);
+
+    // Expand the factors to the g-points of each band.
+    for (int iband=0; iband<nband; ++iband)
+    {
+        const TF* restrict const factor = &sfc_factor[iband*ncol];
+        const TF* restrict const factor_jac = &sfc_factor_jac[iband*ncol];
 
-    const Array<TF,3>& src_layer = sources.get_lay_source();
-    Array<TF,2>& src_sfc = sources.get_sfc_source();
+        for (int igpt=band2gpt({1, iband+1})-1; igpt<band2gpt({2, iband+1}); ++igpt)
+        {
+            const TF* restrict const lay_gpt = &src_layer[igpt*nlay*ncol];
+            TF* restrict const sfc_gpt = &src_sfc[igpt*ncol];
+            TF* restrict const sfc_jac_gpt = &src_sfc_jac[igpt*ncol];
 
-    for (int icol=1; icol<=ncol; ++icol)
-    {
-        //numbers are fitted from longwave coefficients file
-        sfc_factor({1})  = pow((TF(0.0131757912608200)*tsfc({icol})-TF(1.)) / (TF(0.01317579126081997)*tlay({icol,1})-TF(1.)), TF(1.1209724347746475));
-        sfc_factor({2})  = pow((TF(0.0092778215915162)*tsfc({icol})-TF(1.)) / (TF(0.00927782159151618)*tlay({icol,1})-TF(1.)), TF(1.4149505728750649));
-        sfc_factor({3})  = pow((TF(0.0081221064580734)*tsfc({icol})-TF(1.)) / (TF(0.00812210645807336)*tlay({icol,1})-TF(1.)), TF(1.7153859296550862));
-        sfc_factor({4})  = pow((TF(0.0078298195508505)*tsfc({icol})-TF(1.)) / (TF(0.00782981955085045)*tlay({icol,1})-TF(1.)), TF(1.9129486781120648));
-        sfc_factor({5})  = pow((TF(0.0076928950299874)*tsfc({icol})-TF(1.)) / (TF(0.00769289502998736)*tlay({icol,1})-TF(1.)), TF(2.121924616912191));
-        sfc_factor({6})  = pow((TF(0.0075653865084563)*tsfc({icol})-TF(1.)) / (TF(0.00756538650845630)*tlay({icol,1})-TF(1.)), TF(2.4434431185689567));
-        sfc_factor({7})  = pow((TF(0.0074522945371839)*tsfc({icol})-TF(1.)) / (TF(0.00745229453718388)*tlay({icol,1})-TF(1.)), TF(2.7504289450500714));
-        sfc_factor({8})  = pow((TF(0.0074105017545267)*tsfc({icol})-TF(1.)) / (TF(0.00741050175452665)*tlay({icol,1})-TF(1.)), TF(2.9950297268205865));
-        sfc_factor({9})  = pow((TF(0.0074119101719575)*tsfc({icol})-TF(1.)) / (TF(0.00741191017195750)*tlay({icol,1})-TF(1.)), TF(3.3798218227597565));
-        sfc_factor({10}) = pow((TF(0.0073401394763094)*tsfc({icol})-TF(1.)) / (TF(0.00734013947630943)*tlay({icol,1})-TF(1.)), TF(3.760811429547177));
-        sfc_factor({11}) = pow((TF(0.0074075710256119)*tsfc({icol})-TF(1.)) / (TF(0.00740757102561185)*tlay({icol,1})-TF(1.)), TF(4.267112286396149));
-        sfc_factor({12}) = pow((TF(0.0073542571820469)*tsfc({icol})-TF(1.)) / (TF(0.00735425718204687)*tlay({icol,1})-TF(1.)), TF(5.037348344205931));
-        sfc_factor({13}) = pow((TF(0.0073059753467312)*tsfc({icol})-TF(1.)) / (TF(0.00730597534673117)*tlay({icol,1})-TF(1.)), TF(5.629568565488524));
-        sfc_factor({14}) = pow((TF(0.0072946170050561)*tsfc({icol})-TF(1.)) / (TF(0.00729461700505611)*tlay({icol,1})-TF(1.)), TF(6.032163655628699));
-        sfc_factor({15}) = pow((TF(0.0073266552903883)*tsfc({icol})-TF(1.)) / (TF(0.00732665529038828)*tlay({icol,1})-TF(1.)), TF(6.566161469007115));
-        sfc_factor({16}) = pow((TF(0.0074129528692143)*tsfc({icol})-TF(1.)) / (TF(0.00741295286921425)*tlay({icol,1})-TF(1.)), TF(7.579678774748928));
-
-        for (int iband=1; iband<=nband; ++iband)
-            for (int igpt=1; igpt<=16; ++igpt)
+            #pragma ivdep
+            for (int icol=0; icol<ncol; ++icol)
             {
-                const int idxgpt = igpt + 16 * (iband-1);
-                src_sfc({icol,idxgpt}) = sfc_factor({iband}) * src_layer({icol,1,idxgpt});
-            }           
-    }                       
+                sfc_gpt[icol] = factor[icol] * lay_gpt[icol];
+                sfc_jac_gpt[icol] = factor_jac[icol] * lay_gpt[icol];
+            }
+        }
+    }
 }
  
 //Neural Network optical property function for shortwave
@@ -358,133 +535,39 @@ void Gas_optics_nn<TF>::compute_tau_ssa_nn(
         std::unique_ptr<Optical_props_arry<TF>>& optical_props,
         const bool lower_atm, const bool upper_atm) const
 {
-    const int nlay_in = 3 + this->n_o3; //minimum input: h2o,T,P
     TF* tau = optical_props->get_tau().ptr();
     TF* ssa = optical_props->get_ssa().ptr();
-    
-    int startidx = 0;
-
-    float dp[ncol*nlay];
-    for (int ilay=0; ilay<nlay; ++ilay)
-        for (int icol=0; icol<ncol; ++icol)
-        {
-            const int dpidx = icol+ilay*ncol;
-            dp[dpidx] = abs(plev[dpidx]-plev[dpidx+ncol]);
-        }
-
-    //get gas concentrations
-    const TF* h2o = gas_desc.get_vmr(this->gas_names({1})).ptr();
-    const TF* o3  = gas_desc.get_vmr(this->gas_names({3})).ptr();
-
-    std::vector<float> input;
-    std::vector<float> output_tau;
-    std::vector<float> output_ssa;
 
     const int nbatch_lower = ncol*idx_tropo;
     const int nbatch_upper = ncol*(nlay-idx_tropo);
-    const int nbatch_max = std::max(nbatch_lower, nbatch_upper);
 
-    input.resize(nbatch_max*nlay_in);
+    const int n_in = this->features.get_n_features(this->i_input_tau);
+
+    Nn_workspace& workspace = get_workspace();
+    workspace.dp.resize(ncol*nlay);
+    workspace.input.resize((nbatch_lower+nbatch_upper)*n_in);
+    float* restrict const dp = workspace.dp.data();
+    float* restrict const input_lower = workspace.input.data();
+    float* restrict const input_upper = input_lower + nbatch_lower*n_in;
 
-    output_tau.resize(nbatch_max*ngpt);
-    output_ssa.resize(nbatch_max*ngpt);
+    // The lower and upper atmosphere of both networks run as one group. The SSA network uses the
+    // inputs after they are normalized for the TSW network.
+    std::vector<Network::Problem> problems;
 
     if (lower_atm) // Lower atmosphere:
     {
-        //fill input array
-        for (int i=0; i<idx_tropo; ++i)
-            for (int j=0; j<ncol; ++j)
-            {
-                const float val = logarithm(h2o[j+i*ncol]);
-                const int idx = j+i*ncol;
-                input[idx] = val;
-            }
-        
-        if (this->n_o3 == 1)
-        {
-            startidx += ncol * idx_tropo;
-            for (int i=0; i<idx_tropo; ++i)
-                for (int j=0; j<ncol; ++j)
-                {
-                    const float val = logarithm(o3[j+i*ncol]);
-                    const int idx   = startidx + j+i*ncol;
-                    input[idx] = val;
-                }
-        }
-        
-        startidx += ncol * idx_tropo;
-        for (int i=0; i<idx_tropo; ++i)
-            for (int j=0; j<ncol; ++j)
-            {
-                const float val = logarithm(play[j+i*ncol]);
-                const int idx   = startidx + j+i*ncol;
-                input[idx] = val;
-            }
-
-        startidx += ncol * idx_tropo;
-        for (int i=0; i<idx_tropo; ++i)
-            for (int j=0; j<ncol; ++j)
-            {
-                const float val = tlay[j+i*ncol];
-                const int idx   = startidx + j+i*ncol;
-                input[idx] = val;
-            }
-
-        nw_tsw.inference(input.data(), output_tau.data(), nbatch_lower, 1,1,1, this->n_layers, this->n_layer1, this->n_layer2, this->n_layer3); //lower atmosphere, exp(output), normalize input
-        nw_ssa.inference(input.data(), output_ssa.data(), nbatch_lower, 1,0,0, this->n_layers, this->n_layer1, this->n_layer2, this->n_layer3); //lower atmosphere, output, input already normalized);
-   
-        copy_arrays_ssa(output_ssa.data(), ssa, ncol, 0, idx_tropo, ngpt, nlay);
-        copy_arrays_tau(output_tau.data(), dp, tau, ncol, 0, idx_tropo, ngpt, nlay);
+        this->features.assemble(play, plev, tlay, nullptr, gas_desc, ncol, 0, idx_tropo, {input_lower}, dp);
+        problems.push_back({&nw_tsw, input_lower, tau_epilogue(dp, tau, ncol, 0, nlay), nbatch_lower, 1,1,1}); //exp(output), normalize input
+        problems.push_back({&nw_ssa, input_lower, ssa_epilogue(ssa, ncol, 0, nlay), nbatch_lower, 1,0,0}); //output, input already normalized
     }
-//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++     
     if (upper_atm) //// Upper atmosphere:
     {
-        // Fill input array.
-        startidx = 0;
-        for (int i=idx_tropo; i<nlay; ++i)
-            for (int j=0; j<ncol; ++j)
-            {
-                const float val = logarithm(h2o[j+i*ncol]);
-                const int idx = j+(i-idx_tropo)*ncol;
-                input[idx] = val;
-            }
-
-        if (this->n_o3 == 1)
-        {
-            startidx += ncol*(nlay-idx_tropo);
-            for (int i=idx_tropo; i<nlay; ++i)
-                for (int j=0; j<ncol; ++j)
-                {
-                    const float val = logarithm(o3[j+i*ncol]);
-                    const int idx   = startidx + j+(i-idx_tropo)*ncol;
-                    input[idx] = val;
-                }
-        } 
-        
-        startidx += ncol*(nlay-idx_tropo);
-        for (int i=idx_tropo; i<nlay; ++i)
-            for (int j=0; j<ncol; ++j)
-            {
-                const float val = logarithm(play[j+i*ncol]);
-                const int idx   = startidx + j+(i-idx_tropo)*ncol;
-                input[idx] = val;
-            }
-
-        startidx += ncol*(nlay-idx_tropo);
-        for (int i=idx_tropo; i<nlay; ++i)
-            for (int j=0; j<ncol; ++j)
-            {
-                const float val = tlay[j+i*ncol];
-                const int idx   = startidx + j+(i-idx_tropo)*ncol;
-                input[idx] = val;
-            }
-
-        nw_tsw.inference(input.data(), output_tau.data(), nbatch_upper, 0,1,1, this->n_layers, this->n_layer1, this->n_layer2, this->n_layer3); //upper atmosphere, exp(output), normalize input
-        nw_ssa.inference(input.data(), output_ssa.data(), nbatch_upper, 0,0,0, this->n_layers, this->n_layer1, this->n_layer2, this->n_layer3); //upper atmosphere, output, input already normalized
-
-        copy_arrays_ssa(output_ssa.data(), ssa, ncol, idx_tropo, nlay, ngpt, nlay);
-        copy_arrays_tau(output_tau.data(), dp, tau, ncol, idx_tropo, nlay, ngpt, nlay);
+        this->features.assemble(play, plev, tlay, nullptr, gas_desc, ncol, idx_tropo, nlay, {input_upper}, dp);
+        problems.push_back({&nw_tsw, input_upper, tau_epilogue(dp, tau, ncol, idx_tropo, nlay), nbatch_upper, 0,1,1}); //exp(output), normalize input
+        problems.push_back({&nw_ssa, input_upper, ssa_epilogue(ssa, ncol, idx_tropo, nlay), nbatch_upper, 0,0,0}); //output, input already normalized
     }
+
+    Network::inference_group(problems, this->n_layers, this->n_layer1, this->n_layer2, this->n_layer3, this->thread_pool);
 }
 
 // Neural Network optical property function for longwave.
@@ -503,178 +586,46 @@ void Gas_optics_nn<TF>::compute_tau_sources_nn(
         std::unique_ptr<Optical_props_arry<TF>>& optical_props,
         const bool lower_atm, const bool upper_atm) const
 {
-    const int nlay_in = 3 + this->n_o3; //minimum input: h2o,T,P
-
     TF* tau = optical_props->get_tau().ptr();
     TF* src_layer = sources.get_lay_source().ptr();
     TF* src_lvinc = sources.get_lev_source_inc().ptr();
     TF* src_lvdec = sources.get_lev_source_dec().ptr();
 
-    int startidx = 0;
-    int startidx2 =0;
-
-    float dp[ncol*nlay];
-    for (int ilay=0; ilay<nlay; ++ilay)
-        for (int icol=0; icol<ncol; ++icol)
-        {
-            const int dpidx = icol + ilay * ncol;
-            dp[dpidx] = std::abs(plev[dpidx]-plev[dpidx+ncol]);
-        }
-    
-    // Get gas concentrations.
-    const TF* h2o = gas_desc.get_vmr(this->gas_names({1})).ptr();
-    const TF* o3  = gas_desc.get_vmr(this->gas_names({3})).ptr();
-
-    std::vector<float> input_tau;
-    std::vector<float> input_plk;
-    std::vector<float> output_tau;
-    std::vector<float> output_plk;
-
     const int nbatch_lower = ncol*idx_tropo;
     const int nbatch_upper = ncol*(nlay-idx_tropo);
-    const int nbatch_max = std::max(nbatch_lower, nbatch_upper);
-    input_tau .resize(nbatch_max*nlay_in);
-    input_plk .resize(nbatch_max*(nlay_in+2));
-    output_tau.resize(nbatch_max*ngpt);
-    output_plk.resize(nbatch_max*ngpt*3);
 
-    if (lower_atm) //// Lower atmosphere:
-    {
-        //fill input arrays
-        for (int i=0; i<idx_tropo; ++i)
-            for (int j=0; j<ncol; ++j)
-            { 
-                const float val = logarithm(h2o[j+i*ncol]);
-                const int idx = j + i*ncol;
-                input_tau[idx] = val;
-                input_plk[idx] = val;
-            }
+    const int n_in = this->features.get_n_features(this->i_input_tau);
+    const int n_in_plk = this->features.get_n_features(this->i_input_plk);
 
-        if (this->n_o3 == 1)
-        {
-            startidx += ncol * idx_tropo;
-            for (int i=0; i<idx_tropo; ++i)
-                for (int j=0; j<ncol; ++j)
-                {
-                    const float val = logarithm(o3[j+i*ncol]);
-                    const int idx = startidx + j + i*ncol;
-                    input_tau[idx] = val;
-                    input_plk[idx] = val;
-                }
-        }
-
-        startidx += ncol * idx_tropo;
-        for (int i=0; i<idx_tropo; ++i)
-            for (int j=0; j<ncol; ++j)
-            {
-                const float val = logarithm(play[j+i*ncol]);
-                const int idx = startidx + j + i*ncol;
-                input_tau[idx] = val;
-                input_plk[idx] = val;
-            }
-
-        startidx += ncol * idx_tropo;
-        for (int i=0; i<idx_tropo; ++i)
-            for (int j=0; j<ncol; ++j)
-            {
-                const float val = tlay[j+i*ncol];
-                const int idx = startidx + j + i*ncol;
-                input_tau[idx] = val;
-                input_plk[idx] = val;
-            }
-
-        startidx += ncol * idx_tropo;
-        startidx2 = startidx + ncol * idx_tropo;
-        for (int i=0; i<idx_tropo; ++i)
-            for (int j=0; j<ncol; ++j)
-            {
-                const float val1 = tlev[j+i*ncol];
-                const float val2 = tlev[j+(i+1)*ncol];
-                const int idx1 = startidx + j+i*ncol;
-                const int idx2 = startidx2 + j+i*ncol;
-                input_plk[idx1] = val1;
-                input_plk[idx2] = val2;
-            }
+    Nn_workspace& workspace = get_workspace();
+    workspace.dp.resize(ncol*nlay);
+    workspace.input.resize((nbatch_lower+nbatch_upper)*n_in);
+    workspace.input_plk.resize((nbatch_lower+nbatch_upper)*n_in_plk);
+    float* restrict const dp = workspace.dp.data();
+    float* restrict const input_tau_lower = workspace.input.data();
+    float* restrict const input_tau_upper = input_tau_lower + nbatch_lower*n_in;
+    float* restrict const input_plk_lower = workspace.input_plk.data();
+    float* restrict const input_plk_upper = input_plk_lower + nbatch_lower*n_in_plk;
 
-        nw_tlw.inference(input_tau.data(), output_tau.data(), nbatch_lower, 1,1,1, this->n_layers, this->n_layer1, this->n_layer2, this->n_layer3); //lower atmosphere, exp(output), normalize input
-        nw_plk.inference(input_plk.data(), output_plk.data(), nbatch_lower, 1,1,1, this->n_layers, this->n_layer1, this->n_layer2, this->n_layer3); //lower atmosphere, exp(output), normalize input
+    // The lower and upper atmosphere of both networks run as one group.
+    std::vector<Network::Problem> problems;
 
-        copy_arrays_tau(output_tau.data(), dp, tau, ncol, 0, idx_tropo, ngpt, nlay);
-        copy_arrays_plk(output_plk.data(), src_layer, src_lvinc, src_lvdec,ncol, 0, idx_tropo, ngpt, nlay);
-        // We swap lvdec and lvinc with respect to neural network training data, which was generated with a top-bottom ordering.
+    if (lower_atm) //// Lower atmosphere:
+    {
+        this->features.assemble(play, plev, tlay, tlev, gas_desc, ncol, 0, idx_tropo, {input_tau_lower, input_plk_lower}, dp);
+        problems.push_back({&nw_tlw, input_tau_lower, tau_epilogue(dp, tau, ncol, 0, nlay), nbatch_lower, 1,1,1}); //exp(output), normalize input
+        problems.push_back({&nw_plk, input_plk_lower, plk_epilogue(src_layer, src_lvinc, src_lvdec, ncol, 0, ngpt, nlay), nbatch_lower, 1,1,1}); //exp(output), normalize input
     }
     if (upper_atm) //// Upper atmosphere:
     {
-        // Fill input array.
-        startidx = 0;
-        for (int i=idx_tropo;i< nlay; ++i)
-            for (int j = 0; j < ncol; ++j)
-            {
-                const float val = logarithm(h2o[j+i*ncol]);
-                const int idx = j+(i-idx_tropo)*ncol;
-                input_tau[idx] = val;
-                input_plk[idx] = val;
-            }
-
-        if (this->n_o3 == 1)
-        {
-            startidx += ncol*(nlay-idx_tropo);
-            for (int i=idx_tropo; i<nlay; ++i)
-                for (int j=0; j<ncol; ++j)
-                {
-                    const float val = logarithm(o3[j+i*ncol]);
-                    const int idx = startidx + j+(i-idx_tropo)*ncol;
-                    input_tau[idx] = val;
-                    input_plk[idx] = val;
-                }
-        }
-
-        startidx += ncol*(nlay-idx_tropo);
-        for (int i=idx_tropo; i<nlay; ++i)
-            for (int j=0; j<ncol; ++j)
-            {
-                const float val = logarithm(play[j+i*ncol]);
-                const int idx = startidx + j+(i-idx_tropo)*ncol;
-                input_tau[idx] = val;
-                input_plk[idx] = val;
-            }
-
-        startidx += ncol*(nlay-idx_tropo);
-        for (int i=idx_tropo; i<nlay; ++i)
-            for (int j=0; j<ncol; ++j)
-            {
-                const float val = tlay[j+i*ncol];
-                const int idx = startidx + j+(i-idx_tropo)*ncol;
-                input_tau[idx] = val;
-                input_plk[idx] = val;
-            }
-        
-        startidx += ncol*(nlay-idx_tropo);
-        startidx2 = startidx+ncol*(nlay-idx_tropo);
-
-        for (int i=idx_tropo; i<nlay; ++i)
-            for (int j=0; j<ncol; ++j)
-            {
-                const float val1 = tlev[j+i*ncol];
-                const float val2 = tlev[j+(i+1)*ncol];
-                const int idx1 = startidx  + j+(i-idx_tropo)*ncol;
-                const int idx2 = startidx2 + j+(i-idx_tropo)*ncol;
-                input_plk[idx1] = val1;
-                input_plk[idx2] = val2;
-            }
-
-        nw_tlw.inference(input_tau.data(), output_tau.data(), nbatch_upper, 0,1,1, this->n_layers, this->n_layer1, this->n_layer2, this->n_layer3); //upper atmosphere, exp(output), normalize input
-        nw_plk.inference(input_plk.data(), output_plk.data(), nbatch_upper, 0,1,1, this->n_layers, this->n_layer1, this->n_layer2, this->n_layer3); //upper atmosphere, exp(output), normalize input
- 
-        copy_arrays_tau(output_tau.data(), dp, tau, ncol, idx_tropo, nlay, ngpt, nlay);
-        copy_arrays_plk(output_plk.data(), src_layer, src_lvinc, src_lvdec, ncol, idx_tropo, nlay, ngpt, nlay);
-        // We swap lvdec and lvinc with respect to neural network training data, which was generated with a top-bottom ordering.
+        this->features.assemble(play, plev, tlay, tlev, gas_desc, ncol, idx_tropo, nlay, {input_tau_upper, input_plk_upper}, dp);
+        problems.push_back({&nw_tlw, input_tau_upper, tau_epilogue(dp, tau, ncol, idx_tropo, nlay), nbatch_upper, 0,1,1}); //exp(output), normalize input
+        problems.push_back({&nw_plk, input_plk_upper, plk_epilogue(src_layer, src_lvinc, src_lvdec, ncol, idx_tropo, ngpt, nlay), nbatch_upper, 0,1,1}); //exp(output), normalize input
     }
+
+    Network::inference_group(problems, this->n_layers, this->n_layer1, this->n_layer2, this->n_layer3, this->thread_pool);
 }
 
-#ifdef FLOAT_SINGLE_RRTMGP
 template class Gas_optics_nn<float>;
-#else
 template class Gas_optics_nn<double>;
-#endif
 
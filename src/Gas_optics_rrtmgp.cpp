@@ -22,7 +22,9 @@
  *
  */
 
+#include <algorithm>
 #include <cmath>
+#include <limits>
 #include <numeric>
 #include <boost/algorithm/string.hpp>
 // #include <xtensor/xarray.hpp>
@@ -36,10 +38,143 @@
 #include "Source_functions.h"
 
 #include "rrtmgp_kernels.h"
+#include "transpose_kernels.h"
 #define restrict __restrict__
 
 namespace
 {
+    // The part of the RRTMGP interpolation that depends on the gas concentrations: the column amounts of
+    // the flavors and the interpolation of their binary species parameter eta, at the two reference
+    // temperatures that enclose each layer. Follows the interpolation kernel of RRTMGP.
+    template<typename TF>
+    void interpolation_eta(
+            const int ncol, const int nlay, const int ngas, const int nflav, const int neta,
+            const Array<int,2>& flavor,
+            const Array<TF,3>& vmr_ref,
+            const Array<TF,3>& col_gas,
+            const Array<int,2>& jtemp, const Array<BOOL_TYPE,2>& tropo,
+            const Array<TF,2>& ftemp, const Array<TF,2>& fpress,
+            Array<TF,6>& fmajor, Array<TF,5>& fminor,
+            Array<TF,4>& col_mix, Array<int,4>& jeta)
+    {
+        const TF col_mix_min = TF(2.)*std::numeric_limits<TF>::min();
+        const int ncell = ncol*nlay;
+
+        // The gas dimensions of vmr_ref and col_gas start at 0, the dry air.
+        const TF* vmr_ref_ptr = vmr_ref.ptr();
+        const TF* col_gas_ptr = col_gas.ptr();
+
+        for (int idx=0; idx<ncell; ++idx)
+        {
+            const int itropo = tropo.ptr()[idx] ? 0 : 1;
+            const int jt = jtemp.ptr()[idx] - 1;
+            const TF ft = ftemp.ptr()[idx];
+            const TF fp = fpress.ptr()[idx];
+
+            for (int iflav=0; iflav<nflav; ++iflav)
+            {
+                const int igas1 = flavor.ptr()[2*iflav];
+                const int igas2 = flavor.ptr()[2*iflav+1];
+
+                const TF col_gas1 = col_gas_ptr[idx + igas1*ncell];
+                const TF col_gas2 = col_gas_ptr[idx + igas2*ncell];
+
+                for (int itemp=0; itemp<2; ++itemp)
+                {
+                    const int idx_ref = itropo + (jt+itemp)*2*(ngas+1);
+                    const TF ratio_eta_half = vmr_ref_ptr[idx_ref + 2*igas1] / vmr_ref_ptr[idx_ref + 2*igas2];
+
+                    const int idx_mix = itemp + 2*iflav + 2*nflav*idx;
+                    const TF col_mix_val = col_gas1 + ratio_eta_half*col_gas2;
+                    col_mix.ptr()[idx_mix] = col_mix_val;
+
+                    const TF eta = (col_mix_val > col_mix_min) ? col_gas1/col_mix_val : TF(0.5);
+                    const TF loceta = eta*TF(neta-1);
+                    jeta.ptr()[idx_mix] = std::min(int(loceta)+1, neta-1);
+                    const TF feta = std::fmod(loceta, TF(1.));
+
+                    // The temperature weight is 1-ftemp for the lower and ftemp for the upper reference.
+                    const TF ftemp_term = TF(1-itemp) + TF(2*itemp-1)*ft;
+                    const TF fminor1 = (TF(1.)-feta)*ftemp_term;
+                    const TF fminor2 = feta*ftemp_term;
+
+                    fminor.ptr()[2*idx_mix  ] = fminor1;
+                    fminor.ptr()[2*idx_mix+1] = fminor2;
+
+                    fmajor.ptr()[4*idx_mix  ] = (TF(1.)-fp)*fminor1;
+                    fmajor.ptr()[4*idx_mix+1] = (TF(1.)-fp)*fminor2;
+                    fmajor.ptr()[4*idx_mix+2] = fp*fminor1;
+                    fmajor.ptr()[4*idx_mix+3] = fp*fminor2;
+                }
+            }
+        }
+    }
+
+    // Fraction of the Planck function of its band in each g-point of the layers (col, lay, gpt),
+    // interpolated in eta, pressure and temperature. Follows the Planck source kernel of RRTMGP.
+    template<typename TF>
+    void compute_planck_fraction(
+            const int ncol, const int nlay, const int ngpt, const int nflav, const int neta, const int npres,
+            const Array<TF,6>& fmajor, const Array<int,4>& jeta,
+            const Array<BOOL_TYPE,2>& tropo, const Array<int,2>& jtemp, const Array<int,2>& jpress,
+            const Array<TF,4>& pfracin, const Array<int,2>& gpoint_flavor,
+            Array<TF,3>& pfrac)
+    {
+        const int ncell = ncol*nlay;
+
+        // Strides of the eta, pressure and temperature dimensions of pfracin (gpt, eta, press, temp).
+        const int stride_eta = ngpt;
+        const int stride_press = ngpt*neta;
+        const int stride_temp = ngpt*neta*(npres+1);
+
+        const TF* pfracin_ptr = pfracin.ptr();
+
+        for (int igpt=0; igpt<ngpt; ++igpt)
+            for (int idx=0; idx<ncell; ++idx)
+            {
+                const int itropo = tropo.ptr()[idx] ? 0 : 1;
+                const int iflav = gpoint_flavor.ptr()[itropo + 2*igpt] - 1;
+
+                // Lower of the two pressures and temperatures that enclose the layer.
+                const int ipress = jpress.ptr()[idx] + itropo - 1;
+                const int itemp = jtemp.ptr()[idx] - 1;
+
+                const TF* f = &fmajor.ptr()[8*(iflav + nflav*idx)];
+                const int* je = &jeta.ptr()[2*(iflav + nflav*idx)];
+
+                const TF* k1 = &pfracin_ptr[igpt + (je[0]-1)*stride_eta + ipress*stride_press + itemp*stride_temp];
+                const TF* k2 = &pfracin_ptr[igpt + (je[1]-1)*stride_eta + ipress*stride_press + (itemp+1)*stride_temp];
+
+                pfrac.ptr()[idx + igpt*ncell] =
+                        ( f[0]*k1[0] + f[1]*k1[stride_eta] + f[2]*k1[stride_press] + f[3]*k1[stride_eta+stride_press] )
+                      + ( f[4]*k2[0] + f[5]*k2[stride_eta] + f[6]*k2[stride_press] + f[7]*k2[stride_eta+stride_press] );
+            }
+    }
+
+    // Planck function of each band (n, band) at the n temperatures t, interpolated linearly in
+    // the table totplnk (temperature, band). Follows the Planck source kernel of RRTMGP.
+    template<typename TF>
+    void compute_planck_function(
+            const int n, const int nbnd, const TF* t,
+            const TF temp_ref_min, const TF totplnk_delta, const Array<TF,2>& totplnk,
+            TF* planck)
+    {
+        const int ntemp = totplnk.dim(1);
+
+        for (int i=0; i<n; ++i)
+        {
+            const TF val0 = (t[i] - temp_ref_min) / totplnk_delta;
+            const TF frac = val0 - int(val0);
+            const int index = std::min(ntemp-2, std::max(0, int(val0)));
+
+            for (int ibnd=0; ibnd<nbnd; ++ibnd)
+            {
+                const TF* table = &totplnk.ptr()[index + ibnd*ntemp];
+                planck[i + ibnd*n] = table[0] + frac*(table[1] - table[0]);
+            }
+        }
+    }
+
     int find_index(
             const Array<std::string,1>& data, const std::string& value)
     {
@@ -352,45 +487,6 @@ namespace
                         flavor, rewritten_pair);
             }
     }
-
-    /*
-    template<typename TF>
-    inline void reorder123x321_test(
-            TF* restrict out, const TF* restrict in,
-            const int d1, const int d2, const int d3)
-    {
-        const int jj_in = d1;
-        const int kk_in = d1*d2;
-
-        const int ii_out = d3*d2;
-        const int jj_out = d3;
-
-        for (int i=0; i<d1; ++i)
-            for (int j=0; j<d2; ++j)
-                #pragma GCC ivdep
-                for (int k=0; k<d3; ++k)
-                {
-                    const int ijk_in  = i + j*jj_in  + k*kk_in ;
-                    const int ijk_out = k + j*jj_out + i*ii_out;
-                    out[ijk_out] = in[ijk_in];
-                }
-    }
-
-    template<typename TF>
-    inline void reorder123x321_test(
-            TF* out, const TF* in,
-            const size_t d1, const size_t d2, const size_t d3)
-    {
-        const size_t size = d1*d2*d3;
-        const std::array<size_t, 3> in_shape = { d1, d2, d3 };
-        const std::array<size_t, 3> out_shape = { d3, d2, d1 };
-
-        const auto a_in = xt::adapt<xt::layout_type::column_major>(in, size, xt::no_ownership(), in_shape);
-        auto a_out = xt::adapt<xt::layout_type::column_major>(out, size, xt::no_ownership(), out_shape);
-
-        xt::noalias(a_out) = xt::transpose(a_out);
-    }
-    */
 }
 
 // IMPLEMENTATION OF CLASS FUNCTIONS.
@@ -808,6 +904,27 @@ void Gas_optics_rrtmgp<TF>::gas_optics(
     Array<int,4> jeta({2, this->get_nflav(), play.dim(1), play.dim(2)});
 
     // Gas optics.
+    if (this->pressure_cache)
+    {
+        Interpolation_pt interp = interpolation_pt(play, tlay);
+
+        compute_gas_taus(
+                ncol, nlay, ngpt, nband,
+                play, plev, tlay, gas_desc,
+                optical_props,
+                interp.jtemp, interp.jpress, jeta, interp.tropo, fmajor,
+                col_dry,
+                &interp);
+
+        source(
+                ncol, nlay, nband, ngpt,
+                play, plev, tlay, tsfc,
+                interp.jtemp, interp.jpress, jeta, interp.tropo, fmajor,
+                sources, tlev);
+
+        return;
+    }
+
     compute_gas_taus(
             ncol, nlay, ngpt, nband,
             play, plev, tlay, gas_desc,
@@ -846,12 +963,25 @@ void Gas_optics_rrtmgp<TF>::gas_optics(
     Array<int,4> jeta({2, this->get_nflav(), play.dim(1), play.dim(2)});
 
     // Gas optics.
-    compute_gas_taus(
-            ncol, nlay, ngpt, nband,
-            play, plev, tlay, gas_desc,
-            optical_props,
-            jtemp, jpress, jeta, tropo, fmajor,
-            col_dry);
+    if (this->pressure_cache)
+    {
+        Interpolation_pt interp = interpolation_pt(play, tlay);
+
+        compute_gas_taus(
+                ncol, nlay, ngpt, nband,
+                play, plev, tlay, gas_desc,
+                optical_props,
+                interp.jtemp, interp.jpress, jeta, interp.tropo, fmajor,
+                col_dry,
+                &interp);
+    }
+    else
+        compute_gas_taus(
+                ncol, nlay, ngpt, nband,
+                play, plev, tlay, gas_desc,
+                optical_props,
+                jtemp, jpress, jeta, tropo, fmajor,
+                col_dry);
 
     // External source function is constant.
     for (int igpt=1; igpt<=ngpt; ++igpt)
@@ -1008,13 +1138,9 @@ namespace rrtmgp_kernel_launcher
             const Array<TF,3>& data,
             Array<TF,3>& data_out)
     {
-        int dim1 = data.dim(1);
-        int dim2 = data.dim(2);
-        int dim3 = data.dim(3);
-        rrtmgp_kernels::reorder_123x321_kernel(
-                &dim1, &dim2, &dim3,
-                const_cast<TF*>(data.ptr()),
-                data_out.ptr());
+        transpose_kernels::reorder_123x321(
+                data_out.ptr(), data.ptr(),
+                data.dim(1), data.dim(2), data.dim(3));
     }
 
     template<typename TF>
@@ -1023,39 +1149,10 @@ namespace rrtmgp_kernel_launcher
             const Array<TF,3>& tau_local, const Array<TF,3>& tau_rayleigh,
             Array<TF,3>& tau, Array<TF,3>& ssa, Array<TF,3>& g)
     {
-        rrtmgp_kernels::combine_and_reorder_2str(
-                &ncol, &nlay, &ngpt,
-                const_cast<TF*>(tau_local.ptr()), const_cast<TF*>(tau_rayleigh.ptr()),
-                tau.ptr(), ssa.ptr(), g.ptr());
-    }
-
-    template<typename TF>
-    void compute_Planck_source(
-            int ncol, int nlay, int nbnd, int ngpt,
-            int nflav, int neta, int npres, int ntemp, int nPlanckTemp,
-            const Array<TF,2>& tlay, const Array<TF,2>& tlev, const Array<TF,1>& tsfc, int sfc_lay,
-            const Array<TF,6>& fmajor, const Array<int,4>& jeta, const Array<BOOL_TYPE,2>& tropo, const Array<int,2>& jtemp, const Array<int,2>& jpress,
-            const Array<int,1>& gpoint_bands, const Array<int,2>& band_lims_gpt, const Array<TF,4>& pfracin, TF temp_ref_min,
-            TF totplnk_delta, const Array<TF,2>& totplnk, const Array<int,2>& gpoint_flavor,
-            Array<TF,2>& sfc_src, Array<TF,3>& lay_src, Array<TF,3>& lev_src_inc, Array<TF,3>& lev_src_dec,
-            Array<TF,2>& sfc_src_jac)
-    {
-        rrtmgp_kernels::compute_Planck_source(
-                &ncol, &nlay, &nbnd, &ngpt,
-                &nflav, &neta, &npres, &ntemp, &nPlanckTemp,
-                const_cast<TF*>(tlay.ptr()),
-                const_cast<TF*>(tlev.ptr()),
-                const_cast<TF*>(tsfc.ptr()),
-                &sfc_lay,
-                const_cast<TF*>(fmajor.ptr()),
-                const_cast<int*>(jeta.ptr()),
-                const_cast<BOOL_TYPE*>(tropo.ptr()),
-                const_cast<int*>(jtemp.ptr()),
-                const_cast<int*>(jpress.ptr()),
-                const_cast<int*>(gpoint_bands.ptr()), const_cast<int*>(band_lims_gpt.ptr()), const_cast<TF*>(pfracin.ptr()), &temp_ref_min,
-                &totplnk_delta, const_cast<TF*>(totplnk.ptr()), const_cast<int*>(gpoint_flavor.ptr()),
-                sfc_src.ptr(), lay_src.ptr(), lev_src_inc.ptr(), lev_src_dec.ptr(),
-                sfc_src_jac.ptr());
+        transpose_kernels::combine_and_reorder_2str(
+                tau.ptr(), ssa.ptr(), g.ptr(),
+                tau_local.ptr(), tau_rayleigh.ptr(),
+                ncol, nlay, ngpt);
     }
 }
 
@@ -1071,7 +1168,8 @@ void Gas_optics_rrtmgp<TF>::compute_gas_taus(
         Array<int,4>& jeta,
         Array<BOOL_TYPE,2>& tropo,
         Array<TF,6>& fmajor,
-        const Array<TF,2>& col_dry) const
+        const Array<TF,2>& col_dry,
+        const Interpolation_pt* interpolation_pt_shared) const
 {
     Array<TF,3> tau({ngpt, nlay, ncol});
     Array<TF,3> tau_rayleigh({ngpt, nlay, ncol});
@@ -1137,25 +1235,38 @@ void Gas_optics_rrtmgp<TF>::compute_gas_taus(
     // Call the fortran kernels
     rrtmgp_kernel_launcher::zero_array(ngpt, nlay, ncol, tau);
 
-    rrtmgp_kernel_launcher::interpolation(
-            ncol, nlay,
-            ngas, nflav, neta, npres, ntemp,
-            this->flavor,
-            this->press_ref_log,
-            this->temp_ref,
-            this->press_ref_log_delta,
-            this->temp_ref_min,
-            this->temp_ref_delta,
-            this->press_ref_trop_log,
-            this->vmr_ref,
-            play,
-            tlay,
-            col_gas,
-            jtemp,
-            fmajor, fminor,
-            col_mix,
-            tropo,
-            jeta, jpress);
+    // With a shared pressure and temperature interpolation, of which jtemp, jpress and tropo
+    // are passed in, only the part that depends on the gases is computed.
+    if (interpolation_pt_shared)
+        interpolation_eta(
+                ncol, nlay, ngas, nflav, neta,
+                this->flavor,
+                this->vmr_ref,
+                col_gas,
+                jtemp, tropo,
+                interpolation_pt_shared->ftemp, interpolation_pt_shared->fpress,
+                fmajor, fminor,
+                col_mix, jeta);
+    else
+        rrtmgp_kernel_launcher::interpolation(
+                ncol, nlay,
+                ngas, nflav, neta, npres, ntemp,
+                this->flavor,
+                this->press_ref_log,
+                this->temp_ref,
+                this->press_ref_log_delta,
+                this->temp_ref_min,
+                this->temp_ref_delta,
+                this->press_ref_trop_log,
+                this->vmr_ref,
+                play,
+                tlay,
+                col_gas,
+                jtemp,
+                fmajor, fminor,
+                col_mix,
+                tropo,
+                jeta, jpress);
 
     int idx_h2o = -1;
     for (int i=1; i<=this->gas_names.dim(1); ++i)
@@ -1215,6 +1326,240 @@ void Gas_optics_rrtmgp<TF>::compute_gas_taus(
     combine_and_reorder(tau, tau_rayleigh, has_rayleigh, optical_props);
 }
 
+// Interpolation indices and weights in pressure and temperature, as in the interpolation kernel of RRTMGP.
+template<typename TF>
+typename Gas_optics_rrtmgp<TF>::Interpolation_pt Gas_optics_rrtmgp<TF>::interpolation_pt(
+        const Array<TF,2>& play, const Array<TF,2>& tlay) const
+{
+    const int ncol = play.dim(1);
+    const int nlay = play.dim(2);
+    const int ntemp = this->get_ntemp();
+
+    Interpolation_pt interp;
+    interp.jtemp.set_dims({ncol, nlay});
+    interp.ftemp.set_dims({ncol, nlay});
+
+    for (int i=0; i<ncol*nlay; ++i)
+    {
+        const int jtemp = std::min(ntemp-1, std::max(1,
+                int((tlay.ptr()[i] - (this->temp_ref_min - this->temp_ref_delta)) / this->temp_ref_delta)));
+        interp.jtemp.ptr()[i] = jtemp;
+        interp.ftemp.ptr()[i] = (tlay.ptr()[i] - this->temp_ref({jtemp})) / this->temp_ref_delta;
+    }
+
+    if (!find_pressure_cache(play, interp))
+    {
+        Interpolation_p interp_p = interpolation_p(play);
+        interp.jpress = interp_p.jpress;
+        interp.tropo = interp_p.tropo;
+        interp.fpress = interp_p.fpress;
+
+        if (this->pressure_cache)
+        {
+            auto entry = std::make_shared<const Interpolation_p>(std::move(interp_p));
+
+            Pressure_cache& cache = *this->pressure_cache;
+            std::lock_guard<std::mutex> lock(cache.mutex);
+
+            // Replace the oldest entry if the cache is full, the entries after it shift one down.
+            if (int(cache.entries.size()) == cache.max_entries)
+            {
+                cache.entries.erase(cache.entries.begin());
+                if (cache.i_next > 0)
+                    --cache.i_next;
+            }
+            cache.entries.push_back(std::move(entry));
+        }
+    }
+
+    return interp;
+}
+
+template<typename TF>
+typename Gas_optics_rrtmgp<TF>::Interpolation_p Gas_optics_rrtmgp<TF>::interpolation_p(
+        const Array<TF,2>& play) const
+{
+    const int ncol = play.dim(1);
+    const int nlay = play.dim(2);
+    const int npres = this->get_npres();
+
+    Interpolation_p interp_p;
+    interp_p.play = play;
+    interp_p.jpress.set_dims({ncol, nlay});
+    interp_p.tropo.set_dims({ncol, nlay});
+    interp_p.fpress.set_dims({ncol, nlay});
+
+    for (int i=0; i<ncol*nlay; ++i)
+    {
+        const TF play_log = std::log(play.ptr()[i]);
+        const TF locpress = TF(1.) + (play_log - this->press_ref_log({1})) / this->press_ref_log_delta;
+        const int jpress = std::min(npres-1, std::max(1, int(locpress)));
+        interp_p.jpress.ptr()[i] = jpress;
+        interp_p.fpress.ptr()[i] = locpress - TF(jpress);
+
+        interp_p.tropo.ptr()[i] = play_log > this->press_ref_trop_log;
+    }
+
+    return interp_p;
+}
+
+// Copy the pressure part of the interpolation from the cache, if it holds an entry with matching pressures.
+template<typename TF>
+bool Gas_optics_rrtmgp<TF>::find_pressure_cache(const Array<TF,2>& play, Interpolation_pt& interp) const
+{
+    if (!this->pressure_cache)
+        return false;
+
+    Pressure_cache& cache = *this->pressure_cache;
+
+    const TF tolerance = cache.tolerance_rel;
+    auto matches = [&](const TF p, const TF p_ref) { return std::abs(p - p_ref) <= tolerance*std::abs(p_ref); };
+
+    const int n = play.size();
+
+    // Under the lock, only select the candidates of which the dimensions and the outer values match.
+    // Fixed grids are traversed in the same order of column blocks each call,
+    // therefore the search starts at the entry after the last hit.
+    std::vector<std::shared_ptr<const Interpolation_p>> candidates;
+    {
+        std::lock_guard<std::mutex> lock(cache.mutex);
+
+        const int n_entries = cache.entries.size();
+        for (int ientry=0; ientry<n_entries; ++ientry)
+        {
+            const std::shared_ptr<const Interpolation_p>& entry = cache.entries[(cache.i_next + ientry) % n_entries];
+
+            if (entry->play.get_dims() == play.get_dims()
+                    && matches(play.ptr()[0], entry->play.ptr()[0])
+                    && matches(play.ptr()[n-1], entry->play.ptr()[n-1]))
+                candidates.push_back(entry);
+        }
+    }
+
+    // The full comparison and the copy do not block other threads.
+    for (const std::shared_ptr<const Interpolation_p>& entry : candidates)
+    {
+        bool match = true;
+        for (int j=0; j<n && match; ++j)
+            match = matches(play.ptr()[j], entry->play.ptr()[j]);
+
+        if (match)
+        {
+            interp.jpress = entry->jpress;
+            interp.tropo = entry->tropo;
+            interp.fpress = entry->fpress;
+
+            // The entry can have been moved or evicted in the meantime.
+            std::lock_guard<std::mutex> lock(cache.mutex);
+            const auto it = std::find(cache.entries.begin(), cache.entries.end(), entry);
+            if (it != cache.entries.end())
+                cache.i_next = (int(it - cache.entries.begin()) + 1) % cache.entries.size();
+            ++cache.n_hit;
+            return true;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    ++cache.n_miss;
+    return false;
+}
+
+template<typename TF>
+void Gas_optics_rrtmgp<TF>::enable_pressure_cache(const TF tolerance_rel, const int max_entries)
+{
+    if (tolerance_rel < TF(0.) || max_entries < 1)
+        throw std::runtime_error("The pressure cache needs a non-negative tolerance and at least one entry");
+
+    this->pressure_cache = std::make_unique<Pressure_cache>();
+    this->pressure_cache->tolerance_rel = tolerance_rel;
+    this->pressure_cache->max_entries = max_entries;
+}
+
+// Gas optics solver longwave variant for multiple gas scenarios.
+template<typename TF>
+void Gas_optics_rrtmgp<TF>::gas_optics_scenarios(
+        const Array<TF,2>& play,
+        const Array<TF,2>& plev,
+        const Array<TF,2>& tlay,
+        const Array<TF,1>& tsfc,
+        const std::vector<Gas_concs<TF>>& gas_descs,
+        std::vector<std::unique_ptr<Optical_props_arry<TF>>>& optical_props,
+        std::vector<Source_func_lw<TF>>& sources,
+        const std::vector<Array<TF,2>>& col_dry,
+        const Array<TF,2>& tlev) const
+{
+    const int ncol = play.dim(1);
+    const int nlay = play.dim(2);
+    const int ngpt = this->get_ngpt();
+    const int nband = this->get_nband();
+    const int nscen = gas_descs.size();
+
+    if (int(optical_props.size()) != nscen || int(sources.size()) != nscen || int(col_dry.size()) != nscen)
+        throw std::runtime_error("All gas scenarios need optical properties, sources and a dry air column");
+
+    Interpolation_pt interp = interpolation_pt(play, tlay);
+
+    Array<TF,6> fmajor({2, 2, 2, this->get_nflav(), ncol, nlay});
+    Array<int,4> jeta({2, this->get_nflav(), ncol, nlay});
+
+    for (int iscen=0; iscen<nscen; ++iscen)
+    {
+        compute_gas_taus(
+                ncol, nlay, ngpt, nband,
+                play, plev, tlay, gas_descs[iscen],
+                optical_props[iscen],
+                interp.jtemp, interp.jpress, jeta, interp.tropo, fmajor,
+                col_dry[iscen],
+                &interp);
+
+        source(
+                ncol, nlay, nband, ngpt,
+                play, plev, tlay, tsfc,
+                interp.jtemp, interp.jpress, jeta, interp.tropo, fmajor,
+                sources[iscen], tlev);
+    }
+}
+
+// Gas optics solver shortwave variant for multiple gas scenarios.
+template<typename TF>
+void Gas_optics_rrtmgp<TF>::gas_optics_scenarios(
+        const Array<TF,2>& play,
+        const Array<TF,2>& plev,
+        const Array<TF,2>& tlay,
+        const std::vector<Gas_concs<TF>>& gas_descs,
+        std::vector<std::unique_ptr<Optical_props_arry<TF>>>& optical_props,
+        Array<TF,2>& toa_src,
+        const std::vector<Array<TF,2>>& col_dry) const
+{
+    const int ncol = play.dim(1);
+    const int nlay = play.dim(2);
+    const int ngpt = this->get_ngpt();
+    const int nband = this->get_nband();
+    const int nscen = gas_descs.size();
+
+    if (int(optical_props.size()) != nscen || int(col_dry.size()) != nscen)
+        throw std::runtime_error("All gas scenarios need optical properties and a dry air column");
+
+    Interpolation_pt interp = interpolation_pt(play, tlay);
+
+    Array<TF,6> fmajor({2, 2, 2, this->get_nflav(), ncol, nlay});
+    Array<int,4> jeta({2, this->get_nflav(), ncol, nlay});
+
+    for (int iscen=0; iscen<nscen; ++iscen)
+        compute_gas_taus(
+                ncol, nlay, ngpt, nband,
+                play, plev, tlay, gas_descs[iscen],
+                optical_props[iscen],
+                interp.jtemp, interp.jpress, jeta, interp.tropo, fmajor,
+                col_dry[iscen],
+                &interp);
+
+    // External source function is constant.
+    for (int igpt=1; igpt<=ngpt; ++igpt)
+        for (int icol=1; icol<=ncol; ++icol)
+            toa_src({icol, igpt}) = this->solar_source({igpt});
+}
+
 template<typename TF>
 void Gas_optics_rrtmgp<TF>::combine_and_reorder(
         const Array<TF,3>& tau,
@@ -1230,7 +1575,6 @@ void Gas_optics_rrtmgp<TF>::combine_and_reorder(
     {
         // CvH for 2 stream and n-stream zero the g and ssa
         rrtmgp_kernel_launcher::reorder123x321(tau, optical_props->get_tau());
-        // reorder123x321_test(optical_props->get_tau().ptr(), tau.ptr(), ngpt, nlay, ncol);
 
         // rrtmgp_kernel_launcher::zero_array(ngpt, nlay, ncol, optical_props->get_ssa());
         // rrtmgp_kernel_launcher::zero_array(ngpt, nlay, ncol, optical_props->get_g  ());
@@ -1262,45 +1606,78 @@ void Gas_optics_rrtmgp<TF>::source(
     // CvH Assume tlev is available.
     // Compute internal (Planck) source functions at layers and levels,
     // which depend on mapping from spectral space that creates k-distribution.
-    const int nflav = this->get_nflav();
-    const int neta = this->get_neta();
-    const int npres = this->get_npres();
-    const int ntemp = this->get_ntemp();
-    const int nPlanckTemp = this->get_nPlanckTemp();
-    auto gpoint_bands = this->get_gpoint_bands();
-    auto band_lims_gpoint = this->get_band_lims_gpoint();
-
-    Array<TF,3> lay_source_t({ngpt, nlay, ncol});
-    Array<TF,3> lev_source_inc_t({ngpt, nlay, ncol});
-    Array<TF,3> lev_source_dec_t({ngpt, nlay, ncol});
-    Array<TF,2> sfc_source_t({ngpt, ncol});
-    Array<TF,2> sfc_source_jac({ngpt, ncol});
-
-    int sfc_lay = play({1, 1}) > play({1, nlay}) ? 1 : nlay;
-    rrtmgp_kernel_launcher::compute_Planck_source(
-            ncol, nlay, nbnd, ngpt,
-            nflav, neta, npres, ntemp, nPlanckTemp,
-            tlay, tlev, tsfc, sfc_lay,
+    // The sources of a g-point are the Planck function of its band times its Planck fraction.
+    const int nlev = nlay+1;
+    const int ncell = ncol*nlay;
+    const Array<int,2> band_lims_gpoint = this->get_band_lims_gpoint();
+
+    // Split sources get the product for each level of each layer, otherwise the Planck function of the
+    // levels and the Planck fractions are stored, and the solver derives the level sources.
+    const bool split = sources.lev_source_is_split();
+
+    Array<TF,3> pfrac_split;
+    Array<TF,3> lev_source_split;
+    if (split)
+    {
+        pfrac_split.set_dims({ncol, nlay, ngpt});
+        lev_source_split.set_dims({ncol, nlev, nbnd});
+    }
+    Array<TF,3>& pfrac = split ? pfrac_split : sources.get_pfrac();
+    Array<TF,3>& lev_source = split ? lev_source_split : sources.get_lev_source();
+
+    compute_planck_fraction(
+            ncol, nlay, ngpt, this->get_nflav(), this->get_neta(), this->get_npres(),
             fmajor, jeta, tropo, jtemp, jpress,
-            gpoint_bands, band_lims_gpoint, this->planck_frac, this->temp_ref_min,
-            this->totplnk_delta, this->totplnk, this->gpoint_flavor,
-            sfc_source_t, lay_source_t, lev_source_inc_t, lev_source_dec_t,
-            sfc_source_jac);
-
-    // CvH this transpose is super slow.
-    for (int j=1; j<=sfc_source_t.dim(2); ++j)
-        for (int i=1; i<=sfc_source_t.dim(1); ++i)
+            this->planck_frac, this->gpoint_flavor,
+            pfrac);
+
+    // Surface, at the surface temperature and 1 K above for the Jacobian.
+    const int sfc_lay = play({1, 1}) > play({1, nlay}) ? 1 : nlay;
+
+    std::vector<TF> tsfc_inc(ncol);
+    for (int icol=0; icol<ncol; ++icol)
+        tsfc_inc[icol] = tsfc.ptr()[icol] + TF(1.);
+
+    std::vector<TF> planck_sfc(ncol*nbnd);
+    std::vector<TF> planck_sfc_inc(ncol*nbnd);
+    compute_planck_function(ncol, nbnd, tsfc.ptr(), this->temp_ref_min, this->totplnk_delta, this->totplnk, planck_sfc.data());
+    compute_planck_function(ncol, nbnd, tsfc_inc.data(), this->temp_ref_min, this->totplnk_delta, this->totplnk, planck_sfc_inc.data());
+
+    // Layers and levels.
+    std::vector<TF> planck_lay(ncell*nbnd);
+    compute_planck_function(ncell, nbnd, tlay.ptr(), this->temp_ref_min, this->totplnk_delta, this->totplnk, planck_lay.data());
+    compute_planck_function(ncol*nlev, nbnd, tlev.ptr(), this->temp_ref_min, this->totplnk_delta, this->totplnk, lev_source.ptr());
+
+    for (int ibnd=0; ibnd<nbnd; ++ibnd)
+        for (int igpt=band_lims_gpoint({1, ibnd+1})-1; igpt<band_lims_gpoint({2, ibnd+1}); ++igpt)
         {
-            sources.get_sfc_source    ()({j, i}) = sfc_source_t  ({i, j});
-            sources.get_sfc_source_jac()({j, i}) = sfc_source_jac({i, j});
-        }
+            const TF* pfrac_gpt = pfrac.ptr() + igpt*ncell;
+            const TF* pfrac_sfc = pfrac_gpt + (sfc_lay-1)*ncol;
+
+            TF* sfc_src = sources.get_sfc_source().ptr() + igpt*ncol;
+            TF* sfc_src_jac = sources.get_sfc_source_jac().ptr() + igpt*ncol;
+            for (int icol=0; icol<ncol; ++icol)
+            {
+                sfc_src[icol] = pfrac_sfc[icol] * planck_sfc[icol + ibnd*ncol];
+                sfc_src_jac[icol] = pfrac_sfc[icol] * (planck_sfc_inc[icol + ibnd*ncol] - planck_sfc[icol + ibnd*ncol]);
+            }
 
-    rrtmgp_kernel_launcher::reorder123x321(lay_source_t, sources.get_lay_source());
-    rrtmgp_kernel_launcher::reorder123x321(lev_source_inc_t, sources.get_lev_source_inc());
-    rrtmgp_kernel_launcher::reorder123x321(lev_source_dec_t, sources.get_lev_source_dec());
-    // reorder123x321_test(sources.get_lay_source    ().ptr(), lay_source_t    .ptr(), ngpt, nlay, ncol);
-    // reorder123x321_test(sources.get_lev_source_inc().ptr(), lev_source_inc_t.ptr(), ngpt, nlay, ncol);
-    // reorder123x321_test(sources.get_lev_source_dec().ptr(), lev_source_dec_t.ptr(), ngpt, nlay, ncol);
+            TF* lay_src = sources.get_lay_source().ptr() + igpt*ncell;
+            for (int idx=0; idx<ncell; ++idx)
+                lay_src[idx] = pfrac_gpt[idx] * planck_lay[idx + ibnd*ncell];
+
+            if (split)
+            {
+                const TF* planck_lev = lev_source.ptr() + ibnd*ncol*nlev;
+                TF* lev_src_inc = sources.get_lev_source_inc().ptr() + igpt*ncell;
+                TF* lev_src_dec = sources.get_lev_source_dec().ptr() + igpt*ncell;
+                for (int idx=0; idx<ncell; ++idx)
+                {
+                    lev_src_inc[idx] = pfrac_gpt[idx] * planck_lev[idx+ncol];
+                    lev_src_dec[idx] = pfrac_gpt[idx] * planck_lev[idx];
+                }
+            }
+        }
 }
 
 template<typename TF>
@@ -1315,8 +1692,5 @@ TF Gas_optics_rrtmgp<TF>::get_tsi() const
     return tsi;
 }
 
-#ifdef FLOAT_SINGLE_RRTMGP
 template class Gas_optics_rrtmgp<float>;
-#else
 template class Gas_optics_rrtmgp<double>;
-#endif
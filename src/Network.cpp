@@ -5,10 +5,13 @@
 #include <algorithm>
 #include <string>
 #include <fstream>
+#include <stdexcept>
 #include <vector>
 #include <iostream>
 #include "Netcdf_interface.h"
 #include "Network.h"
+#include "Cpu_dispatch.h"
+#include "Thread_pool.h"
 #include <mkl.h>
 //#include <cblas.h>
 #include <time.h>
@@ -18,7 +21,7 @@ namespace
 {
     inline float leaky_relu(const float a) {return std::max(0.2f*a,a);}
 
-    inline void bias_and_activate(float* restrict output, const float* restrict bias, const int n_out, const int n_batch)
+    DISPATCH_KERNEL void bias_and_activate(float* restrict output, const float* restrict bias, const int n_out, const int n_batch)
     {
         for (int i=0; i<n_out; ++i)
             #pragma ivdep
@@ -32,11 +35,12 @@ namespace
             const int n_col,
             const float* restrict weights,
             const float* restrict bias,
-            float* restrict const layer_in,
+            const float* restrict const layer_in,
+            const int ld_in,
             float* restrict const layer_out)
     {
         cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, n_row, n_batch, n_col, 1.f,
-                    weights, n_col, layer_in, n_batch , 0.f, layer_out, n_batch);
+                    weights, n_col, layer_in, ld_in, 0.f, layer_out, n_batch);
         bias_and_activate(layer_out, bias, n_row, n_batch);
     }
 
@@ -50,105 +54,332 @@ namespace
         return x;
     }
 
-    void normalize_input(
+    DISPATCH_KERNEL void normalize_input(
             float* restrict const input, 
             const float* restrict const input_mean,
             const float* restrict const input_stdev,
             const int n_batch,
-            const int n_lay_in)
+            const int n_lay_in,
+            const int ld_in)
     {
         for (int i=0; i<n_lay_in; ++i)
             #pragma ivdep
             for (int j=0; j<n_batch; ++j) {
-                const int idxin = j + i * n_batch;
+                const int idxin = j + i * ld_in;
                 input[idxin] = (input[idxin] - input_mean[i]) / input_stdev[i];
             }
     }
 
-    void feedforward(
-            float* restrict const input, 
-            float* restrict const output,
-            const float* restrict const layer1_wgth,
-            const float* restrict const layer2_wgth,
-            const float* restrict const layer3_wgth,
-            const float* restrict const output_wgth,
-            const float* restrict const layer1_bias,
-            const float* restrict const layer2_bias,
-            const float* restrict const layer3_bias,
-            const float* restrict const output_bias,
-            const float* restrict const input_mean,
-            const float* restrict const input_stdev,
-            const float* restrict const output_mean,
-            const float* restrict const output_stdev,
-            float* restrict const hiddenlayer1,
-            float* restrict const hiddenlayer2,
-            float* restrict const hiddenlayer3,
+    // Number of output neurons that are computed together, such that the block of
+    // outputs stays in cache until the epilogue has consumed it. Block-sparse weights
+    // need a multiple of the rows of their blocks. Large batches do not fit in cache
+    // with a useful number of rows, they keep the minimum such that the GEMM does
+    // not degrade into a sequence of matrix-vector products.
+    inline int output_block_size(const int n_batch, const int n_lay_out, const int n_align=1)
+    {
+        constexpr int n_block_elements = 1<<15;
+        constexpr int n_block_min = 16;
+        const int n_block = std::max(n_block_min, n_block_elements / std::max(n_batch, 1));
+        return std::min(n_lay_out, (n_block + n_align - 1) / n_align * n_align);
+    }
+
+    // Multiply rows row_s to row_s+n_row of block-sparse weights with the input. The batch is processed
+    // in chunks that stay in the L1 cache while the blocks of a block row are applied, and the inner
+    // loop runs over contiguous batch elements, such that it vectorizes.
+    DISPATCH_KERNEL void matmul_block_sparse(
+            const Block_sparse_weights& weights,
+            const int row_s,
+            const int n_row,
             const int n_batch,
-            const int n_lay_out,
-            const int n_lay_in,
-            const int do_exp,
-            const int do_norm,
-            const int n_layers,
-            const int n_layer1,
-            const int n_layer2,
-            const int n_layer3)
-    {  
-        if (do_norm) {normalize_input(input, input_mean, input_stdev, n_batch, n_lay_in);}
+            const float* restrict const layer_in,
+            const int ld_in,
+            float* restrict const layer_out)
+    {
+        constexpr int n_chunk = 256;
+        const int n_block_row = weights.n_block_row;
+        const int n_block_col = weights.n_block_col;
 
-        if (n_layers==0)
-        {   
-            cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, n_lay_out, n_batch, n_lay_in, 1.f,
-                        output_wgth, n_lay_in, input, n_batch, 0.f, output, n_batch);
-        }
-        if (n_layers==1)
-        {   
-            matmul_bias_act_blas(n_batch, n_layer1, n_lay_in, layer1_wgth, layer1_bias, input, hiddenlayer1);
-            cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, n_lay_out, n_batch, n_layer1, 1.f,
-                        output_wgth, n_layer1, hiddenlayer1, n_batch, 0.f, output , n_batch);
+        for (int j_s=0; j_s<n_batch; j_s+=n_chunk)
+        {
+            const int n_j = std::min(n_chunk, n_batch-j_s);
+
+            for (int i_br=row_s/n_block_row; i_br<(row_s+n_row)/n_block_row; ++i_br)
+            {
+                float* restrict const out_block = layer_out + (i_br*n_block_row - row_s)*n_batch + j_s;
+
+                for (int r=0; r<n_block_row; ++r)
+                    std::fill(out_block + r*n_batch, out_block + r*n_batch + n_j, 0.f);
+
+                for (int k=weights.block_row_start[i_br]; k<weights.block_row_start[i_br+1]; ++k)
+                {
+                    const float* restrict const block = &weights.values[size_t(k)*n_block_row*n_block_col];
+                    const float* restrict const in_block = layer_in + size_t(weights.block_col[k])*n_block_col*ld_in + j_s;
+
+                    for (int r=0; r<n_block_row; ++r)
+                    {
+                        float* restrict const out = out_block + r*n_batch;
+                        for (int c=0; c<n_block_col; ++c)
+                        {
+                            const float wgth = block[r*n_block_col + c];
+                            const float* restrict const in = in_block + c*ld_in;
+                            #pragma ivdep
+                            for (int j=0; j<n_j; ++j)
+                                out[j] += wgth * in[j];
+                        }
+                    }
+                }
+            }
         }
-        if (n_layers==2)
+    }
+
+    void matmul_bias_act(
+            const int n_batch,
+            const int n_row,
+            const int n_col,
+            const float* restrict weights,
+            const Block_sparse_weights* sparse,
+            const float* restrict bias,
+            const float* restrict const layer_in,
+            const int ld_in,
+            float* restrict const layer_out)
+    {
+        if (sparse)
         {
-            matmul_bias_act_blas(n_batch, n_layer1, n_lay_in, layer1_wgth, layer1_bias, input,  hiddenlayer1);
-            matmul_bias_act_blas(n_batch, n_layer2, n_layer1, layer2_wgth, layer2_bias, hiddenlayer1, hiddenlayer2);
-            cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, n_lay_out, n_batch, n_layer2, 1.f,
-                        output_wgth, n_layer2, hiddenlayer2, n_batch, 0.f, output, n_batch);
+            matmul_block_sparse(*sparse, 0, n_row, n_batch, layer_in, ld_in, layer_out);
+            bias_and_activate(layer_out, bias, n_row, n_batch);
         }
-        if (n_layers==3)
+        else
+            matmul_bias_act_blas(n_batch, n_row, n_col, weights, bias, layer_in, ld_in, layer_out);
+    }
+
+    // Read a weight matrix of n_row by n_col. A pruned matrix is stored in block compressed sparse row
+    // format as name_block_shape, name_values, name_block_col and name_block_row_start, instead of name.
+    // If more than half of the blocks are nonzero it is expanded, because the dense GEMM is faster then.
+    void read_weights(
+            const Netcdf_group& grp,
+            const std::string& name,
+            const int n_row,
+            const int n_col,
+            std::vector<float>& dense,
+            Block_sparse_weights& sparse)
+    {
+        if (!grp.variable_exists(name + "_values"))
         {
-            matmul_bias_act_blas(n_batch, n_layer1, n_lay_in, layer1_wgth, layer1_bias, input,  hiddenlayer1);
-            matmul_bias_act_blas(n_batch, n_layer2, n_layer1, layer2_wgth, layer2_bias, hiddenlayer1, hiddenlayer2);
-            matmul_bias_act_blas(n_batch, n_layer3, n_layer2, layer3_wgth, layer3_bias, hiddenlayer2, hiddenlayer3);
-            cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, n_lay_out, n_batch, n_layer3, 1.f,
-                        output_wgth, n_layer3, hiddenlayer3, n_batch, 0.f, output, n_batch);
+            dense = grp.get_variable<float>(name, {n_row, n_col});
+            return;
         }
 
-        //output layer and denormalize
-        if (do_exp==1)
+        const std::vector<int> block_shape = grp.get_variable<int>(name + "_block_shape", {2});
+        const int n_block_row = block_shape[0];
+        const int n_block_col = block_shape[1];
+
+        if (n_block_row < 1 || n_block_col < 1 || n_row % n_block_row != 0 || n_col % n_block_col != 0)
+            throw std::runtime_error("Blocks of " + name + " do not tile its " + std::to_string(n_row) + " x " + std::to_string(n_col) + " weights");
+
+        const int n_blocks = grp.get_variable_dimensions(name + "_block_col").begin()->second;
+        const int n_block_rows = n_row / n_block_row;
+
+        sparse.n_block_row = n_block_row;
+        sparse.n_block_col = n_block_col;
+        sparse.block_row_start = grp.get_variable<int>(name + "_block_row_start", {n_block_rows+1});
+        sparse.block_col = (n_blocks > 0) ? grp.get_variable<int>(name + "_block_col", {n_blocks}) : std::vector<int>();
+        sparse.values = (n_blocks > 0) ? grp.get_variable<float>(name + "_values", {n_blocks, n_block_row, n_block_col}) : std::vector<float>();
+
+        if (sparse.block_row_start.front() != 0 || sparse.block_row_start.back() != n_blocks
+                || !std::is_sorted(sparse.block_row_start.begin(), sparse.block_row_start.end())
+                || std::any_of(sparse.block_col.begin(), sparse.block_col.end(),
+                               [&](const int i_bc) { return i_bc < 0 || i_bc >= n_col/n_block_col; }))
+            throw std::runtime_error("Block-sparse weights " + name + " have an invalid structure");
+
+        if (2*size_t(n_blocks)*n_block_row*n_block_col > size_t(n_row)*n_col)
         {
-            for (int i=0; i<n_lay_out; ++i)
-                #pragma ivdep
-                for (int j=0; j<n_batch; ++j)
-                {
-                    const int layidx = j + i * n_batch;
-                    output[layidx] = exponential((output[layidx] + output_bias[i]) * output_stdev[i] + output_mean[i]);
-                }
+            dense.assign(size_t(n_row)*n_col, 0.f);
+            for (int i_br=0; i_br<n_block_rows; ++i_br)
+                for (int k=sparse.block_row_start[i_br]; k<sparse.block_row_start[i_br+1]; ++k)
+                    for (int r=0; r<n_block_row; ++r)
+                        for (int c=0; c<n_block_col; ++c)
+                            dense[size_t(i_br*n_block_row + r)*n_col + sparse.block_col[k]*n_block_col + c] =
+                                    sparse.values[(size_t(k)*n_block_row + r)*n_block_col + c];
+            sparse = Block_sparse_weights();
         }
+    }
+
+    // Number of batch elements per tile, such that the hidden layers of a tile stay in the L2 cache,
+    // but small enough that every thread gets a tile.
+    inline int tile_size(const int n_batch, const int n_per_element, const int n_threads)
+    {
+        constexpr int n_tile_elements = 1<<16;
+        constexpr int n_tile_min = 64;
+        const int n_tile_cache = n_tile_elements / std::max(n_per_element, 1) / 16 * 16;
+        const int n_tile_threads = ((n_batch + n_threads - 1) / n_threads + 15) / 16 * 16;
+        return std::min(n_batch, std::max(n_tile_min, std::min(n_tile_cache, n_tile_threads)));
+    }
+
+    // Pointers to the weights and normalization of the lower or upper atmosphere network.
+    struct Weights
+    {
+        const float* layer1_wgth;
+        const float* layer2_wgth;
+        const float* layer3_wgth;
+        const float* output_wgth;
+        const float* layer1_bias;
+        const float* layer2_bias;
+        const float* layer3_bias;
+        const float* output_bias;
+        const float* input_mean;
+        const float* input_stdev;
+        const float* output_mean;
+        const float* output_stdev;
+        const Block_sparse_weights* layer1_sparse;
+        const Block_sparse_weights* layer2_sparse;
+        const Block_sparse_weights* layer3_sparse;
+        const Block_sparse_weights* output_sparse;
+        int n_lay_in;
+        int n_lay_out;
+    };
+
+    // Output neurons per block of the output layer of a batch.
+    inline int output_block_size(const int n_batch, const Weights& w)
+    {
+        return output_block_size(n_batch, w.n_lay_out, w.output_sparse ? w.output_sparse->n_block_row : 1);
+    }
+
+    // Product of the output weights of rows i_s to i_s+n_row with the last layer.
+    void matmul_output(
+            const Weights& w, const int i_s, const int n_row, const int n_batch, const int n_last,
+            const float* restrict const last_layer, const int ld_last, float* restrict const output_block)
+    {
+        if (w.output_sparse)
+            matmul_block_sparse(*w.output_sparse, i_s, n_row, n_batch, last_layer, ld_last, output_block);
         else
+            cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, n_row, n_batch, n_last, 1.f,
+                        w.output_wgth + i_s*n_last, n_last, last_layer, ld_last, 0.f, output_block, n_batch);
+    }
+
+    // Add the bias to the n_row output neurons from i_s onward, denormalize them, and pass them to the epilogue.
+    DISPATCH_KERNEL void output_rows(
+            float* restrict const output_block,
+            const Weights& w,
+            const Network::Output_epilogue& epilogue,
+            const int i_s,
+            const int n_row,
+            const int j_start,
+            const int n_batch,
+            const int do_exp)
+    {
+        for (int i_row=0; i_row<n_row; ++i_row)
         {
-            for (int i=0; i<n_lay_out; ++i)
+            const int i = i_s + i_row;
+            float* restrict const output = output_block + i_row*n_batch;
+            if (do_exp==1)
+            {
                 #pragma ivdep
                 for (int j=0; j<n_batch; ++j)
-                {
-                    const int layidx = j + i * n_batch;
-                    output[layidx] = (output[layidx] +  output_bias[i]) * output_stdev[i] + output_mean[i] ;
-                }
+                    output[j] = exponential((output[j] + w.output_bias[i]) * w.output_stdev[i] + w.output_mean[i]);
+            }
+            else
+            {
+                #pragma ivdep
+                for (int j=0; j<n_batch; ++j)
+                    output[j] = (output[j] + w.output_bias[i]) * w.output_stdev[i] + w.output_mean[i];
+            }
+            epilogue(i, output, j_start, n_batch);
+        }
+    }
+
+    void feedforward(
+            const float* restrict const input,
+            const Weights& w,
+            const Network::Output_epilogue& epilogue,
+            float* restrict const hiddenlayer1,
+            float* restrict const hiddenlayer2,
+            float* restrict const hiddenlayer3,
+            float* restrict const output_block,
+            const int j_start,
+            const int n_batch,
+            const int ld_in,
+            const int do_exp,
+            const int n_layers,
+            const int n_layer1,
+            const int n_layer2,
+            const int n_layer3)
+    {  
+        // The input of the batch elements j_start to j_start+n_batch, its rows are ld_in apart.
+        const float* restrict const input_tile = input + j_start;
+
+        if (n_layers>=1)
+            matmul_bias_act(n_batch, n_layer1, w.n_lay_in, w.layer1_wgth, w.layer1_sparse, w.layer1_bias, input_tile, ld_in, hiddenlayer1);
+        if (n_layers>=2)
+            matmul_bias_act(n_batch, n_layer2, n_layer1, w.layer2_wgth, w.layer2_sparse, w.layer2_bias, hiddenlayer1, n_batch, hiddenlayer2);
+        if (n_layers>=3)
+            matmul_bias_act(n_batch, n_layer3, n_layer2, w.layer3_wgth, w.layer3_sparse, w.layer3_bias, hiddenlayer2, n_batch, hiddenlayer3);
+
+        const float* restrict const last_layer =
+                (n_layers==0) ? input_tile : (n_layers==1) ? hiddenlayer1 : (n_layers==2) ? hiddenlayer2 : hiddenlayer3;
+        const int n_last = 
+                (n_layers==0) ? w.n_lay_in : (n_layers==1) ? n_layer1 : (n_layers==2) ? n_layer2 : n_layer3;
+        const int ld_last = (n_layers==0) ? ld_in : n_batch;
+
+        //output layer and denormalize, per block of output neurons
+        const int n_block = output_block_size(n_batch, w);
+        for (int i_s=0; i_s<w.n_lay_out; i_s+=n_block)
+        {
+            const int n_row = std::min(n_block, w.n_lay_out-i_s);
+            matmul_output(w, i_s, n_row, n_batch, n_last, last_layer, ld_last, output_block);
+            output_rows(output_block, w, epilogue, i_s, n_row, j_start, n_batch, do_exp);
         }
     }
+
+    // Collects the GEMMs of one layer of all problems, which are launched in a single grouped call.
+    // Every GEMM is its own group, because the problems differ in size.
+    class Gemm_group
+    {
+        public:
+            void add(
+                    const int n_row, const int n_batch, const int n_col,
+                    const float* weights, const float* layer_in, const int ld_in, float* layer_out)
+            {
+                m.push_back(n_row);
+                n.push_back(n_batch);
+                k.push_back(n_col);
+                a.push_back(weights);
+                lda.push_back(n_col);
+                b.push_back(layer_in);
+                ldb.push_back(ld_in);
+                c.push_back(layer_out);
+                ldc.push_back(n_batch);
+            }
+
+            void run()
+            {
+                const MKL_INT n_gemm = m.size();
+                if (n_gemm == 0)
+                    return;
+
+                const std::vector<CBLAS_TRANSPOSE> no_trans(n_gemm, CblasNoTrans);
+                const std::vector<float> alpha(n_gemm, 1.f);
+                const std::vector<float> beta(n_gemm, 0.f);
+                const std::vector<MKL_INT> group_size(n_gemm, 1);
+
+                cblas_sgemm_batch(CblasRowMajor, no_trans.data(), no_trans.data(),
+                                  m.data(), n.data(), k.data(), alpha.data(),
+                                  a.data(), lda.data(), b.data(), ldb.data(),
+                                  beta.data(), c.data(), ldc.data(), n_gemm, group_size.data());
+
+                m.clear(); n.clear(); k.clear();
+                a.clear(); lda.clear(); b.clear(); ldb.clear(); c.clear(); ldc.clear();
+            }
+
+        private:
+            std::vector<MKL_INT> m, n, k, lda, ldb, ldc;
+            std::vector<const float*> a, b;
+            std::vector<float*> c;
+    };
 }
 
 void Network::inference(
         float* inputs,
-        float* outputs,
+        const Output_epilogue& epilogue,
         const int n_batch,
         const int lower_atmos,
         const int do_exp,
@@ -156,70 +387,256 @@ void Network::inference(
         const int n_layers,
         const int n_layer1,
         const int n_layer2,
-        const int n_layer3) const
+        const int n_layer3,
+        Thread_pool* thread_pool) const
+{
+    inference_group(
+            {{this, inputs, epilogue, n_batch, lower_atmos, do_exp, do_norm}},
+            n_layers, n_layer1, n_layer2, n_layer3, thread_pool);
+}
+
+void Network::inference_group(
+        const std::vector<Problem>& problems_all,
+        const int n_layers,
+        const int n_layer1,
+        const int n_layer2,
+        const int n_layer3,
+        Thread_pool* thread_pool)
 {
-    std::vector<float> hiddenlayer1(n_layer1*n_batch);
-    std::vector<float> hiddenlayer2(n_layer2*n_batch);
-    std::vector<float> hiddenlayer3(n_layer3*n_batch);
-    if (lower_atmos == 1)
+    std::vector<Problem> problems;
+    std::vector<Weights> weights;
+
+    auto sparse_or_null = [](const Block_sparse_weights& sparse)
+    {
+        return sparse.is_set() ? &sparse : nullptr;
+    };
+
+    for (const Problem& problem : problems_all)
     {
-        feedforward(
-            inputs,
-            outputs,
-            this->layer1_wgth_lower.data(),
-            this->layer2_wgth_lower.data(),
-            this->layer3_wgth_lower.data(),
-            this->output_wgth_lower.data(),
-            this->layer1_bias_lower.data(),
-            this->layer2_bias_lower.data(),
-            this->layer3_bias_lower.data(),
-            this->output_bias_lower.data(),
-            this->mean_input_lower.data(),
-            this->stdev_input_lower.data(),
-            this->mean_output_lower.data(),
-            this->stdev_output_lower.data(),
-            hiddenlayer1.data(),
-            hiddenlayer2.data(),
-            hiddenlayer3.data(),
-            n_batch,
-            this->n_layer_out,
-            this->n_layer_in,
-            do_exp,
-            do_norm,
-            n_layers,
-            n_layer1,
-            n_layer2,
-            n_layer3);
+        if (problem.n_batch == 0)
+            continue;
+
+        const Network& nw = *problem.network;
+        const bool lower = (problem.lower_atmos == 1);
+
+        problems.push_back(problem);
+        weights.push_back({
+                lower ? nw.layer1_wgth_lower.data() : nw.layer1_wgth_upper.data(),
+                lower ? nw.layer2_wgth_lower.data() : nw.layer2_wgth_upper.data(),
+                lower ? nw.layer3_wgth_lower.data() : nw.layer3_wgth_upper.data(),
+                lower ? nw.output_wgth_lower.data() : nw.output_wgth_upper.data(),
+                lower ? nw.layer1_bias_lower.data() : nw.layer1_bias_upper.data(),
+                lower ? nw.layer2_bias_lower.data() : nw.layer2_bias_upper.data(),
+                lower ? nw.layer3_bias_lower.data() : nw.layer3_bias_upper.data(),
+                lower ? nw.output_bias_lower.data() : nw.output_bias_upper.data(),
+                lower ? nw.mean_input_lower.data()  : nw.mean_input_upper.data(),
+                lower ? nw.stdev_input_lower.data() : nw.stdev_input_upper.data(),
+                lower ? nw.mean_output_lower.data() : nw.mean_output_upper.data(),
+                lower ? nw.stdev_output_lower.data() : nw.stdev_output_upper.data(),
+                sparse_or_null(lower ? nw.layer1_sparse_lower : nw.layer1_sparse_upper),
+                sparse_or_null(lower ? nw.layer2_sparse_lower : nw.layer2_sparse_upper),
+                sparse_or_null(lower ? nw.layer3_sparse_lower : nw.layer3_sparse_upper),
+                sparse_or_null(lower ? nw.output_sparse_lower : nw.output_sparse_upper),
+                nw.n_layer_in,
+                nw.n_layer_out});
     }
-    else
+
+    const int n_problems = problems.size();
+    if (n_problems == 0)
+        return;
+
+    const int n_threads = thread_pool ? thread_pool->get_n_threads() : 1;
+
+    int n_batch_total = 0;
+    int n_per_element = 0;
+    for (int p=0; p<n_problems; ++p)
+    {
+        n_batch_total += problems[p].n_batch;
+        n_per_element = std::max(n_per_element, weights[p].n_lay_in + n_layer1 + n_layer2 + n_layer3);
+    }
+
+    // The tiles of all problems together are split over the threads of the pool.
+    struct Tile
     {
-        feedforward(
-            inputs,
-            outputs,
-            this->layer1_wgth_upper.data(),
-            this->layer2_wgth_upper.data(),
-            this->layer3_wgth_upper.data(),
-            this->output_wgth_upper.data(),
-            this->layer1_bias_upper.data(),
-            this->layer2_bias_upper.data(),
-            this->layer3_bias_upper.data(),
-            this->output_bias_upper.data(),
-            this->mean_input_upper.data(),
-            this->stdev_input_upper.data(),
-            this->mean_output_upper.data(),
-            this->stdev_output_upper.data(),
-            hiddenlayer1.data(),
-            hiddenlayer2.data(),
-            hiddenlayer3.data(),
-            n_batch,
-            this->n_layer_out,
-            this->n_layer_in,
-            do_exp,
-            do_norm,
-            n_layers,
-            n_layer1,
-            n_layer2,
-            n_layer3);
+        int p;
+        int j_start;
+        int n_batch;
+    };
+
+    std::vector<Tile> tiles;
+    const int n_tile = (n_threads > 1) ? tile_size(n_batch_total, n_per_element, n_threads) : 0;
+    if (n_threads > 1)
+        for (int p=0; p<n_problems; ++p)
+            for (int j_start=0; j_start<problems[p].n_batch; j_start+=n_tile)
+                tiles.push_back({p, j_start, std::min(n_tile, problems[p].n_batch-j_start)});
+
+    // All inputs are normalized before any network runs, such that a problem without
+    // normalization can share the input of one that normalizes it.
+    auto normalize_tile = [&](const Tile& tile)
+    {
+        const Problem& problem = problems[tile.p];
+        if (problem.do_norm)
+            normalize_input(problem.inputs + tile.j_start, weights[tile.p].input_mean, weights[tile.p].input_stdev,
+                            tile.n_batch, weights[tile.p].n_lay_in, problem.n_batch);
+    };
+
+    // The workspace is reused between calls, one per calling thread, which holds a slice per
+    // thread of the pool, or a part per problem without a pool.
+    thread_local std::vector<float> workspace;
+
+    if (tiles.size() > 1)
+    {
+        thread_pool->parallel_for(tiles.size(), [&](const int i_tile, const int)
+        {
+            normalize_tile(tiles[i_tile]);
+        });
+
+        int n_block_max = 0;
+        for (int p=0; p<n_problems; ++p)
+            n_block_max = std::max(n_block_max, output_block_size(n_tile, weights[p]));
+
+        const size_t n_slice = size_t(n_layer1 + n_layer2 + n_layer3 + n_block_max) * n_tile;
+        workspace.resize(n_slice*n_threads);
+        float* const workspace_data = workspace.data();
+
+        // Each tile runs a sequential GEMM, such that a threaded MKL does not compete with the pool.
+        thread_pool->parallel_for(tiles.size(), [&](const int i_tile, const int i_thread)
+        {
+            const Tile& tile = tiles[i_tile];
+            float* restrict const hiddenlayer1 = workspace_data + i_thread*n_slice;
+            float* restrict const hiddenlayer2 = hiddenlayer1 + n_layer1*tile.n_batch;
+            float* restrict const hiddenlayer3 = hiddenlayer2 + n_layer2*tile.n_batch;
+            float* restrict const output_block = hiddenlayer3 + n_layer3*tile.n_batch;
+
+            const int n_mkl_threads = mkl_set_num_threads_local(1);
+            feedforward(
+                    problems[tile.p].inputs, weights[tile.p], problems[tile.p].epilogue,
+                    hiddenlayer1, hiddenlayer2, hiddenlayer3, output_block,
+                    tile.j_start, tile.n_batch, problems[tile.p].n_batch, problems[tile.p].do_exp,
+                    n_layers, n_layer1, n_layer2, n_layer3);
+            mkl_set_num_threads_local(n_mkl_threads);
+        });
+
+        return;
+    }
+
+    // Without a pool, each layer of all problems is a single grouped GEMM.
+    for (int p=0; p<n_problems; ++p)
+        normalize_tile({p, 0, problems[p].n_batch});
+
+    std::vector<size_t> offsets(n_problems+1, 0);
+    for (int p=0; p<n_problems; ++p)
+        offsets[p+1] = offsets[p] + size_t(n_layer1 + n_layer2 + n_layer3
+                + output_block_size(problems[p].n_batch, weights[p])) * problems[p].n_batch;
+    workspace.resize(offsets[n_problems]);
+
+    std::vector<const float*> layer_in(n_problems);
+    std::vector<int> ld_in(n_problems);
+    for (int p=0; p<n_problems; ++p)
+    {
+        layer_in[p] = problems[p].inputs;
+        ld_in[p] = problems[p].n_batch;
+    }
+
+    Gemm_group gemm_group;
+
+    const int n_layer[3] = {n_layer1, n_layer2, n_layer3};
+    size_t offset_layer = 0;
+    int n_last = -1;
+
+    for (int i_layer=0; i_layer<n_layers; ++i_layer)
+    {
+        std::vector<float*> layer_out(n_problems);
+        for (int p=0; p<n_problems; ++p)
+        {
+            const float* wgth = (i_layer==0) ? weights[p].layer1_wgth : (i_layer==1) ? weights[p].layer2_wgth : weights[p].layer3_wgth;
+            const Block_sparse_weights* sparse =
+                    (i_layer==0) ? weights[p].layer1_sparse : (i_layer==1) ? weights[p].layer2_sparse : weights[p].layer3_sparse;
+            const int n_col = (i_layer==0) ? weights[p].n_lay_in : n_last;
+            layer_out[p] = workspace.data() + offsets[p] + offset_layer*problems[p].n_batch;
+
+            // Block-sparse layers do not go through BLAS.
+            if (sparse)
+                matmul_block_sparse(*sparse, 0, n_layer[i_layer], problems[p].n_batch, layer_in[p], ld_in[p], layer_out[p]);
+            else
+                gemm_group.add(n_layer[i_layer], problems[p].n_batch, n_col, wgth, layer_in[p], ld_in[p], layer_out[p]);
+        }
+        gemm_group.run();
+
+        for (int p=0; p<n_problems; ++p)
+        {
+            const float* bias = (i_layer==0) ? weights[p].layer1_bias : (i_layer==1) ? weights[p].layer2_bias : weights[p].layer3_bias;
+            bias_and_activate(layer_out[p], bias, n_layer[i_layer], problems[p].n_batch);
+            layer_in[p] = layer_out[p];
+        }
+
+        n_last = n_layer[i_layer];
+        offset_layer += n_layer[i_layer];
+    }
+
+    // The output layers are computed per block of output neurons, the i-th blocks of all problems together.
+    std::vector<float*> output_block(n_problems);
+    std::vector<int> n_block(n_problems);
+    for (int p=0; p<n_problems; ++p)
+    {
+        output_block[p] = workspace.data() + offsets[p] + size_t(n_layer1 + n_layer2 + n_layer3)*problems[p].n_batch;
+        n_block[p] = output_block_size(problems[p].n_batch, weights[p]);
+    }
+
+    for (int i_block=0; ; ++i_block)
+    {
+        bool has_block = false;
+        for (int p=0; p<n_problems; ++p)
+        {
+            const int i_s = i_block*n_block[p];
+            if (i_s >= weights[p].n_lay_out)
+                continue;
+
+            const int n_col = (n_layers==0) ? weights[p].n_lay_in : n_last;
+            const int n_row = std::min(n_block[p], weights[p].n_lay_out-i_s);
+            if (weights[p].output_sparse)
+                matmul_output(weights[p], i_s, n_row, problems[p].n_batch, n_col, layer_in[p], ld_in[p], output_block[p]);
+            else
+                gemm_group.add(n_row, problems[p].n_batch, n_col,
+                               weights[p].output_wgth + i_s*n_col, layer_in[p], ld_in[p], output_block[p]);
+            has_block = true;
+        }
+
+        if (!has_block)
+            break;
+
+        gemm_group.run();
+
+        for (int p=0; p<n_problems; ++p)
+        {
+            const int i_s = i_block*n_block[p];
+            if (i_s < weights[p].n_lay_out)
+                output_rows(output_block[p], weights[p], problems[p].epilogue,
+                            i_s, std::min(n_block[p], weights[p].n_lay_out-i_s), 0, problems[p].n_batch, problems[p].do_exp);
+        }
+    }
+}
+
+void Network::check_envelope(
+        const float* inputs,
+        int* in_envelope,
+        const int n_batch,
+        const int lower_atmos,
+        const float n_sigma) const
+{
+    const float* restrict const input_mean  = (lower_atmos == 1) ? this->mean_input_lower.data()  : this->mean_input_upper.data();
+    const float* restrict const input_stdev = (lower_atmos == 1) ? this->stdev_input_lower.data() : this->stdev_input_upper.data();
+
+    for (int i=0; i<this->n_layer_in; ++i)
+    {
+        const float lower_bound = input_mean[i] - n_sigma*input_stdev[i];
+        const float upper_bound = input_mean[i] + n_sigma*input_stdev[i];
+        #pragma ivdep
+        for (int j=0; j<n_batch; ++j)
+        {
+            const float val = inputs[j + i*n_batch];
+            in_envelope[j] &= (val >= lower_bound) & (val <= upper_bound);
+        }
     }
 }
 
@@ -239,35 +656,35 @@ Network::Network(Netcdf_group& grp,
     if (n_layers == 0)
     {
         this->output_bias_lower = grp.get_variable<float>("bias1_lower", {n_layer_out});
-        this->output_wgth_lower = grp.get_variable<float>("wgth1_lower", {n_layer_out, n_layer_in});
+        read_weights(grp, "wgth1_lower", n_layer_out, n_layer_in, this->output_wgth_lower, this->output_sparse_lower);
         this->output_bias_upper = grp.get_variable<float>("bias1_upper", {n_layer_out});
-        this->output_wgth_upper = grp.get_variable<float>("wgth1_upper", {n_layer_out, n_layer_in});
+        read_weights(grp, "wgth1_upper", n_layer_out, n_layer_in, this->output_wgth_upper, this->output_sparse_upper);
     }
     else if (n_layers == 1)
     {
         this->layer1_bias_lower = grp.get_variable<float>("bias1_lower", {n_layer1});
         this->output_bias_lower = grp.get_variable<float>("bias2_lower", {n_layer_out});
-        this->layer1_wgth_lower = grp.get_variable<float>("wgth1_lower", {n_layer1,    n_layer_in});
-        this->output_wgth_lower = grp.get_variable<float>("wgth2_lower", {n_layer_out, n_layer1});
+        read_weights(grp, "wgth1_lower", n_layer1, n_layer_in, this->layer1_wgth_lower, this->layer1_sparse_lower);
+        read_weights(grp, "wgth2_lower", n_layer_out, n_layer1, this->output_wgth_lower, this->output_sparse_lower);
         this->layer1_bias_upper = grp.get_variable<float>("bias1_upper", {n_layer1});
         this->output_bias_upper = grp.get_variable<float>("bias2_upper", {n_layer_out});
-        this->layer1_wgth_upper = grp.get_variable<float>("wgth1_upper", {n_layer1,    n_layer_in});
-        this->output_wgth_upper = grp.get_variable<float>("wgth2_upper", {n_layer_out, n_layer1});
+        read_weights(grp, "wgth1_upper", n_layer1, n_layer_in, this->layer1_wgth_upper, this->layer1_sparse_upper);
+        read_weights(grp, "wgth2_upper", n_layer_out, n_layer1, this->output_wgth_upper, this->output_sparse_upper);
     }
     else if (n_layers == 2)
     {
         this->layer1_bias_lower = grp.get_variable<float>("bias1_lower", {n_layer1});
         this->layer2_bias_lower = grp.get_variable<float>("bias2_lower", {n_layer2});
         this->output_bias_lower = grp.get_variable<float>("bias3_lower", {n_layer_out});
-        this->layer1_wgth_lower = grp.get_variable<float>("wgth1_lower", {n_layer1,    n_layer_in});
-        this->layer2_wgth_lower = grp.get_variable<float>("wgth2_lower", {n_layer2,    n_layer1});
-        this->output_wgth_lower = grp.get_variable<float>("wgth3_lower", {n_layer_out, n_layer2});
+        read_weights(grp, "wgth1_lower", n_layer1, n_layer_in, this->layer1_wgth_lower, this->layer1_sparse_lower);
+        read_weights(grp, "wgth2_lower", n_layer2, n_layer1, this->layer2_wgth_lower, this->layer2_sparse_lower);
+        read_weights(grp, "wgth3_lower", n_layer_out, n_layer2, this->output_wgth_lower, this->output_sparse_lower);
         this->layer1_bias_upper = grp.get_variable<float>("bias1_upper", {n_layer1});
         this->layer2_bias_upper = grp.get_variable<float>("bias2_upper", {n_layer2});
         this->output_bias_upper = grp.get_variable<float>("bias3_upper", {n_layer_out});
-        this->layer1_wgth_upper = grp.get_variable<float>("wgth1_upper", {n_layer1,    n_layer_in});
-        this->layer2_wgth_upper = grp.get_variable<float>("wgth2_upper", {n_layer2,    n_layer1});
-        this->output_wgth_upper = grp.get_variable<float>("wgth3_upper", {n_layer_out, n_layer2});
+        read_weights(grp, "wgth1_upper", n_layer1, n_layer_in, this->layer1_wgth_upper, this->layer1_sparse_upper);
+        read_weights(grp, "wgth2_upper", n_layer2, n_layer1, this->layer2_wgth_upper, this->layer2_sparse_upper);
+        read_weights(grp, "wgth3_upper", n_layer_out, n_layer2, this->output_wgth_upper, this->output_sparse_upper);
     }
     else if (n_layers == 3)
     {
@@ -275,18 +692,18 @@ Network::Network(Netcdf_group& grp,
         this->layer2_bias_lower = grp.get_variable<float>("bias2_lower", {n_layer2});
         this->layer3_bias_lower = grp.get_variable<float>("bias3_lower", {n_layer3});
         this->output_bias_lower = grp.get_variable<float>("bias4_lower", {n_layer_out});
-        this->layer1_wgth_lower = grp.get_variable<float>("wgth1_lower", {n_layer1,    n_layer_in});
-        this->layer2_wgth_lower = grp.get_variable<float>("wgth2_lower", {n_layer2,    n_layer1});
-        this->layer3_wgth_lower = grp.get_variable<float>("wgth3_lower", {n_layer3,    n_layer2});
-        this->output_wgth_lower = grp.get_variable<float>("wgth4_lower", {n_layer_out, n_layer3});
+        read_weights(grp, "wgth1_lower", n_layer1, n_layer_in, this->layer1_wgth_lower, this->layer1_sparse_lower);
+        read_weights(grp, "wgth2_lower", n_layer2, n_layer1, this->layer2_wgth_lower, this->layer2_sparse_lower);
+        read_weights(grp, "wgth3_lower", n_layer3, n_layer2, this->layer3_wgth_lower, this->layer3_sparse_lower);
+        read_weights(grp, "wgth4_lower", n_layer_out, n_layer3, this->output_wgth_lower, this->output_sparse_lower);
         this->layer1_bias_upper = grp.get_variable<float>("bias1_upper", {n_layer1});
         this->layer2_bias_upper = grp.get_variable<float>("bias2_upper", {n_layer2});
         this->layer3_bias_upper = grp.get_variable<float>("bias3_upper", {n_layer3});
         this->output_bias_upper = grp.get_variable<float>("bias4_upper", {n_layer_out});
-        this->layer1_wgth_upper = grp.get_variable<float>("wgth1_upper", {n_layer1,    n_layer_in});
-        this->layer2_wgth_upper = grp.get_variable<float>("wgth2_upper", {n_layer2,    n_layer1});
-        this->layer3_wgth_upper = grp.get_variable<float>("wgth3_upper", {n_layer3,    n_layer2});
-        this->output_wgth_upper = grp.get_variable<float>("wgth4_upper", {n_layer_out, n_layer3});
+        read_weights(grp, "wgth1_upper", n_layer1, n_layer_in, this->layer1_wgth_upper, this->layer1_sparse_upper);
+        read_weights(grp, "wgth2_upper", n_layer2, n_layer1, this->layer2_wgth_upper, this->layer2_sparse_upper);
+        read_weights(grp, "wgth3_upper", n_layer3, n_layer2, this->layer3_wgth_upper, this->layer3_sparse_upper);
+        read_weights(grp, "wgth4_upper", n_layer_out, n_layer3, this->output_wgth_upper, this->output_sparse_upper);
     }
 
     this->mean_input_lower   = grp.get_variable<float>("Fmean_lower", {n_layer_in});
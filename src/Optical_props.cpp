@@ -266,16 +266,13 @@ void add_to(Optical_props_2str<TF>& op_inout, const Optical_props_2str<TF>& op_i
     }
 }
 
-#ifdef FLOAT_SINGLE_RRTMGP
 template class Optical_props<float>;
 template class Optical_props_1scl<float>;
 template class Optical_props_2str<float>;
 template void add_to(Optical_props_2str<float>&, const Optical_props_2str<float>&);
 template void add_to(Optical_props_1scl<float>&, const Optical_props_1scl<float>&);
-#else
 template class Optical_props<double>;
 template class Optical_props_1scl<double>;
 template class Optical_props_2str<double>;
 template void add_to(Optical_props_2str<double>&, const Optical_props_2str<double>&);
 template void add_to(Optical_props_1scl<double>&, const Optical_props_1scl<double>&);
-#endif
@@ -0,0 +1,688 @@
+/*
+ * This file is part of a C++ interface to the Radiative Transfer for Energetics (RTE)
+ * and Rapid Radiative Transfer Model for GCM applications Parallel (RRTMGP).
+ *
+ * The original code is found at https://github.com/earth-system-radiation/rte-rrtmgp.
+ *
+ * Contacts: Robert Pincus and Eli Mlawer
+ * email: rrtmgp@aer.com
+ *
+ * Copyright 2015-2020,  Atmospheric and Environmental Research and
+ * Regents of the University of Colorado.  All right reserved.
+ *
+ * This C++ interface can be downloaded from https://github.com/earth-system-radiation/rte-rrtmgp-cpp
+ *
+ * Contact: Chiel van Heerwaarden
+ * email: chiel.vanheerwaarden@wur.nl
+ *
+ * Copyright 2020, Wageningen University & Research.
+ *
+ * Use and duplication is permitted under the terms of the
+ * BSD 3-clause license, see http://opensource.org/licenses/BSD-3-Clause
+ *
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <stdexcept>
+
+#include "Radiation_plan.h"
+#include "Gas_concs.h"
+#include "Gas_optics.h"
+#include "Gas_optics_rrtmgp.h"
+#include "Cloud_optics.h"
+#include "Optical_props.h"
+#include "Source_functions.h"
+#include "Fluxes.h"
+#include "Rte_lw.h"
+#include "Rte_sw.h"
+
+namespace
+{
+    // Copy the block that starts at the offsets in the view into an array with the size of the block.
+    // Dimensions of size one in the view are spread, as in Array::subset.
+    template<typename TF, int N>
+    void copy_block(Array<TF,N>& block, const Array_view<TF,N>& view, const std::array<int,N>& offsets)
+    {
+        const std::array<int,N> dims = block.get_dims();
+        const std::array<int,N> strides = calc_strides<N>(dims);
+
+        std::array<bool,N> do_spread;
+        for (int n=0; n<N; ++n)
+            do_spread[n] = (view.dim(n+1) == 1);
+
+        for (int i=0; i<block.size(); ++i)
+        {
+            std::array<int,N> index;
+            int ic = i;
+            for (int n=N-1; n>0; --n)
+            {
+                index[n] = do_spread[n] ? 1 : ic / strides[n] + offsets[n] + 1;
+                ic %= strides[n];
+            }
+            index[0] = do_spread[0] ? 1 : ic + offsets[0] + 1;
+            block.ptr()[i] = view(index);
+        }
+    }
+
+    // Copy the broadband fluxes of a block into the output, empty outputs are skipped.
+    template<typename TF>
+    void store_block(Array_view<TF,2>& out, const Array<TF,2>& block, const int col_s)
+    {
+        if (out.is_empty())
+            return;
+
+        for (int ilev=1; ilev<=block.dim(2); ++ilev)
+            for (int icol=1; icol<=block.dim(1); ++icol)
+                out({icol+col_s-1, ilev}) = block({icol, ilev});
+    }
+
+    template<typename TF>
+    void check_dims(const Array_view<TF,2>& a, const int n_1, const int n_2, const std::string& name)
+    {
+        if (a.dim(1) != n_1 || a.dim(2) != n_2)
+            throw std::runtime_error("Shape of " + name + " does not match the plan");
+    }
+
+    template<typename TF>
+    void check_dims(const Array_view<TF,1>& a, const int n_1, const std::string& name)
+    {
+        if (a.dim(1) != n_1)
+            throw std::runtime_error("Shape of " + name + " does not match the plan");
+    }
+
+    // Optional fields and outputs may be left empty.
+    template<typename TF>
+    void check_dims_optional(const Array_view<TF,2>& a, const int n_1, const int n_2, const std::string& name)
+    {
+        if (!a.is_empty())
+            check_dims(a, n_1, n_2, name);
+    }
+
+    // Gases are either given per column or constant over the columns, and may be constant with height.
+    template<typename TF>
+    void check_gas_dims(const Array_view<TF,2>& a, const int n_col, const int n_lay, const std::string& name)
+    {
+        const bool col_ok = (a.dim(1) == n_col || a.dim(1) == 1);
+        const bool lay_ok = (a.dim(2) == n_lay || (a.dim(1) == 1 && a.dim(2) == 1));
+        if (!col_ok || !lay_ok)
+            throw std::runtime_error("Shape of gas " + name + " does not match the plan");
+    }
+
+    template<typename TF>
+    void check_gases(
+            const Gas_concs<TF>* gas_concs, const std::map<std::string, Array_view<TF,2>>& gas_vmr,
+            const int n_col, const int n_lay)
+    {
+        if (gas_concs == nullptr && gas_vmr.empty())
+            throw std::runtime_error("The inputs have no gas concentrations");
+
+        if (gas_concs)
+            for (const std::string& name : gas_concs->get_gas_names())
+                check_gas_dims(Array_view<TF,2>(gas_concs->get_vmr(name)), n_col, n_lay, name);
+        else
+            for (auto& g : gas_vmr)
+                check_gas_dims(g.second, n_col, n_lay, g.first);
+    }
+
+    // Block sizes that are tried when the plan is measured.
+    const std::vector<int> n_col_block_candidates = {4, 8, 16, 32, 64, 128};
+
+    // Block size of a plan that is not measured, the default of the solvers.
+    constexpr int n_col_block_estimate = 8;
+
+    // Number of columns over which the candidates are timed.
+    constexpr int n_col_measure_max = 256;
+
+    // Time the candidate block sizes on the first columns of the tuning inputs, and return the fastest.
+    // The function time_solve(n_col_block, n_col_measure) returns the duration of one solve.
+    template<typename Function>
+    int measure_n_col_block(const int n_col, const int n_repeat, Function&& time_solve)
+    {
+        const int n_col_measure = std::min(n_col, n_col_measure_max);
+
+        int n_col_block_best = std::min(n_col_block_estimate, n_col_measure);
+        double time_best = std::numeric_limits<double>::max();
+
+        for (const int n_col_block : n_col_block_candidates)
+        {
+            if (n_col_block > n_col_measure)
+                break;
+
+            double time = std::numeric_limits<double>::max();
+            for (int i=0; i<std::max(n_repeat, 1); ++i)
+                time = std::min(time, time_solve(n_col_block, n_col_measure));
+
+            if (time < time_best)
+            {
+                time_best = time;
+                n_col_block_best = n_col_block;
+            }
+        }
+
+        return n_col_block_best;
+    }
+
+    int choose_n_col_block(const int n_col, const Radiation_plan_options& options)
+    {
+        if (options.n_col_block > 0)
+            return std::min(options.n_col_block, n_col);
+        else
+            return std::min(n_col_block_estimate, n_col);
+    }
+}
+
+
+// Longwave.
+template<typename TF>
+struct Block_lw
+{
+    Block_lw(
+            const Gas_optics<TF>& kdist, const Cloud_optics<TF>* cloud_optics,
+            const int n_col, const int n_lay, const bool switch_cloud_optics) :
+        n_col(n_col),
+        p_lay({n_col, n_lay}), p_lev({n_col, n_lay+1}),
+        t_lay({n_col, n_lay}), t_lev({n_col, n_lay+1}),
+        col_dry({n_col, n_lay}),
+        t_sfc({n_col}),
+        emis_sfc({kdist.get_nband(), n_col}),
+        optical_props(std::make_unique<Optical_props_1scl<TF>>(n_col, n_lay, kdist)),
+        sources(n_col, n_lay, kdist),
+        gpt_flux_up({n_col, n_lay+1, kdist.get_ngpt()}),
+        gpt_flux_dn({n_col, n_lay+1, kdist.get_ngpt()}),
+        fluxes(n_col, n_lay+1)
+    {
+        if (switch_cloud_optics)
+        {
+            lwp.set_dims({n_col, n_lay});
+            iwp.set_dims({n_col, n_lay});
+            rel.set_dims({n_col, n_lay});
+            rei.set_dims({n_col, n_lay});
+            cloud_optical_props = std::make_unique<Optical_props_1scl<TF>>(n_col, n_lay, *cloud_optics);
+        }
+    }
+
+    const int n_col;
+
+    Gas_concs<TF> gas_concs;
+    Array<TF,2> p_lay, p_lev;
+    Array<TF,2> t_lay, t_lev;
+    Array<TF,2> col_dry;
+    Array<TF,1> t_sfc;
+    Array<TF,2> emis_sfc;
+    Array<TF,2> lwp, iwp, rel, rei;
+
+    std::unique_ptr<Optical_props_arry<TF>> optical_props;
+    std::unique_ptr<Optical_props_1scl<TF>> cloud_optical_props;
+    Source_func_lw<TF> sources;
+
+    Array<TF,3> gpt_flux_up;
+    Array<TF,3> gpt_flux_dn;
+    Fluxes_broadband<TF> fluxes;
+};
+
+// Blocks of n_col_block columns, and a smaller block for the remaining columns, if any.
+template<typename TF>
+struct Radiation_plan_lw<TF>::Workspace
+{
+    std::unique_ptr<Block_lw<TF>> block;
+    std::unique_ptr<Block_lw<TF>> residual;
+};
+
+template<typename TF>
+Radiation_plan_lw<TF>::Radiation_plan_lw(
+        const Gas_optics<TF>& kdist, const Cloud_optics<TF>* cloud_optics,
+        const int n_col, const int n_lay, const bool switch_cloud_optics) :
+    kdist(kdist), cloud_optics(cloud_optics),
+    n_col(n_col), n_lay(n_lay), switch_cloud_optics(switch_cloud_optics),
+    n_col_block(0),
+    workspaces(std::make_unique<Workspace_pool<Workspace>>())
+{}
+
+template<typename TF>
+Radiation_plan_lw<TF>::~Radiation_plan_lw() = default;
+
+template<typename TF>
+std::unique_ptr<Radiation_plan_lw<TF>> Radiation_plan_lw<TF>::make_plan(
+        const Gas_optics<TF>& kdist,
+        const Cloud_optics<TF>* cloud_optics,
+        const int n_col, const int n_lay,
+        const Radiation_plan_options& options,
+        const Radiation_inputs_lw<TF>* tuning_inputs)
+{
+    if (n_col < 1 || n_lay < 1)
+        throw std::runtime_error("A plan needs at least one column and one layer");
+    if (options.switch_cloud_optics && cloud_optics == nullptr)
+        throw std::runtime_error("A plan with cloud optics needs the cloud optics");
+
+    std::unique_ptr<Radiation_plan_lw<TF>> plan(
+            new Radiation_plan_lw<TF>(kdist, cloud_optics, n_col, n_lay, options.switch_cloud_optics));
+
+    if (options.n_col_block == 0 && options.rigor == Plan_rigor::Measure)
+    {
+        if (tuning_inputs == nullptr)
+            throw std::runtime_error("Measuring a plan requires tuning inputs");
+
+        Array<TF,2> flux_up({n_col, n_lay+1});
+        Array<TF,2> flux_dn({n_col, n_lay+1});
+        Radiation_outputs_lw<TF> outputs;
+        outputs.flux_up = flux_up;
+        outputs.flux_dn = flux_dn;
+
+        auto time_solve = [&](const int n_col_block, const int n_col_measure)
+        {
+            std::unique_ptr<Workspace> workspace = plan->make_workspace(n_col_block, n_col_measure);
+
+            auto time_start = std::chrono::high_resolution_clock::now();
+            plan->solve(*workspace, n_col_measure, *tuning_inputs, outputs);
+            auto time_end = std::chrono::high_resolution_clock::now();
+
+            return std::chrono::duration<double>(time_end-time_start).count();
+        };
+
+        plan->n_col_block = measure_n_col_block(n_col, options.n_measure_repeat, time_solve);
+    }
+    else
+        plan->n_col_block = choose_n_col_block(n_col, options);
+
+    for (int i=0; i<std::max(options.n_workspaces, 1); ++i)
+        plan->workspaces->add(plan->make_workspace(plan->n_col_block, n_col));
+
+    return plan;
+}
+
+template<typename TF>
+std::unique_ptr<typename Radiation_plan_lw<TF>::Workspace> Radiation_plan_lw<TF>::make_workspace(
+        const int n_col_block, const int n_col_solve) const
+{
+    auto workspace = std::make_unique<Workspace>();
+    workspace->block = std::make_unique<Block_lw<TF>>(
+            kdist, cloud_optics, n_col_block, n_lay, switch_cloud_optics);
+
+    const int n_col_residual = n_col_solve % n_col_block;
+    if (n_col_residual > 0)
+        workspace->residual = std::make_unique<Block_lw<TF>>(
+                kdist, cloud_optics, n_col_residual, n_lay, switch_cloud_optics);
+
+    return workspace;
+}
+
+template<typename TF>
+void Radiation_plan_lw<TF>::execute(
+        const Radiation_inputs_lw<TF>& inputs, Radiation_outputs_lw<TF>& outputs) const
+{
+    check_gases(inputs.gas_concs, inputs.gas_vmr, n_col, n_lay);
+
+    check_dims(inputs.p_lay, n_col, n_lay, "p_lay");
+    check_dims(inputs.p_lev, n_col, n_lay+1, "p_lev");
+    check_dims(inputs.t_lay, n_col, n_lay, "t_lay");
+    check_dims(inputs.t_lev, n_col, n_lay+1, "t_lev");
+    check_dims_optional(inputs.col_dry, n_col, n_lay, "col_dry");
+    check_dims(inputs.t_sfc, n_col, "t_sfc");
+    check_dims(inputs.emis_sfc, kdist.get_nband(), n_col, "emis_sfc");
+
+    if (switch_cloud_optics)
+    {
+        check_dims(inputs.lwp, n_col, n_lay, "lwp");
+        check_dims(inputs.iwp, n_col, n_lay, "iwp");
+        check_dims(inputs.rel, n_col, n_lay, "rel");
+        check_dims(inputs.rei, n_col, n_lay, "rei");
+    }
+
+    check_dims_optional(outputs.flux_up , n_col, n_lay+1, "flux_up");
+    check_dims_optional(outputs.flux_dn , n_col, n_lay+1, "flux_dn");
+    check_dims_optional(outputs.flux_net, n_col, n_lay+1, "flux_net");
+
+    Workspace& workspace = workspaces->acquire();
+    try
+    {
+        solve(workspace, n_col, inputs, outputs);
+    }
+    catch (...)
+    {
+        workspaces->release(workspace);
+        throw;
+    }
+    workspaces->release(workspace);
+}
+
+template<typename TF>
+void Radiation_plan_lw<TF>::solve(
+        Workspace& workspace, const int n_col_solve,
+        const Radiation_inputs_lw<TF>& inputs, Radiation_outputs_lw<TF>& outputs) const
+{
+    const BOOL_TYPE top_at_1 = inputs.p_lay({1, 1}) < inputs.p_lay({1, n_lay});
+
+    auto solve_block = [&](Block_lw<TF>& b, const int col_s)
+    {
+        const int col_e = col_s + b.n_col - 1;
+
+        if (inputs.gas_concs)
+            inputs.gas_concs->get_subset(b.gas_concs, col_s, col_e);
+        else
+            for (auto& g : inputs.gas_vmr)
+                b.gas_concs.set_vmr(g.first, g.second, col_s, col_e);
+        copy_block(b.p_lay, inputs.p_lay, {col_s-1, 0});
+        copy_block(b.p_lev, inputs.p_lev, {col_s-1, 0});
+        copy_block(b.t_lay, inputs.t_lay, {col_s-1, 0});
+        copy_block(b.t_lev, inputs.t_lev, {col_s-1, 0});
+        copy_block(b.t_sfc, inputs.t_sfc, {col_s-1});
+        copy_block(b.emis_sfc, inputs.emis_sfc, {0, col_s-1});
+
+        if (inputs.col_dry.is_empty())
+            Gas_optics_rrtmgp<TF>::get_col_dry(b.col_dry, b.gas_concs.get_vmr("h2o"), b.p_lev);
+        else
+            copy_block(b.col_dry, inputs.col_dry, {col_s-1, 0});
+
+        kdist.gas_optics(
+                b.p_lay, b.p_lev, b.t_lay, b.t_sfc, b.gas_concs,
+                b.optical_props, b.sources, b.col_dry, b.t_lev);
+
+        if (switch_cloud_optics)
+        {
+            copy_block(b.lwp, inputs.lwp, {col_s-1, 0});
+            copy_block(b.iwp, inputs.iwp, {col_s-1, 0});
+            copy_block(b.rel, inputs.rel, {col_s-1, 0});
+            copy_block(b.rei, inputs.rei, {col_s-1, 0});
+
+            cloud_optics->cloud_optics(b.lwp, b.iwp, b.rel, b.rei, *b.cloud_optical_props);
+
+            add_to(
+                    dynamic_cast<Optical_props_1scl<TF>&>(*b.optical_props),
+                    *b.cloud_optical_props);
+        }
+
+        constexpr int n_ang = 1;
+
+        Rte_lw<TF>::rte_lw(
+                b.optical_props,
+                top_at_1,
+                b.sources,
+                b.emis_sfc,
+                Array<TF,2>(), // Add an empty array, no inc_flux.
+                b.gpt_flux_up, b.gpt_flux_dn,
+                n_ang);
+
+        b.fluxes.reduce(b.gpt_flux_up, b.gpt_flux_dn, top_at_1);
+
+        store_block(outputs.flux_up , b.fluxes.get_flux_up (), col_s);
+        store_block(outputs.flux_dn , b.fluxes.get_flux_dn (), col_s);
+        store_block(outputs.flux_net, b.fluxes.get_flux_net(), col_s);
+    };
+
+    const int n_col_block = workspace.block->n_col;
+    const int n_blocks = n_col_solve / n_col_block;
+
+    for (int ib=0; ib<n_blocks; ++ib)
+        solve_block(*workspace.block, ib*n_col_block + 1);
+
+    if (workspace.residual)
+        solve_block(*workspace.residual, n_blocks*n_col_block + 1);
+}
+
+
+// Shortwave.
+template<typename TF>
+struct Block_sw
+{
+    Block_sw(
+            const Gas_optics<TF>& kdist, const Cloud_optics<TF>* cloud_optics,
+            const int n_col, const int n_lay, const bool switch_cloud_optics) :
+        n_col(n_col),
+        p_lay({n_col, n_lay}), p_lev({n_col, n_lay+1}),
+        t_lay({n_col, n_lay}),
+        col_dry({n_col, n_lay}),
+        sfc_alb_dir({kdist.get_nband(), n_col}),
+        sfc_alb_dif({kdist.get_nband(), n_col}),
+        tsi_scaling({n_col}), mu0({n_col}),
+        toa_src({n_col, kdist.get_ngpt()}),
+        optical_props(std::make_unique<Optical_props_2str<TF>>(n_col, n_lay, kdist)),
+        gpt_flux_up({n_col, n_lay+1, kdist.get_ngpt()}),
+        gpt_flux_dn({n_col, n_lay+1, kdist.get_ngpt()}),
+        gpt_flux_dn_dir({n_col, n_lay+1, kdist.get_ngpt()}),
+        fluxes(n_col, n_lay+1)
+    {
+        if (switch_cloud_optics)
+        {
+            lwp.set_dims({n_col, n_lay});
+            iwp.set_dims({n_col, n_lay});
+            rel.set_dims({n_col, n_lay});
+            rei.set_dims({n_col, n_lay});
+            cloud_optical_props = std::make_unique<Optical_props_2str<TF>>(n_col, n_lay, *cloud_optics);
+        }
+    }
+
+    const int n_col;
+
+    Gas_concs<TF> gas_concs;
+    Array<TF,2> p_lay, p_lev;
+    Array<TF,2> t_lay;
+    Array<TF,2> col_dry;
+    Array<TF,2> sfc_alb_dir, sfc_alb_dif;
+    Array<TF,1> tsi_scaling, mu0;
+    Array<TF,2> lwp, iwp, rel, rei;
+    Array<TF,2> toa_src;
+
+    std::unique_ptr<Optical_props_arry<TF>> optical_props;
+    std::unique_ptr<Optical_props_2str<TF>> cloud_optical_props;
+
+    Array<TF,3> gpt_flux_up;
+    Array<TF,3> gpt_flux_dn;
+    Array<TF,3> gpt_flux_dn_dir;
+    Fluxes_broadband<TF> fluxes;
+};
+
+template<typename TF>
+struct Radiation_plan_sw<TF>::Workspace
+{
+    std::unique_ptr<Block_sw<TF>> block;
+    std::unique_ptr<Block_sw<TF>> residual;
+};
+
+template<typename TF>
+Radiation_plan_sw<TF>::Radiation_plan_sw(
+        const Gas_optics<TF>& kdist, const Cloud_optics<TF>* cloud_optics,
+        const int n_col, const int n_lay, const bool switch_cloud_optics) :
+    kdist(kdist), cloud_optics(cloud_optics),
+    n_col(n_col), n_lay(n_lay), switch_cloud_optics(switch_cloud_optics),
+    n_col_block(0),
+    workspaces(std::make_unique<Workspace_pool<Workspace>>())
+{}
+
+template<typename TF>
+Radiation_plan_sw<TF>::~Radiation_plan_sw() = default;
+
+template<typename TF>
+std::unique_ptr<Radiation_plan_sw<TF>> Radiation_plan_sw<TF>::make_plan(
+        const Gas_optics<TF>& kdist,
+        const Cloud_optics<TF>* cloud_optics,
+        const int n_col, const int n_lay,
+        const Radiation_plan_options& options,
+        const Radiation_inputs_sw<TF>* tuning_inputs)
+{
+    if (n_col < 1 || n_lay < 1)
+        throw std::runtime_error("A plan needs at least one column and one layer");
+    if (options.switch_cloud_optics && cloud_optics == nullptr)
+        throw std::runtime_error("A plan with cloud optics needs the cloud optics");
+
+    std::unique_ptr<Radiation_plan_sw<TF>> plan(
+            new Radiation_plan_sw<TF>(kdist, cloud_optics, n_col, n_lay, options.switch_cloud_optics));
+
+    if (options.n_col_block == 0 && options.rigor == Plan_rigor::Measure)
+    {
+        if (tuning_inputs == nullptr)
+            throw std::runtime_error("Measuring a plan requires tuning inputs");
+
+        Array<TF,2> flux_up({n_col, n_lay+1});
+        Array<TF,2> flux_dn({n_col, n_lay+1});
+        Radiation_outputs_sw<TF> outputs;
+        outputs.flux_up = flux_up;
+        outputs.flux_dn = flux_dn;
+
+        auto time_solve = [&](const int n_col_block, const int n_col_measure)
+        {
+            std::unique_ptr<Workspace> workspace = plan->make_workspace(n_col_block, n_col_measure);
+
+            auto time_start = std::chrono::high_resolution_clock::now();
+            plan->solve(*workspace, n_col_measure, *tuning_inputs, outputs);
+            auto time_end = std::chrono::high_resolution_clock::now();
+
+            return std::chrono::duration<double>(time_end-time_start).count();
+        };
+
+        plan->n_col_block = measure_n_col_block(n_col, options.n_measure_repeat, time_solve);
+    }
+    else
+        plan->n_col_block = choose_n_col_block(n_col, options);
+
+    for (int i=0; i<std::max(options.n_workspaces, 1); ++i)
+        plan->workspaces->add(plan->make_workspace(plan->n_col_block, n_col));
+
+    return plan;
+}
+
+template<typename TF>
+std::unique_ptr<typename Radiation_plan_sw<TF>::Workspace> Radiation_plan_sw<TF>::make_workspace(
+        const int n_col_block, const int n_col_solve) const
+{
+    auto workspace = std::make_unique<Workspace>();
+    workspace->block = std::make_unique<Block_sw<TF>>(
+            kdist, cloud_optics, n_col_block, n_lay, switch_cloud_optics);
+
+    const int n_col_residual = n_col_solve % n_col_block;
+    if (n_col_residual > 0)
+        workspace->residual = std::make_unique<Block_sw<TF>>(
+                kdist, cloud_optics, n_col_residual, n_lay, switch_cloud_optics);
+
+    return workspace;
+}
+
+template<typename TF>
+void Radiation_plan_sw<TF>::execute(
+        const Radiation_inputs_sw<TF>& inputs, Radiation_outputs_sw<TF>& outputs) const
+{
+    check_gases(inputs.gas_concs, inputs.gas_vmr, n_col, n_lay);
+
+    check_dims(inputs.p_lay, n_col, n_lay, "p_lay");
+    check_dims(inputs.p_lev, n_col, n_lay+1, "p_lev");
+    check_dims(inputs.t_lay, n_col, n_lay, "t_lay");
+    check_dims_optional(inputs.col_dry, n_col, n_lay, "col_dry");
+    check_dims(inputs.sfc_alb_dir, kdist.get_nband(), n_col, "sfc_alb_dir");
+    check_dims(inputs.sfc_alb_dif, kdist.get_nband(), n_col, "sfc_alb_dif");
+    check_dims(inputs.tsi_scaling, n_col, "tsi_scaling");
+    check_dims(inputs.mu0, n_col, "mu0");
+
+    if (switch_cloud_optics)
+    {
+        check_dims(inputs.lwp, n_col, n_lay, "lwp");
+        check_dims(inputs.iwp, n_col, n_lay, "iwp");
+        check_dims(inputs.rel, n_col, n_lay, "rel");
+        check_dims(inputs.rei, n_col, n_lay, "rei");
+    }
+
+    check_dims_optional(outputs.flux_up    , n_col, n_lay+1, "flux_up");
+    check_dims_optional(outputs.flux_dn    , n_col, n_lay+1, "flux_dn");
+    check_dims_optional(outputs.flux_dn_dir, n_col, n_lay+1, "flux_dn_dir");
+    check_dims_optional(outputs.flux_net   , n_col, n_lay+1, "flux_net");
+
+    Workspace& workspace = workspaces->acquire();
+    try
+    {
+        solve(workspace, n_col, inputs, outputs);
+    }
+    catch (...)
+    {
+        workspaces->release(workspace);
+        throw;
+    }
+    workspaces->release(workspace);
+}
+
+template<typename TF>
+void Radiation_plan_sw<TF>::solve(
+        Workspace& workspace, const int n_col_solve,
+        const Radiation_inputs_sw<TF>& inputs, Radiation_outputs_sw<TF>& outputs) const
+{
+    const int n_gpt = kdist.get_ngpt();
+    const BOOL_TYPE top_at_1 = inputs.p_lay({1, 1}) < inputs.p_lay({1, n_lay});
+
+    auto solve_block = [&](Block_sw<TF>& b, const int col_s)
+    {
+        const int col_e = col_s + b.n_col - 1;
+
+        if (inputs.gas_concs)
+            inputs.gas_concs->get_subset(b.gas_concs, col_s, col_e);
+        else
+            for (auto& g : inputs.gas_vmr)
+                b.gas_concs.set_vmr(g.first, g.second, col_s, col_e);
+        copy_block(b.p_lay, inputs.p_lay, {col_s-1, 0});
+        copy_block(b.p_lev, inputs.p_lev, {col_s-1, 0});
+        copy_block(b.t_lay, inputs.t_lay, {col_s-1, 0});
+        copy_block(b.sfc_alb_dir, inputs.sfc_alb_dir, {0, col_s-1});
+        copy_block(b.sfc_alb_dif, inputs.sfc_alb_dif, {0, col_s-1});
+        copy_block(b.tsi_scaling, inputs.tsi_scaling, {col_s-1});
+        copy_block(b.mu0, inputs.mu0, {col_s-1});
+
+        if (inputs.col_dry.is_empty())
+            Gas_optics_rrtmgp<TF>::get_col_dry(b.col_dry, b.gas_concs.get_vmr("h2o"), b.p_lev);
+        else
+            copy_block(b.col_dry, inputs.col_dry, {col_s-1, 0});
+
+        kdist.gas_optics(
+                b.p_lay, b.p_lev, b.t_lay, b.gas_concs,
+                b.optical_props, b.toa_src, b.col_dry);
+
+        for (int igpt=1; igpt<=n_gpt; ++igpt)
+            for (int icol=1; icol<=b.n_col; ++icol)
+                b.toa_src({icol, igpt}) *= b.tsi_scaling({icol});
+
+        if (switch_cloud_optics)
+        {
+            copy_block(b.lwp, inputs.lwp, {col_s-1, 0});
+            copy_block(b.iwp, inputs.iwp, {col_s-1, 0});
+            copy_block(b.rel, inputs.rel, {col_s-1, 0});
+            copy_block(b.rei, inputs.rei, {col_s-1, 0});
+
+            cloud_optics->cloud_optics(b.lwp, b.iwp, b.rel, b.rei, *b.cloud_optical_props);
+            b.cloud_optical_props->delta_scale();
+
+            add_to(
+                    dynamic_cast<Optical_props_2str<TF>&>(*b.optical_props),
+                    *b.cloud_optical_props);
+        }
+
+        Rte_sw<TF>::rte_sw(
+                b.optical_props,
+                top_at_1,
+                b.mu0,
+                b.toa_src,
+                b.sfc_alb_dir,
+                b.sfc_alb_dif,
+                Array<TF,2>(), // Add an empty array, no inc_flux.
+                b.gpt_flux_up,
+                b.gpt_flux_dn,
+                b.gpt_flux_dn_dir);
+
+        b.fluxes.reduce(b.gpt_flux_up, b.gpt_flux_dn, b.gpt_flux_dn_dir, top_at_1);
+
+        store_block(outputs.flux_up    , b.fluxes.get_flux_up    (), col_s);
+        store_block(outputs.flux_dn    , b.fluxes.get_flux_dn    (), col_s);
+        store_block(outputs.flux_dn_dir, b.fluxes.get_flux_dn_dir(), col_s);
+        store_block(outputs.flux_net   , b.fluxes.get_flux_net   (), col_s);
+    };
+
+    const int n_col_block = workspace.block->n_col;
+    const int n_blocks = n_col_solve / n_col_block;
+
+    for (int ib=0; ib<n_blocks; ++ib)
+        solve_block(*workspace.block, ib*n_col_block + 1);
+
+    if (workspace.residual)
+        solve_block(*workspace.residual, n_blocks*n_col_block + 1);
+}
+
+template class Radiation_plan_lw<float>;
+template class Radiation_plan_lw<double>;
+template class Radiation_plan_sw<float>;
+template class Radiation_plan_sw<double>;
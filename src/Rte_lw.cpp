@@ -22,6 +22,8 @@
  *
  */
 
+#include <algorithm>
+
 #include "Rte_lw.h"
 #include "Array.h"
 #include "Optical_props.h"
@@ -58,27 +60,27 @@ namespace rrtmgp_kernel_launcher
             int ncol, int nlay, int ngpt, BOOL_TYPE top_at_1, int n_quad_angs,
             const Array<TF,2>& gauss_Ds_subset,
             const Array<TF,2>& gauss_wts_subset,
-            const Array<TF,3>& tau,
-            const Array<TF,3>& lay_source,
-            const Array<TF,3>& lev_source_inc, const Array<TF,3>& lev_source_dec,
-            const Array<TF,2>& sfc_emis_gpt, const Array<TF,2>& sfc_source,
-            Array<TF,3>& gpt_flux_up, Array<TF,3>& gpt_flux_dn,
-            Array<TF,2>& sfc_source_jac, Array<TF,3>& gpt_flux_up_jac)
-{
-    rrtmgp_kernels::lw_solver_noscat_GaussQuad(
+            const TF* tau,
+            const TF* lay_source,
+            const TF* lev_source_inc, const TF* lev_source_dec,
+            const TF* sfc_emis_gpt, const TF* sfc_source,
+            TF* gpt_flux_up, TF* gpt_flux_dn,
+            const TF* sfc_source_jac, TF* gpt_flux_up_jac)
+    {
+        rrtmgp_kernels::lw_solver_noscat_GaussQuad(
                 &ncol, &nlay, &ngpt, &top_at_1, &n_quad_angs,
                 const_cast<TF*>(gauss_Ds_subset.ptr()),
                 const_cast<TF*>(gauss_wts_subset.ptr()),
-                const_cast<TF*>(tau.ptr()),
-                const_cast<TF*>(lay_source.ptr()),
-                const_cast<TF*>(lev_source_inc.ptr()),
-                const_cast<TF*>(lev_source_dec.ptr()),
-                const_cast<TF*>(sfc_emis_gpt.ptr()),
-                const_cast<TF*>(sfc_source.ptr()),
-                gpt_flux_up.ptr(),
-                gpt_flux_dn.ptr(),
-                sfc_source_jac.ptr(),
-                gpt_flux_up_jac.ptr());
+                const_cast<TF*>(tau),
+                const_cast<TF*>(lay_source),
+                const_cast<TF*>(lev_source_inc),
+                const_cast<TF*>(lev_source_dec),
+                const_cast<TF*>(sfc_emis_gpt),
+                const_cast<TF*>(sfc_source),
+                gpt_flux_up,
+                gpt_flux_dn,
+                const_cast<TF*>(sfc_source_jac),
+                gpt_flux_up_jac);
     }
 }
 
@@ -92,6 +94,26 @@ void Rte_lw<TF>::rte_lw(
         Array<TF,3>& gpt_flux_up,
         Array<TF,3>& gpt_flux_dn,
         const int n_gauss_angles)
+{
+    Array<TF,3> gpt_flux_up_jac(gpt_flux_up.get_dims());
+
+    rte_lw(
+            optical_props, top_at_1, sources, sfc_emis, inc_flux,
+            gpt_flux_up, gpt_flux_dn, gpt_flux_up_jac,
+            n_gauss_angles);
+}
+
+template<typename TF>
+void Rte_lw<TF>::rte_lw(
+        const std::unique_ptr<Optical_props_arry<TF>>& optical_props,
+        const BOOL_TYPE top_at_1,
+        const Source_func_lw<TF>& sources,
+        const Array<TF,2>& sfc_emis,
+        const Array<TF,2>& inc_flux,
+        Array<TF,3>& gpt_flux_up,
+        Array<TF,3>& gpt_flux_dn,
+        Array<TF,3>& gpt_flux_up_jac,
+        const int n_gauss_angles)
 {
     const int max_gauss_pts = 4;
     const Array<TF,2> gauss_Ds(
@@ -130,19 +152,56 @@ void Rte_lw<TF>::rte_lw(
     Array<TF,2> gauss_wts_subset = gauss_wts.subset(
             {{ {1, n_quad_angs}, {n_quad_angs, n_quad_angs} }});
 
-    // For now, just pass the arrays around.
-    Array<TF,2> sfc_src_jac(sources.get_sfc_source().get_dims());
-    Array<TF,3> gpt_flux_up_jac(gpt_flux_up.get_dims());
-
-    rrtmgp_kernel_launcher::lw_solver_noscat_GaussQuad(
-            ncol, nlay, ngpt, top_at_1, n_quad_angs,
-            gauss_Ds_subset, gauss_wts_subset,
-            optical_props->get_tau(),
-            sources.get_lay_source(),
-            sources.get_lev_source_inc(), sources.get_lev_source_dec(),
-            sfc_emis_gpt, sources.get_sfc_source(),
-            gpt_flux_up, gpt_flux_dn,
-            sfc_src_jac, gpt_flux_up_jac);
+    if (sources.lev_source_is_split())
+    {
+        rrtmgp_kernel_launcher::lw_solver_noscat_GaussQuad(
+                ncol, nlay, ngpt, top_at_1, n_quad_angs,
+                gauss_Ds_subset, gauss_wts_subset,
+                optical_props->get_tau().ptr(),
+                sources.get_lay_source().ptr(),
+                sources.get_lev_source_inc().ptr(), sources.get_lev_source_dec().ptr(),
+                sfc_emis_gpt.ptr(), sources.get_sfc_source().ptr(),
+                gpt_flux_up.ptr(), gpt_flux_dn.ptr(),
+                sources.get_sfc_source_jac().ptr(), gpt_flux_up_jac.ptr());
+    }
+    else
+    {
+        // The sources at the bottom and top level of each layer are derived from the Planck function
+        // of the levels for one band at a time, and the solver runs over the g-points of that band.
+        const int nlev = nlay+1;
+        const int nband = optical_props->get_nband();
+        const Array<int,2> band_lims_gpt = optical_props->get_band_lims_gpoint();
+
+        int ngpt_band_max = 0;
+        for (int iband=1; iband<=nband; ++iband)
+            ngpt_band_max = std::max(ngpt_band_max, band_lims_gpt({2, iband}) - band_lims_gpt({1, iband}) + 1);
+
+        Array<TF,3> lev_source_inc({ncol, nlay, ngpt_band_max});
+        Array<TF,3> lev_source_dec({ncol, nlay, ngpt_band_max});
+
+        for (int iband=1; iband<=nband; ++iband)
+        {
+            const int gpt_s = band_lims_gpt({1, iband});
+            const int gpt_e = band_lims_gpt({2, iband});
+            const int ngpt_band = gpt_e - gpt_s + 1;
+
+            sources.derive_lev_source(gpt_s, gpt_e, lev_source_inc.ptr(), lev_source_dec.ptr());
+
+            const int offset_lay = (gpt_s-1)*ncol*nlay;
+            const int offset_lev = (gpt_s-1)*ncol*nlev;
+            const int offset_sfc = (gpt_s-1)*ncol;
+
+            rrtmgp_kernel_launcher::lw_solver_noscat_GaussQuad(
+                    ncol, nlay, ngpt_band, top_at_1, n_quad_angs,
+                    gauss_Ds_subset, gauss_wts_subset,
+                    optical_props->get_tau().ptr() + offset_lay,
+                    sources.get_lay_source().ptr() + offset_lay,
+                    lev_source_inc.ptr(), lev_source_dec.ptr(),
+                    sfc_emis_gpt.ptr() + offset_sfc, sources.get_sfc_source().ptr() + offset_sfc,
+                    gpt_flux_up.ptr() + offset_lev, gpt_flux_dn.ptr() + offset_lev,
+                    sources.get_sfc_source_jac().ptr() + offset_sfc, gpt_flux_up_jac.ptr() + offset_lev);
+        }
+    }
 
     // CvH: In the fortran code this call is here, I removed it for performance and flexibility.
     // fluxes->reduce(gpt_flux_up, gpt_flux_dn, optical_props, top_at_1);
@@ -164,8 +223,5 @@ void Rte_lw<TF>::expand_and_transpose(
                 arr_out({icol, igpt}) = arr_in({iband, icol});
 }
 
-#ifdef FLOAT_SINGLE_RRTMGP
 template class Rte_lw<float>;
-#else
 template class Rte_lw<double>;
-#endif
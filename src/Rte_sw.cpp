@@ -22,6 +22,10 @@
  *
  */
 
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
 #include "Rte_sw.h"
 #include "Array.h"
 #include "Optical_props.h"
@@ -88,6 +92,255 @@ namespace rrtmgp_kernel_launcher
     }
 }
 
+// C++ versions of the two-stream kernels of RTE, split such that the parts that do not depend on the
+// surface or the solar zenith angle can be shared between scenarios. All arrays cover a single g-point,
+// layer arrays are (ncol, nlay) and level arrays (ncol, nlay+1), both in Fortran ordering.
+namespace
+{
+    // Properties of the diffuse two-stream solution of the layers (Zdunkowski PIFM, Meador and Weaver 1980).
+    template<typename TF>
+    struct Two_stream_diffuse
+    {
+        Two_stream_diffuse(const int n) :
+            k(n), exp_minusktau(n), rt_term(n), r_dif(n), t_dif(n)
+        {}
+
+        std::vector<TF> k;
+        std::vector<TF> exp_minusktau;
+        std::vector<TF> rt_term;
+        std::vector<TF> r_dif;
+        std::vector<TF> t_dif;
+    };
+
+    template<typename TF>
+    void sw_two_stream_diffuse(
+            const int ncol, const int nlay,
+            const TF* tau, const TF* ssa, const TF* g,
+            Two_stream_diffuse<TF>& dif)
+    {
+        for (int i=0; i<ncol*nlay; ++i)
+        {
+            const TF gamma1 = (TF(8.) - ssa[i] * (TF(5.) + TF(3.) * g[i])) * TF(.25);
+            const TF gamma2 =  TF(3.) *(ssa[i] * (TF(1.) -          g[i])) * TF(.25);
+
+            const TF k = std::sqrt(std::max((gamma1 - gamma2) * (gamma1 + gamma2), TF(1.e-12)));
+            const TF exp_minusktau = std::exp(-tau[i]*k);
+            const TF exp_minus2ktau = exp_minusktau * exp_minusktau;
+
+            // Refactored to avoid rounding errors when k, gamma1 are of very different magnitudes.
+            const TF rt_term = TF(1.) / (k * (TF(1.) + exp_minus2ktau) + gamma1 * (TF(1.) - exp_minus2ktau));
+
+            dif.k[i] = k;
+            dif.exp_minusktau[i] = exp_minusktau;
+            dif.rt_term[i] = rt_term;
+            dif.r_dif[i] = rt_term * gamma2 * (TF(1.) - exp_minus2ktau);    // Eq. 25
+            dif.t_dif[i] = rt_term * TF(2.) * k * exp_minusktau;            // Eq. 26
+        }
+    }
+
+    // Reflectance and transmittance of the direct beam, these depend on the solar zenith angle.
+    template<typename TF>
+    void sw_two_stream_direct(
+            const int ncol, const int nlay,
+            const TF* mu0, const TF* tau, const TF* ssa, const TF* g,
+            const Two_stream_diffuse<TF>& dif,
+            TF* r_dir, TF* t_dir, TF* t_noscat)
+    {
+        const TF eps = std::numeric_limits<TF>::epsilon();
+
+        for (int ilay=0; ilay<nlay; ++ilay)
+            for (int icol=0; icol<ncol; ++icol)
+            {
+                const int i = icol + ilay*ncol;
+
+                const TF gamma1 = (TF(8.) - ssa[i] * (TF(5.) + TF(3.) * g[i])) * TF(.25);
+                const TF gamma2 =  TF(3.) *(ssa[i] * (TF(1.) -          g[i])) * TF(.25);
+                const TF gamma3 = (TF(2.) - TF(3.) * mu0[icol] *        g[i] ) * TF(.25);
+                const TF gamma4 =  TF(1.) - gamma3;
+
+                const TF alpha1 = gamma1 * gamma4 + gamma2 * gamma3;    // Eq. 16
+                const TF alpha2 = gamma1 * gamma3 + gamma2 * gamma4;    // Eq. 17
+
+                const TF exp_minusktau = dif.exp_minusktau[i];
+                const TF exp_minus2ktau = exp_minusktau * exp_minusktau;
+
+                t_noscat[i] = std::exp(-tau[i] / mu0[icol]);
+
+                const TF k_mu     = dif.k[i] * mu0[icol];
+                const TF k_gamma3 = dif.k[i] * gamma3;
+                const TF k_gamma4 = dif.k[i] * gamma4;
+
+                // Eq. 14, multiplying top and bottom by exp(-k*tau) and rearranging to avoid div by 0.
+                const TF denom = (std::abs(TF(1.) - k_mu*k_mu) >= eps) ? TF(1.) - k_mu*k_mu : eps;
+                const TF rt_term = ssa[i] * dif.rt_term[i] / denom;
+
+                r_dir[i] = rt_term *
+                    ( (TF(1.) - k_mu) * (alpha2 + k_gamma3)
+                    - (TF(1.) + k_mu) * (alpha2 - k_gamma3) * exp_minus2ktau
+                    - TF(2.) * (k_gamma3 - alpha2 * k_mu) * exp_minusktau * t_noscat[i] );
+
+                // Eq. 15, omitting the direct transmittance.
+                t_dir[i] = -rt_term *
+                    ( (TF(1.) + k_mu) * (alpha1 + k_gamma4) * t_noscat[i]
+                    - (TF(1.) - k_mu) * (alpha1 - k_gamma4) * exp_minus2ktau * t_noscat[i]
+                    - TF(2.) * (k_gamma4 + alpha1 * k_mu) * exp_minusktau );
+            }
+    }
+
+    // Direct beam and the sources of scattered direct radiation in each layer.
+    // The direct flux at the top of the atmosphere needs to be set before the call.
+    template<typename TF>
+    void sw_source_2str(
+            const int ncol, const int nlay, const BOOL_TYPE top_at_1,
+            const TF* r_dir, const TF* t_dir, const TF* t_noscat,
+            TF* flux_dir, TF* src_up, TF* src_dn)
+    {
+        if (top_at_1)
+        {
+            for (int ilay=0; ilay<nlay; ++ilay)
+                for (int icol=0; icol<ncol; ++icol)
+                {
+                    const int i = icol + ilay*ncol;
+                    src_up[i] = r_dir[i] * flux_dir[i];
+                    src_dn[i] = t_dir[i] * flux_dir[i];
+                    flux_dir[i+ncol] = t_noscat[i] * flux_dir[i];
+                }
+        }
+        else
+        {
+            for (int ilay=nlay-1; ilay>=0; --ilay)
+                for (int icol=0; icol<ncol; ++icol)
+                {
+                    const int i = icol + ilay*ncol;
+                    src_up[i] = r_dir[i] * flux_dir[i+ncol];
+                    src_dn[i] = t_dir[i] * flux_dir[i+ncol];
+                    flux_dir[i] = t_noscat[i] * flux_dir[i+ncol];
+                }
+        }
+    }
+
+    // Adding method (Shonk and Hogan 2008), this is the only part that depends on the surface.
+    // The albedo of the atmosphere below each level and the denominators (ncol, nlay) depend
+    // only on the diffuse properties and the diffuse surface albedo, not on the direct beam.
+    template<typename TF>
+    void sw_adding_albedo(
+            const int ncol, const int nlay, const BOOL_TYPE top_at_1,
+            const TF* alb_sfc, const TF* r_dif, const TF* t_dif,
+            TF* albedo, TF* denom)
+    {
+        if (top_at_1)
+        {
+            for (int icol=0; icol<ncol; ++icol)
+                albedo[icol + nlay*ncol] = alb_sfc[icol];
+
+            // From the bottom to the top of the atmosphere, compute the albedo of upward radiation.
+            for (int ilay=nlay-1; ilay>=0; --ilay)
+                for (int icol=0; icol<ncol; ++icol)
+                {
+                    const int i = icol + ilay*ncol;
+                    denom[i] = TF(1.) / (TF(1.) - r_dif[i]*albedo[i+ncol]);                         // Eq. 10
+                    albedo[i] = r_dif[i] + t_dif[i]*t_dif[i] * albedo[i+ncol] * denom[i];            // Eq. 9
+                }
+        }
+        else
+        {
+            for (int icol=0; icol<ncol; ++icol)
+                albedo[icol] = alb_sfc[icol];
+
+            for (int ilay=0; ilay<nlay; ++ilay)
+                for (int icol=0; icol<ncol; ++icol)
+                {
+                    const int i = icol + ilay*ncol;
+                    denom[i] = TF(1.) / (TF(1.) - r_dif[i]*albedo[i]);
+                    albedo[i+ncol] = r_dif[i] + t_dif[i]*t_dif[i] * albedo[i] * denom[i];
+                }
+        }
+    }
+
+    // Source of upward radiation and the fluxes of the adding method, for the albedo and
+    // denominators of sw_adding_albedo. On entry flux_dn contains the incoming diffuse flux
+    // at the top of the atmosphere, src (ncol, nlay+1) is a work array.
+    template<typename TF>
+    void sw_adding_source(
+            const int ncol, const int nlay, const BOOL_TYPE top_at_1,
+            const TF* src_sfc,
+            const TF* r_dif, const TF* t_dif,
+            const TF* src_dn, const TF* src_up,
+            const TF* albedo, const TF* denom,
+            TF* flux_up, TF* flux_dn, TF* src)
+    {
+        if (top_at_1)
+        {
+            for (int icol=0; icol<ncol; ++icol)
+                src[icol + nlay*ncol] = src_sfc[icol];
+
+            // From the bottom to the top of the atmosphere, compute the source of upward radiation.
+            for (int ilay=nlay-1; ilay>=0; --ilay)
+                for (int icol=0; icol<ncol; ++icol)
+                {
+                    const int i = icol + ilay*ncol;
+                    src[i] = src_up[i] + t_dif[i] * denom[i] * (src[i+ncol] + albedo[i+ncol]*src_dn[i]); // Eq. 11
+                }
+
+            // Eq. 12, from the top of the atmosphere downward compute the fluxes.
+            for (int icol=0; icol<ncol; ++icol)
+                flux_up[icol] = flux_dn[icol]*albedo[icol] + src[icol];
+
+            for (int ilev=1; ilev<=nlay; ++ilev)
+                for (int icol=0; icol<ncol; ++icol)
+                {
+                    const int i = icol + ilev*ncol;
+                    const int i_lay = i - ncol;
+                    flux_dn[i] = (t_dif[i_lay]*flux_dn[i-ncol] + r_dif[i_lay]*src[i] + src_dn[i_lay]) * denom[i_lay];
+                    flux_up[i] = flux_dn[i]*albedo[i] + src[i];
+                }
+        }
+        else
+        {
+            for (int icol=0; icol<ncol; ++icol)
+                src[icol] = src_sfc[icol];
+
+            for (int ilay=0; ilay<nlay; ++ilay)
+                for (int icol=0; icol<ncol; ++icol)
+                {
+                    const int i = icol + ilay*ncol;
+                    src[i+ncol] = src_up[i] + t_dif[i] * denom[i] * (src[i] + albedo[i]*src_dn[i]);
+                }
+
+            for (int icol=0; icol<ncol; ++icol)
+            {
+                const int i = icol + nlay*ncol;
+                flux_up[i] = flux_dn[i]*albedo[i] + src[i];
+            }
+
+            for (int ilay=nlay-1; ilay>=0; --ilay)
+                for (int icol=0; icol<ncol; ++icol)
+                {
+                    const int i = icol + ilay*ncol;
+                    flux_dn[i] = (t_dif[i]*flux_dn[i+ncol] + r_dif[i]*src[i] + src_dn[i]) * denom[i];
+                    flux_up[i] = flux_dn[i]*albedo[i] + src[i];
+                }
+        }
+    }
+
+    // Adding method for a single direct beam. On entry flux_dn contains the incoming diffuse flux
+    // at the top of the atmosphere, albedo, src (ncol, nlay+1) and denom (ncol, nlay) are work arrays.
+    template<typename TF>
+    void sw_adding(
+            const int ncol, const int nlay, const BOOL_TYPE top_at_1,
+            const TF* alb_sfc, const TF* src_sfc,
+            const TF* r_dif, const TF* t_dif,
+            const TF* src_dn, const TF* src_up,
+            TF* flux_up, TF* flux_dn,
+            TF* albedo, TF* src, TF* denom)
+    {
+        sw_adding_albedo(ncol, nlay, top_at_1, alb_sfc, r_dif, t_dif, albedo, denom);
+        sw_adding_source(
+                ncol, nlay, top_at_1, src_sfc, r_dif, t_dif, src_dn, src_up,
+                albedo, denom, flux_up, flux_dn, src);
+    }
+}
+
 template<typename TF>
 void Rte_sw<TF>::rte_sw(
         const std::unique_ptr<Optical_props_arry<TF>>& optical_props,
@@ -133,6 +386,206 @@ void Rte_sw<TF>::rte_sw(
     // fluxes->reduce(gpt_flux_up, gpt_flux_dn, gpt_flux_dir, optical_props, top_at_1);
 }
 
+template<typename TF>
+void Rte_sw<TF>::rte_sw_albedos(
+        const std::unique_ptr<Optical_props_arry<TF>>& optical_props,
+        const BOOL_TYPE top_at_1,
+        const Array<TF,1>& mu0,
+        const Array<TF,2>& inc_flux_dir,
+        const std::vector<Array<TF,2>>& sfc_alb_dir,
+        const std::vector<Array<TF,2>>& sfc_alb_dif,
+        const Array<TF,2>& inc_flux_dif,
+        std::vector<Array<TF,3>>& gpt_flux_up,
+        std::vector<Array<TF,3>>& gpt_flux_dn,
+        Array<TF,3>& gpt_flux_dir)
+{
+    const int ncol = optical_props->get_ncol();
+    const int nlay = optical_props->get_nlay();
+    const int ngpt = optical_props->get_ngpt();
+    const int nlev = nlay+1;
+
+    const int n_alb = sfc_alb_dir.size();
+    if (int(sfc_alb_dif.size()) != n_alb)
+        throw std::runtime_error("Number of direct and diffuse surface albedo scenarios differs");
+
+    std::vector<Array<TF,2>> sfc_alb_dir_gpt(n_alb, Array<TF,2>({ncol, ngpt}));
+    std::vector<Array<TF,2>> sfc_alb_dif_gpt(n_alb, Array<TF,2>({ncol, ngpt}));
+
+    for (int ialb=0; ialb<n_alb; ++ialb)
+    {
+        expand_and_transpose(optical_props, sfc_alb_dir[ialb], sfc_alb_dir_gpt[ialb]);
+        expand_and_transpose(optical_props, sfc_alb_dif[ialb], sfc_alb_dif_gpt[ialb]);
+    }
+
+    gpt_flux_up.resize(n_alb);
+    gpt_flux_dn.resize(n_alb);
+
+    // Upper boundary condition, the same for all scenarios.
+    rrtmgp_kernel_launcher::apply_BC(ncol, nlay, ngpt, top_at_1, inc_flux_dir, mu0, gpt_flux_dir);
+    for (int ialb=0; ialb<n_alb; ++ialb)
+    {
+        if (gpt_flux_up[ialb].is_empty())
+            gpt_flux_up[ialb].set_dims({ncol, nlev, ngpt});
+        if (gpt_flux_dn[ialb].is_empty())
+            gpt_flux_dn[ialb].set_dims({ncol, nlev, ngpt});
+
+        if (inc_flux_dif.size() == 0)
+            rrtmgp_kernel_launcher::apply_BC(ncol, nlay, ngpt, top_at_1, gpt_flux_dn[ialb]);
+        else
+            rrtmgp_kernel_launcher::apply_BC(ncol, nlay, ngpt, top_at_1, inc_flux_dif, gpt_flux_dn[ialb]);
+    }
+
+    Two_stream_diffuse<TF> dif(ncol*nlay);
+    std::vector<TF> r_dir(ncol*nlay), t_dir(ncol*nlay), t_noscat(ncol*nlay);
+    std::vector<TF> src_up(ncol*nlay), src_dn(ncol*nlay), src_sfc(ncol);
+    std::vector<TF> albedo(ncol*nlev), src(ncol*nlev), denom(ncol*nlay);
+
+    const int sfc_offset = top_at_1 ? nlay*ncol : 0;
+
+    for (int igpt=0; igpt<ngpt; ++igpt)
+    {
+        const TF* tau = optical_props->get_tau().ptr() + igpt*ncol*nlay;
+        const TF* ssa = optical_props->get_ssa().ptr() + igpt*ncol*nlay;
+        const TF* g   = optical_props->get_g  ().ptr() + igpt*ncol*nlay;
+
+        TF* flux_dir = gpt_flux_dir.ptr() + igpt*ncol*nlev;
+
+        // Everything up to the adding pass is independent of the surface.
+        sw_two_stream_diffuse(ncol, nlay, tau, ssa, g, dif);
+        sw_two_stream_direct(
+                ncol, nlay, mu0.ptr(), tau, ssa, g, dif,
+                r_dir.data(), t_dir.data(), t_noscat.data());
+        sw_source_2str(
+                ncol, nlay, top_at_1,
+                r_dir.data(), t_dir.data(), t_noscat.data(),
+                flux_dir, src_up.data(), src_dn.data());
+
+        for (int ialb=0; ialb<n_alb; ++ialb)
+        {
+            const TF* alb_dir = sfc_alb_dir_gpt[ialb].ptr() + igpt*ncol;
+            const TF* alb_dif = sfc_alb_dif_gpt[ialb].ptr() + igpt*ncol;
+
+            for (int icol=0; icol<ncol; ++icol)
+                src_sfc[icol] = flux_dir[icol + sfc_offset] * alb_dir[icol];
+
+            TF* flux_up = gpt_flux_up[ialb].ptr() + igpt*ncol*nlev;
+            TF* flux_dn = gpt_flux_dn[ialb].ptr() + igpt*ncol*nlev;
+
+            sw_adding(
+                    ncol, nlay, top_at_1,
+                    alb_dif, src_sfc.data(),
+                    dif.r_dif.data(), dif.t_dif.data(),
+                    src_dn.data(), src_up.data(),
+                    flux_up, flux_dn,
+                    albedo.data(), src.data(), denom.data());
+
+            // The adding pass computes the diffuse flux only, flux_dn is the total flux.
+            for (int i=0; i<ncol*nlev; ++i)
+                flux_dn[i] += flux_dir[i];
+        }
+    }
+}
+
+template<typename TF>
+void Rte_sw<TF>::rte_sw_mu0s(
+        const std::unique_ptr<Optical_props_arry<TF>>& optical_props,
+        const BOOL_TYPE top_at_1,
+        const std::vector<Array<TF,1>>& mu0,
+        const Array<TF,2>& inc_flux_dir,
+        const Array<TF,2>& sfc_alb_dir,
+        const Array<TF,2>& sfc_alb_dif,
+        const Array<TF,2>& inc_flux_dif,
+        std::vector<Array<TF,3>>& gpt_flux_up,
+        std::vector<Array<TF,3>>& gpt_flux_dn,
+        std::vector<Array<TF,3>>& gpt_flux_dir)
+{
+    const int ncol = optical_props->get_ncol();
+    const int nlay = optical_props->get_nlay();
+    const int ngpt = optical_props->get_ngpt();
+    const int nlev = nlay+1;
+
+    const int n_mu0 = mu0.size();
+
+    Array<TF,2> sfc_alb_dir_gpt({ncol, ngpt});
+    Array<TF,2> sfc_alb_dif_gpt({ncol, ngpt});
+
+    expand_and_transpose(optical_props, sfc_alb_dir, sfc_alb_dir_gpt);
+    expand_and_transpose(optical_props, sfc_alb_dif, sfc_alb_dif_gpt);
+
+    gpt_flux_up.resize(n_mu0);
+    gpt_flux_dn.resize(n_mu0);
+    gpt_flux_dir.resize(n_mu0);
+
+    // Upper boundary conditions, the direct beam at the top of the atmosphere scales with mu0.
+    for (int imu0=0; imu0<n_mu0; ++imu0)
+    {
+        if (gpt_flux_up[imu0].is_empty())
+            gpt_flux_up[imu0].set_dims({ncol, nlev, ngpt});
+        if (gpt_flux_dn[imu0].is_empty())
+            gpt_flux_dn[imu0].set_dims({ncol, nlev, ngpt});
+        if (gpt_flux_dir[imu0].is_empty())
+            gpt_flux_dir[imu0].set_dims({ncol, nlev, ngpt});
+
+        rrtmgp_kernel_launcher::apply_BC(ncol, nlay, ngpt, top_at_1, inc_flux_dir, mu0[imu0], gpt_flux_dir[imu0]);
+        if (inc_flux_dif.size() == 0)
+            rrtmgp_kernel_launcher::apply_BC(ncol, nlay, ngpt, top_at_1, gpt_flux_dn[imu0]);
+        else
+            rrtmgp_kernel_launcher::apply_BC(ncol, nlay, ngpt, top_at_1, inc_flux_dif, gpt_flux_dn[imu0]);
+    }
+
+    Two_stream_diffuse<TF> dif(ncol*nlay);
+    std::vector<TF> r_dir(ncol*nlay), t_dir(ncol*nlay), t_noscat(ncol*nlay);
+    std::vector<TF> src_up(ncol*nlay), src_dn(ncol*nlay), src_sfc(ncol);
+    std::vector<TF> albedo(ncol*nlev), src(ncol*nlev), denom(ncol*nlay);
+
+    const int sfc_offset = top_at_1 ? nlay*ncol : 0;
+
+    for (int igpt=0; igpt<ngpt; ++igpt)
+    {
+        const TF* tau = optical_props->get_tau().ptr() + igpt*ncol*nlay;
+        const TF* ssa = optical_props->get_ssa().ptr() + igpt*ncol*nlay;
+        const TF* g   = optical_props->get_g  ().ptr() + igpt*ncol*nlay;
+
+        const TF* alb_dir = sfc_alb_dir_gpt.ptr() + igpt*ncol;
+        const TF* alb_dif = sfc_alb_dif_gpt.ptr() + igpt*ncol;
+
+        // The diffuse layer properties, including the exponentials and square roots
+        // that dominate the cost of the two-stream solution, are shared by all angles,
+        // and so are the albedo and denominators of the adding method.
+        sw_two_stream_diffuse(ncol, nlay, tau, ssa, g, dif);
+        sw_adding_albedo(ncol, nlay, top_at_1, alb_dif, dif.r_dif.data(), dif.t_dif.data(), albedo.data(), denom.data());
+
+        for (int imu0=0; imu0<n_mu0; ++imu0)
+        {
+            TF* flux_dir = gpt_flux_dir[imu0].ptr() + igpt*ncol*nlev;
+            TF* flux_up  = gpt_flux_up [imu0].ptr() + igpt*ncol*nlev;
+            TF* flux_dn  = gpt_flux_dn [imu0].ptr() + igpt*ncol*nlev;
+
+            sw_two_stream_direct(
+                    ncol, nlay, mu0[imu0].ptr(), tau, ssa, g, dif,
+                    r_dir.data(), t_dir.data(), t_noscat.data());
+            sw_source_2str(
+                    ncol, nlay, top_at_1,
+                    r_dir.data(), t_dir.data(), t_noscat.data(),
+                    flux_dir, src_up.data(), src_dn.data());
+
+            for (int icol=0; icol<ncol; ++icol)
+                src_sfc[icol] = flux_dir[icol + sfc_offset] * alb_dir[icol];
+
+            sw_adding_source(
+                    ncol, nlay, top_at_1,
+                    src_sfc.data(),
+                    dif.r_dif.data(), dif.t_dif.data(),
+                    src_dn.data(), src_up.data(),
+                    albedo.data(), denom.data(),
+                    flux_up, flux_dn, src.data());
+
+            for (int i=0; i<ncol*nlev; ++i)
+                flux_dn[i] += flux_dir[i];
+        }
+    }
+}
+
 template<typename TF>
 void Rte_sw<TF>::expand_and_transpose(
         const std::unique_ptr<Optical_props_arry<TF>>& ops,
@@ -149,8 +602,5 @@ void Rte_sw<TF>::expand_and_transpose(
                 arr_out({icol, igpt}) = arr_in({iband, icol});
 }
 
-#ifdef FLOAT_SINGLE_RRTMGP
 template class Rte_sw<float>;
-#else
 template class Rte_sw<double>;
-#endif
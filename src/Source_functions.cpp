@@ -22,10 +22,29 @@
  *
  */
 
+#include <algorithm>
+
 #include "Source_functions.h"
 #include "Array.h"
 #include "Optical_props.h"
 
+#define restrict __restrict__
+
+namespace
+{
+    // Copy n_col columns of in, starting at col_in, to out, starting at col_out.
+    template<typename TF>
+    void copy_columns(
+            Array<TF,3>& out, const int col_out,
+            const Array<TF,3>& in, const int col_in, const int n_col)
+    {
+        for (int k=1; k<=out.dim(3); ++k)
+            for (int j=1; j<=out.dim(2); ++j)
+                for (int i=0; i<n_col; ++i)
+                    out({col_out+i, j, k}) = in({col_in+i, j, k});
+    }
+}
+
 template<typename TF>
 Source_func_lw<TF>::Source_func_lw(
         const int n_col,
@@ -35,10 +54,57 @@ Source_func_lw<TF>::Source_func_lw(
     sfc_source({n_col, optical_props.get_ngpt()}),
     sfc_source_jac({n_col, optical_props.get_ngpt()}),
     lay_source({n_col, n_lay, optical_props.get_ngpt()}),
-    lev_source_inc({n_col, n_lay, optical_props.get_ngpt()}),
-    lev_source_dec({n_col, n_lay, optical_props.get_ngpt()})
+    lev_source({n_col, n_lay+1, optical_props.get_nband()}),
+    pfrac({n_col, n_lay, optical_props.get_ngpt()})
 {}
 
+template<typename TF>
+void Source_func_lw<TF>::split_lev_source()
+{
+    if (lev_source_is_split())
+        return;
+
+    lev_source_inc.set_dims(lay_source.get_dims());
+    lev_source_dec.set_dims(lay_source.get_dims());
+
+    lev_source = Array<TF,3>();
+    pfrac = Array<TF,3>();
+}
+
+template<typename TF>
+void Source_func_lw<TF>::derive_lev_source(
+        const int gpt_s, const int gpt_e,
+        TF* restrict lev_source_inc_out, TF* restrict lev_source_dec_out) const
+{
+    const int n_col = lay_source.dim(1);
+    const int n_cell = n_col*lay_source.dim(2);
+
+    if (lev_source_is_split())
+    {
+        std::copy(lev_source_inc.ptr() + (gpt_s-1)*n_cell, lev_source_inc.ptr() + gpt_e*n_cell, lev_source_inc_out);
+        std::copy(lev_source_dec.ptr() + (gpt_s-1)*n_cell, lev_source_dec.ptr() + gpt_e*n_cell, lev_source_dec_out);
+        return;
+    }
+
+    const Array<int,1> gpt2band = this->get_gpoint_bands();
+
+    // The level below layer ilay is level ilay, the level above is one row of columns further.
+    for (int igpt=gpt_s; igpt<=gpt_e; ++igpt)
+    {
+        const TF* restrict pfrac_gpt = pfrac.ptr() + (igpt-1)*n_cell;
+        const TF* restrict planck_lev = lev_source.ptr() + (gpt2band({igpt})-1)*(n_cell+n_col);
+        TF* restrict inc = lev_source_inc_out + (igpt-gpt_s)*n_cell;
+        TF* restrict dec = lev_source_dec_out + (igpt-gpt_s)*n_cell;
+
+        #pragma ivdep
+        for (int idx=0; idx<n_cell; ++idx)
+        {
+            inc[idx] = pfrac_gpt[idx] * planck_lev[idx+n_col];
+            dec[idx] = pfrac_gpt[idx] * planck_lev[idx];
+        }
+    }
+}
+
 template<typename TF>
 void Source_func_lw<TF>::set_subset(
         const Source_func_lw<TF>& sources_sub,
@@ -46,16 +112,30 @@ void Source_func_lw<TF>::set_subset(
 {
     for (int igpt=1; igpt<=lay_source.dim(3); ++igpt)
         for (int icol=col_s; icol<=col_e; ++icol)
-            sfc_source({icol, igpt}) = sources_sub.get_sfc_source()({icol-col_s+1, igpt});
+        {
+            sfc_source    ({icol, igpt}) = sources_sub.get_sfc_source    ()({icol-col_s+1, igpt});
+            sfc_source_jac({icol, igpt}) = sources_sub.get_sfc_source_jac()({icol-col_s+1, igpt});
+        }
 
-    for (int igpt=1; igpt<=lay_source.dim(3); ++igpt)
-        for (int ilay=1; ilay<=lay_source.dim(2); ++ilay)
-            for (int icol=col_s; icol<=col_e; ++icol)
-            {
-                lay_source    ({icol, ilay, igpt}) = sources_sub.get_lay_source()    ({icol-col_s+1, ilay, igpt});
-                lev_source_inc({icol, ilay, igpt}) = sources_sub.get_lev_source_inc()({icol-col_s+1, ilay, igpt});
-                lev_source_dec({icol, ilay, igpt}) = sources_sub.get_lev_source_dec()({icol-col_s+1, ilay, igpt});
-            }
+    const int n_col = col_e-col_s+1;
+    copy_columns(lay_source, col_s, sources_sub.get_lay_source(), 1, n_col);
+
+    if (sources_sub.lev_source_is_split() || lev_source_is_split())
+    {
+        split_lev_source();
+
+        Array<TF,3> lev_source_inc_sub(sources_sub.get_lay_source().get_dims());
+        Array<TF,3> lev_source_dec_sub(sources_sub.get_lay_source().get_dims());
+        sources_sub.derive_lev_source(1, lay_source.dim(3), lev_source_inc_sub.ptr(), lev_source_dec_sub.ptr());
+
+        copy_columns(lev_source_inc, col_s, lev_source_inc_sub, 1, n_col);
+        copy_columns(lev_source_dec, col_s, lev_source_dec_sub, 1, n_col);
+    }
+    else
+    {
+        copy_columns(lev_source, col_s, sources_sub.get_lev_source(), 1, n_col);
+        copy_columns(pfrac, col_s, sources_sub.get_pfrac(), 1, n_col);
+    }
 }
 
 template<typename TF>
@@ -65,20 +145,35 @@ void Source_func_lw<TF>::get_subset(
 {
     for (int igpt=1; igpt<=lay_source.dim(3); ++igpt)
         for (int icol=col_s; icol<=col_e; ++icol)
-            sfc_source({icol-col_s+1, igpt}) = sources_sub.get_sfc_source()({icol, igpt});
+        {
+            sfc_source    ({icol-col_s+1, igpt}) = sources_sub.get_sfc_source    ()({icol, igpt});
+            sfc_source_jac({icol-col_s+1, igpt}) = sources_sub.get_sfc_source_jac()({icol, igpt});
+        }
 
-    for (int igpt=1; igpt<=lay_source.dim(3); ++igpt)
-        for (int ilay=1; ilay<=lay_source.dim(2); ++ilay)
-            for (int icol=col_s; icol<=col_e; ++icol)
-            {
-                lay_source    ({icol-col_s+1, ilay, igpt}) = sources_sub.get_lay_source()    ({icol, ilay, igpt});
-                lev_source_inc({icol-col_s+1, ilay, igpt}) = sources_sub.get_lev_source_inc()({icol, ilay, igpt});
-                lev_source_dec({icol-col_s+1, ilay, igpt}) = sources_sub.get_lev_source_dec()({icol, ilay, igpt});
-            }
+    const int n_col = col_e-col_s+1;
+    copy_columns(lay_source, 1, sources_sub.get_lay_source(), col_s, n_col);
+
+    if (sources_sub.lev_source_is_split())
+    {
+        split_lev_source();
+        copy_columns(lev_source_inc, 1, sources_sub.get_lev_source_inc(), col_s, n_col);
+        copy_columns(lev_source_dec, 1, sources_sub.get_lev_source_dec(), col_s, n_col);
+    }
+    else if (lev_source_is_split())
+    {
+        Array<TF,3> lev_source_inc_sub(sources_sub.get_lay_source().get_dims());
+        Array<TF,3> lev_source_dec_sub(sources_sub.get_lay_source().get_dims());
+        sources_sub.derive_lev_source(1, lay_source.dim(3), lev_source_inc_sub.ptr(), lev_source_dec_sub.ptr());
+
+        copy_columns(lev_source_inc, 1, lev_source_inc_sub, col_s, n_col);
+        copy_columns(lev_source_dec, 1, lev_source_dec_sub, col_s, n_col);
+    }
+    else
+    {
+        copy_columns(lev_source, 1, sources_sub.get_lev_source(), col_s, n_col);
+        copy_columns(pfrac, 1, sources_sub.get_pfrac(), col_s, n_col);
+    }
 }
 
-#ifdef FLOAT_SINGLE_RRTMGP
 template class Source_func_lw<float>;
-#else
 template class Source_func_lw<double>;
-#endif
@@ -0,0 +1,151 @@
+/*
+ * This file is part of a C++ interface to the Radiative Transfer for Energetics (RTE)
+ * and Rapid Radiative Transfer Model for GCM applications Parallel (RRTMGP).
+ *
+ * The original code is found at https://github.com/earth-system-radiation/rte-rrtmgp.
+ *
+ * Contacts: Robert Pincus and Eli Mlawer
+ * email: rrtmgp@aer.com
+ *
+ * Copyright 2015-2020,  Atmospheric and Environmental Research and
+ * Regents of the University of Colorado.  All right reserved.
+ *
+ * This C++ interface can be downloaded from https://github.com/earth-system-radiation/rte-rrtmgp-cpp
+ *
+ * Contact: Chiel van Heerwaarden
+ * email: chiel.vanheerwaarden@wur.nl
+ *
+ * Copyright 2020, Wageningen University & Research.
+ *
+ * Use and duplication is permitted under the terms of the
+ * BSD 3-clause license, see http://opensource.org/licenses/BSD-3-Clause
+ *
+ */
+
+
+#include <stdexcept>
+
+#include "Thread_pool.h"
+
+namespace
+{
+    // Pool of which the current thread is a worker, to run nested calls serially.
+    thread_local const Thread_pool* current_pool = nullptr;
+}
+
+Thread_pool::Thread_pool(const int n_threads) :
+    n_threads(n_threads), stop(false)
+{
+    if (n_threads < 1)
+        throw std::runtime_error("A thread pool needs at least one thread");
+
+    for (int i_thread=1; i_thread<n_threads; ++i_thread)
+        workers.emplace_back(&Thread_pool::work, this, i_thread);
+}
+
+Thread_pool::~Thread_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    job_available.notify_all();
+
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+void Thread_pool::run_tasks(Job& job, const int i_thread)
+{
+    int i_task;
+    while ((i_task = job.i_task_next++) < job.n_tasks)
+    {
+        try
+        {
+            (*job.task)(i_task, i_thread);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(job.exception_mutex);
+            if (!job.exception)
+                job.exception = std::current_exception();
+        }
+        ++job.n_tasks_done;
+    }
+}
+
+void Thread_pool::work(const int i_thread)
+{
+    current_pool = this;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        // Drop the jobs of which all tasks have been taken.
+        while (!jobs.empty() && jobs.front()->i_task_next >= jobs.front()->n_tasks)
+            jobs.pop_front();
+
+        if (stop)
+            return;
+
+        if (jobs.empty())
+        {
+            job_available.wait(lock);
+            continue;
+        }
+
+        Job& job = *jobs.front();
+        ++job.n_workers;
+
+        lock.unlock();
+        run_tasks(job, i_thread);
+        lock.lock();
+
+        --job.n_workers;
+        job_finished.notify_all();
+    }
+}
+
+void Thread_pool::parallel_for(const int n_tasks, const std::function<void(int, int)>& task)
+{
+    if (n_tasks <= 0)
+        return;
+
+    if (n_tasks == 1 || n_threads == 1 || current_pool == this)
+    {
+        for (int i_task=0; i_task<n_tasks; ++i_task)
+            task(i_task, 0);
+        return;
+    }
+
+    Job job;
+    job.task = &task;
+    job.n_tasks = n_tasks;
+    job.i_task_next = 0;
+    job.n_tasks_done = 0;
+    job.n_workers = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(&job);
+    }
+    job_available.notify_all();
+
+    run_tasks(job, 0);
+
+    // Wait until the workers have left the job, after which it can go out of scope.
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        job_finished.wait(lock, [&]{ return job.n_tasks_done == n_tasks && job.n_workers == 0; });
+
+        for (auto it=jobs.begin(); it!=jobs.end(); ++it)
+            if (*it == &job)
+            {
+                jobs.erase(it);
+                break;
+            }
+    }
+
+    if (job.exception)
+        std::rethrow_exception(job.exception);
+}
@@ -0,0 +1,38 @@
+#
+# This file is part of a C++ interface to the Radiative Transfer for Energetics (RTE)
+#
+# Append SUFFIX to all global symbols that are defined in the static library LIBRARY,
+# references to these symbols within the library are renamed as well.
+# Usage: cmake -DNM=<nm> -DOBJCOPY=<objcopy> -DLIBRARY=<lib> -DSUFFIX=<suffix> -P suffix_symbols.cmake
+execute_process(
+    COMMAND ${NM} --defined-only --extern-only --format=posix ${LIBRARY}
+    OUTPUT_VARIABLE nm_output
+    RESULT_VARIABLE nm_result)
+
+if(NOT nm_result EQUAL 0)
+    message(FATAL_ERROR "Listing the symbols of ${LIBRARY} failed.")
+endif()
+
+# Each symbol line reads "name type [value size]", the archive member lines end with a colon.
+string(REPLACE "\n" ";" nm_lines "${nm_output}")
+set(symbols "")
+foreach(line IN LISTS nm_lines)
+    if(line MATCHES "^([^ :]+) [A-Za-z]( |$)")
+        list(APPEND symbols ${CMAKE_MATCH_1})
+    endif()
+endforeach()
+list(REMOVE_DUPLICATES symbols)
+
+set(symbol_map "")
+foreach(symbol IN LISTS symbols)
+    set(symbol_map "${symbol_map}${symbol} ${symbol}${SUFFIX}\n")
+endforeach()
+file(WRITE ${LIBRARY}.symbols "${symbol_map}")
+
+execute_process(
+    COMMAND ${OBJCOPY} --redefine-syms=${LIBRARY}.symbols ${LIBRARY}
+    RESULT_VARIABLE objcopy_result)
+
+if(NOT objcopy_result EQUAL 0)
+    message(FATAL_ERROR "Renaming the symbols of ${LIBRARY} failed.")
+endif()
@@ -0,0 +1,330 @@
+/*
+ * This file is part of the local radiation service that is
+ * used for the testing of the C++ interface to the RTE+RRTMGP radiation code.
+ *
+ * It is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "Radiation_service.h"
+
+namespace Radiation_service
+{
+    namespace
+    {
+        std::runtime_error system_error(const std::string& message)
+        {
+            return std::runtime_error(message + ": " + std::strerror(errno));
+        }
+    }
+
+    Segment_layout::Segment_layout(
+            const Request_type type, const int n_col, const int n_lay,
+            const std::vector<std::string>& gas_names) :
+        n_col(n_col), n_lay(n_lay), n_values(0)
+    {
+        if (type != Request_type::Longwave && type != Request_type::Shortwave)
+            throw std::runtime_error("Unknown request type");
+        if (n_col < 1 || n_lay < 1)
+            throw std::runtime_error("Request has no columns or layers");
+        if (gas_names.size() > max_gases)
+            throw std::runtime_error("Request has more than " + std::to_string(max_gases) + " gases");
+
+        const int n_lev = n_lay + 1;
+
+        add_field("p_lay", Field_kind::Input, n_lay);
+        add_field("p_lev", Field_kind::Input, n_lev);
+        add_field("t_lay", Field_kind::Input, n_lay);
+        add_field("t_lev", Field_kind::Input, n_lev);
+
+        if (type == Request_type::Longwave)
+        {
+            add_field("t_sfc", Field_kind::Input, 1);
+            add_field("emis_sfc", Field_kind::Input, 1);
+        }
+        else
+        {
+            add_field("sfc_alb_dir", Field_kind::Input, 1);
+            add_field("sfc_alb_dif", Field_kind::Input, 1);
+            add_field("tsi_scaling", Field_kind::Input, 1);
+            add_field("mu0", Field_kind::Input, 1);
+        }
+
+        for (const std::string& gas_name : gas_names)
+        {
+            if (gas_name.empty() || gas_name.size() >= gas_name_length)
+                throw std::runtime_error("Invalid gas name " + gas_name);
+            if (has_field(gas_name))
+                throw std::runtime_error("Gas " + gas_name + " is given twice");
+            add_field(gas_name, Field_kind::Gas, n_lay);
+        }
+
+        add_field("flux_up", Field_kind::Output, n_lev);
+        add_field("flux_dn", Field_kind::Output, n_lev);
+        if (type == Request_type::Shortwave)
+            add_field("flux_dn_dir", Field_kind::Output, n_lev);
+        add_field("flux_net", Field_kind::Output, n_lev);
+    }
+
+    namespace
+    {
+        std::vector<std::string> get_gas_names(const Segment_header& header)
+        {
+            if (header.n_gas < 0 || header.n_gas > max_gases)
+                throw std::runtime_error("Invalid number of gases");
+
+            std::vector<std::string> gas_names;
+            for (int igas=0; igas<header.n_gas; ++igas)
+                gas_names.emplace_back(header.gas_names[igas], strnlen(header.gas_names[igas], gas_name_length));
+            return gas_names;
+        }
+    }
+
+    Segment_layout::Segment_layout(const Segment_header& header) :
+        Segment_layout(header.type, header.n_col, header.n_lay, get_gas_names(header))
+    {}
+
+    void Segment_layout::add_field(const std::string& name, const Field_kind kind, const int n_per_col)
+    {
+        fields.push_back({name, kind, n_per_col, n_values});
+        n_values += size_t(n_per_col) * n_col;
+    }
+
+    const Field& Segment_layout::get_field(const std::string& name) const
+    {
+        for (const Field& field : fields)
+            if (field.name == name)
+                return field;
+
+        throw std::runtime_error("Request has no field " + name);
+    }
+
+    bool Segment_layout::has_field(const std::string& name) const
+    {
+        for (const Field& field : fields)
+            if (field.name == name)
+                return true;
+        return false;
+    }
+
+    size_t Segment_layout::get_n_bytes() const
+    {
+        return header_bytes + n_values*sizeof(double);
+    }
+
+    Shared_segment::Shared_segment(const std::string& name, void* address, const size_t n_bytes, const bool owner) :
+        name(name), address(address), n_bytes(n_bytes), owner(owner)
+    {}
+
+    Shared_segment::~Shared_segment()
+    {
+        munmap(address, n_bytes);
+        if (owner)
+            shm_unlink(name.c_str());
+    }
+
+    std::unique_ptr<Shared_segment> Shared_segment::create(const std::string& name, const size_t n_bytes)
+    {
+        if (name.size() >= segment_name_length)
+            throw std::runtime_error("Segment name " + name + " is too long");
+
+        const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+        if (fd == -1)
+            throw system_error("Cannot create shared memory segment " + name);
+
+        if (ftruncate(fd, n_bytes) == -1)
+        {
+            close(fd);
+            shm_unlink(name.c_str());
+            throw system_error("Cannot resize shared memory segment " + name);
+        }
+
+        void* address = mmap(nullptr, n_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+
+        if (address == MAP_FAILED)
+        {
+            shm_unlink(name.c_str());
+            throw system_error("Cannot map shared memory segment " + name);
+        }
+
+        return std::unique_ptr<Shared_segment>(new Shared_segment(name, address, n_bytes, true));
+    }
+
+    std::unique_ptr<Shared_segment> Shared_segment::open(const std::string& name)
+    {
+        const int fd = shm_open(name.c_str(), O_RDWR, 0);
+        if (fd == -1)
+            throw system_error("Cannot open shared memory segment " + name);
+
+        struct stat status;
+        if (fstat(fd, &status) == -1 || size_t(status.st_size) < sizeof(Segment_header))
+        {
+            close(fd);
+            throw std::runtime_error("Shared memory segment " + name + " has no header");
+        }
+
+        const size_t n_bytes = status.st_size;
+        void* address = mmap(nullptr, n_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+
+        if (address == MAP_FAILED)
+            throw system_error("Cannot map shared memory segment " + name);
+
+        return std::unique_ptr<Shared_segment>(new Shared_segment(name, address, n_bytes, false));
+    }
+
+    bool receive_message(const int socket_fd, void* message, const size_t n_bytes)
+    {
+        size_t n_received = 0;
+        while (n_received < n_bytes)
+        {
+            const ssize_t n = recv(socket_fd, static_cast<char*>(message) + n_received, n_bytes - n_received, 0);
+            if (n == 0)
+                return false;
+            if (n == -1)
+            {
+                if (errno == EINTR)
+                    continue;
+                throw system_error("Cannot receive message");
+            }
+            n_received += n;
+        }
+        return true;
+    }
+
+    void send_message(const int socket_fd, const void* message, const size_t n_bytes)
+    {
+        size_t n_sent = 0;
+        while (n_sent < n_bytes)
+        {
+            const ssize_t n = send(socket_fd, static_cast<const char*>(message) + n_sent, n_bytes - n_sent, MSG_NOSIGNAL);
+            if (n == -1)
+            {
+                if (errno == EINTR)
+                    continue;
+                throw system_error("Cannot send message");
+            }
+            n_sent += n;
+        }
+    }
+
+    Client::Client(const std::string& socket_path)
+    {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (socket_path.size() >= sizeof(address.sun_path))
+            throw std::runtime_error("Socket path " + socket_path + " is too long");
+        std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path)-1);
+
+        socket_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (socket_fd == -1)
+            throw system_error("Cannot create socket");
+
+        if (connect(socket_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1)
+        {
+            close(socket_fd);
+            throw system_error("Cannot connect to " + socket_path);
+        }
+    }
+
+    Client::~Client()
+    {
+        close(socket_fd);
+    }
+
+    void Client::prepare(
+            const Request_type type, const int n_col, const int n_lay,
+            const std::vector<std::string>& gas_names)
+    {
+        // Every segment gets a unique name, so that the server never confuses it with an earlier one.
+        static std::atomic<int> n_segments(0);
+
+        layout.reset();
+        segment.reset();
+
+        std::unique_ptr<Segment_layout> layout_new(new Segment_layout(type, n_col, n_lay, gas_names));
+
+        const std::string name = "/rrtmgp_" + std::to_string(getpid()) + "_" + std::to_string(n_segments++);
+        segment = Shared_segment::create(name, layout_new->get_n_bytes());
+
+        Segment_header& header = segment->get_header();
+        header.type = type;
+        header.n_col = n_col;
+        header.n_lay = n_lay;
+        header.n_gas = gas_names.size();
+        for (size_t igas=0; igas<gas_names.size(); ++igas)
+            std::strncpy(header.gas_names[igas], gas_names[igas].c_str(), gas_name_length);
+        header.status = 0;
+        header.error[0] = '\0';
+
+        layout = std::move(layout_new);
+    }
+
+    double* Client::field(const std::string& name)
+    {
+        if (!segment)
+            throw std::runtime_error("No request is prepared");
+
+        const Field& field = layout->get_field(name);
+        if (field.kind == Field_kind::Gas)
+            throw std::runtime_error(name + " is a gas");
+
+        return segment->get_data() + field.offset;
+    }
+
+    double* Client::gas(const std::string& name)
+    {
+        if (!segment)
+            throw std::runtime_error("No request is prepared");
+
+        const Field& field = layout->get_field(name);
+        if (field.kind != Field_kind::Gas)
+            throw std::runtime_error(name + " is not a gas");
+
+        return segment->get_data() + field.offset;
+    }
+
+    void Client::solve()
+    {
+        if (!segment)
+            throw std::runtime_error("No request is prepared");
+
+        Request_message request = {};
+        std::strncpy(request.segment_name, segment->get_name().c_str(), segment_name_length-1);
+        send_message(socket_fd, &request, sizeof(request));
+
+        Response_message response;
+        if (!receive_message(socket_fd, &response, sizeof(response)))
+            throw std::runtime_error("Server closed the connection");
+
+        if (response.status != 0)
+        {
+            const Segment_header& header = segment->get_header();
+            throw std::runtime_error(
+                    "Server failed to solve: " + std::string(header.error, strnlen(header.error, error_length)));
+        }
+    }
+}
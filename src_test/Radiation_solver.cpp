@@ -29,14 +29,199 @@
 #include "Array.h"
 #include "Gas_concs.h"
 #include "Gas_optics_rrtmgp.h"
+#include "Gas_optics_hybrid.h"
 #include "Optical_props.h"
 #include "Source_functions.h"
 #include "Fluxes.h"
 #include "Rte_lw.h"
 #include "Rte_sw.h"
+#include "column_kernels.h"
 
 namespace
 {
+    // The hybrid gas optics use the networks for the columns of which all inputs are
+    // within this number of standard deviations of the mean of the training data.
+    constexpr double n_sigma_hybrid = 3.;
+
+    template<typename TF>
+    TF nn_column_fraction(const std::unique_ptr<Gas_optics<TF>>& kdist)
+    {
+        if (auto kdist_hybrid = dynamic_cast<const Gas_optics_hybrid<TF>*>(kdist.get()))
+            return kdist_hybrid->get_nn_column_fraction();
+        else
+            return dynamic_cast<const Gas_optics_nn<TF>*>(kdist.get()) ? TF(1.) : TF(0.);
+    }
+
+    template<typename TF>
+    void set_nn_thread_pool(const std::unique_ptr<Gas_optics<TF>>& kdist, Thread_pool* thread_pool)
+    {
+        if (auto kdist_hybrid = dynamic_cast<Gas_optics_hybrid<TF>*>(kdist.get()))
+            kdist_hybrid->set_thread_pool(thread_pool);
+        else if (auto kdist_nn = dynamic_cast<Gas_optics_nn<TF>*>(kdist.get()))
+            kdist_nn->set_thread_pool(thread_pool);
+    }
+
+    // Convert an array into the storage precision of the spectral computations, without a copy if equal.
+    template<typename TF_store, typename TF, int N>
+    Array<TF_store,N> to_store(Array<TF,N>&& array, std::false_type)
+    {
+        return convert_array<TF_store>(array);
+    }
+
+    template<typename TF_store, int N>
+    Array<TF_store,N> to_store(Array<TF_store,N>&& array, std::true_type)
+    {
+        return std::move(array);
+    }
+
+    template<typename TF_store, typename TF, int N>
+    Array<TF_store,N> to_store(Array<TF,N>&& array)
+    {
+        return to_store<TF_store>(std::move(array), std::is_same<TF_store, TF>());
+    }
+
+    // Whether any of the columns col_s to col_e contains liquid or ice water.
+    template<typename TF>
+    bool has_clouds(
+            const Array_view<TF,2>& lwp, const Array_view<TF,2>& iwp,
+            const int col_s, const int col_e)
+    {
+        const int n_lay = lwp.dim(2);
+        for (int ilay=1; ilay<=n_lay; ++ilay)
+            for (int icol=col_s; icol<=col_e; ++icol)
+                if (lwp({icol, ilay}) > TF(0.) || iwp({icol, ilay}) > TF(0.))
+                    return true;
+        return false;
+    }
+
+    // Gas and cloud optics of the shortwave columns col_s to col_e, and the incoming
+    // solar radiation at the top of the atmosphere scaled with tsi_scaling.
+    template<typename TF>
+    void sw_optics_subset(
+            const Gas_optics<TF>& kdist,
+            Cloud_optics<TF>* cloud_optics,
+            const bool switch_cloud_optics,
+            const Gas_concs<TF>& gas_concs,
+            const int col_s, const int col_e,
+            const Array_view<TF,2>& p_lay, const Array_view<TF,2>& p_lev,
+            const Array_view<TF,2>& t_lay, const Array_view<TF,2>& col_dry,
+            const Array_view<TF,1>& tsi_scaling,
+            const Array_view<TF,2>& lwp, const Array_view<TF,2>& iwp,
+            const Array_view<TF,2>& rel, const Array_view<TF,2>& rei,
+            std::unique_ptr<Optical_props_arry<TF>>& optical_props,
+            Array<TF,2>& toa_src)
+    {
+        const int n_col_in = col_e - col_s + 1;
+        const int n_lay = p_lay.dim(2);
+        const int n_lev = p_lev.dim(2);
+        const int n_gpt = kdist.get_ngpt();
+
+        Gas_concs<TF> gas_concs_subset(gas_concs, col_s, n_col_in);
+
+        Array<TF,2> p_lev_subset = p_lev.subset({{ {col_s, col_e}, {1, n_lev} }});
+
+        Array<TF,2> col_dry_subset({n_col_in, n_lay});
+        if (col_dry.size() == 0)
+            Gas_optics_rrtmgp<TF>::get_col_dry(col_dry_subset, gas_concs_subset.get_vmr("h2o"), p_lev_subset);
+        else
+            col_dry_subset = col_dry.subset({{ {col_s, col_e}, {1, n_lay} }});
+
+        optical_props = std::make_unique<Optical_props_2str<TF>>(n_col_in, n_lay, kdist);
+        toa_src = Array<TF,2>({n_col_in, n_gpt});
+
+        kdist.gas_optics(
+                p_lay.subset({{ {col_s, col_e}, {1, n_lay} }}),
+                p_lev_subset,
+                t_lay.subset({{ {col_s, col_e}, {1, n_lay} }}),
+                gas_concs_subset,
+                optical_props,
+                toa_src,
+                col_dry_subset);
+
+        for (int igpt=1; igpt<=n_gpt; ++igpt)
+            for (int icol=1; icol<=n_col_in; ++icol)
+                toa_src({icol, igpt}) *= tsi_scaling({icol+col_s-1});
+
+        if (switch_cloud_optics)
+        {
+            Optical_props_2str<TF> cloud_optical_props(n_col_in, n_lay, *cloud_optics);
+
+            cloud_optics->cloud_optics(
+                    lwp.subset({{ {col_s, col_e}, {1, n_lay} }}),
+                    iwp.subset({{ {col_s, col_e}, {1, n_lay} }}),
+                    rel.subset({{ {col_s, col_e}, {1, n_lay} }}),
+                    rei.subset({{ {col_s, col_e}, {1, n_lay} }}),
+                    cloud_optical_props);
+
+            cloud_optical_props.delta_scale();
+
+            add_to(dynamic_cast<Optical_props_2str<TF>&>(*optical_props), cloud_optical_props);
+        }
+    }
+
+    // Copy the data of a stage into the container of the next stage, if that has another precision.
+    // If the precisions are equal, the overloads below pass the data on without a copy.
+    template<typename TO, typename FROM>
+    const Array<TO,3>& to_precision(const Array<FROM,3>& in, Array<TO,3>& out)
+    {
+        std::copy(in.v().begin(), in.v().end(), out.v().begin());
+        return out;
+    }
+
+    template<typename TF>
+    const Array<TF,3>& to_precision(const Array<TF,3>& in, Array<TF,3>&)
+    {
+        return in;
+    }
+
+    template<typename TO, typename FROM>
+    const std::unique_ptr<Optical_props_arry<TO>>& to_precision(
+            const std::unique_ptr<Optical_props_arry<FROM>>& in, std::unique_ptr<Optical_props_arry<TO>>& out)
+    {
+        to_precision(in->get_tau(), out->get_tau());
+        if (dynamic_cast<const Optical_props_2str<FROM>*>(in.get()))
+        {
+            to_precision(in->get_ssa(), out->get_ssa());
+            to_precision(in->get_g  (), out->get_g  ());
+        }
+        return out;
+    }
+
+    template<typename TF>
+    const std::unique_ptr<Optical_props_arry<TF>>& to_precision(
+            const std::unique_ptr<Optical_props_arry<TF>>& in, std::unique_ptr<Optical_props_arry<TF>>&)
+    {
+        return in;
+    }
+
+    template<typename TO, typename FROM>
+    const Source_func_lw<TO>& to_precision(
+            const std::unique_ptr<Source_func_lw<FROM>>& in, std::unique_ptr<Source_func_lw<TO>>& out)
+    {
+        std::copy(in->get_sfc_source().v().begin(), in->get_sfc_source().v().end(), out->get_sfc_source().v().begin());
+        std::copy(in->get_sfc_source_jac().v().begin(), in->get_sfc_source_jac().v().end(), out->get_sfc_source_jac().v().begin());
+        to_precision(in->get_lay_source(), out->get_lay_source());
+        if (in->lev_source_is_split())
+        {
+            out->split_lev_source();
+            to_precision(in->get_lev_source_inc(), out->get_lev_source_inc());
+            to_precision(in->get_lev_source_dec(), out->get_lev_source_dec());
+        }
+        else
+        {
+            to_precision(in->get_lev_source(), out->get_lev_source());
+            to_precision(in->get_pfrac(), out->get_pfrac());
+        }
+        return *out;
+    }
+
+    template<typename TF>
+    const Source_func_lw<TF>& to_precision(
+            const std::unique_ptr<Source_func_lw<TF>>& in, std::unique_ptr<Source_func_lw<TF>>&)
+    {
+        return *in;
+    }
+
     std::vector<std::string> get_variable_string(
             const std::string& var_name,
             std::vector<int> i_count,
@@ -118,229 +303,233 @@ namespace
                     input_nc);
         }
     }
+}
 
-    template<typename TF>
-    Gas_optics_rrtmgp<TF> load_and_init_gas_optics_rrtmgp(
-            const Gas_concs<TF>& gas_concs,
-            const std::string& coef_file)
+// Load the RRTMGP gas optics from a coefficient file.
+template<typename TF>
+Gas_optics_rrtmgp<TF> load_and_init_gas_optics_rrtmgp(
+        const Gas_concs<TF>& gas_concs,
+        const std::string& coef_file)
+{
+    // READ THE COEFFICIENTS FOR THE OPTICAL SOLVER.
+    Netcdf_file coef_nc(coef_file, Netcdf_mode::Read);
+
+    // Read k-distribution information.
+    int n_temps = coef_nc.get_dimension_size("temperature");
+    int n_press = coef_nc.get_dimension_size("pressure");
+    int n_absorbers = coef_nc.get_dimension_size("absorber");
+
+    // CvH: I hardcode the value to 32 now, because coef files
+    // CvH: changed dimension name inconsistently.
+    // int n_char = coef_nc.get_dimension_size("string_len");
+    constexpr int n_char = 32;
+
+    int n_minorabsorbers = coef_nc.get_dimension_size("minor_absorber");
+    int n_extabsorbers = coef_nc.get_dimension_size("absorber_ext");
+    int n_mixingfracs = coef_nc.get_dimension_size("mixing_fraction");
+    int n_layers = coef_nc.get_dimension_size("atmos_layer");
+    int n_bnds = coef_nc.get_dimension_size("bnd");
+    int n_gpts = coef_nc.get_dimension_size("gpt");
+    int n_pairs = coef_nc.get_dimension_size("pair");
+    int n_minor_absorber_intervals_lower = coef_nc.get_dimension_size("minor_absorber_intervals_lower");
+    int n_minor_absorber_intervals_upper = coef_nc.get_dimension_size("minor_absorber_intervals_upper");
+    int n_contributors_lower = coef_nc.get_dimension_size("contributors_lower");
+    int n_contributors_upper = coef_nc.get_dimension_size("contributors_upper");
+
+    // Read gas names.
+    Array<std::string,1> gas_names(
+            get_variable_string("gas_names", {n_absorbers}, coef_nc, n_char, true), {n_absorbers});
+
+    Array<int,3> key_species(
+            coef_nc.get_variable<int>("key_species", {n_bnds, n_layers, 2}),
+            {2, n_layers, n_bnds});
+    Array<TF,2> band_lims(coef_nc.get_variable<TF>("bnd_limits_wavenumber", {n_bnds, 2}), {2, n_bnds});
+    Array<int,2> band2gpt(coef_nc.get_variable<int>("bnd_limits_gpt", {n_bnds, 2}), {2, n_bnds});
+    Array<TF,1> press_ref(coef_nc.get_variable<TF>("press_ref", {n_press}), {n_press});
+    Array<TF,1> temp_ref(coef_nc.get_variable<TF>("temp_ref", {n_temps}), {n_temps});
+
+    TF temp_ref_p = coef_nc.get_variable<TF>("absorption_coefficient_ref_P");
+    TF temp_ref_t = coef_nc.get_variable<TF>("absorption_coefficient_ref_T");
+    TF press_ref_trop = coef_nc.get_variable<TF>("press_ref_trop");
+
+    Array<TF,3> kminor_lower(
+            coef_nc.get_variable<TF>("kminor_lower", {n_temps, n_mixingfracs, n_contributors_lower}),
+            {n_contributors_lower, n_mixingfracs, n_temps});
+    Array<TF,3> kminor_upper(
+            coef_nc.get_variable<TF>("kminor_upper", {n_temps, n_mixingfracs, n_contributors_upper}),
+            {n_contributors_upper, n_mixingfracs, n_temps});
+
+    Array<std::string,1> gas_minor(get_variable_string("gas_minor", {n_minorabsorbers}, coef_nc, n_char),
+                                   {n_minorabsorbers});
+
+    Array<std::string,1> identifier_minor(
+            get_variable_string("identifier_minor", {n_minorabsorbers}, coef_nc, n_char), {n_minorabsorbers});
+
+    Array<std::string,1> minor_gases_lower(
+            get_variable_string("minor_gases_lower", {n_minor_absorber_intervals_lower}, coef_nc, n_char),
+            {n_minor_absorber_intervals_lower});
+    Array<std::string,1> minor_gases_upper(
+            get_variable_string("minor_gases_upper", {n_minor_absorber_intervals_upper}, coef_nc, n_char),
+            {n_minor_absorber_intervals_upper});
+
+    Array<int,2> minor_limits_gpt_lower(
+            coef_nc.get_variable<int>("minor_limits_gpt_lower", {n_minor_absorber_intervals_lower, n_pairs}),
+            {n_pairs, n_minor_absorber_intervals_lower});
+    Array<int,2> minor_limits_gpt_upper(
+            coef_nc.get_variable<int>("minor_limits_gpt_upper", {n_minor_absorber_intervals_upper, n_pairs}),
+            {n_pairs, n_minor_absorber_intervals_upper});
+
+    Array<BOOL_TYPE,1> minor_scales_with_density_lower(
+            coef_nc.get_variable<BOOL_TYPE>("minor_scales_with_density_lower", {n_minor_absorber_intervals_lower}),
+            {n_minor_absorber_intervals_lower});
+    Array<BOOL_TYPE,1> minor_scales_with_density_upper(
+            coef_nc.get_variable<BOOL_TYPE>("minor_scales_with_density_upper", {n_minor_absorber_intervals_upper}),
+            {n_minor_absorber_intervals_upper});
+
+    Array<BOOL_TYPE,1> scale_by_complement_lower(
+            coef_nc.get_variable<BOOL_TYPE>("scale_by_complement_lower", {n_minor_absorber_intervals_lower}),
+            {n_minor_absorber_intervals_lower});
+    Array<BOOL_TYPE,1> scale_by_complement_upper(
+            coef_nc.get_variable<BOOL_TYPE>("scale_by_complement_upper", {n_minor_absorber_intervals_upper}),
+            {n_minor_absorber_intervals_upper});
+
+    Array<std::string,1> scaling_gas_lower(
+            get_variable_string("scaling_gas_lower", {n_minor_absorber_intervals_lower}, coef_nc, n_char),
+            {n_minor_absorber_intervals_lower});
+    Array<std::string,1> scaling_gas_upper(
+            get_variable_string("scaling_gas_upper", {n_minor_absorber_intervals_upper}, coef_nc, n_char),
+            {n_minor_absorber_intervals_upper});
+
+    Array<int,1> kminor_start_lower(
+            coef_nc.get_variable<int>("kminor_start_lower", {n_minor_absorber_intervals_lower}),
+            {n_minor_absorber_intervals_lower});
+    Array<int,1> kminor_start_upper(
+            coef_nc.get_variable<int>("kminor_start_upper", {n_minor_absorber_intervals_upper}),
+            {n_minor_absorber_intervals_upper});
+
+    Array<TF,3> vmr_ref(
+            coef_nc.get_variable<TF>("vmr_ref", {n_temps, n_extabsorbers, n_layers}),
+            {n_layers, n_extabsorbers, n_temps});
+
+    Array<TF,4> kmajor(
+            coef_nc.get_variable<TF>("kmajor", {n_temps, n_press+1, n_mixingfracs, n_gpts}),
+            {n_gpts, n_mixingfracs, n_press+1, n_temps});
+
+    // Keep the size at zero, if it does not exist.
+    Array<TF,3> rayl_lower;
+    Array<TF,3> rayl_upper;
+
+    if (coef_nc.variable_exists("rayl_lower"))
     {
-        // READ THE COEFFICIENTS FOR THE OPTICAL SOLVER.
-        Netcdf_file coef_nc(coef_file, Netcdf_mode::Read);
-
-        // Read k-distribution information.
-        int n_temps = coef_nc.get_dimension_size("temperature");
-        int n_press = coef_nc.get_dimension_size("pressure");
-        int n_absorbers = coef_nc.get_dimension_size("absorber");
-
-        // CvH: I hardcode the value to 32 now, because coef files
-        // CvH: changed dimension name inconsistently.
-        // int n_char = coef_nc.get_dimension_size("string_len");
-        constexpr int n_char = 32;
-
-        int n_minorabsorbers = coef_nc.get_dimension_size("minor_absorber");
-        int n_extabsorbers = coef_nc.get_dimension_size("absorber_ext");
-        int n_mixingfracs = coef_nc.get_dimension_size("mixing_fraction");
-        int n_layers = coef_nc.get_dimension_size("atmos_layer");
-        int n_bnds = coef_nc.get_dimension_size("bnd");
-        int n_gpts = coef_nc.get_dimension_size("gpt");
-        int n_pairs = coef_nc.get_dimension_size("pair");
-        int n_minor_absorber_intervals_lower = coef_nc.get_dimension_size("minor_absorber_intervals_lower");
-        int n_minor_absorber_intervals_upper = coef_nc.get_dimension_size("minor_absorber_intervals_upper");
-        int n_contributors_lower = coef_nc.get_dimension_size("contributors_lower");
-        int n_contributors_upper = coef_nc.get_dimension_size("contributors_upper");
+        rayl_lower.set_dims({n_gpts, n_mixingfracs, n_temps});
+        rayl_upper.set_dims({n_gpts, n_mixingfracs, n_temps});
+        rayl_lower = coef_nc.get_variable<TF>("rayl_lower", {n_temps, n_mixingfracs, n_gpts});
+        rayl_upper = coef_nc.get_variable<TF>("rayl_upper", {n_temps, n_mixingfracs, n_gpts});
+    }
 
-        // Read gas names.
-        Array<std::string,1> gas_names(
-                get_variable_string("gas_names", {n_absorbers}, coef_nc, n_char, true), {n_absorbers});
+    // Is it really LW if so read these variables as well.
+    if (coef_nc.variable_exists("totplnk"))
+    {
+        int n_internal_sourcetemps = coef_nc.get_dimension_size("temperature_Planck");
 
-        Array<int,3> key_species(
-                coef_nc.get_variable<int>("key_species", {n_bnds, n_layers, 2}),
-                {2, n_layers, n_bnds});
-        Array<TF,2> band_lims(coef_nc.get_variable<TF>("bnd_limits_wavenumber", {n_bnds, 2}), {2, n_bnds});
-        Array<int,2> band2gpt(coef_nc.get_variable<int>("bnd_limits_gpt", {n_bnds, 2}), {2, n_bnds});
-        Array<TF,1> press_ref(coef_nc.get_variable<TF>("press_ref", {n_press}), {n_press});
-        Array<TF,1> temp_ref(coef_nc.get_variable<TF>("temp_ref", {n_temps}), {n_temps});
-
-        TF temp_ref_p = coef_nc.get_variable<TF>("absorption_coefficient_ref_P");
-        TF temp_ref_t = coef_nc.get_variable<TF>("absorption_coefficient_ref_T");
-        TF press_ref_trop = coef_nc.get_variable<TF>("press_ref_trop");
-
-        Array<TF,3> kminor_lower(
-                coef_nc.get_variable<TF>("kminor_lower", {n_temps, n_mixingfracs, n_contributors_lower}),
-                {n_contributors_lower, n_mixingfracs, n_temps});
-        Array<TF,3> kminor_upper(
-                coef_nc.get_variable<TF>("kminor_upper", {n_temps, n_mixingfracs, n_contributors_upper}),
-                {n_contributors_upper, n_mixingfracs, n_temps});
-
-        Array<std::string,1> gas_minor(get_variable_string("gas_minor", {n_minorabsorbers}, coef_nc, n_char),
-                                       {n_minorabsorbers});
-
-        Array<std::string,1> identifier_minor(
-                get_variable_string("identifier_minor", {n_minorabsorbers}, coef_nc, n_char), {n_minorabsorbers});
-
-        Array<std::string,1> minor_gases_lower(
-                get_variable_string("minor_gases_lower", {n_minor_absorber_intervals_lower}, coef_nc, n_char),
-                {n_minor_absorber_intervals_lower});
-        Array<std::string,1> minor_gases_upper(
-                get_variable_string("minor_gases_upper", {n_minor_absorber_intervals_upper}, coef_nc, n_char),
-                {n_minor_absorber_intervals_upper});
-
-        Array<int,2> minor_limits_gpt_lower(
-                coef_nc.get_variable<int>("minor_limits_gpt_lower", {n_minor_absorber_intervals_lower, n_pairs}),
-                {n_pairs, n_minor_absorber_intervals_lower});
-        Array<int,2> minor_limits_gpt_upper(
-                coef_nc.get_variable<int>("minor_limits_gpt_upper", {n_minor_absorber_intervals_upper, n_pairs}),
-                {n_pairs, n_minor_absorber_intervals_upper});
-
-        Array<BOOL_TYPE,1> minor_scales_with_density_lower(
-                coef_nc.get_variable<BOOL_TYPE>("minor_scales_with_density_lower", {n_minor_absorber_intervals_lower}),
-                {n_minor_absorber_intervals_lower});
-        Array<BOOL_TYPE,1> minor_scales_with_density_upper(
-                coef_nc.get_variable<BOOL_TYPE>("minor_scales_with_density_upper", {n_minor_absorber_intervals_upper}),
-                {n_minor_absorber_intervals_upper});
-
-        Array<BOOL_TYPE,1> scale_by_complement_lower(
-                coef_nc.get_variable<BOOL_TYPE>("scale_by_complement_lower", {n_minor_absorber_intervals_lower}),
-                {n_minor_absorber_intervals_lower});
-        Array<BOOL_TYPE,1> scale_by_complement_upper(
-                coef_nc.get_variable<BOOL_TYPE>("scale_by_complement_upper", {n_minor_absorber_intervals_upper}),
-                {n_minor_absorber_intervals_upper});
-
-        Array<std::string,1> scaling_gas_lower(
-                get_variable_string("scaling_gas_lower", {n_minor_absorber_intervals_lower}, coef_nc, n_char),
-                {n_minor_absorber_intervals_lower});
-        Array<std::string,1> scaling_gas_upper(
-                get_variable_string("scaling_gas_upper", {n_minor_absorber_intervals_upper}, coef_nc, n_char),
-                {n_minor_absorber_intervals_upper});
-
-        Array<int,1> kminor_start_lower(
-                coef_nc.get_variable<int>("kminor_start_lower", {n_minor_absorber_intervals_lower}),
-                {n_minor_absorber_intervals_lower});
-        Array<int,1> kminor_start_upper(
-                coef_nc.get_variable<int>("kminor_start_upper", {n_minor_absorber_intervals_upper}),
-                {n_minor_absorber_intervals_upper});
-
-        Array<TF,3> vmr_ref(
-                coef_nc.get_variable<TF>("vmr_ref", {n_temps, n_extabsorbers, n_layers}),
-                {n_layers, n_extabsorbers, n_temps});
-
-        Array<TF,4> kmajor(
-                coef_nc.get_variable<TF>("kmajor", {n_temps, n_press+1, n_mixingfracs, n_gpts}),
+        Array<TF,2> totplnk(
+                coef_nc.get_variable<TF>( "totplnk", {n_bnds, n_internal_sourcetemps}),
+                {n_internal_sourcetemps, n_bnds});
+        Array<TF,4> planck_frac(
+                coef_nc.get_variable<TF>("plank_fraction", {n_temps, n_press+1, n_mixingfracs, n_gpts}),
                 {n_gpts, n_mixingfracs, n_press+1, n_temps});
 
-        // Keep the size at zero, if it does not exist.
-        Array<TF,3> rayl_lower;
-        Array<TF,3> rayl_upper;
-
-        if (coef_nc.variable_exists("rayl_lower"))
-        {
-            rayl_lower.set_dims({n_gpts, n_mixingfracs, n_temps});
-            rayl_upper.set_dims({n_gpts, n_mixingfracs, n_temps});
-            rayl_lower = coef_nc.get_variable<TF>("rayl_lower", {n_temps, n_mixingfracs, n_gpts});
-            rayl_upper = coef_nc.get_variable<TF>("rayl_upper", {n_temps, n_mixingfracs, n_gpts});
-        }
-
-        // Is it really LW if so read these variables as well.
-        if (coef_nc.variable_exists("totplnk"))
-        {
-            int n_internal_sourcetemps = coef_nc.get_dimension_size("temperature_Planck");
-
-            Array<TF,2> totplnk(
-                    coef_nc.get_variable<TF>( "totplnk", {n_bnds, n_internal_sourcetemps}),
-                    {n_internal_sourcetemps, n_bnds});
-            Array<TF,4> planck_frac(
-                    coef_nc.get_variable<TF>("plank_fraction", {n_temps, n_press+1, n_mixingfracs, n_gpts}),
-                    {n_gpts, n_mixingfracs, n_press+1, n_temps});
-
-            // Construct the k-distribution.
-            return Gas_optics_rrtmgp<TF>(
-                    gas_concs,
-                    gas_names,
-                    key_species,
-                    band2gpt,
-                    band_lims,
-                    press_ref,
-                    press_ref_trop,
-                    temp_ref,
-                    temp_ref_p,
-                    temp_ref_t,
-                    vmr_ref,
-                    kmajor,
-                    kminor_lower,
-                    kminor_upper,
-                    gas_minor,
-                    identifier_minor,
-                    minor_gases_lower,
-                    minor_gases_upper,
-                    minor_limits_gpt_lower,
-                    minor_limits_gpt_upper,
-                    minor_scales_with_density_lower,
-                    minor_scales_with_density_upper,
-                    scaling_gas_lower,
-                    scaling_gas_upper,
-                    scale_by_complement_lower,
-                    scale_by_complement_upper,
-                    kminor_start_lower,
-                    kminor_start_upper,
-                    totplnk,
-                    planck_frac,
-                    rayl_lower,
-                    rayl_upper);
-        }
-        else
-        {
-            Array<TF,1> solar_src_quiet(
-                    coef_nc.get_variable<TF>("solar_source_quiet", {n_gpts}), {n_gpts});
-            Array<TF,1> solar_src_facular(
-                    coef_nc.get_variable<TF>("solar_source_facular", {n_gpts}), {n_gpts});
-            Array<TF,1> solar_src_sunspot(
-                    coef_nc.get_variable<TF>("solar_source_sunspot", {n_gpts}), {n_gpts});
-
-            TF tsi = coef_nc.get_variable<TF>("tsi_default");
-            TF mg_index = coef_nc.get_variable<TF>("mg_default");
-            TF sb_index = coef_nc.get_variable<TF>("sb_default");
-
-            return Gas_optics_rrtmgp<TF>(
-                    gas_concs,
-                    gas_names,
-                    key_species,
-                    band2gpt,
-                    band_lims,
-                    press_ref,
-                    press_ref_trop,
-                    temp_ref,
-                    temp_ref_p,
-                    temp_ref_t,
-                    vmr_ref,
-                    kmajor,
-                    kminor_lower,
-                    kminor_upper,
-                    gas_minor,
-                    identifier_minor,
-                    minor_gases_lower,
-                    minor_gases_upper,
-                    minor_limits_gpt_lower,
-                    minor_limits_gpt_upper,
-                    minor_scales_with_density_lower,
-                    minor_scales_with_density_upper,
-                    scaling_gas_lower,
-                    scaling_gas_upper,
-                    scale_by_complement_lower,
-                    scale_by_complement_upper,
-                    kminor_start_lower,
-                    kminor_start_upper,
-                    solar_src_quiet,
-                    solar_src_facular,
-                    solar_src_sunspot,
-                    tsi,
-                    mg_index,
-                    sb_index,
-                    rayl_lower,
-                    rayl_upper);
-        }
-        // End reading of k-distribution.
+        // Construct the k-distribution.
+        return Gas_optics_rrtmgp<TF>(
+                gas_concs,
+                gas_names,
+                key_species,
+                band2gpt,
+                band_lims,
+                press_ref,
+                press_ref_trop,
+                temp_ref,
+                temp_ref_p,
+                temp_ref_t,
+                vmr_ref,
+                kmajor,
+                kminor_lower,
+                kminor_upper,
+                gas_minor,
+                identifier_minor,
+                minor_gases_lower,
+                minor_gases_upper,
+                minor_limits_gpt_lower,
+                minor_limits_gpt_upper,
+                minor_scales_with_density_lower,
+                minor_scales_with_density_upper,
+                scaling_gas_lower,
+                scaling_gas_upper,
+                scale_by_complement_lower,
+                scale_by_complement_upper,
+                kminor_start_lower,
+                kminor_start_upper,
+                totplnk,
+                planck_frac,
+                rayl_lower,
+                rayl_upper);
     }
+    else
+    {
+        Array<TF,1> solar_src_quiet(
+                coef_nc.get_variable<TF>("solar_source_quiet", {n_gpts}), {n_gpts});
+        Array<TF,1> solar_src_facular(
+                coef_nc.get_variable<TF>("solar_source_facular", {n_gpts}), {n_gpts});
+        Array<TF,1> solar_src_sunspot(
+                coef_nc.get_variable<TF>("solar_source_sunspot", {n_gpts}), {n_gpts});
+
+        TF tsi = coef_nc.get_variable<TF>("tsi_default");
+        TF mg_index = coef_nc.get_variable<TF>("mg_default");
+        TF sb_index = coef_nc.get_variable<TF>("sb_default");
+
+        return Gas_optics_rrtmgp<TF>(
+                gas_concs,
+                gas_names,
+                key_species,
+                band2gpt,
+                band_lims,
+                press_ref,
+                press_ref_trop,
+                temp_ref,
+                temp_ref_p,
+                temp_ref_t,
+                vmr_ref,
+                kmajor,
+                kminor_lower,
+                kminor_upper,
+                gas_minor,
+                identifier_minor,
+                minor_gases_lower,
+                minor_gases_upper,
+                minor_limits_gpt_lower,
+                minor_limits_gpt_upper,
+                minor_scales_with_density_lower,
+                minor_scales_with_density_upper,
+                scaling_gas_lower,
+                scaling_gas_upper,
+                scale_by_complement_lower,
+                scale_by_complement_upper,
+                kminor_start_lower,
+                kminor_start_upper,
+                solar_src_quiet,
+                solar_src_facular,
+                solar_src_sunspot,
+                tsi,
+                mg_index,
+                sb_index,
+                rayl_lower,
+                rayl_upper);
+    }
+    // End reading of k-distribution.
+}
 
+namespace
+{
     template<typename TF>
     Cloud_optics<TF> load_and_init_cloud_optics(
             const std::string& coef_file)
@@ -386,6 +575,172 @@ namespace
                 lut_extliq, lut_ssaliq, lut_asyliq,
                 lut_extice, lut_ssaice, lut_asyice);
     }
+
+    template<typename TF>
+    std::unique_ptr<Gas_optics<TF>> load_and_init_gas_optics(
+            const Gas_concs<TF>& gas_concs,
+            const std::string& file_name_gas,
+            const std::string& file_name_weights,
+            Netcdf_file& input_nc,
+            const bool sw_nn_gas_optics,
+            const bool sw_hybrid_gas_optics)
+    {
+        if (sw_hybrid_gas_optics)
+            return std::make_unique<Gas_optics_hybrid<TF>>(
+                    std::make_unique<Gas_optics_nn<TF>>(
+                        load_and_init_gas_optics_nn<TF>(gas_concs, file_name_gas, file_name_weights, input_nc)),
+                    std::make_unique<Gas_optics_rrtmgp<TF>>(
+                        load_and_init_gas_optics_rrtmgp<TF>(gas_concs, file_name_gas)),
+                    n_sigma_hybrid);
+        else if (sw_nn_gas_optics)
+            return std::make_unique<Gas_optics_nn<TF>>(
+                    load_and_init_gas_optics_nn<TF>(gas_concs, file_name_gas, file_name_weights, input_nc));
+        else
+            return std::make_unique<Gas_optics_rrtmgp<TF>>(
+                    load_and_init_gas_optics_rrtmgp<TF>(gas_concs, file_name_gas));
+    }
+
+    // Input of the change metric of the incremental solvers. A column has changed once an element
+    // deviates more than tol_abs + tol_rel*|x_ref| from the reference x_ref.
+    template<typename TF>
+    struct Change_input
+    {
+        Array_view<TF,2> data;
+        bool cols_in_dim2; // The columns are in the second dimension, as in the surface properties.
+        TF tol_abs;
+        TF tol_rel;
+    };
+
+    template<typename TF>
+    Array_view<TF,2> as_2d(const Array_view<TF,1>& data)
+    {
+        return Array_view<TF,2>(
+                const_cast<TF*>(data.ptr()), {data.dim(1), 1}, {data.get_strides()[0], data.size()});
+    }
+
+    // Return the columns that have to be recomputed, and age the others. All columns are recomputed
+    // if there is no reference yet. A spread input (a single column) that changed affects all columns.
+    template<typename TF>
+    std::vector<int> changed_columns(
+            const std::vector<Change_input<TF>>& inputs,
+            const std::vector<Array<TF,2>>& reference,
+            std::vector<int>& age, const int max_age, const int n_col)
+    {
+        bool recompute_all = (reference.size() != inputs.size()) || (int(age.size()) != n_col);
+        for (size_t i=0; !recompute_all && i<inputs.size(); ++i)
+            recompute_all = (reference[i].get_dims() != inputs[i].data.get_dims());
+
+        std::vector<char> changed(n_col, recompute_all);
+
+        if (!recompute_all && max_age > 0)
+            for (int icol=0; icol<n_col; ++icol)
+                changed[icol] = (age[icol] >= max_age);
+
+        for (size_t i=0; !recompute_all && i<inputs.size(); ++i)
+        {
+            const Change_input<TF>& input = inputs[i];
+            const Array<TF,2>& ref = reference[i];
+            const int n_col_in = input.cols_in_dim2 ? input.data.dim(2) : input.data.dim(1);
+
+            for (int j=1; j<=input.data.dim(2); ++j)
+                for (int k=1; k<=input.data.dim(1); ++k)
+                {
+                    const TF x_ref = ref({k, j});
+                    if (std::abs(input.data({k, j}) - x_ref) > input.tol_abs + input.tol_rel*std::abs(x_ref))
+                    {
+                        if (n_col_in == 1)
+                            recompute_all = true;
+                        else
+                            changed[(input.cols_in_dim2 ? j : k) - 1] = true;
+                    }
+                }
+        }
+
+        if (recompute_all)
+            age.assign(n_col, 0);
+
+        std::vector<int> cols;
+        for (int icol=1; icol<=n_col; ++icol)
+        {
+            if (recompute_all || changed[icol-1])
+                cols.push_back(icol);
+            else
+                ++age[icol-1];
+        }
+
+        return cols;
+    }
+
+    // Store the inputs of the recomputed columns as their new reference.
+    template<typename TF>
+    void update_reference(
+            const std::vector<Change_input<TF>>& inputs,
+            std::vector<Array<TF,2>>& reference,
+            std::vector<int>& age, const std::vector<int>& cols, const int n_col)
+    {
+        if (reference.size() != inputs.size() || int(cols.size()) == n_col)
+        {
+            reference.clear();
+            for (const Change_input<TF>& input : inputs)
+                reference.push_back(input.data.subset({{ {1, input.data.dim(1)}, {1, input.data.dim(2)} }}));
+        }
+        else
+        {
+            for (size_t i=0; i<inputs.size(); ++i)
+            {
+                const Change_input<TF>& input = inputs[i];
+                Array<TF,2>& ref = reference[i];
+
+                // Spread inputs only change together with all columns.
+                if ((input.cols_in_dim2 ? input.data.dim(2) : input.data.dim(1)) == 1)
+                    continue;
+
+                for (const int icol : cols)
+                {
+                    if (input.cols_in_dim2)
+                        for (int k=1; k<=input.data.dim(1); ++k)
+                            ref({k, icol}) = input.data({k, icol});
+                    else
+                        for (int j=1; j<=input.data.dim(2); ++j)
+                            ref({icol, j}) = input.data({icol, j});
+                }
+            }
+        }
+
+        for (const int icol : cols)
+            age[icol-1] = 0;
+    }
+
+    template<typename TF>
+    void copy_fluxes(Array_view<TF,2> out, const Array<TF,2>& in)
+    {
+        for (int ilev=1; ilev<=in.dim(2); ++ilev)
+            for (int icol=1; icol<=in.dim(1); ++icol)
+                out({icol, ilev}) = in({icol, ilev});
+    }
+
+    template<typename TF>
+    void add_change_inputs_cloud(
+            std::vector<Change_input<TF>>& inputs,
+            const Array_view<TF,2>& lwp, const Array_view<TF,2>& iwp,
+            const Array_view<TF,2>& rel, const Array_view<TF,2>& rei,
+            const TF tol_abs)
+    {
+        for (const Array_view<TF,2>* data : {&lwp, &iwp, &rel, &rei})
+            inputs.push_back({*data, false, tol_abs, TF(0.)});
+    }
+
+    // Array for the results of the unique columns of an output, empty if the output is not requested.
+    template<typename TF, int N>
+    Array<TF,N> unique_output(const Array_view<TF,N>& out, const int n_unique)
+    {
+        if (out.is_empty())
+            return Array<TF,N>();
+
+        std::array<int,N> dims = out.get_dims();
+        dims[0] = n_unique;
+        return Array<TF,N>(dims);
+    }
 }
 
 template<typename TF>
@@ -396,25 +751,56 @@ Radiation_solver_longwave<TF>::Radiation_solver_longwave(
         const std::string& file_name_weights,
         Netcdf_file& input_nc,
         const bool sw_cloud_optics,
-        const bool sw_nn_gas_optics)
+        const bool sw_nn_gas_optics,
+        const bool sw_hybrid_gas_optics,
+        const bool sw_float_storage)
 {
     // Construct the gas optics classes for the solver.
-    if (sw_nn_gas_optics)
-    {
-        this->kdist = std::make_unique<Gas_optics_nn<TF>>(
-                load_and_init_gas_optics_nn<TF>(gas_concs, file_name_gas, file_name_weights, input_nc));
-    }
-    else
-    {
-        this->kdist = std::make_unique<Gas_optics_rrtmgp<TF>>(
-                load_and_init_gas_optics_rrtmgp<TF>(gas_concs, file_name_gas));
-    }
+    this->kdist = load_and_init_gas_optics<TF>(
+            gas_concs, file_name_gas, file_name_weights, input_nc,
+            sw_nn_gas_optics, sw_hybrid_gas_optics);
 
     if (sw_cloud_optics)
-    {
         this->cloud_optics = std::make_unique<Cloud_optics<TF>>(
                 load_and_init_cloud_optics<TF>(file_name_cloud));
-    }
+
+    // Single precision storage only differs from the solve in TF if TF is double.
+    this->sw_float_storage = sw_float_storage && !std::is_same<TF, float>::value;
+}
+
+template<typename TF>
+TF Radiation_solver_longwave<TF>::get_nn_column_fraction() const
+{
+    return nn_column_fraction(this->kdist);
+}
+
+template<typename TF>
+const Gas_optics<TF>& Radiation_solver_longwave<TF>::get_gas_optics() const
+{
+    return *this->kdist;
+}
+
+template<typename TF>
+void Radiation_solver_longwave<TF>::set_n_col_block(const int n_col_block)
+{
+    if (n_col_block < 1)
+        throw std::runtime_error("The number of columns per block should be at least one");
+    this->n_col_block = n_col_block;
+}
+
+template<typename TF>
+void Radiation_solver_longwave<TF>::set_thread_pool(Thread_pool* thread_pool)
+{
+    set_nn_thread_pool(this->kdist, thread_pool);
+}
+
+template<typename TF>
+void Radiation_solver_longwave<TF>::set_column_dedup(const bool sw_column_dedup, const TF quantization)
+{
+    if (quantization < TF(0.))
+        throw std::runtime_error("The quantization of the column deduplication cannot be negative");
+    this->sw_column_dedup = sw_column_dedup;
+    this->dedup_quantization = quantization;
 }
 
 template<typename TF>
@@ -424,16 +810,182 @@ void Radiation_solver_longwave<TF>::solve(
         const bool switch_output_optical,
         const bool switch_output_bnd_fluxes,
         const Gas_concs<TF>& gas_concs,
-        const Array<TF,2>& p_lay, const Array<TF,2>& p_lev,
-        const Array<TF,2>& t_lay, const Array<TF,2>& t_lev,
-        const Array<TF,2>& col_dry,
-        const Array<TF,1>& t_sfc, const Array<TF,2>& emis_sfc,
-        const Array<TF,2>& lwp, const Array<TF,2>& iwp,
-        const Array<TF,2>& rel, const Array<TF,2>& rei,
-        Array<TF,3>& tau, Array<TF,3>& lay_source,
-        Array<TF,3>& lev_source_inc, Array<TF,3>& lev_source_dec, Array<TF,2>& sfc_source,
-        Array<TF,2>& lw_flux_up, Array<TF,2>& lw_flux_dn, Array<TF,2>& lw_flux_net,
-        Array<TF,3>& lw_bnd_flux_up, Array<TF,3>& lw_bnd_flux_dn, Array<TF,3>& lw_bnd_flux_net) const
+        const Array_view<TF,2>& p_lay, const Array_view<TF,2>& p_lev,
+        const Array_view<TF,2>& t_lay, const Array_view<TF,2>& t_lev,
+        const Array_view<TF,2>& col_dry,
+        const Array_view<TF,1>& t_sfc, const Array_view<TF,2>& emis_sfc,
+        const Array_view<TF,2>& lwp, const Array_view<TF,2>& iwp,
+        const Array_view<TF,2>& rel, const Array_view<TF,2>& rei,
+        Array_view<TF,3> tau, Array_view<TF,3> lay_source,
+        Array_view<TF,3> lev_source_inc, Array_view<TF,3> lev_source_dec, Array_view<TF,2> sfc_source,
+        Array_view<TF,2> lw_flux_up, Array_view<TF,2> lw_flux_dn, Array_view<TF,2> lw_flux_net,
+        Array_view<TF,3> lw_bnd_flux_up, Array_view<TF,3> lw_bnd_flux_dn, Array_view<TF,3> lw_bnd_flux_net,
+        Array_view<TF,2> lw_flux_up_jac,
+        Array_view<TF,2> lw_flux_up_clear, Array_view<TF,2> lw_flux_dn_clear,
+        Array_view<TF,2> lw_flux_net_clear) const
+{
+    this->dedup_ratio = 1.;
+
+    if (!this->sw_column_dedup)
+    {
+        solve_columns(
+                switch_fluxes, switch_cloud_optics, switch_output_optical, switch_output_bnd_fluxes,
+                gas_concs,
+                p_lay, p_lev, t_lay, t_lev, col_dry, t_sfc, emis_sfc,
+                lwp, iwp, rel, rei,
+                tau, lay_source, lev_source_inc, lev_source_dec, sfc_source,
+                lw_flux_up, lw_flux_dn, lw_flux_net,
+                lw_bnd_flux_up, lw_bnd_flux_dn, lw_bnd_flux_net,
+                lw_flux_up_jac,
+                lw_flux_up_clear, lw_flux_dn_clear, lw_flux_net_clear);
+        return;
+    }
+
+    const int n_col = p_lay.dim(1);
+
+    Column_dedup<TF> dedup(n_col, this->dedup_quantization);
+    dedup.add(gas_concs);
+    dedup.add(p_lay);
+    dedup.add(p_lev);
+    dedup.add(t_lay);
+    dedup.add(t_lev);
+    dedup.add(col_dry);
+    dedup.add(t_sfc);
+    dedup.add_dim2(emis_sfc);
+
+    if (switch_cloud_optics)
+    {
+        dedup.add(lwp);
+        dedup.add(iwp);
+        dedup.add(rel);
+        dedup.add(rei);
+    }
+
+    dedup.find_unique();
+
+    const std::vector<int>& cols = dedup.get_unique_cols();
+    const int n_unique = dedup.get_n_unique();
+
+    Array<TF,3> tau_u = unique_output(tau, n_unique);
+    Array<TF,3> lay_source_u = unique_output(lay_source, n_unique);
+    Array<TF,3> lev_source_inc_u = unique_output(lev_source_inc, n_unique);
+    Array<TF,3> lev_source_dec_u = unique_output(lev_source_dec, n_unique);
+    Array<TF,2> sfc_source_u = unique_output(sfc_source, n_unique);
+    Array<TF,2> lw_flux_up_u = unique_output(lw_flux_up, n_unique);
+    Array<TF,2> lw_flux_dn_u = unique_output(lw_flux_dn, n_unique);
+    Array<TF,2> lw_flux_net_u = unique_output(lw_flux_net, n_unique);
+    Array<TF,3> lw_bnd_flux_up_u = unique_output(lw_bnd_flux_up, n_unique);
+    Array<TF,3> lw_bnd_flux_dn_u = unique_output(lw_bnd_flux_dn, n_unique);
+    Array<TF,3> lw_bnd_flux_net_u = unique_output(lw_bnd_flux_net, n_unique);
+    Array<TF,2> lw_flux_up_jac_u = unique_output(lw_flux_up_jac, n_unique);
+    Array<TF,2> lw_flux_up_clear_u = unique_output(lw_flux_up_clear, n_unique);
+    Array<TF,2> lw_flux_dn_clear_u = unique_output(lw_flux_dn_clear, n_unique);
+    Array<TF,2> lw_flux_net_clear_u = unique_output(lw_flux_net_clear, n_unique);
+
+    using column_kernels::gather;
+
+    solve_columns(
+            switch_fluxes, switch_cloud_optics, switch_output_optical, switch_output_bnd_fluxes,
+            Gas_concs<TF>(gas_concs, cols),
+            gather(p_lay, cols), gather(p_lev, cols),
+            gather(t_lay, cols), gather(t_lev, cols),
+            gather(col_dry, cols),
+            gather(t_sfc, cols), column_kernels::gather_dim2(emis_sfc, cols),
+            gather(lwp, cols), gather(iwp, cols),
+            gather(rel, cols), gather(rei, cols),
+            tau_u, lay_source_u, lev_source_inc_u, lev_source_dec_u, sfc_source_u,
+            lw_flux_up_u, lw_flux_dn_u, lw_flux_net_u,
+            lw_bnd_flux_up_u, lw_bnd_flux_dn_u, lw_bnd_flux_net_u,
+            lw_flux_up_jac_u,
+            lw_flux_up_clear_u, lw_flux_dn_clear_u, lw_flux_net_clear_u);
+
+    dedup.expand(tau, tau_u);
+    dedup.expand(lay_source, lay_source_u);
+    dedup.expand(lev_source_inc, lev_source_inc_u);
+    dedup.expand(lev_source_dec, lev_source_dec_u);
+    dedup.expand(sfc_source, sfc_source_u);
+    dedup.expand(lw_flux_up, lw_flux_up_u);
+    dedup.expand(lw_flux_dn, lw_flux_dn_u);
+    dedup.expand(lw_flux_net, lw_flux_net_u);
+    dedup.expand(lw_bnd_flux_up, lw_bnd_flux_up_u);
+    dedup.expand(lw_bnd_flux_dn, lw_bnd_flux_dn_u);
+    dedup.expand(lw_bnd_flux_net, lw_bnd_flux_net_u);
+    dedup.expand(lw_flux_up_jac, lw_flux_up_jac_u);
+    dedup.expand(lw_flux_up_clear, lw_flux_up_clear_u);
+    dedup.expand(lw_flux_dn_clear, lw_flux_dn_clear_u);
+    dedup.expand(lw_flux_net_clear, lw_flux_net_clear_u);
+
+    this->dedup_ratio = dedup.get_dedup_ratio();
+}
+
+template<typename TF>
+void Radiation_solver_longwave<TF>::solve_columns(
+        const bool switch_fluxes,
+        const bool switch_cloud_optics,
+        const bool switch_output_optical,
+        const bool switch_output_bnd_fluxes,
+        const Gas_concs<TF>& gas_concs,
+        const Array_view<TF,2>& p_lay, const Array_view<TF,2>& p_lev,
+        const Array_view<TF,2>& t_lay, const Array_view<TF,2>& t_lev,
+        const Array_view<TF,2>& col_dry,
+        const Array_view<TF,1>& t_sfc, const Array_view<TF,2>& emis_sfc,
+        const Array_view<TF,2>& lwp, const Array_view<TF,2>& iwp,
+        const Array_view<TF,2>& rel, const Array_view<TF,2>& rei,
+        Array_view<TF,3> tau, Array_view<TF,3> lay_source,
+        Array_view<TF,3> lev_source_inc, Array_view<TF,3> lev_source_dec, Array_view<TF,2> sfc_source,
+        Array_view<TF,2> lw_flux_up, Array_view<TF,2> lw_flux_dn, Array_view<TF,2> lw_flux_net,
+        Array_view<TF,3> lw_bnd_flux_up, Array_view<TF,3> lw_bnd_flux_dn, Array_view<TF,3> lw_bnd_flux_net,
+        Array_view<TF,2> lw_flux_up_jac,
+        Array_view<TF,2> lw_flux_up_clear, Array_view<TF,2> lw_flux_dn_clear,
+        Array_view<TF,2> lw_flux_net_clear) const
+{
+    if (this->sw_float_storage)
+        solve_stored<float>(
+                switch_fluxes, switch_cloud_optics, switch_output_optical, switch_output_bnd_fluxes,
+                gas_concs,
+                p_lay, p_lev, t_lay, t_lev, col_dry, t_sfc, emis_sfc,
+                lwp, iwp, rel, rei,
+                tau, lay_source, lev_source_inc, lev_source_dec, sfc_source,
+                lw_flux_up, lw_flux_dn, lw_flux_net,
+                lw_bnd_flux_up, lw_bnd_flux_dn, lw_bnd_flux_net,
+                lw_flux_up_jac,
+                lw_flux_up_clear, lw_flux_dn_clear, lw_flux_net_clear);
+    else
+        solve_stored<TF>(
+                switch_fluxes, switch_cloud_optics, switch_output_optical, switch_output_bnd_fluxes,
+                gas_concs,
+                p_lay, p_lev, t_lay, t_lev, col_dry, t_sfc, emis_sfc,
+                lwp, iwp, rel, rei,
+                tau, lay_source, lev_source_inc, lev_source_dec, sfc_source,
+                lw_flux_up, lw_flux_dn, lw_flux_net,
+                lw_bnd_flux_up, lw_bnd_flux_dn, lw_bnd_flux_net,
+                lw_flux_up_jac,
+                lw_flux_up_clear, lw_flux_dn_clear, lw_flux_net_clear);
+}
+
+// Solve with the gas and cloud optics in TF. The solver receives the optical properties and sources
+// in TF_store and stores its g-point fluxes in TF_store, which are reduced to broadband fluxes in TF.
+template<typename TF>
+template<typename TF_store>
+void Radiation_solver_longwave<TF>::solve_stored(
+        const bool switch_fluxes,
+        const bool switch_cloud_optics,
+        const bool switch_output_optical,
+        const bool switch_output_bnd_fluxes,
+        const Gas_concs<TF>& gas_concs,
+        const Array_view<TF,2>& p_lay, const Array_view<TF,2>& p_lev,
+        const Array_view<TF,2>& t_lay, const Array_view<TF,2>& t_lev,
+        const Array_view<TF,2>& col_dry,
+        const Array_view<TF,1>& t_sfc, const Array_view<TF,2>& emis_sfc,
+        const Array_view<TF,2>& lwp, const Array_view<TF,2>& iwp,
+        const Array_view<TF,2>& rel, const Array_view<TF,2>& rei,
+        Array_view<TF,3> tau, Array_view<TF,3> lay_source,
+        Array_view<TF,3> lev_source_inc, Array_view<TF,3> lev_source_dec, Array_view<TF,2> sfc_source,
+        Array_view<TF,2> lw_flux_up, Array_view<TF,2> lw_flux_dn, Array_view<TF,2> lw_flux_net,
+        Array_view<TF,3> lw_bnd_flux_up, Array_view<TF,3> lw_bnd_flux_dn, Array_view<TF,3> lw_bnd_flux_net,
+        Array_view<TF,2> lw_flux_up_jac,
+        Array_view<TF,2> lw_flux_up_clear, Array_view<TF,2> lw_flux_dn_clear,
+        Array_view<TF,2> lw_flux_net_clear) const
 {
     const int n_col = p_lay.dim(1);
     const int n_lay = p_lay.dim(2);
@@ -443,7 +995,14 @@ void Radiation_solver_longwave<TF>::solve(
 
     const BOOL_TYPE top_at_1 = p_lay({1, 1}) < p_lay({1, n_lay});
 
-    constexpr int n_col_block = 8;
+    const int n_col_block = this->n_col_block;
+
+    // Spectral discretization in the precision of the solver.
+    const Optical_props<TF_store> spectral_disc_store(
+            convert_array<TF_store>(this->kdist->get_band_lims_wavenumber()), this->kdist->get_band_lims_gpoint());
+
+    // The containers in TF_store are only needed if the precision of the solver differs.
+    constexpr bool store_copy = !std::is_same<TF, TF_store>::value;
 
     // Read the sources and create containers for the substeps.
     int n_blocks = n_col / n_col_block;
@@ -451,18 +1010,34 @@ void Radiation_solver_longwave<TF>::solve(
 
     std::unique_ptr<Optical_props_arry<TF>> optical_props_subset;
     std::unique_ptr<Optical_props_arry<TF>> optical_props_residual;
+    std::unique_ptr<Optical_props_arry<TF_store>> optical_props_store_subset;
+    std::unique_ptr<Optical_props_arry<TF_store>> optical_props_store_residual;
 
-    optical_props_subset = std::make_unique<Optical_props_1scl<TF>>(n_col_block, n_lay, *kdist);
+    optical_props_subset = std::make_unique<Optical_props_1scl<TF>>(n_col_block, n_lay, *this->kdist);
 
     std::unique_ptr<Source_func_lw<TF>> sources_subset;
     std::unique_ptr<Source_func_lw<TF>> sources_residual;
+    std::unique_ptr<Source_func_lw<TF_store>> sources_store_subset;
+    std::unique_ptr<Source_func_lw<TF_store>> sources_store_residual;
 
-    sources_subset = std::make_unique<Source_func_lw<TF>>(n_col_block, n_lay, *kdist);
+    sources_subset = std::make_unique<Source_func_lw<TF>>(n_col_block, n_lay, *this->kdist);
+
+    if (store_copy)
+    {
+        optical_props_store_subset = std::make_unique<Optical_props_1scl<TF_store>>(n_col_block, n_lay, spectral_disc_store);
+        sources_store_subset = std::make_unique<Source_func_lw<TF_store>>(n_col_block, n_lay, spectral_disc_store);
+    }
 
     if (n_col_block_residual > 0)
     {
-        optical_props_residual = std::make_unique<Optical_props_1scl<TF>>(n_col_block_residual, n_lay, *kdist);
-        sources_residual = std::make_unique<Source_func_lw<TF>>(n_col_block_residual, n_lay, *kdist);
+        optical_props_residual = std::make_unique<Optical_props_1scl<TF>>(n_col_block_residual, n_lay, *this->kdist);
+        sources_residual = std::make_unique<Source_func_lw<TF>>(n_col_block_residual, n_lay, *this->kdist);
+
+        if (store_copy)
+        {
+            optical_props_store_residual = std::make_unique<Optical_props_1scl<TF_store>>(n_col_block_residual, n_lay, spectral_disc_store);
+            sources_store_residual = std::make_unique<Source_func_lw<TF_store>>(n_col_block_residual, n_lay, spectral_disc_store);
+        }
     }
 
     std::unique_ptr<Optical_props_1scl<TF>> cloud_optical_props_subset;
@@ -470,14 +1045,21 @@ void Radiation_solver_longwave<TF>::solve(
 
     if (switch_cloud_optics)
     {
-        cloud_optical_props_subset = std::make_unique<Optical_props_1scl<TF>>(n_col_block, n_lay, *cloud_optics);
+        cloud_optical_props_subset = std::make_unique<Optical_props_1scl<TF>>(n_col_block, n_lay, *this->cloud_optics);
         if (n_col_block_residual > 0)
-            cloud_optical_props_residual = std::make_unique<Optical_props_1scl<TF>>(n_col_block_residual, n_lay, *cloud_optics);
+            cloud_optical_props_residual = std::make_unique<Optical_props_1scl<TF>>(n_col_block_residual, n_lay, *this->cloud_optics);
     }
-    Array<TF,3> gpt_flux_up    ({n_col_block, n_lev, n_gpt});
-    Array<TF,3> gpt_flux_dn    ({n_col_block, n_lev, n_gpt});
-    Array<TF,3> gpt_flux_up_res    ({n_col_block_residual, n_lev, n_gpt});
-    Array<TF,3> gpt_flux_dn_res    ({n_col_block_residual, n_lev, n_gpt});
+    Array<TF_store,3> gpt_flux_up    ({n_col_block, n_lev, n_gpt});
+    Array<TF_store,3> gpt_flux_dn    ({n_col_block, n_lev, n_gpt});
+    Array<TF_store,3> gpt_flux_up_res    ({n_col_block_residual, n_lev, n_gpt});
+    Array<TF_store,3> gpt_flux_dn_res    ({n_col_block_residual, n_lev, n_gpt});
+
+    Array<TF_store,3> gpt_flux_up_jac    ({n_col_block, n_lev, n_gpt});
+    Array<TF_store,3> gpt_flux_up_jac_res({n_col_block_residual, n_lev, n_gpt});
+
+    // The derivative of the upward flux to the surface temperature is only reduced if requested.
+    const bool switch_flux_up_jac = lw_flux_up_jac.size() > 0;
+    const bool switch_clear_sky = lw_flux_up_clear.size() > 0;
     
     TF total_duration = 0;
    
@@ -485,35 +1067,38 @@ void Radiation_solver_longwave<TF>::solve(
     auto call_kernels = [&](
             const int col_s_in, const int col_e_in,
             std::unique_ptr<Optical_props_arry<TF>>& optical_props_subset_in,
+            std::unique_ptr<Optical_props_arry<TF_store>>& optical_props_store_in,
             std::unique_ptr<Optical_props_1scl<TF>>& cloud_optical_props_subset_in,
-            Source_func_lw<TF>& sources_subset_in,
-            const Array<TF,2>& emis_sfc_subset_in,
+            std::unique_ptr<Source_func_lw<TF>>& sources_subset_in,
+            std::unique_ptr<Source_func_lw<TF_store>>& sources_store_in,
+            const Array<TF_store,2>& emis_sfc_subset_in,
             Fluxes_broadband<TF>& fluxes,
-            Fluxes_broadband<TF>& bnd_fluxes,
-            Array<TF,3>& gpt_flux_up, 
-            Array<TF,3>& gpt_flux_dn) 
+            Fluxes_broadband<TF_store>& bnd_fluxes,
+            Array<TF_store,3>& gpt_flux_up, 
+            Array<TF_store,3>& gpt_flux_dn,
+            Array<TF_store,3>& gpt_flux_up_jac)
     {
         const int n_col_in = col_e_in - col_s_in + 1;
         Gas_concs<TF> gas_concs_subset(gas_concs, col_s_in, n_col_in);
 
-        auto p_lev_subset = p_lev.subset({{ {col_s_in, col_e_in}, {1, n_lev} }});
+        Array<TF,2> p_lev_subset = p_lev.subset({{ {col_s_in, col_e_in}, {1, n_lev} }});
 
         Array<TF,2> col_dry_subset({n_col_in, n_lay});
         if (col_dry.size() == 0)
             Gas_optics_rrtmgp<TF>::get_col_dry(col_dry_subset, gas_concs_subset.get_vmr("h2o"), p_lev_subset);
         else
-            col_dry_subset = std::move(col_dry.subset({{ {col_s_in, col_e_in}, {1, n_lay} }}));
+            col_dry_subset = col_dry.subset({{ {col_s_in, col_e_in}, {1, n_lay} }});
 
         auto time_start = std::chrono::high_resolution_clock::now();
 
-        kdist->gas_optics(
+        this->kdist->gas_optics(
                 p_lay.subset({{ {col_s_in, col_e_in}, {1, n_lay} }}),
                 p_lev_subset,
                 t_lay.subset({{ {col_s_in, col_e_in}, {1, n_lay} }}),
                 t_sfc.subset({{ {col_s_in, col_e_in} }}),
                 gas_concs_subset,
                 optical_props_subset_in,
-                sources_subset_in,
+                *sources_subset_in,
                 col_dry_subset,
                 t_lev.subset({{ {col_s_in, col_e_in}, {1, n_lev} }}) );
         auto time_end = std::chrono::high_resolution_clock::now();
@@ -521,9 +1106,23 @@ void Radiation_solver_longwave<TF>::solve(
         total_duration += duration;
         Status::print_message("Duration longwave optics: " + std::to_string(duration) + " (ms)");
 
+        // Keep the gas optical properties for the clear-sky fluxes. In a block without clouds
+        // the all-sky fluxes are the clear-sky fluxes, and no separate solve is needed.
+        const bool solve_clear_sky = switch_clear_sky && switch_cloud_optics
+                && has_clouds(lwp, iwp, col_s_in, col_e_in);
+
+        std::unique_ptr<Optical_props_arry<TF_store>> optical_props_clear;
+        if (solve_clear_sky)
+        {
+            optical_props_clear = std::make_unique<Optical_props_1scl<TF_store>>(n_col_in, n_lay, spectral_disc_store);
+            std::copy(
+                    optical_props_subset_in->get_tau().v().begin(), optical_props_subset_in->get_tau().v().end(),
+                    optical_props_clear->get_tau().v().begin());
+        }
+
         if (switch_cloud_optics)
         {
-            cloud_optics->cloud_optics(
+            this->cloud_optics->cloud_optics(
                     lwp.subset({{ {col_s_in, col_e_in}, {1, n_lay} }}),
                     iwp.subset({{ {col_s_in, col_e_in}, {1, n_lay} }}),
                     rel.subset({{ {col_s_in, col_e_in}, {1, n_lay} }}),
@@ -541,19 +1140,23 @@ void Radiation_solver_longwave<TF>::solve(
         // Store the optical properties, if desired.
         if (switch_output_optical)
         {
+            Array<TF,3> lev_source_inc_subset({n_col_in, n_lay, n_gpt});
+            Array<TF,3> lev_source_dec_subset({n_col_in, n_lay, n_gpt});
+            sources_subset_in->derive_lev_source(1, n_gpt, lev_source_inc_subset.ptr(), lev_source_dec_subset.ptr());
+
             for (int igpt=1; igpt<=n_gpt; ++igpt)
                 for (int ilay=1; ilay<=n_lay; ++ilay)
                     for (int icol=1; icol<=n_col_in; ++icol)
                     {
-                        tau           ({icol+col_s_in-1, ilay, igpt}) = optical_props_subset_in->get_tau()    ({icol, ilay, igpt});
-                        lay_source    ({icol+col_s_in-1, ilay, igpt}) = sources_subset_in.get_lay_source()    ({icol, ilay, igpt});
-                        lev_source_inc({icol+col_s_in-1, ilay, igpt}) = sources_subset_in.get_lev_source_inc()({icol, ilay, igpt});
-                        lev_source_dec({icol+col_s_in-1, ilay, igpt}) = sources_subset_in.get_lev_source_dec()({icol, ilay, igpt});
+                        tau           ({icol+col_s_in-1, ilay, igpt}) = optical_props_subset_in->get_tau()({icol, ilay, igpt});
+                        lay_source    ({icol+col_s_in-1, ilay, igpt}) = sources_subset_in->get_lay_source()({icol, ilay, igpt});
+                        lev_source_inc({icol+col_s_in-1, ilay, igpt}) = lev_source_inc_subset({icol, ilay, igpt});
+                        lev_source_dec({icol+col_s_in-1, ilay, igpt}) = lev_source_dec_subset({icol, ilay, igpt});
                     }
 
             for (int igpt=1; igpt<=n_gpt; ++igpt)
                 for (int icol=1; icol<=n_col_in; ++icol)
-                    sfc_source({icol+col_s_in-1, igpt}) = sources_subset_in.get_sfc_source()({icol, igpt});
+                    sfc_source({icol+col_s_in-1, igpt}) = sources_subset_in->get_sfc_source()({icol, igpt});
         }
 
         if (!switch_fluxes)
@@ -562,16 +1165,36 @@ void Radiation_solver_longwave<TF>::solve(
         constexpr int n_ang = 1;
 
         time_start = std::chrono::high_resolution_clock::now();
-        Rte_lw<TF>::rte_lw(
-                optical_props_subset_in,
+
+        // Hand the optical properties and sources to the solver in its precision.
+        const std::unique_ptr<Optical_props_arry<TF_store>>& optical_props_rte =
+                to_precision(optical_props_subset_in, optical_props_store_in);
+        const Source_func_lw<TF_store>& sources_rte = to_precision(sources_subset_in, sources_store_in);
+
+        Rte_lw<TF_store>::rte_lw(
+                optical_props_rte,
                 top_at_1,
-                sources_subset_in,
+                sources_rte,
                 emis_sfc_subset_in,
-                Array<TF,2>(), // Add an empty array, no inc_flux.
+                Array<TF_store,2>(), // Add an empty array, no inc_flux.
                 gpt_flux_up, gpt_flux_dn,
+                gpt_flux_up_jac,
                 n_ang);
 
-        fluxes.reduce(gpt_flux_up, gpt_flux_dn, optical_props_subset_in, top_at_1);
+        fluxes.reduce(gpt_flux_up, gpt_flux_dn, top_at_1);
+
+        // Sum the derivatives over the g-points, the quadrature weights are included by the solver.
+        if (switch_flux_up_jac)
+        {
+            for (int ilev=1; ilev<=n_lev; ++ilev)
+                for (int icol=1; icol<=n_col_in; ++icol)
+                    lw_flux_up_jac({icol+col_s_in-1, ilev}) = TF(0.);
+
+            for (int igpt=1; igpt<=n_gpt; ++igpt)
+                for (int ilev=1; ilev<=n_lev; ++ilev)
+                    for (int icol=1; icol<=n_col_in; ++icol)
+                        lw_flux_up_jac({icol+col_s_in-1, ilev}) += gpt_flux_up_jac({icol, ilev, igpt});
+        }
 
         // Copy the data to the output.
         for (int ilev=1; ilev<=n_lev; ++ilev)
@@ -589,7 +1212,7 @@ void Radiation_solver_longwave<TF>::solve(
 
         if (switch_output_bnd_fluxes)
         {
-            bnd_fluxes.reduce(gpt_flux_up, gpt_flux_dn, optical_props_subset_in, top_at_1);
+            bnd_fluxes.reduce(gpt_flux_up, gpt_flux_dn, optical_props_rte, top_at_1);
 
             for (int ibnd=1; ibnd<=n_bnd; ++ibnd)
                 for (int ilev=1; ilev<=n_lev; ++ilev)
@@ -600,6 +1223,31 @@ void Radiation_solver_longwave<TF>::solve(
                         lw_bnd_flux_net({icol+col_s_in-1, ilev, ibnd}) = bnd_fluxes.get_bnd_flux_net()({icol, ilev, ibnd});
                     }
         }
+
+        if (switch_clear_sky)
+        {
+            if (solve_clear_sky)
+            {
+                Rte_lw<TF_store>::rte_lw(
+                        optical_props_clear,
+                        top_at_1,
+                        sources_rte,
+                        emis_sfc_subset_in,
+                        Array<TF_store,2>(),
+                        gpt_flux_up, gpt_flux_dn,
+                        n_ang);
+
+                fluxes.reduce(gpt_flux_up, gpt_flux_dn, top_at_1);
+            }
+
+            for (int ilev=1; ilev<=n_lev; ++ilev)
+                for (int icol=1; icol<=n_col_in; ++icol)
+                {
+                    lw_flux_up_clear ({icol+col_s_in-1, ilev}) = fluxes.get_flux_up ()({icol, ilev});
+                    lw_flux_dn_clear ({icol+col_s_in-1, ilev}) = fluxes.get_flux_dn ()({icol, ilev});
+                    lw_flux_net_clear({icol+col_s_in-1, ilev}) = fluxes.get_flux_net()({icol, ilev});
+                }
+        }
     };
 
     for (int b=1; b<=n_blocks; ++b)
@@ -607,23 +1255,26 @@ void Radiation_solver_longwave<TF>::solve(
         const int col_s = (b-1) * n_col_block + 1;
         const int col_e =  b    * n_col_block;
 
-        Array<TF,2> emis_sfc_subset = emis_sfc.subset({{ {1, n_bnd}, {col_s, col_e} }});
+        Array<TF_store,2> emis_sfc_subset = to_store<TF_store>(emis_sfc.subset({{ {1, n_bnd}, {col_s, col_e} }}));
 
         std::unique_ptr<Fluxes_broadband<TF>> fluxes_subset =
                 std::make_unique<Fluxes_broadband<TF>>(n_col_block, n_lev);
-        std::unique_ptr<Fluxes_broadband<TF>> bnd_fluxes_subset =
-                std::make_unique<Fluxes_byband<TF>>(n_col_block, n_lev, n_bnd);
+        std::unique_ptr<Fluxes_broadband<TF_store>> bnd_fluxes_subset =
+                std::make_unique<Fluxes_byband<TF_store>>(n_col_block, n_lev, n_bnd);
 
         call_kernels(
                 col_s, col_e,
                 optical_props_subset,
+                optical_props_store_subset,
                 cloud_optical_props_subset,
-                *sources_subset,
+                sources_subset,
+                sources_store_subset,
                 emis_sfc_subset,
                 *fluxes_subset,
                 *bnd_fluxes_subset,
                 gpt_flux_up,
-                gpt_flux_dn);
+                gpt_flux_dn,
+                gpt_flux_up_jac);
     }
 
     if (n_col_block_residual > 0)
@@ -631,69 +1282,304 @@ void Radiation_solver_longwave<TF>::solve(
         const int col_s = n_col - n_col_block_residual + 1;
         const int col_e = n_col;
 
-        Array<TF,2> emis_sfc_residual = emis_sfc.subset({{ {1, n_bnd}, {col_s, col_e} }});
-        std::unique_ptr<Fluxes_broadband<TF>> fluxes_residual =
-                std::make_unique<Fluxes_broadband<TF>>(n_col_block_residual, n_lev);
-        std::unique_ptr<Fluxes_broadband<TF>> bnd_fluxes_residual =
-                std::make_unique<Fluxes_byband<TF>>(n_col_block_residual, n_lev, n_bnd);
+        Array<TF_store,2> emis_sfc_residual = to_store<TF_store>(emis_sfc.subset({{ {1, n_bnd}, {col_s, col_e} }}));
+        std::unique_ptr<Fluxes_broadband<TF>> fluxes_residual =
+                std::make_unique<Fluxes_broadband<TF>>(n_col_block_residual, n_lev);
+        std::unique_ptr<Fluxes_broadband<TF_store>> bnd_fluxes_residual =
+                std::make_unique<Fluxes_byband<TF_store>>(n_col_block_residual, n_lev, n_bnd);
+
+        call_kernels(
+                col_s, col_e,
+                optical_props_residual,
+                optical_props_store_residual,
+                cloud_optical_props_residual,
+                sources_residual,
+                sources_store_residual,
+                emis_sfc_residual,
+                *fluxes_residual,
+                *bnd_fluxes_residual,
+                gpt_flux_up_res,
+                gpt_flux_dn_res,
+                gpt_flux_up_jac_res);
+    }
+    std::cout<<"total_longwave_gasoptics: "<<total_duration<<std::endl;
+}
+
+template<typename TF>
+void Radiation_solver_longwave<TF>::update_surface_temperature(
+        const Array_view<TF,1>& t_sfc, const Array_view<TF,1>& t_sfc_ref,
+        const Array_view<TF,2>& lw_flux_up_ref, const Array_view<TF,2>& lw_flux_dn,
+        const Array_view<TF,2>& lw_flux_up_jac,
+        Array_view<TF,2> lw_flux_up, Array_view<TF,2> lw_flux_net)
+{
+    const int n_col = lw_flux_up_ref.dim(1);
+    const int n_lev = lw_flux_up_ref.dim(2);
+
+    if (lw_flux_up_jac.size() != lw_flux_up_ref.size())
+        throw std::runtime_error("The surface temperature update requires the flux Jacobian of the reference solve");
+
+    for (int ilev=1; ilev<=n_lev; ++ilev)
+        for (int icol=1; icol<=n_col; ++icol)
+        {
+            const TF dt_sfc = t_sfc({icol}) - t_sfc_ref({icol});
+            lw_flux_up ({icol, ilev}) = lw_flux_up_ref({icol, ilev}) + lw_flux_up_jac({icol, ilev}) * dt_sfc;
+            lw_flux_net({icol, ilev}) = lw_flux_dn({icol, ilev}) - lw_flux_up({icol, ilev});
+        }
+}
+
+template<typename TF>
+Radiation_solver_shortwave<TF>::Radiation_solver_shortwave(
+        const Gas_concs<TF>& gas_concs,
+        const std::string& file_name_gas,
+        const std::string& file_name_cloud,
+        const std::string& file_name_weights,
+        Netcdf_file& input_nc,
+        const bool sw_cloud_optics,
+        const bool sw_nn_gas_optics,
+        const bool sw_hybrid_gas_optics,
+        const bool sw_float_storage)
+{
+    // Construct the gas optics classes for the solver.
+    this->kdist = load_and_init_gas_optics<TF>(
+            gas_concs, file_name_gas, file_name_weights, input_nc,
+            sw_nn_gas_optics, sw_hybrid_gas_optics);
+
+    if (sw_cloud_optics)
+        this->cloud_optics = std::make_unique<Cloud_optics<TF>>(
+                load_and_init_cloud_optics<TF>(file_name_cloud));
+
+    // Single precision storage only differs from the solve in TF if TF is double.
+    this->sw_float_storage = sw_float_storage && !std::is_same<TF, float>::value;
+}
+
+template<typename TF>
+TF Radiation_solver_shortwave<TF>::get_nn_column_fraction() const
+{
+    return nn_column_fraction(this->kdist);
+}
+
+template<typename TF>
+const Gas_optics<TF>& Radiation_solver_shortwave<TF>::get_gas_optics() const
+{
+    return *this->kdist;
+}
+
+template<typename TF>
+void Radiation_solver_shortwave<TF>::set_n_col_block(const int n_col_block)
+{
+    if (n_col_block < 1)
+        throw std::runtime_error("The number of columns per block should be at least one");
+    this->n_col_block = n_col_block;
+}
+
+template<typename TF>
+void Radiation_solver_shortwave<TF>::set_thread_pool(Thread_pool* thread_pool)
+{
+    set_nn_thread_pool(this->kdist, thread_pool);
+}
+
+template<typename TF>
+void Radiation_solver_shortwave<TF>::set_column_dedup(const bool sw_column_dedup, const TF quantization)
+{
+    if (quantization < TF(0.))
+        throw std::runtime_error("The quantization of the column deduplication cannot be negative");
+    this->sw_column_dedup = sw_column_dedup;
+    this->dedup_quantization = quantization;
+}
+
+template<typename TF>
+void Radiation_solver_shortwave<TF>::solve(
+        const bool switch_fluxes,
+        const bool switch_cloud_optics,
+        const bool switch_output_optical,
+        const bool switch_output_bnd_fluxes,
+        const Gas_concs<TF>& gas_concs,
+        const Array_view<TF,2>& p_lay, const Array_view<TF,2>& p_lev,
+        const Array_view<TF,2>& t_lay, const Array_view<TF,2>& t_lev,
+        const Array_view<TF,2>& col_dry,
+        const Array_view<TF,2>& sfc_alb_dir, const Array_view<TF,2>& sfc_alb_dif,
+        const Array_view<TF,1>& tsi_scaling, const Array_view<TF,1>& mu0,
+        const Array_view<TF,2>& lwp, const Array_view<TF,2>& iwp,
+        const Array_view<TF,2>& rel, const Array_view<TF,2>& rei,
+        Array_view<TF,3> tau, Array_view<TF,3> ssa, Array_view<TF,3> g,
+        Array_view<TF,2> toa_src,
+        Array_view<TF,2> sw_flux_up, Array_view<TF,2> sw_flux_dn,
+        Array_view<TF,2> sw_flux_dn_dir, Array_view<TF,2> sw_flux_net,
+        Array_view<TF,3> sw_bnd_flux_up, Array_view<TF,3> sw_bnd_flux_dn,
+        Array_view<TF,3> sw_bnd_flux_dn_dir, Array_view<TF,3> sw_bnd_flux_net,
+        Array_view<TF,2> sw_flux_up_clear, Array_view<TF,2> sw_flux_dn_clear,
+        Array_view<TF,2> sw_flux_dn_dir_clear, Array_view<TF,2> sw_flux_net_clear) const
+{
+    this->dedup_ratio = 1.;
+
+    if (!this->sw_column_dedup)
+    {
+        solve_columns(
+                switch_fluxes, switch_cloud_optics, switch_output_optical, switch_output_bnd_fluxes,
+                gas_concs,
+                p_lay, p_lev, t_lay, t_lev, col_dry,
+                sfc_alb_dir, sfc_alb_dif, tsi_scaling, mu0,
+                lwp, iwp, rel, rei,
+                tau, ssa, g, toa_src,
+                sw_flux_up, sw_flux_dn, sw_flux_dn_dir, sw_flux_net,
+                sw_bnd_flux_up, sw_bnd_flux_dn, sw_bnd_flux_dn_dir, sw_bnd_flux_net,
+                sw_flux_up_clear, sw_flux_dn_clear, sw_flux_dn_dir_clear, sw_flux_net_clear);
+        return;
+    }
+
+    const int n_col = p_lay.dim(1);
+
+    Column_dedup<TF> dedup(n_col, this->dedup_quantization);
+    dedup.add(gas_concs);
+    dedup.add(p_lay);
+    dedup.add(p_lev);
+    dedup.add(t_lay);
+    dedup.add(t_lev);
+    dedup.add(col_dry);
+    dedup.add_dim2(sfc_alb_dir);
+    dedup.add_dim2(sfc_alb_dif);
+    dedup.add(tsi_scaling);
+    dedup.add(mu0);
 
-        call_kernels(
-                col_s, col_e,
-                optical_props_residual,
-                cloud_optical_props_residual,
-                *sources_residual,
-                emis_sfc_residual,
-                *fluxes_residual,
-                *bnd_fluxes_residual,
-                gpt_flux_up_res,
-                gpt_flux_dn_res);
+    if (switch_cloud_optics)
+    {
+        dedup.add(lwp);
+        dedup.add(iwp);
+        dedup.add(rel);
+        dedup.add(rei);
     }
-    std::cout<<"total_longwave_gasoptics: "<<total_duration<<std::endl;
+
+    dedup.find_unique();
+
+    const std::vector<int>& cols = dedup.get_unique_cols();
+    const int n_unique = dedup.get_n_unique();
+
+    Array<TF,3> tau_u = unique_output(tau, n_unique);
+    Array<TF,3> ssa_u = unique_output(ssa, n_unique);
+    Array<TF,3> g_u = unique_output(g, n_unique);
+    Array<TF,2> toa_src_u = unique_output(toa_src, n_unique);
+    Array<TF,2> sw_flux_up_u = unique_output(sw_flux_up, n_unique);
+    Array<TF,2> sw_flux_dn_u = unique_output(sw_flux_dn, n_unique);
+    Array<TF,2> sw_flux_dn_dir_u = unique_output(sw_flux_dn_dir, n_unique);
+    Array<TF,2> sw_flux_net_u = unique_output(sw_flux_net, n_unique);
+    Array<TF,3> sw_bnd_flux_up_u = unique_output(sw_bnd_flux_up, n_unique);
+    Array<TF,3> sw_bnd_flux_dn_u = unique_output(sw_bnd_flux_dn, n_unique);
+    Array<TF,3> sw_bnd_flux_dn_dir_u = unique_output(sw_bnd_flux_dn_dir, n_unique);
+    Array<TF,3> sw_bnd_flux_net_u = unique_output(sw_bnd_flux_net, n_unique);
+    Array<TF,2> sw_flux_up_clear_u = unique_output(sw_flux_up_clear, n_unique);
+    Array<TF,2> sw_flux_dn_clear_u = unique_output(sw_flux_dn_clear, n_unique);
+    Array<TF,2> sw_flux_dn_dir_clear_u = unique_output(sw_flux_dn_dir_clear, n_unique);
+    Array<TF,2> sw_flux_net_clear_u = unique_output(sw_flux_net_clear, n_unique);
+
+    using column_kernels::gather;
+
+    solve_columns(
+            switch_fluxes, switch_cloud_optics, switch_output_optical, switch_output_bnd_fluxes,
+            Gas_concs<TF>(gas_concs, cols),
+            gather(p_lay, cols), gather(p_lev, cols),
+            gather(t_lay, cols), gather(t_lev, cols),
+            gather(col_dry, cols),
+            column_kernels::gather_dim2(sfc_alb_dir, cols), column_kernels::gather_dim2(sfc_alb_dif, cols),
+            gather(tsi_scaling, cols), gather(mu0, cols),
+            gather(lwp, cols), gather(iwp, cols),
+            gather(rel, cols), gather(rei, cols),
+            tau_u, ssa_u, g_u, toa_src_u,
+            sw_flux_up_u, sw_flux_dn_u, sw_flux_dn_dir_u, sw_flux_net_u,
+            sw_bnd_flux_up_u, sw_bnd_flux_dn_u, sw_bnd_flux_dn_dir_u, sw_bnd_flux_net_u,
+            sw_flux_up_clear_u, sw_flux_dn_clear_u, sw_flux_dn_dir_clear_u, sw_flux_net_clear_u);
+
+    dedup.expand(tau, tau_u);
+    dedup.expand(ssa, ssa_u);
+    dedup.expand(g, g_u);
+    dedup.expand(toa_src, toa_src_u);
+    dedup.expand(sw_flux_up, sw_flux_up_u);
+    dedup.expand(sw_flux_dn, sw_flux_dn_u);
+    dedup.expand(sw_flux_dn_dir, sw_flux_dn_dir_u);
+    dedup.expand(sw_flux_net, sw_flux_net_u);
+    dedup.expand(sw_bnd_flux_up, sw_bnd_flux_up_u);
+    dedup.expand(sw_bnd_flux_dn, sw_bnd_flux_dn_u);
+    dedup.expand(sw_bnd_flux_dn_dir, sw_bnd_flux_dn_dir_u);
+    dedup.expand(sw_bnd_flux_net, sw_bnd_flux_net_u);
+    dedup.expand(sw_flux_up_clear, sw_flux_up_clear_u);
+    dedup.expand(sw_flux_dn_clear, sw_flux_dn_clear_u);
+    dedup.expand(sw_flux_dn_dir_clear, sw_flux_dn_dir_clear_u);
+    dedup.expand(sw_flux_net_clear, sw_flux_net_clear_u);
+
+    this->dedup_ratio = dedup.get_dedup_ratio();
 }
 
 template<typename TF>
-Radiation_solver_shortwave<TF>::Radiation_solver_shortwave(
+void Radiation_solver_shortwave<TF>::solve_columns(
+        const bool switch_fluxes,
+        const bool switch_cloud_optics,
+        const bool switch_output_optical,
+        const bool switch_output_bnd_fluxes,
         const Gas_concs<TF>& gas_concs,
-        const std::string& file_name_gas,
-        const std::string& file_name_cloud,
-        const std::string& file_name_weights,
-        Netcdf_file& input_nc,
-        const bool sw_cloud_optics,
-        const bool sw_nn_gas_optics)
+        const Array_view<TF,2>& p_lay, const Array_view<TF,2>& p_lev,
+        const Array_view<TF,2>& t_lay, const Array_view<TF,2>& t_lev,
+        const Array_view<TF,2>& col_dry,
+        const Array_view<TF,2>& sfc_alb_dir, const Array_view<TF,2>& sfc_alb_dif,
+        const Array_view<TF,1>& tsi_scaling, const Array_view<TF,1>& mu0,
+        const Array_view<TF,2>& lwp, const Array_view<TF,2>& iwp,
+        const Array_view<TF,2>& rel, const Array_view<TF,2>& rei,
+        Array_view<TF,3> tau, Array_view<TF,3> ssa, Array_view<TF,3> g,
+        Array_view<TF,2> toa_src,
+        Array_view<TF,2> sw_flux_up, Array_view<TF,2> sw_flux_dn,
+        Array_view<TF,2> sw_flux_dn_dir, Array_view<TF,2> sw_flux_net,
+        Array_view<TF,3> sw_bnd_flux_up, Array_view<TF,3> sw_bnd_flux_dn,
+        Array_view<TF,3> sw_bnd_flux_dn_dir, Array_view<TF,3> sw_bnd_flux_net,
+        Array_view<TF,2> sw_flux_up_clear, Array_view<TF,2> sw_flux_dn_clear,
+        Array_view<TF,2> sw_flux_dn_dir_clear, Array_view<TF,2> sw_flux_net_clear) const
 {
-    // Construct the gas optics classes for the solver.
-    if (sw_nn_gas_optics)
-        this->kdist = std::make_unique<Gas_optics_nn<TF>>(
-                load_and_init_gas_optics_nn<TF>(gas_concs, file_name_gas, file_name_weights, input_nc));
+    if (this->sw_float_storage)
+        solve_stored<float>(
+                switch_fluxes, switch_cloud_optics, switch_output_optical, switch_output_bnd_fluxes,
+                gas_concs,
+                p_lay, p_lev, t_lay, t_lev, col_dry,
+                sfc_alb_dir, sfc_alb_dif, tsi_scaling, mu0,
+                lwp, iwp, rel, rei,
+                tau, ssa, g, toa_src,
+                sw_flux_up, sw_flux_dn, sw_flux_dn_dir, sw_flux_net,
+                sw_bnd_flux_up, sw_bnd_flux_dn, sw_bnd_flux_dn_dir, sw_bnd_flux_net,
+                sw_flux_up_clear, sw_flux_dn_clear, sw_flux_dn_dir_clear, sw_flux_net_clear);
     else
-        this->kdist = std::make_unique<Gas_optics_rrtmgp<TF>>(
-                load_and_init_gas_optics_rrtmgp<TF>(gas_concs, file_name_gas));
-
-    if (sw_cloud_optics)
-        this->cloud_optics = std::make_unique<Cloud_optics<TF>>(
-            load_and_init_cloud_optics<TF>(file_name_cloud));
+        solve_stored<TF>(
+                switch_fluxes, switch_cloud_optics, switch_output_optical, switch_output_bnd_fluxes,
+                gas_concs,
+                p_lay, p_lev, t_lay, t_lev, col_dry,
+                sfc_alb_dir, sfc_alb_dif, tsi_scaling, mu0,
+                lwp, iwp, rel, rei,
+                tau, ssa, g, toa_src,
+                sw_flux_up, sw_flux_dn, sw_flux_dn_dir, sw_flux_net,
+                sw_bnd_flux_up, sw_bnd_flux_dn, sw_bnd_flux_dn_dir, sw_bnd_flux_net,
+                sw_flux_up_clear, sw_flux_dn_clear, sw_flux_dn_dir_clear, sw_flux_net_clear);
 }
 
+// Solve with the gas and cloud optics in TF. The solver receives the optical properties and incoming
+// solar radiation in TF_store and stores its g-point fluxes in TF_store, which are reduced in TF.
 template<typename TF>
-void Radiation_solver_shortwave<TF>::solve(
+template<typename TF_store>
+void Radiation_solver_shortwave<TF>::solve_stored(
         const bool switch_fluxes,
         const bool switch_cloud_optics,
         const bool switch_output_optical,
         const bool switch_output_bnd_fluxes,
         const Gas_concs<TF>& gas_concs,
-        const Array<TF,2>& p_lay, const Array<TF,2>& p_lev,
-        const Array<TF,2>& t_lay, const Array<TF,2>& t_lev,
-        const Array<TF,2>& col_dry,
-        const Array<TF,2>& sfc_alb_dir, const Array<TF,2>& sfc_alb_dif,
-        const Array<TF,1>& tsi_scaling, const Array<TF,1>& mu0,
-        const Array<TF,2>& lwp, const Array<TF,2>& iwp,
-        const Array<TF,2>& rel, const Array<TF,2>& rei,
-        Array<TF,3>& tau, Array<TF,3>& ssa, Array<TF,3>& g,
-        Array<TF,2>& toa_src,
-        Array<TF,2>& sw_flux_up, Array<TF,2>& sw_flux_dn,
-        Array<TF,2>& sw_flux_dn_dir, Array<TF,2>& sw_flux_net,
-        Array<TF,3>& sw_bnd_flux_up, Array<TF,3>& sw_bnd_flux_dn,
-        Array<TF,3>& sw_bnd_flux_dn_dir, Array<TF,3>& sw_bnd_flux_net) const
+        const Array_view<TF,2>& p_lay, const Array_view<TF,2>& p_lev,
+        const Array_view<TF,2>& t_lay, const Array_view<TF,2>& t_lev,
+        const Array_view<TF,2>& col_dry,
+        const Array_view<TF,2>& sfc_alb_dir, const Array_view<TF,2>& sfc_alb_dif,
+        const Array_view<TF,1>& tsi_scaling, const Array_view<TF,1>& mu0,
+        const Array_view<TF,2>& lwp, const Array_view<TF,2>& iwp,
+        const Array_view<TF,2>& rel, const Array_view<TF,2>& rei,
+        Array_view<TF,3> tau, Array_view<TF,3> ssa, Array_view<TF,3> g,
+        Array_view<TF,2> toa_src,
+        Array_view<TF,2> sw_flux_up, Array_view<TF,2> sw_flux_dn,
+        Array_view<TF,2> sw_flux_dn_dir, Array_view<TF,2> sw_flux_net,
+        Array_view<TF,3> sw_bnd_flux_up, Array_view<TF,3> sw_bnd_flux_dn,
+        Array_view<TF,3> sw_bnd_flux_dn_dir, Array_view<TF,3> sw_bnd_flux_net,
+        Array_view<TF,2> sw_flux_up_clear, Array_view<TF,2> sw_flux_dn_clear,
+        Array_view<TF,2> sw_flux_dn_dir_clear, Array_view<TF,2> sw_flux_net_clear) const
 {
     const int n_col = p_lay.dim(1);
     const int n_lay = p_lay.dim(2);
@@ -703,7 +1589,14 @@ void Radiation_solver_shortwave<TF>::solve(
 
     const BOOL_TYPE top_at_1 = p_lay({1, 1}) < p_lay({1, n_lay});
 
-    constexpr int n_col_block = 8;
+    const int n_col_block = this->n_col_block;
+
+    // Spectral discretization in the precision of the solver.
+    const Optical_props<TF_store> spectral_disc_store(
+            convert_array<TF_store>(this->kdist->get_band_lims_wavenumber()), this->kdist->get_band_lims_gpoint());
+
+    // The containers in TF_store are only needed if the precision of the solver differs.
+    constexpr bool store_copy = !std::is_same<TF, TF_store>::value;
 
     // Read the sources and create containers for the substeps.
     int n_blocks = n_col / n_col_block;
@@ -711,55 +1604,67 @@ void Radiation_solver_shortwave<TF>::solve(
 
     std::unique_ptr<Optical_props_arry<TF>> optical_props_subset;
     std::unique_ptr<Optical_props_arry<TF>> optical_props_residual;
+    std::unique_ptr<Optical_props_arry<TF_store>> optical_props_store_subset;
+    std::unique_ptr<Optical_props_arry<TF_store>> optical_props_store_residual;
+
+    optical_props_subset = std::make_unique<Optical_props_2str<TF>>(n_col_block, n_lay, *this->kdist);
+    if (store_copy)
+        optical_props_store_subset = std::make_unique<Optical_props_2str<TF_store>>(n_col_block, n_lay, spectral_disc_store);
 
-    optical_props_subset = std::make_unique<Optical_props_2str<TF>>(n_col_block, n_lay, *kdist);
     if (n_col_block_residual > 0)
-        optical_props_residual = std::make_unique<Optical_props_2str<TF>>(n_col_block_residual, n_lay, *kdist);
+    {
+        optical_props_residual = std::make_unique<Optical_props_2str<TF>>(n_col_block_residual, n_lay, *this->kdist);
+        if (store_copy)
+            optical_props_store_residual = std::make_unique<Optical_props_2str<TF_store>>(n_col_block_residual, n_lay, spectral_disc_store);
+    }
 
     std::unique_ptr<Optical_props_2str<TF>> cloud_optical_props_subset;
     std::unique_ptr<Optical_props_2str<TF>> cloud_optical_props_residual;
 
     if (switch_cloud_optics)
     {
-        cloud_optical_props_subset = std::make_unique<Optical_props_2str<TF>>(n_col_block, n_lay, *cloud_optics);
+        cloud_optical_props_subset = std::make_unique<Optical_props_2str<TF>>(n_col_block, n_lay, *this->cloud_optics);
         if (n_col_block_residual > 0)
-            cloud_optical_props_residual = std::make_unique<Optical_props_2str<TF>>(n_col_block_residual, n_lay, *cloud_optics);
+            cloud_optical_props_residual = std::make_unique<Optical_props_2str<TF>>(n_col_block_residual, n_lay, *this->cloud_optics);
     }
  
-    Array<TF,3> gpt_flux_up    ({n_col_block, n_lev, n_gpt});
-    Array<TF,3> gpt_flux_dn    ({n_col_block, n_lev, n_gpt});
-    Array<TF,3> gpt_flux_dn_dir({n_col_block, n_lev, n_gpt});
-    Array<TF,3> gpt_flux_up_res    ({n_col_block_residual, n_lev, n_gpt});
-    Array<TF,3> gpt_flux_dn_res    ({n_col_block_residual, n_lev, n_gpt});
-    Array<TF,3> gpt_flux_dn_dir_res({n_col_block_residual, n_lev, n_gpt});
+    Array<TF_store,3> gpt_flux_up    ({n_col_block, n_lev, n_gpt});
+    Array<TF_store,3> gpt_flux_dn    ({n_col_block, n_lev, n_gpt});
+    Array<TF_store,3> gpt_flux_dn_dir({n_col_block, n_lev, n_gpt});
+    Array<TF_store,3> gpt_flux_up_res    ({n_col_block_residual, n_lev, n_gpt});
+    Array<TF_store,3> gpt_flux_dn_res    ({n_col_block_residual, n_lev, n_gpt});
+    Array<TF_store,3> gpt_flux_dn_dir_res({n_col_block_residual, n_lev, n_gpt});
+
+    const bool switch_clear_sky = sw_flux_up_clear.size() > 0;
     
     TF total_duration = 0;
     // Lambda function for solving optical properties subset.
     auto call_kernels = [&](
             const int col_s_in, const int col_e_in,
             std::unique_ptr<Optical_props_arry<TF>>& optical_props_subset_in,
+            std::unique_ptr<Optical_props_arry<TF_store>>& optical_props_store_in,
             std::unique_ptr<Optical_props_2str<TF>>& cloud_optical_props_subset_in,
             Fluxes_broadband<TF>& fluxes,
-            Fluxes_broadband<TF>& bnd_fluxes,
-            Array<TF,3>& gpt_flux_up, 
-            Array<TF,3>& gpt_flux_dn, 
-            Array<TF,3>& gpt_flux_dn_dir)
+            Fluxes_broadband<TF_store>& bnd_fluxes,
+            Array<TF_store,3>& gpt_flux_up, 
+            Array<TF_store,3>& gpt_flux_dn, 
+            Array<TF_store,3>& gpt_flux_dn_dir)
     {
         const int n_col_in = col_e_in - col_s_in + 1;
         Gas_concs<TF> gas_concs_subset(gas_concs, col_s_in, n_col_in);
 
-        auto p_lev_subset = p_lev.subset({{ {col_s_in, col_e_in}, {1, n_lev} }});
+        Array<TF,2> p_lev_subset = p_lev.subset({{ {col_s_in, col_e_in}, {1, n_lev} }});
 
         Array<TF,2> col_dry_subset({n_col_in, n_lay});
         if (col_dry.size() == 0)
             Gas_optics_rrtmgp<TF>::get_col_dry(col_dry_subset, gas_concs_subset.get_vmr("h2o"), p_lev_subset);
         else
-            col_dry_subset = std::move(col_dry.subset({{ {col_s_in, col_e_in}, {1, n_lay} }}));
+            col_dry_subset = col_dry.subset({{ {col_s_in, col_e_in}, {1, n_lay} }});
 
         Array<TF,2> toa_src_subset({n_col_in, n_gpt});
 
         auto time_start = std::chrono::high_resolution_clock::now();
-        kdist->gas_optics(
+        this->kdist->gas_optics(
                 p_lay.subset({{ {col_s_in, col_e_in}, {1, n_lay} }}),
                 p_lev_subset,
                 t_lay.subset({{ {col_s_in, col_e_in}, {1, n_lay} }}),
@@ -778,12 +1683,32 @@ void Radiation_solver_shortwave<TF>::solve(
             for (int icol=1; icol<=n_col_in; ++icol)
                 toa_src_subset({icol, igpt}) *= tsi_scaling_subset({icol});
 
+        // Keep the gas optical properties for the clear-sky fluxes. In a block without clouds
+        // the all-sky fluxes are the clear-sky fluxes, and no separate solve is needed.
+        const bool solve_clear_sky = switch_clear_sky && switch_cloud_optics
+                && has_clouds(lwp, iwp, col_s_in, col_e_in);
+
+        std::unique_ptr<Optical_props_arry<TF_store>> optical_props_clear;
+        if (solve_clear_sky)
+        {
+            optical_props_clear = std::make_unique<Optical_props_2str<TF_store>>(n_col_in, n_lay, spectral_disc_store);
+            std::copy(
+                    optical_props_subset_in->get_tau().v().begin(), optical_props_subset_in->get_tau().v().end(),
+                    optical_props_clear->get_tau().v().begin());
+            std::copy(
+                    optical_props_subset_in->get_ssa().v().begin(), optical_props_subset_in->get_ssa().v().end(),
+                    optical_props_clear->get_ssa().v().begin());
+            std::copy(
+                    optical_props_subset_in->get_g().v().begin(), optical_props_subset_in->get_g().v().end(),
+                    optical_props_clear->get_g().v().begin());
+        }
+
         if (switch_cloud_optics)
         {
             Array<int,2> cld_mask_liq({n_col_in, n_lay});
             Array<int,2> cld_mask_ice({n_col_in, n_lay});
 
-            cloud_optics->cloud_optics(
+            this->cloud_optics->cloud_optics(
                     lwp.subset({{ {col_s_in, col_e_in}, {1, n_lay} }}),
                     iwp.subset({{ {col_s_in, col_e_in}, {1, n_lay} }}),
                     rel.subset({{ {col_s_in, col_e_in}, {1, n_lay} }}),
@@ -819,19 +1744,25 @@ void Radiation_solver_shortwave<TF>::solve(
             return;
 
         time_start = std::chrono::high_resolution_clock::now();
-        Rte_sw<TF>::rte_sw(
-                optical_props_subset_in,
+
+        // Hand the optical properties and incoming radiation to the solver in its precision.
+        const std::unique_ptr<Optical_props_arry<TF_store>>& optical_props_rte =
+                to_precision(optical_props_subset_in, optical_props_store_in);
+        const Array<TF_store,2> toa_src_rte = to_store<TF_store>(std::move(toa_src_subset));
+
+        Rte_sw<TF_store>::rte_sw(
+                optical_props_rte,
                 top_at_1,
-                mu0.subset({{ {col_s_in, col_e_in} }}),
-                toa_src_subset,
-                sfc_alb_dir.subset({{ {1, n_bnd}, {col_s_in, col_e_in} }}),
-                sfc_alb_dif.subset({{ {1, n_bnd}, {col_s_in, col_e_in} }}),
-                Array<TF,2>(), // Add an empty array, no inc_flux.
+                to_store<TF_store>(mu0.subset({{ {col_s_in, col_e_in} }})),
+                toa_src_rte,
+                to_store<TF_store>(sfc_alb_dir.subset({{ {1, n_bnd}, {col_s_in, col_e_in} }})),
+                to_store<TF_store>(sfc_alb_dif.subset({{ {1, n_bnd}, {col_s_in, col_e_in} }})),
+                Array<TF_store,2>(), // Add an empty array, no inc_flux.
                 gpt_flux_up,
                 gpt_flux_dn,
                 gpt_flux_dn_dir);
 
-        fluxes.reduce(gpt_flux_up, gpt_flux_dn, gpt_flux_dn_dir, optical_props_subset_in, top_at_1);
+        fluxes.reduce(gpt_flux_up, gpt_flux_dn, gpt_flux_dn_dir, top_at_1);
 
         // Copy the data to the output.
         for (int ilev=1; ilev<=n_lev; ++ilev)
@@ -850,7 +1781,7 @@ void Radiation_solver_shortwave<TF>::solve(
 
         if (switch_output_bnd_fluxes)
         {
-            bnd_fluxes.reduce(gpt_flux_up, gpt_flux_dn, optical_props_subset_in, top_at_1);
+            bnd_fluxes.reduce(gpt_flux_up, gpt_flux_dn, optical_props_rte, top_at_1);
 
             for (int ibnd=1; ibnd<=n_bnd; ++ibnd)
                 for (int ilev=1; ilev<=n_lev; ++ilev)
@@ -862,6 +1793,35 @@ void Radiation_solver_shortwave<TF>::solve(
                         sw_bnd_flux_net    ({icol+col_s_in-1, ilev, ibnd}) = bnd_fluxes.get_bnd_flux_net    ()({icol, ilev, ibnd});
                     }
         }
+
+        if (switch_clear_sky)
+        {
+            if (solve_clear_sky)
+            {
+                Rte_sw<TF_store>::rte_sw(
+                        optical_props_clear,
+                        top_at_1,
+                        to_store<TF_store>(mu0.subset({{ {col_s_in, col_e_in} }})),
+                        toa_src_rte,
+                        to_store<TF_store>(sfc_alb_dir.subset({{ {1, n_bnd}, {col_s_in, col_e_in} }})),
+                        to_store<TF_store>(sfc_alb_dif.subset({{ {1, n_bnd}, {col_s_in, col_e_in} }})),
+                        Array<TF_store,2>(),
+                        gpt_flux_up,
+                        gpt_flux_dn,
+                        gpt_flux_dn_dir);
+
+                fluxes.reduce(gpt_flux_up, gpt_flux_dn, gpt_flux_dn_dir, top_at_1);
+            }
+
+            for (int ilev=1; ilev<=n_lev; ++ilev)
+                for (int icol=1; icol<=n_col_in; ++icol)
+                {
+                    sw_flux_up_clear     ({icol+col_s_in-1, ilev}) = fluxes.get_flux_up    ()({icol, ilev});
+                    sw_flux_dn_clear     ({icol+col_s_in-1, ilev}) = fluxes.get_flux_dn    ()({icol, ilev});
+                    sw_flux_dn_dir_clear ({icol+col_s_in-1, ilev}) = fluxes.get_flux_dn_dir()({icol, ilev});
+                    sw_flux_net_clear    ({icol+col_s_in-1, ilev}) = fluxes.get_flux_net   ()({icol, ilev});
+                }
+        }
     };
 
     for (int b=1; b<=n_blocks; ++b)
@@ -871,12 +1831,13 @@ void Radiation_solver_shortwave<TF>::solve(
 
         std::unique_ptr<Fluxes_broadband<TF>> fluxes_subset =
                 std::make_unique<Fluxes_broadband<TF>>(n_col_block, n_lev);
-        std::unique_ptr<Fluxes_broadband<TF>> bnd_fluxes_subset =
-                std::make_unique<Fluxes_byband<TF>>(n_col_block, n_lev, n_bnd);
+        std::unique_ptr<Fluxes_broadband<TF_store>> bnd_fluxes_subset =
+                std::make_unique<Fluxes_byband<TF_store>>(n_col_block, n_lev, n_bnd);
 
         call_kernels(
                 col_s, col_e,
                 optical_props_subset,
+                optical_props_store_subset,
                 cloud_optical_props_subset,
                 *fluxes_subset,
                 *bnd_fluxes_subset,
@@ -892,12 +1853,13 @@ void Radiation_solver_shortwave<TF>::solve(
 
         std::unique_ptr<Fluxes_broadband<TF>> fluxes_residual =
                 std::make_unique<Fluxes_broadband<TF>>(n_col_block_residual, n_lev);
-        std::unique_ptr<Fluxes_broadband<TF>> bnd_fluxes_residual =
-                std::make_unique<Fluxes_byband<TF>>(n_col_block_residual, n_lev, n_bnd);
+        std::unique_ptr<Fluxes_broadband<TF_store>> bnd_fluxes_residual =
+                std::make_unique<Fluxes_byband<TF_store>>(n_col_block_residual, n_lev, n_bnd);
 
         call_kernels(
                 col_s, col_e,
                 optical_props_residual,
+                optical_props_store_residual,
                 cloud_optical_props_residual,
                 *fluxes_residual,
                 *bnd_fluxes_residual,
@@ -908,10 +1870,678 @@ void Radiation_solver_shortwave<TF>::solve(
     std::cout<<"total_shortwave_gasoptics: "<<total_duration<<std::endl;
 }
 
-#ifdef FLOAT_SINGLE_RRTMGP
+template<typename TF>
+void Radiation_solver_shortwave<TF>::solve_albedos(
+        const bool switch_cloud_optics,
+        const Gas_concs<TF>& gas_concs,
+        const Array_view<TF,2>& p_lay, const Array_view<TF,2>& p_lev,
+        const Array_view<TF,2>& t_lay, const Array_view<TF,2>& t_lev,
+        const Array_view<TF,2>& col_dry,
+        const std::vector<Array_view<TF,2>>& sfc_alb_dir,
+        const std::vector<Array_view<TF,2>>& sfc_alb_dif,
+        const Array_view<TF,1>& tsi_scaling, const Array_view<TF,1>& mu0,
+        const Array_view<TF,2>& lwp, const Array_view<TF,2>& iwp,
+        const Array_view<TF,2>& rel, const Array_view<TF,2>& rei,
+        std::vector<Array_view<TF,2>>& sw_flux_up, std::vector<Array_view<TF,2>>& sw_flux_dn,
+        Array_view<TF,2> sw_flux_dn_dir, std::vector<Array_view<TF,2>>& sw_flux_net) const
+{
+    const std::size_t n_alb = sfc_alb_dir.size();
+    if (sfc_alb_dif.size() != n_alb || sw_flux_up.size() != n_alb
+            || sw_flux_dn.size() != n_alb || sw_flux_net.size() != n_alb)
+        throw std::runtime_error("Number of surface albedo scenarios and flux outputs differs");
+
+    if (this->sw_float_storage)
+        solve_albedos_stored<float>(
+                switch_cloud_optics, gas_concs,
+                p_lay, p_lev, t_lay, col_dry,
+                sfc_alb_dir, sfc_alb_dif, tsi_scaling, mu0,
+                lwp, iwp, rel, rei,
+                sw_flux_up, sw_flux_dn, sw_flux_dn_dir, sw_flux_net);
+    else
+        solve_albedos_stored<TF>(
+                switch_cloud_optics, gas_concs,
+                p_lay, p_lev, t_lay, col_dry,
+                sfc_alb_dir, sfc_alb_dif, tsi_scaling, mu0,
+                lwp, iwp, rel, rei,
+                sw_flux_up, sw_flux_dn, sw_flux_dn_dir, sw_flux_net);
+}
+
+template<typename TF>
+template<typename TF_store>
+void Radiation_solver_shortwave<TF>::solve_albedos_stored(
+        const bool switch_cloud_optics,
+        const Gas_concs<TF>& gas_concs,
+        const Array_view<TF,2>& p_lay, const Array_view<TF,2>& p_lev,
+        const Array_view<TF,2>& t_lay, const Array_view<TF,2>& col_dry,
+        const std::vector<Array_view<TF,2>>& sfc_alb_dir,
+        const std::vector<Array_view<TF,2>>& sfc_alb_dif,
+        const Array_view<TF,1>& tsi_scaling, const Array_view<TF,1>& mu0,
+        const Array_view<TF,2>& lwp, const Array_view<TF,2>& iwp,
+        const Array_view<TF,2>& rel, const Array_view<TF,2>& rei,
+        std::vector<Array_view<TF,2>>& sw_flux_up, std::vector<Array_view<TF,2>>& sw_flux_dn,
+        Array_view<TF,2> sw_flux_dn_dir, std::vector<Array_view<TF,2>>& sw_flux_net) const
+{
+    const int n_col = p_lay.dim(1);
+    const int n_lay = p_lay.dim(2);
+    const int n_lev = p_lev.dim(2);
+    const int n_gpt = this->kdist->get_ngpt();
+    const int n_bnd = this->kdist->get_nband();
+    const int n_alb = sfc_alb_dir.size();
+
+    const BOOL_TYPE top_at_1 = p_lay({1, 1}) < p_lay({1, n_lay});
+
+    // Spectral discretization in the precision of the solver.
+    const Optical_props<TF_store> spectral_disc_store(
+            convert_array<TF_store>(this->kdist->get_band_lims_wavenumber()), this->kdist->get_band_lims_gpoint());
+
+    for (int col_s=1; col_s<=n_col; col_s+=this->n_col_block)
+    {
+        const int col_e = std::min(col_s + this->n_col_block - 1, n_col);
+        const int n_col_in = col_e - col_s + 1;
+
+        std::unique_ptr<Optical_props_arry<TF>> optical_props;
+        Array<TF,2> toa_src;
+
+        sw_optics_subset(
+                *this->kdist, this->cloud_optics.get(), switch_cloud_optics, gas_concs,
+                col_s, col_e,
+                p_lay, p_lev, t_lay, col_dry, tsi_scaling,
+                lwp, iwp, rel, rei,
+                optical_props, toa_src);
+
+        // Hand the optical properties and incoming radiation to the solver in its precision.
+        std::unique_ptr<Optical_props_arry<TF_store>> optical_props_store;
+        if (!std::is_same<TF, TF_store>::value)
+            optical_props_store = std::make_unique<Optical_props_2str<TF_store>>(n_col_in, n_lay, spectral_disc_store);
+        const std::unique_ptr<Optical_props_arry<TF_store>>& optical_props_rte =
+                to_precision(optical_props, optical_props_store);
+        const Array<TF_store,2> toa_src_rte = to_store<TF_store>(std::move(toa_src));
+
+        std::vector<Array<TF_store,2>> sfc_alb_dir_subset;
+        std::vector<Array<TF_store,2>> sfc_alb_dif_subset;
+        for (int ialb=0; ialb<n_alb; ++ialb)
+        {
+            sfc_alb_dir_subset.push_back(to_store<TF_store>(sfc_alb_dir[ialb].subset({{ {1, n_bnd}, {col_s, col_e} }})));
+            sfc_alb_dif_subset.push_back(to_store<TF_store>(sfc_alb_dif[ialb].subset({{ {1, n_bnd}, {col_s, col_e} }})));
+        }
+
+        std::vector<Array<TF_store,3>> gpt_flux_up;
+        std::vector<Array<TF_store,3>> gpt_flux_dn;
+        Array<TF_store,3> gpt_flux_dn_dir({n_col_in, n_lev, n_gpt});
+
+        Rte_sw<TF_store>::rte_sw_albedos(
+                optical_props_rte,
+                top_at_1,
+                to_store<TF_store>(mu0.subset({{ {col_s, col_e} }})),
+                toa_src_rte,
+                sfc_alb_dir_subset,
+                sfc_alb_dif_subset,
+                Array<TF_store,2>(), // Add an empty array, no inc_flux.
+                gpt_flux_up,
+                gpt_flux_dn,
+                gpt_flux_dn_dir);
+
+        Fluxes_broadband<TF> fluxes(n_col_in, n_lev);
+
+        for (int ialb=0; ialb<n_alb; ++ialb)
+        {
+            fluxes.reduce(gpt_flux_up[ialb], gpt_flux_dn[ialb], gpt_flux_dn_dir, top_at_1);
+
+            for (int ilev=1; ilev<=n_lev; ++ilev)
+                for (int icol=1; icol<=n_col_in; ++icol)
+                {
+                    sw_flux_up [ialb]({icol+col_s-1, ilev}) = fluxes.get_flux_up ()({icol, ilev});
+                    sw_flux_dn [ialb]({icol+col_s-1, ilev}) = fluxes.get_flux_dn ()({icol, ilev});
+                    sw_flux_net[ialb]({icol+col_s-1, ilev}) = fluxes.get_flux_net()({icol, ilev});
+                }
+        }
+
+        for (int ilev=1; ilev<=n_lev; ++ilev)
+            for (int icol=1; icol<=n_col_in; ++icol)
+                sw_flux_dn_dir({icol+col_s-1, ilev}) = fluxes.get_flux_dn_dir()({icol, ilev});
+    }
+}
+
+template<typename TF>
+void Radiation_solver_shortwave<TF>::solve_mu0s(
+        const bool switch_cloud_optics,
+        const Gas_concs<TF>& gas_concs,
+        const Array_view<TF,2>& p_lay, const Array_view<TF,2>& p_lev,
+        const Array_view<TF,2>& t_lay, const Array_view<TF,2>& t_lev,
+        const Array_view<TF,2>& col_dry,
+        const Array_view<TF,2>& sfc_alb_dir, const Array_view<TF,2>& sfc_alb_dif,
+        const Array_view<TF,1>& tsi_scaling,
+        const std::vector<Array_view<TF,1>>& mu0,
+        const Array_view<TF,2>& lwp, const Array_view<TF,2>& iwp,
+        const Array_view<TF,2>& rel, const Array_view<TF,2>& rei,
+        std::vector<Array_view<TF,2>>& sw_flux_up, std::vector<Array_view<TF,2>>& sw_flux_dn,
+        std::vector<Array_view<TF,2>>& sw_flux_dn_dir, std::vector<Array_view<TF,2>>& sw_flux_net) const
+{
+    const std::size_t n_mu0 = mu0.size();
+    if (sw_flux_up.size() != n_mu0 || sw_flux_dn.size() != n_mu0
+            || sw_flux_dn_dir.size() != n_mu0 || sw_flux_net.size() != n_mu0)
+        throw std::runtime_error("Number of solar zenith angles and flux outputs differs");
+
+    if (this->sw_float_storage)
+        solve_mu0s_stored<float>(
+                switch_cloud_optics, gas_concs,
+                p_lay, p_lev, t_lay, col_dry,
+                sfc_alb_dir, sfc_alb_dif, tsi_scaling, mu0,
+                lwp, iwp, rel, rei,
+                sw_flux_up, sw_flux_dn, sw_flux_dn_dir, sw_flux_net);
+    else
+        solve_mu0s_stored<TF>(
+                switch_cloud_optics, gas_concs,
+                p_lay, p_lev, t_lay, col_dry,
+                sfc_alb_dir, sfc_alb_dif, tsi_scaling, mu0,
+                lwp, iwp, rel, rei,
+                sw_flux_up, sw_flux_dn, sw_flux_dn_dir, sw_flux_net);
+}
+
+template<typename TF>
+template<typename TF_store>
+void Radiation_solver_shortwave<TF>::solve_mu0s_stored(
+        const bool switch_cloud_optics,
+        const Gas_concs<TF>& gas_concs,
+        const Array_view<TF,2>& p_lay, const Array_view<TF,2>& p_lev,
+        const Array_view<TF,2>& t_lay, const Array_view<TF,2>& col_dry,
+        const Array_view<TF,2>& sfc_alb_dir, const Array_view<TF,2>& sfc_alb_dif,
+        const Array_view<TF,1>& tsi_scaling,
+        const std::vector<Array_view<TF,1>>& mu0,
+        const Array_view<TF,2>& lwp, const Array_view<TF,2>& iwp,
+        const Array_view<TF,2>& rel, const Array_view<TF,2>& rei,
+        std::vector<Array_view<TF,2>>& sw_flux_up, std::vector<Array_view<TF,2>>& sw_flux_dn,
+        std::vector<Array_view<TF,2>>& sw_flux_dn_dir, std::vector<Array_view<TF,2>>& sw_flux_net) const
+{
+    const int n_col = p_lay.dim(1);
+    const int n_lay = p_lay.dim(2);
+    const int n_lev = p_lev.dim(2);
+    const int n_bnd = this->kdist->get_nband();
+    const int n_mu0 = mu0.size();
+
+    const BOOL_TYPE top_at_1 = p_lay({1, 1}) < p_lay({1, n_lay});
+
+    // Spectral discretization in the precision of the solver.
+    const Optical_props<TF_store> spectral_disc_store(
+            convert_array<TF_store>(this->kdist->get_band_lims_wavenumber()), this->kdist->get_band_lims_gpoint());
+
+    for (int col_s=1; col_s<=n_col; col_s+=this->n_col_block)
+    {
+        const int col_e = std::min(col_s + this->n_col_block - 1, n_col);
+        const int n_col_in = col_e - col_s + 1;
+
+        std::unique_ptr<Optical_props_arry<TF>> optical_props;
+        Array<TF,2> toa_src;
+
+        sw_optics_subset(
+                *this->kdist, this->cloud_optics.get(), switch_cloud_optics, gas_concs,
+                col_s, col_e,
+                p_lay, p_lev, t_lay, col_dry, tsi_scaling,
+                lwp, iwp, rel, rei,
+                optical_props, toa_src);
+
+        // Hand the optical properties and incoming radiation to the solver in its precision.
+        std::unique_ptr<Optical_props_arry<TF_store>> optical_props_store;
+        if (!std::is_same<TF, TF_store>::value)
+            optical_props_store = std::make_unique<Optical_props_2str<TF_store>>(n_col_in, n_lay, spectral_disc_store);
+        const std::unique_ptr<Optical_props_arry<TF_store>>& optical_props_rte =
+                to_precision(optical_props, optical_props_store);
+        const Array<TF_store,2> toa_src_rte = to_store<TF_store>(std::move(toa_src));
+
+        std::vector<Array<TF_store,1>> mu0_subset;
+        for (int imu0=0; imu0<n_mu0; ++imu0)
+            mu0_subset.push_back(to_store<TF_store>(mu0[imu0].subset({{ {col_s, col_e} }})));
+
+        std::vector<Array<TF_store,3>> gpt_flux_up;
+        std::vector<Array<TF_store,3>> gpt_flux_dn;
+        std::vector<Array<TF_store,3>> gpt_flux_dn_dir;
+
+        Rte_sw<TF_store>::rte_sw_mu0s(
+                optical_props_rte,
+                top_at_1,
+                mu0_subset,
+                toa_src_rte,
+                to_store<TF_store>(sfc_alb_dir.subset({{ {1, n_bnd}, {col_s, col_e} }})),
+                to_store<TF_store>(sfc_alb_dif.subset({{ {1, n_bnd}, {col_s, col_e} }})),
+                Array<TF_store,2>(), // Add an empty array, no inc_flux.
+                gpt_flux_up,
+                gpt_flux_dn,
+                gpt_flux_dn_dir);
+
+        Fluxes_broadband<TF> fluxes(n_col_in, n_lev);
+
+        for (int imu0=0; imu0<n_mu0; ++imu0)
+        {
+            fluxes.reduce(gpt_flux_up[imu0], gpt_flux_dn[imu0], gpt_flux_dn_dir[imu0], top_at_1);
+
+            for (int ilev=1; ilev<=n_lev; ++ilev)
+                for (int icol=1; icol<=n_col_in; ++icol)
+                {
+                    sw_flux_up    [imu0]({icol+col_s-1, ilev}) = fluxes.get_flux_up    ()({icol, ilev});
+                    sw_flux_dn    [imu0]({icol+col_s-1, ilev}) = fluxes.get_flux_dn    ()({icol, ilev});
+                    sw_flux_dn_dir[imu0]({icol+col_s-1, ilev}) = fluxes.get_flux_dn_dir()({icol, ilev});
+                    sw_flux_net   [imu0]({icol+col_s-1, ilev}) = fluxes.get_flux_net   ()({icol, ilev});
+                }
+        }
+    }
+}
+
+Radiation_solver_longwave_mixed::Radiation_solver_longwave_mixed(
+        const Gas_concs<double>& gas_concs,
+        const std::string& file_name_gas,
+        const Precision_config& precision) :
+    precision(precision)
+{
+    if (precision.gas_optics == Precision::Single)
+        kdist_float = std::make_unique<Gas_optics_rrtmgp<float>>(
+                load_and_init_gas_optics_rrtmgp<float>(Gas_concs<float>(gas_concs), file_name_gas));
+    else
+        kdist_double = std::make_unique<Gas_optics_rrtmgp<double>>(
+                load_and_init_gas_optics_rrtmgp<double>(gas_concs, file_name_gas));
+}
+
+template<>
+const Gas_optics_rrtmgp<float>& Radiation_solver_longwave_mixed::get_kdist<float>() const
+{
+    return *this->kdist_float;
+}
+
+template<>
+const Gas_optics_rrtmgp<double>& Radiation_solver_longwave_mixed::get_kdist<double>() const
+{
+    return *this->kdist_double;
+}
+
+int Radiation_solver_longwave_mixed::get_n_bnd() const
+{
+    return kdist_float ? kdist_float->get_nband() : kdist_double->get_nband();
+}
+
+int Radiation_solver_longwave_mixed::get_n_gpt() const
+{
+    return kdist_float ? kdist_float->get_ngpt() : kdist_double->get_ngpt();
+}
+
+void Radiation_solver_longwave_mixed::set_n_col_block(const int n_col_block)
+{
+    if (n_col_block < 1)
+        throw std::runtime_error("The number of columns per block should be at least one");
+    this->n_col_block = n_col_block;
+}
+
+void Radiation_solver_longwave_mixed::solve(
+        const Gas_concs<double>& gas_concs,
+        const Array<double,2>& p_lay, const Array<double,2>& p_lev,
+        const Array<double,2>& t_lay, const Array<double,2>& t_lev,
+        const Array<double,1>& t_sfc, const Array<double,2>& emis_sfc,
+        Array<double,2>& lw_flux_up, Array<double,2>& lw_flux_dn, Array<double,2>& lw_flux_net) const
+{
+    const int i_config =
+            4*(precision.gas_optics == Precision::Single)
+          + 2*(precision.solver     == Precision::Single)
+          +   (precision.fluxes     == Precision::Single);
+
+    auto solve_config = [&](auto solve_stages_ptr)
+    {
+        (this->*solve_stages_ptr)(
+                gas_concs, p_lay, p_lev, t_lay, t_lev, t_sfc, emis_sfc,
+                lw_flux_up, lw_flux_dn, lw_flux_net);
+    };
+
+    switch (i_config)
+    {
+        case 0: solve_config(&Radiation_solver_longwave_mixed::solve_stages<double, double, double>); break;
+        case 1: solve_config(&Radiation_solver_longwave_mixed::solve_stages<double, double, float >); break;
+        case 2: solve_config(&Radiation_solver_longwave_mixed::solve_stages<double, float , double>); break;
+        case 3: solve_config(&Radiation_solver_longwave_mixed::solve_stages<double, float , float >); break;
+        case 4: solve_config(&Radiation_solver_longwave_mixed::solve_stages<float , double, double>); break;
+        case 5: solve_config(&Radiation_solver_longwave_mixed::solve_stages<float , double, float >); break;
+        case 6: solve_config(&Radiation_solver_longwave_mixed::solve_stages<float , float , double>); break;
+        case 7: solve_config(&Radiation_solver_longwave_mixed::solve_stages<float , float , float >); break;
+    }
+}
+
+template<typename TF_gas, typename TF_rte, typename TF_flux>
+void Radiation_solver_longwave_mixed::solve_stages(
+        const Gas_concs<double>& gas_concs,
+        const Array<double,2>& p_lay, const Array<double,2>& p_lev,
+        const Array<double,2>& t_lay, const Array<double,2>& t_lev,
+        const Array<double,1>& t_sfc, const Array<double,2>& emis_sfc,
+        Array<double,2>& lw_flux_up, Array<double,2>& lw_flux_dn, Array<double,2>& lw_flux_net) const
+{
+    const Gas_optics_rrtmgp<TF_gas>& kdist = get_kdist<TF_gas>();
+
+    const int n_col = p_lay.dim(1);
+    const int n_lay = p_lay.dim(2);
+    const int n_lev = p_lev.dim(2);
+    const int n_gpt = kdist.get_ngpt();
+    const int n_bnd = kdist.get_nband();
+
+    const BOOL_TYPE top_at_1 = p_lay({1, 1}) < p_lay({1, n_lay});
+
+    // Convert the input to the precision of the stage that uses it.
+    const Gas_concs<TF_gas> gas_concs_gas(gas_concs);
+    const Array<TF_gas,2> p_lay_gas = convert_array<TF_gas>(p_lay);
+    const Array<TF_gas,2> p_lev_gas = convert_array<TF_gas>(p_lev);
+    const Array<TF_gas,2> t_lay_gas = convert_array<TF_gas>(t_lay);
+    const Array<TF_gas,2> t_lev_gas = convert_array<TF_gas>(t_lev);
+    const Array<TF_gas,1> t_sfc_gas = convert_array<TF_gas>(t_sfc);
+    const Array<TF_rte,2> emis_sfc_rte = convert_array<TF_rte>(emis_sfc);
+
+    // Spectral discretization in the precision of the solver.
+    const Optical_props<TF_rte> spectral_disc_rte(
+            convert_array<TF_rte>(kdist.get_band_lims_wavenumber()), kdist.get_band_lims_gpoint());
+
+    std::unique_ptr<Optical_props_arry<TF_gas>> optical_props_gas;
+    std::unique_ptr<Optical_props_arry<TF_rte>> optical_props_rte;
+    std::unique_ptr<Source_func_lw<TF_gas>> sources_gas;
+    std::unique_ptr<Source_func_lw<TF_rte>> sources_rte;
+    std::unique_ptr<Fluxes_broadband<TF_flux>> fluxes;
+
+    Array<TF_rte,3> gpt_flux_up;
+    Array<TF_rte,3> gpt_flux_dn;
+    Array<TF_flux,3> gpt_flux_up_flux;
+    Array<TF_flux,3> gpt_flux_dn_flux;
+
+    for (int col_s=1; col_s<=n_col; col_s+=this->n_col_block)
+    {
+        const int col_e = std::min(col_s + this->n_col_block - 1, n_col);
+        const int n_col_in = col_e - col_s + 1;
+
+        // (Re)create the containers for the first block and the residual block.
+        if (!optical_props_gas || optical_props_gas->get_ncol() != n_col_in)
+        {
+            optical_props_gas = std::make_unique<Optical_props_1scl<TF_gas>>(n_col_in, n_lay, kdist);
+            sources_gas = std::make_unique<Source_func_lw<TF_gas>>(n_col_in, n_lay, kdist);
+
+            if (!std::is_same<TF_gas, TF_rte>::value)
+            {
+                optical_props_rte = std::make_unique<Optical_props_1scl<TF_rte>>(n_col_in, n_lay, spectral_disc_rte);
+                sources_rte = std::make_unique<Source_func_lw<TF_rte>>(n_col_in, n_lay, spectral_disc_rte);
+            }
+
+            gpt_flux_up = Array<TF_rte,3>({n_col_in, n_lev, n_gpt});
+            gpt_flux_dn = Array<TF_rte,3>({n_col_in, n_lev, n_gpt});
+
+            if (!std::is_same<TF_rte, TF_flux>::value)
+            {
+                gpt_flux_up_flux = Array<TF_flux,3>({n_col_in, n_lev, n_gpt});
+                gpt_flux_dn_flux = Array<TF_flux,3>({n_col_in, n_lev, n_gpt});
+            }
+
+            fluxes = std::make_unique<Fluxes_broadband<TF_flux>>(n_col_in, n_lev);
+        }
+
+        Gas_concs<TF_gas> gas_concs_subset(gas_concs_gas, col_s, n_col_in);
+        Array<TF_gas,2> p_lev_subset = p_lev_gas.subset({{ {col_s, col_e}, {1, n_lev} }});
+
+        Array<TF_gas,2> col_dry_subset({n_col_in, n_lay});
+        Gas_optics_rrtmgp<TF_gas>::get_col_dry(col_dry_subset, gas_concs_subset.get_vmr("h2o"), p_lev_subset);
+
+        kdist.gas_optics(
+                p_lay_gas.subset({{ {col_s, col_e}, {1, n_lay} }}),
+                p_lev_subset,
+                t_lay_gas.subset({{ {col_s, col_e}, {1, n_lay} }}),
+                t_sfc_gas.subset({{ {col_s, col_e} }}),
+                gas_concs_subset,
+                optical_props_gas,
+                *sources_gas,
+                col_dry_subset,
+                t_lev_gas.subset({{ {col_s, col_e}, {1, n_lev} }}) );
+
+        constexpr int n_ang = 1;
+
+        Rte_lw<TF_rte>::rte_lw(
+                to_precision(optical_props_gas, optical_props_rte),
+                top_at_1,
+                to_precision(sources_gas, sources_rte),
+                emis_sfc_rte.subset({{ {1, n_bnd}, {col_s, col_e} }}),
+                Array<TF_rte,2>(), // Add an empty array, no inc_flux.
+                gpt_flux_up, gpt_flux_dn,
+                n_ang);
+
+        // The reduction does not use the spectral discretization.
+        fluxes->reduce(
+                to_precision(gpt_flux_up, gpt_flux_up_flux),
+                to_precision(gpt_flux_dn, gpt_flux_dn_flux),
+                std::unique_ptr<Optical_props_arry<TF_flux>>(),
+                top_at_1);
+
+        for (int ilev=1; ilev<=n_lev; ++ilev)
+            for (int icol=1; icol<=n_col_in; ++icol)
+            {
+                lw_flux_up ({icol+col_s-1, ilev}) = fluxes->get_flux_up ()({icol, ilev});
+                lw_flux_dn ({icol+col_s-1, ilev}) = fluxes->get_flux_dn ()({icol, ilev});
+                lw_flux_net({icol+col_s-1, ilev}) = fluxes->get_flux_net()({icol, ilev});
+            }
+    }
+}
+
+template<typename TF>
+Radiation_solver_longwave_incremental<TF>::Radiation_solver_longwave_incremental(
+        const Radiation_solver_longwave<TF>& solver,
+        const Incremental_tolerances<TF>& tolerances) :
+    solver(solver), tolerances(tolerances)
+{}
+
+template<typename TF>
+void Radiation_solver_longwave_incremental<TF>::solve(
+        const bool switch_cloud_optics,
+        const Gas_concs<TF>& gas_concs,
+        const Array_view<TF,2>& p_lay, const Array_view<TF,2>& p_lev,
+        const Array_view<TF,2>& t_lay, const Array_view<TF,2>& t_lev,
+        const Array_view<TF,2>& col_dry,
+        const Array_view<TF,1>& t_sfc, const Array_view<TF,2>& emis_sfc,
+        const Array_view<TF,2>& lwp, const Array_view<TF,2>& iwp,
+        const Array_view<TF,2>& rel, const Array_view<TF,2>& rei,
+        Array_view<TF,2> lw_flux_up, Array_view<TF,2> lw_flux_dn, Array_view<TF,2> lw_flux_net)
+{
+    const int n_col = p_lay.dim(1);
+    const int n_lev = p_lev.dim(2);
+
+    std::vector<Change_input<TF>> inputs = {
+            {p_lay, false, TF(0.), tolerances.p_rel},
+            {p_lev, false, TF(0.), tolerances.p_rel},
+            {t_lay, false, tolerances.t_abs, TF(0.)},
+            {t_lev, false, tolerances.t_abs, TF(0.)},
+            {as_2d(t_sfc), false, tolerances.t_abs, TF(0.)},
+            {emis_sfc, true, tolerances.sfc_abs, TF(0.)} };
+
+    if (gas_concs.exists("h2o"))
+        inputs.push_back({gas_concs.get_vmr("h2o"), false, TF(0.), tolerances.h2o_rel});
+
+    if (switch_cloud_optics)
+        add_change_inputs_cloud(inputs, lwp, iwp, rel, rei, tolerances.cloud_abs);
+
+    const std::vector<int> cols = changed_columns(inputs, reference, age, tolerances.max_age, n_col);
+    const int n_col_sub = cols.size();
+
+    if (n_col_sub == n_col)
+    {
+        flux_up  = Array<TF,2>({n_col, n_lev});
+        flux_dn  = Array<TF,2>({n_col, n_lev});
+        flux_net = Array<TF,2>({n_col, n_lev});
+
+        solver.solve(
+                true, switch_cloud_optics, false, false,
+                gas_concs,
+                p_lay, p_lev, t_lay, t_lev, col_dry, t_sfc, emis_sfc,
+                lwp, iwp, rel, rei,
+                Array_view<TF,3>(), Array_view<TF,3>(), Array_view<TF,3>(), Array_view<TF,3>(), Array_view<TF,2>(),
+                flux_up, flux_dn, flux_net,
+                Array_view<TF,3>(), Array_view<TF,3>(), Array_view<TF,3>());
+    }
+    else if (n_col_sub > 0)
+    {
+        using namespace column_kernels;
+
+        Array<TF,2> flux_up_sub ({n_col_sub, n_lev});
+        Array<TF,2> flux_dn_sub ({n_col_sub, n_lev});
+        Array<TF,2> flux_net_sub({n_col_sub, n_lev});
+
+        solver.solve(
+                true, switch_cloud_optics, false, false,
+                Gas_concs<TF>(gas_concs, cols),
+                gather(p_lay, cols), gather(p_lev, cols),
+                gather(t_lay, cols), gather(t_lev, cols),
+                gather(col_dry, cols),
+                gather(t_sfc, cols), gather_dim2(emis_sfc, cols),
+                gather(lwp, cols), gather(iwp, cols),
+                gather(rel, cols), gather(rei, cols),
+                Array_view<TF,3>(), Array_view<TF,3>(), Array_view<TF,3>(), Array_view<TF,3>(), Array_view<TF,2>(),
+                flux_up_sub, flux_dn_sub, flux_net_sub,
+                Array_view<TF,3>(), Array_view<TF,3>(), Array_view<TF,3>());
+
+        scatter(flux_up,  flux_up_sub,  cols);
+        scatter(flux_dn,  flux_dn_sub,  cols);
+        scatter(flux_net, flux_net_sub, cols);
+    }
+
+    update_reference(inputs, reference, age, cols, n_col);
+
+    ++stats.n_calls;
+    stats.n_col_total += n_col;
+    stats.n_col_recomputed += n_col_sub;
+    stats.n_col_last = n_col;
+    stats.n_col_recomputed_last = n_col_sub;
+
+    copy_fluxes(lw_flux_up,  flux_up);
+    copy_fluxes(lw_flux_dn,  flux_dn);
+    copy_fluxes(lw_flux_net, flux_net);
+}
+
+template<typename TF>
+Radiation_solver_shortwave_incremental<TF>::Radiation_solver_shortwave_incremental(
+        const Radiation_solver_shortwave<TF>& solver,
+        const Incremental_tolerances<TF>& tolerances) :
+    solver(solver), tolerances(tolerances)
+{}
+
+template<typename TF>
+void Radiation_solver_shortwave_incremental<TF>::solve(
+        const bool switch_cloud_optics,
+        const Gas_concs<TF>& gas_concs,
+        const Array_view<TF,2>& p_lay, const Array_view<TF,2>& p_lev,
+        const Array_view<TF,2>& t_lay, const Array_view<TF,2>& t_lev,
+        const Array_view<TF,2>& col_dry,
+        const Array_view<TF,2>& sfc_alb_dir, const Array_view<TF,2>& sfc_alb_dif,
+        const Array_view<TF,1>& tsi_scaling, const Array_view<TF,1>& mu0,
+        const Array_view<TF,2>& lwp, const Array_view<TF,2>& iwp,
+        const Array_view<TF,2>& rel, const Array_view<TF,2>& rei,
+        Array_view<TF,2> sw_flux_up, Array_view<TF,2> sw_flux_dn,
+        Array_view<TF,2> sw_flux_dn_dir, Array_view<TF,2> sw_flux_net)
+{
+    const int n_col = p_lay.dim(1);
+    const int n_lev = p_lev.dim(2);
+
+    std::vector<Change_input<TF>> inputs = {
+            {p_lay, false, TF(0.), tolerances.p_rel},
+            {p_lev, false, TF(0.), tolerances.p_rel},
+            {t_lay, false, tolerances.t_abs, TF(0.)},
+            {as_2d(mu0), false, tolerances.mu0_abs, TF(0.)},
+            {sfc_alb_dir, true, tolerances.sfc_abs, TF(0.)},
+            {sfc_alb_dif, true, tolerances.sfc_abs, TF(0.)} };
+
+    if (gas_concs.exists("h2o"))
+        inputs.push_back({gas_concs.get_vmr("h2o"), false, TF(0.), tolerances.h2o_rel});
+
+    if (switch_cloud_optics)
+        add_change_inputs_cloud(inputs, lwp, iwp, rel, rei, tolerances.cloud_abs);
+
+    const std::vector<int> cols = changed_columns(inputs, reference, age, tolerances.max_age, n_col);
+    const int n_col_sub = cols.size();
+
+    if (n_col_sub == n_col)
+    {
+        flux_up     = Array<TF,2>({n_col, n_lev});
+        flux_dn     = Array<TF,2>({n_col, n_lev});
+        flux_dn_dir = Array<TF,2>({n_col, n_lev});
+        flux_net    = Array<TF,2>({n_col, n_lev});
+
+        solver.solve(
+                true, switch_cloud_optics, false, false,
+                gas_concs,
+                p_lay, p_lev, t_lay, t_lev, col_dry,
+                sfc_alb_dir, sfc_alb_dif, tsi_scaling, mu0,
+                lwp, iwp, rel, rei,
+                Array_view<TF,3>(), Array_view<TF,3>(), Array_view<TF,3>(), Array_view<TF,2>(),
+                flux_up, flux_dn, flux_dn_dir, flux_net,
+                Array_view<TF,3>(), Array_view<TF,3>(), Array_view<TF,3>(), Array_view<TF,3>());
+
+        tsi_scaling_ref.resize(n_col);
+    }
+    else if (n_col_sub > 0)
+    {
+        using namespace column_kernels;
+
+        Array<TF,2> flux_up_sub    ({n_col_sub, n_lev});
+        Array<TF,2> flux_dn_sub    ({n_col_sub, n_lev});
+        Array<TF,2> flux_dn_dir_sub({n_col_sub, n_lev});
+        Array<TF,2> flux_net_sub   ({n_col_sub, n_lev});
+
+        solver.solve(
+                true, switch_cloud_optics, false, false,
+                Gas_concs<TF>(gas_concs, cols),
+                gather(p_lay, cols), gather(p_lev, cols),
+                gather(t_lay, cols), gather(t_lev, cols),
+                gather(col_dry, cols),
+                gather_dim2(sfc_alb_dir, cols), gather_dim2(sfc_alb_dif, cols),
+                gather(tsi_scaling, cols), gather(mu0, cols),
+                gather(lwp, cols), gather(iwp, cols),
+                gather(rel, cols), gather(rei, cols),
+                Array_view<TF,3>(), Array_view<TF,3>(), Array_view<TF,3>(), Array_view<TF,2>(),
+                flux_up_sub, flux_dn_sub, flux_dn_dir_sub, flux_net_sub,
+                Array_view<TF,3>(), Array_view<TF,3>(), Array_view<TF,3>(), Array_view<TF,3>());
+
+        scatter(flux_up,     flux_up_sub,     cols);
+        scatter(flux_dn,     flux_dn_sub,     cols);
+        scatter(flux_dn_dir, flux_dn_dir_sub, cols);
+        scatter(flux_net,    flux_net_sub,    cols);
+    }
+
+    update_reference(inputs, reference, age, cols, n_col);
+
+    // The reused columns are rescaled with the ratio of the current and the cached TSI scaling.
+    const bool tsi_spread = (tsi_scaling.dim(1) == 1);
+    for (const int icol : cols)
+        tsi_scaling_ref[icol-1] = tsi_scaling({tsi_spread ? 1 : icol});
+
+    for (int icol=1; icol<=n_col; ++icol)
+    {
+        const TF tsi_ratio = tsi_scaling({tsi_spread ? 1 : icol}) / tsi_scaling_ref[icol-1];
+        if (tsi_ratio == TF(1.))
+            continue;
+
+        for (int ilev=1; ilev<=n_lev; ++ilev)
+        {
+            flux_up    ({icol, ilev}) *= tsi_ratio;
+            flux_dn    ({icol, ilev}) *= tsi_ratio;
+            flux_dn_dir({icol, ilev}) *= tsi_ratio;
+            flux_net   ({icol, ilev}) *= tsi_ratio;
+        }
+        tsi_scaling_ref[icol-1] = tsi_scaling({tsi_spread ? 1 : icol});
+    }
+
+    ++stats.n_calls;
+    stats.n_col_total += n_col;
+    stats.n_col_recomputed += n_col_sub;
+    stats.n_col_last = n_col;
+    stats.n_col_recomputed_last = n_col_sub;
+
+    copy_fluxes(sw_flux_up,     flux_up);
+    copy_fluxes(sw_flux_dn,     flux_dn);
+    copy_fluxes(sw_flux_dn_dir, flux_dn_dir);
+    copy_fluxes(sw_flux_net,    flux_net);
+}
+
 template class Radiation_solver_longwave<float>;
 template class Radiation_solver_shortwave<float>;
-#else
 template class Radiation_solver_longwave<double>;
 template class Radiation_solver_shortwave<double>;
-#endif
+template class Radiation_solver_longwave_incremental<float>;
+template class Radiation_solver_shortwave_incremental<float>;
+template class Radiation_solver_longwave_incremental<double>;
+template class Radiation_solver_shortwave_incremental<double>;
+
+template Gas_optics_rrtmgp<float> load_and_init_gas_optics_rrtmgp(const Gas_concs<float>&, const std::string&);
+template Gas_optics_rrtmgp<double> load_and_init_gas_optics_rrtmgp(const Gas_concs<double>&, const std::string&);
@@ -0,0 +1,376 @@
+/*
+ * This file is part of the C and Fortran interface to the solvers that are
+ * used for the testing of the C++ interface to the RTE+RRTMGP radiation code.
+ *
+ * It is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Radiation_solver_c.h"
+#include "Radiation_solver.h"
+#include "Radiation_plan.h"
+#include "Netcdf_interface.h"
+
+using Float = rrtmgp_real;
+
+struct Rrtmgp_lw
+{
+    std::unique_ptr<Radiation_solver_longwave<Float>> solver;
+    std::unique_ptr<Radiation_plan_lw<Float>> plan;
+    Radiation_inputs_lw<Float> inputs;
+    Radiation_outputs_lw<Float> outputs;
+    bool switch_cloud_optics = false;
+};
+
+struct Rrtmgp_sw
+{
+    std::unique_ptr<Radiation_solver_shortwave<Float>> solver;
+    std::unique_ptr<Radiation_plan_sw<Float>> plan;
+    Radiation_inputs_sw<Float> inputs;
+    Radiation_outputs_sw<Float> outputs;
+    bool switch_cloud_optics = false;
+};
+
+namespace
+{
+    thread_local std::string last_error;
+
+    // Run a function and translate its exceptions into a status code, as exceptions cannot cross the C interface.
+    template<typename Function>
+    int call(Function&& function)
+    {
+        try
+        {
+            function();
+            return 0;
+        }
+        catch (std::exception& e)
+        {
+            last_error = e.what();
+            return 1;
+        }
+        catch (...)
+        {
+            last_error = "Unknown error";
+            return 1;
+        }
+    }
+
+    template<int N>
+    Array_view<Float,N> make_view(
+            Float* data, const int n_dims, const int* dims, const int* strides, const std::string& name)
+    {
+        if (n_dims != N)
+            throw std::runtime_error("Field " + name + " has " + std::to_string(N) + " dimensions");
+
+        // Without strides the memory is contiguous.
+        std::array<int,N> dims_view;
+        std::copy(dims, dims+N, dims_view.begin());
+
+        if (strides == nullptr)
+            return Array_view<Float,N>(data, dims_view);
+
+        std::array<int,N> strides_view;
+        std::copy(strides, strides+N, strides_view.begin());
+        return Array_view<Float,N>(data, dims_view, strides_view);
+    }
+
+    // Gas concentrations with only the names of the gases, which is all the gas optics need at construction.
+    Gas_concs<Float> make_gas_names(const std::string& gas_names)
+    {
+        Gas_concs<Float> gas_concs;
+        std::istringstream names(gas_names);
+        std::string name;
+        while (names >> name)
+            gas_concs.set_vmr(name, Float(0.));
+
+        if (gas_concs.get_gas_names().empty())
+            throw std::runtime_error("No gases given");
+
+        return gas_concs;
+    }
+
+    const std::map<std::string, Array_view<Float,2> Radiation_inputs_lw<Float>::*> lw_inputs_2d = {
+        {"p_lay", &Radiation_inputs_lw<Float>::p_lay}, {"p_lev", &Radiation_inputs_lw<Float>::p_lev},
+        {"t_lay", &Radiation_inputs_lw<Float>::t_lay}, {"t_lev", &Radiation_inputs_lw<Float>::t_lev},
+        {"col_dry", &Radiation_inputs_lw<Float>::col_dry},
+        {"emis_sfc", &Radiation_inputs_lw<Float>::emis_sfc},
+        {"lwp", &Radiation_inputs_lw<Float>::lwp}, {"iwp", &Radiation_inputs_lw<Float>::iwp},
+        {"rel", &Radiation_inputs_lw<Float>::rel}, {"rei", &Radiation_inputs_lw<Float>::rei} };
+
+    const std::map<std::string, Array_view<Float,1> Radiation_inputs_lw<Float>::*> lw_inputs_1d = {
+        {"t_sfc", &Radiation_inputs_lw<Float>::t_sfc} };
+
+    const std::map<std::string, Array_view<Float,2> Radiation_outputs_lw<Float>::*> lw_outputs = {
+        {"flux_up", &Radiation_outputs_lw<Float>::flux_up},
+        {"flux_dn", &Radiation_outputs_lw<Float>::flux_dn},
+        {"flux_net", &Radiation_outputs_lw<Float>::flux_net} };
+
+    const std::map<std::string, Array_view<Float,2> Radiation_inputs_sw<Float>::*> sw_inputs_2d = {
+        {"p_lay", &Radiation_inputs_sw<Float>::p_lay}, {"p_lev", &Radiation_inputs_sw<Float>::p_lev},
+        {"t_lay", &Radiation_inputs_sw<Float>::t_lay}, {"t_lev", &Radiation_inputs_sw<Float>::t_lev},
+        {"col_dry", &Radiation_inputs_sw<Float>::col_dry},
+        {"sfc_alb_dir", &Radiation_inputs_sw<Float>::sfc_alb_dir},
+        {"sfc_alb_dif", &Radiation_inputs_sw<Float>::sfc_alb_dif},
+        {"lwp", &Radiation_inputs_sw<Float>::lwp}, {"iwp", &Radiation_inputs_sw<Float>::iwp},
+        {"rel", &Radiation_inputs_sw<Float>::rel}, {"rei", &Radiation_inputs_sw<Float>::rei} };
+
+    const std::map<std::string, Array_view<Float,1> Radiation_inputs_sw<Float>::*> sw_inputs_1d = {
+        {"tsi_scaling", &Radiation_inputs_sw<Float>::tsi_scaling},
+        {"mu0", &Radiation_inputs_sw<Float>::mu0} };
+
+    const std::map<std::string, Array_view<Float,2> Radiation_outputs_sw<Float>::*> sw_outputs = {
+        {"flux_up", &Radiation_outputs_sw<Float>::flux_up},
+        {"flux_dn", &Radiation_outputs_sw<Float>::flux_dn},
+        {"flux_dn_dir", &Radiation_outputs_sw<Float>::flux_dn_dir},
+        {"flux_net", &Radiation_outputs_sw<Float>::flux_net} };
+
+    // Fields that have to be registered before a solve, the cloud fields only with cloud optics.
+    const std::vector<std::string> lw_required = {"p_lay", "p_lev", "t_lay", "t_lev", "t_sfc", "emis_sfc"};
+    const std::vector<std::string> sw_required = {
+        "p_lay", "p_lev", "t_lay", "sfc_alb_dir", "sfc_alb_dif", "tsi_scaling", "mu0"};
+    const std::vector<std::string> cloud_required = {"lwp", "iwp", "rel", "rei"};
+
+    // Shape of a field as in the C++ solvers.
+    template<int N>
+    std::array<int,N> field_dims(const std::string& name, const int n_col, const int n_lay, const int n_bnd);
+
+    template<>
+    std::array<int,1> field_dims<1>(const std::string& name, const int n_col, const int n_lay, const int n_bnd)
+    {
+        return {n_col};
+    }
+
+    template<>
+    std::array<int,2> field_dims<2>(const std::string& name, const int n_col, const int n_lay, const int n_bnd)
+    {
+        if (name == "emis_sfc" || name == "sfc_alb_dir" || name == "sfc_alb_dif")
+            return {n_bnd, n_col};
+        else if (name == "p_lev" || name == "t_lev" || name.compare(0, 5, "flux_") == 0)
+            return {n_col, n_lay+1};
+        else
+            return {n_col, n_lay};
+    }
+
+    template<int N, typename Handle>
+    Array_view<Float,N> make_field_view(
+            const Handle& handle, const std::string& name, Float* data,
+            const int n_dims, const int* dims, const int* strides)
+    {
+        Array_view<Float,N> view = make_view<N>(data, n_dims, dims, strides, name);
+
+        const std::array<int,N> dims_expected = field_dims<N>(
+                name, handle.plan->get_n_col(), handle.plan->get_n_lay(),
+                handle.solver->get_gas_optics().get_nband());
+
+        if (view.get_dims() != dims_expected)
+            throw std::runtime_error("Shape of field " + name + " does not match the solver");
+
+        return view;
+    }
+
+    // Store the view of a field in the inputs or the outputs of a solver, looking up the field by name.
+    template<typename Handle, typename Inputs_2d, typename Inputs_1d, typename Outputs>
+    void register_field(
+            Handle& handle, const std::string& name, Float* data,
+            const int n_dims, const int* dims, const int* strides,
+            const Inputs_2d& inputs_2d, const Inputs_1d& inputs_1d, const Outputs& outputs)
+    {
+        if (inputs_2d.count(name))
+            handle.inputs.*inputs_2d.at(name) = make_field_view<2>(handle, name, data, n_dims, dims, strides);
+        else if (inputs_1d.count(name))
+            handle.inputs.*inputs_1d.at(name) = make_field_view<1>(handle, name, data, n_dims, dims, strides);
+        else if (outputs.count(name))
+            handle.outputs.*outputs.at(name) = make_field_view<2>(handle, name, data, n_dims, dims, strides);
+        else
+            throw std::runtime_error("Unknown field " + name);
+    }
+
+    template<typename Handle, typename Inputs_2d, typename Inputs_1d>
+    void check_registered(
+            const Handle& handle, const std::vector<std::string>& required,
+            const Inputs_2d& inputs_2d, const Inputs_1d& inputs_1d)
+    {
+        auto is_registered = [&](const std::string& name)
+        {
+            return inputs_2d.count(name)
+                ? !(handle.inputs.*inputs_2d.at(name)).is_empty()
+                : !(handle.inputs.*inputs_1d.at(name)).is_empty();
+        };
+
+        for (const std::string& name : required)
+            if (!is_registered(name))
+                throw std::runtime_error("Field " + name + " is not registered");
+
+        if (handle.switch_cloud_optics)
+            for (const std::string& name : cloud_required)
+                if (!is_registered(name))
+                    throw std::runtime_error("Field " + name + " is not registered");
+
+        if (handle.inputs.gas_vmr.empty())
+            throw std::runtime_error("No gases are registered");
+    }
+
+    template<typename Handle>
+    void register_gas(Handle& handle, const std::string& name, Float* data, const int* dims, const int* strides)
+    {
+        Array_view<Float,2> view = make_view<2>(data, 2, dims, strides, name);
+
+        if (view.dim(2) != handle.plan->get_n_lay() || (view.dim(1) != 1 && view.dim(1) != handle.plan->get_n_col()))
+            throw std::runtime_error("Shape of gas " + name + " does not match the solver");
+
+        handle.inputs.gas_vmr[name] = view;
+    }
+}
+
+extern "C"
+{
+    int rrtmgp_lw_create(
+            Rrtmgp_lw** solver,
+            const char* gas_names,
+            const char* file_name_gas, const char* file_name_cloud,
+            const char* file_name_weights, const char* file_name_input,
+            int n_col, int n_lay,
+            int switch_cloud_optics, int switch_nn_gas_optics,
+            int n_col_block)
+    {
+        return call([&]
+        {
+            auto handle = std::make_unique<Rrtmgp_lw>();
+            Netcdf_file input_nc(file_name_input, Netcdf_mode::Read);
+
+            handle->solver = std::make_unique<Radiation_solver_longwave<Float>>(
+                    make_gas_names(gas_names),
+                    file_name_gas, file_name_cloud, file_name_weights, input_nc,
+                    switch_cloud_optics, switch_nn_gas_optics);
+
+            Radiation_plan_options options;
+            options.n_col_block = n_col_block;
+            options.switch_cloud_optics = switch_cloud_optics;
+            handle->switch_cloud_optics = switch_cloud_optics;
+
+            handle->plan = Radiation_plan_lw<Float>::make_plan(
+                    handle->solver->get_gas_optics(), handle->solver->get_cloud_optics(),
+                    n_col, n_lay, options);
+
+            *solver = handle.release();
+        });
+    }
+
+    int rrtmgp_lw_register(
+            Rrtmgp_lw* solver, const char* name, rrtmgp_real* data,
+            int n_dims, const int* dims, const int* strides)
+    {
+        return call([&]
+        {
+            register_field(*solver, name, data, n_dims, dims, strides, lw_inputs_2d, lw_inputs_1d, lw_outputs);
+        });
+    }
+
+    int rrtmgp_lw_register_gas(
+            Rrtmgp_lw* solver, const char* name, rrtmgp_real* data,
+            const int* dims, const int* strides)
+    {
+        return call([&]{ register_gas(*solver, name, data, dims, strides); });
+    }
+
+    int rrtmgp_lw_solve(Rrtmgp_lw* solver)
+    {
+        return call([&]
+        {
+            check_registered(*solver, lw_required, lw_inputs_2d, lw_inputs_1d);
+            solver->plan->execute(solver->inputs, solver->outputs);
+        });
+    }
+
+    void rrtmgp_lw_destroy(Rrtmgp_lw* solver)
+    {
+        delete solver;
+    }
+
+    int rrtmgp_sw_create(
+            Rrtmgp_sw** solver,
+            const char* gas_names,
+            const char* file_name_gas, const char* file_name_cloud,
+            const char* file_name_weights, const char* file_name_input,
+            int n_col, int n_lay,
+            int switch_cloud_optics, int switch_nn_gas_optics,
+            int n_col_block)
+    {
+        return call([&]
+        {
+            auto handle = std::make_unique<Rrtmgp_sw>();
+            Netcdf_file input_nc(file_name_input, Netcdf_mode::Read);
+
+            handle->solver = std::make_unique<Radiation_solver_shortwave<Float>>(
+                    make_gas_names(gas_names),
+                    file_name_gas, file_name_cloud, file_name_weights, input_nc,
+                    switch_cloud_optics, switch_nn_gas_optics);
+
+            Radiation_plan_options options;
+            options.n_col_block = n_col_block;
+            options.switch_cloud_optics = switch_cloud_optics;
+            handle->switch_cloud_optics = switch_cloud_optics;
+
+            handle->plan = Radiation_plan_sw<Float>::make_plan(
+                    handle->solver->get_gas_optics(), handle->solver->get_cloud_optics(),
+                    n_col, n_lay, options);
+
+            *solver = handle.release();
+        });
+    }
+
+    int rrtmgp_sw_register(
+            Rrtmgp_sw* solver, const char* name, rrtmgp_real* data,
+            int n_dims, const int* dims, const int* strides)
+    {
+        return call([&]
+        {
+            register_field(*solver, name, data, n_dims, dims, strides, sw_inputs_2d, sw_inputs_1d, sw_outputs);
+        });
+    }
+
+    int rrtmgp_sw_register_gas(
+            Rrtmgp_sw* solver, const char* name, rrtmgp_real* data,
+            const int* dims, const int* strides)
+    {
+        return call([&]{ register_gas(*solver, name, data, dims, strides); });
+    }
+
+    int rrtmgp_sw_solve(Rrtmgp_sw* solver)
+    {
+        return call([&]
+        {
+            check_registered(*solver, sw_required, sw_inputs_2d, sw_inputs_1d);
+            solver->plan->execute(solver->inputs, solver->outputs);
+        });
+    }
+
+    void rrtmgp_sw_destroy(Rrtmgp_sw* solver)
+    {
+        delete solver;
+    }
+
+    const char* rrtmgp_last_error(void)
+    {
+        return last_error.c_str();
+    }
+}
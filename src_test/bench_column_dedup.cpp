@@ -0,0 +1,255 @@
+/*
+ * This file is a stand-alone executable developed for the
+ * testing of the C++ interface to the RTE+RRTMGP radiation code.
+ *
+ * It is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+#include "Status.h"
+#include "Netcdf_interface.h"
+#include "Array.h"
+#include "Gas_concs.h"
+#include "Radiation_solver.h"
+#include "column_kernels.h"
+
+
+namespace
+{
+    // The deduplicated columns are solved exactly as their originals, so the fluxes match to rounding.
+    const double tol_flux = 1.e-6;
+
+    void read_and_set_vmr(
+            const std::string& gas_name, const int n_col, const int n_lay,
+            const Netcdf_handle& input_nc, Gas_concs<double>& gas_concs)
+    {
+        const std::string vmr_gas_name = "vmr_" + gas_name;
+
+        if (!input_nc.variable_exists(vmr_gas_name))
+            return;
+
+        const int n_dims = input_nc.get_variable_dimensions(vmr_gas_name).size();
+
+        if (n_dims == 0)
+            gas_concs.set_vmr(gas_name, input_nc.get_variable<double>(vmr_gas_name));
+        else if (n_dims == 1)
+            gas_concs.set_vmr(gas_name,
+                    Array<double,1>(input_nc.get_variable<double>(vmr_gas_name, {n_lay}), {n_lay}));
+        else
+            gas_concs.set_vmr(gas_name,
+                    Array<double,2>(input_nc.get_variable<double>(vmr_gas_name, {n_lay, n_col}), {n_col, n_lay}));
+    }
+
+    void check(const std::string& name, const Array<double,2>& data, const Array<double,2>& data_ref)
+    {
+        double error = 0.;
+        for (int i=0; i<data.size(); ++i)
+            error = std::max(error, std::abs(data.v()[i] - data_ref.v()[i]));
+
+        std::ostringstream ss;
+        ss << "  " << std::left << std::setw(24) << name << std::right
+           << std::scientific << std::setprecision(3) << error
+           << "  (tolerance " << tol_flux << ")";
+        Status::print_message(ss.str());
+
+        if (!(error <= tol_flux))
+            throw std::runtime_error(name + " exceeds its tolerance");
+    }
+
+    // Copy the surface property of the first column of the file to all n_col columns.
+    Array<double,2> expand_column(const Array<double,2>& in, const int n_col)
+    {
+        const int n_bnd = in.dim(1);
+        Array<double,2> out({n_bnd, n_col});
+        for (int icol=1; icol<=n_col; ++icol)
+            for (int ibnd=1; ibnd<=n_bnd; ++ibnd)
+                out({ibnd, icol}) = in({ibnd, 1});
+        return out;
+    }
+}
+
+
+// Check of the column deduplication of the solvers. The first columns of the file are repeated, and
+// the fluxes of a solve with deduplication and surface properties of a single column, that are spread
+// over all columns, are compared against a solve without deduplication with the properties per column.
+int main(int argc, char** argv)
+{
+    Status::print_message("###### Check of the column deduplication ######");
+
+    try
+    {
+        const std::string file_name = (argc > 1) ? argv[1] : "rte_rrtmgp_input.nc";
+        const int n_col_unique_max = (argc > 2) ? std::stoi(argv[2]) : 4;
+        const int n_repeat = (argc > 3) ? std::stoi(argv[3]) : 8;
+
+        Netcdf_file input_nc(file_name, Netcdf_mode::Read);
+
+        const int n_col_file = input_nc.get_dimension_size("col");
+        const int n_lay = input_nc.get_dimension_size("lay");
+        const int n_lev = input_nc.get_dimension_size("lev");
+
+        Gas_concs<double> gas_concs_file;
+        for (const std::string gas_name : {
+                "h2o", "co2", "o3", "n2o", "co", "ch4", "o2", "n2",
+                "ccl4", "cfc11", "cfc12", "cfc22", "hfc143a", "hfc125", "hfc23", "hfc32", "hfc134a", "cf4", "no2" })
+            read_and_set_vmr(gas_name, n_col_file, n_lay, input_nc, gas_concs_file);
+
+        // Column icol is a copy of column (icol-1) % n_col_unique + 1 of the file.
+        const int n_col_unique = std::min(n_col_file, n_col_unique_max);
+        const int n_col = n_col_unique*n_repeat;
+        std::vector<int> cols(n_col);
+        for (int icol=0; icol<n_col; ++icol)
+            cols[icol] = icol % n_col_unique + 1;
+
+        auto read_2d = [&](const std::string& name, const int n_z)
+        {
+            return column_kernels::gather(
+                    Array<double,2>(input_nc.get_variable<double>(name, {n_z, n_col_file}), {n_col_file, n_z}), cols);
+        };
+        auto read_1d = [&](const std::string& name)
+        {
+            return column_kernels::gather(
+                    Array<double,1>(input_nc.get_variable<double>(name, {n_col_file}), {n_col_file}), cols);
+        };
+        auto read_sfc = [&](const std::string& name, const int n_bnd)
+        {
+            return Array<double,2>(input_nc.get_variable<double>(name, {n_col_file, n_bnd}), {n_bnd, n_col_file})
+                .subset({{ {1, n_bnd}, {1, 1} }});
+        };
+
+        const Gas_concs<double> gas_concs(gas_concs_file, cols);
+        const Array<double,2> p_lay = read_2d("p_lay", n_lay);
+        const Array<double,2> p_lev = read_2d("p_lev", n_lev);
+        const Array<double,2> t_lay = read_2d("t_lay", n_lay);
+        const Array<double,2> t_lev = read_2d("t_lev", n_lev);
+
+        const Array<double,2> col_dry;
+        const Array<double,2> lwp, iwp, rel, rei;
+
+        Status::print_message("Longwave fluxes with a single column surface emissivity:");
+        {
+            Radiation_solver_longwave<double> rad_lw(
+                    gas_concs_file, "coefficients_lw.nc", "cloud_coefficients_lw.nc", "weights.nc",
+                    input_nc, false, false);
+
+            const int n_bnd = rad_lw.get_n_bnd();
+            const Array<double,1> t_sfc = read_1d("t_sfc");
+            const Array<double,2> emis_sfc = read_sfc("emis_sfc", n_bnd);
+            const Array<double,2> emis_sfc_ref = expand_column(emis_sfc, n_col);
+
+            Array<double,3> tau, lay_source, lev_source_inc, lev_source_dec;
+            Array<double,2> sfc_source;
+            Array<double,3> bnd_flux_up, bnd_flux_dn, bnd_flux_net;
+
+            auto solve = [&](const Array<double,2>& emis)
+            {
+                std::vector<Array<double,2>> fluxes(3, Array<double,2>({n_col, n_lev}));
+                rad_lw.solve(
+                        true, false, false, false,
+                        gas_concs,
+                        p_lay, p_lev,
+                        t_lay, t_lev,
+                        col_dry,
+                        t_sfc, emis,
+                        lwp, iwp,
+                        rel, rei,
+                        tau, lay_source, lev_source_inc, lev_source_dec, sfc_source,
+                        fluxes[0], fluxes[1], fluxes[2],
+                        bnd_flux_up, bnd_flux_dn, bnd_flux_net);
+                return fluxes;
+            };
+
+            rad_lw.set_column_dedup(false);
+            const std::vector<Array<double,2>> fluxes_ref = solve(emis_sfc_ref);
+
+            rad_lw.set_column_dedup(true);
+            const std::vector<Array<double,2>> fluxes = solve(emis_sfc);
+            Status::print_message("  dedup ratio " + std::to_string(rad_lw.get_dedup_ratio()));
+
+            check("lw_flux_up",  fluxes[0], fluxes_ref[0]);
+            check("lw_flux_dn",  fluxes[1], fluxes_ref[1]);
+            check("lw_flux_net", fluxes[2], fluxes_ref[2]);
+        }
+
+        Status::print_message("Shortwave fluxes with a single column surface albedo:");
+        {
+            Radiation_solver_shortwave<double> rad_sw(
+                    gas_concs_file, "coefficients_sw.nc", "cloud_coefficients_sw.nc", "weights.nc",
+                    input_nc, false, false);
+
+            const int n_bnd = rad_sw.get_n_bnd();
+            const Array<double,1> mu0 = read_1d("mu0");
+            const Array<double,2> sfc_alb_dir = read_sfc("sfc_alb_dir", n_bnd);
+            const Array<double,2> sfc_alb_dif = read_sfc("sfc_alb_dif", n_bnd);
+            const Array<double,2> sfc_alb_dir_ref = expand_column(sfc_alb_dir, n_col);
+            const Array<double,2> sfc_alb_dif_ref = expand_column(sfc_alb_dif, n_col);
+
+            Array<double,1> tsi_scaling({n_col});
+            for (int icol=1; icol<=n_col; ++icol)
+                tsi_scaling({icol}) = 1.;
+
+            Array<double,3> tau, ssa, g;
+            Array<double,2> toa_source;
+            Array<double,3> bnd_flux_up, bnd_flux_dn, bnd_flux_dn_dir, bnd_flux_net;
+
+            auto solve = [&](const Array<double,2>& alb_dir, const Array<double,2>& alb_dif)
+            {
+                std::vector<Array<double,2>> fluxes(4, Array<double,2>({n_col, n_lev}));
+                rad_sw.solve(
+                        true, false, false, false,
+                        gas_concs,
+                        p_lay, p_lev,
+                        t_lay, t_lev,
+                        col_dry,
+                        alb_dir, alb_dif,
+                        tsi_scaling, mu0,
+                        lwp, iwp,
+                        rel, rei,
+                        tau, ssa, g,
+                        toa_source,
+                        fluxes[0], fluxes[1],
+                        fluxes[2], fluxes[3],
+                        bnd_flux_up, bnd_flux_dn,
+                        bnd_flux_dn_dir, bnd_flux_net);
+                return fluxes;
+            };
+
+            rad_sw.set_column_dedup(false);
+            const std::vector<Array<double,2>> fluxes_ref = solve(sfc_alb_dir_ref, sfc_alb_dif_ref);
+
+            rad_sw.set_column_dedup(true);
+            const std::vector<Array<double,2>> fluxes = solve(sfc_alb_dir, sfc_alb_dif);
+            Status::print_message("  dedup ratio " + std::to_string(rad_sw.get_dedup_ratio()));
+
+            check("sw_flux_up",     fluxes[0], fluxes_ref[0]);
+            check("sw_flux_dn",     fluxes[1], fluxes_ref[1]);
+            check("sw_flux_dn_dir", fluxes[2], fluxes_ref[2]);
+            check("sw_flux_net",    fluxes[3], fluxes_ref[3]);
+        }
+
+        Status::print_message("All checks passed.");
+    }
+
+    catch (std::exception& e)
+    {
+        Status::print_message("EXCEPTION: " + std::string(e.what()));
+        return 1;
+    }
+
+    return 0;
+}
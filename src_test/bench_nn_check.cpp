@@ -0,0 +1,692 @@
+/*
+ * This file is a stand-alone executable developed for the
+ * testing of the C++ interface to the RTE+RRTMGP radiation code.
+ *
+ * It is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iomanip>
+#include <random>
+#include <thread>
+
+#include "Status.h"
+#include "Netcdf_interface.h"
+#include "Array.h"
+#include "Gas_concs.h"
+#include "Gas_optics.h"
+#include "Optical_props.h"
+#include "Source_functions.h"
+#include "Fluxes.h"
+#include "Rte_lw.h"
+#include "Rte_sw.h"
+#include "Network.h"
+#include "Thread_pool.h"
+#include "Radiation_solver.h"
+
+
+namespace
+{
+    // Tolerances of the comparisons. The optical properties and sources are compared relative to their
+    // value, the fluxes in W m-2, and the outputs of the pruned network relative to their value.
+    const double tol_optics = 1.e-4;
+    const double tol_flux = 1.e-2;
+    const double tol_sparse = 1.e-4;
+
+    // Pressure of the boundary between the lower and the upper atmosphere networks, see Gas_optics_nn.h.
+    const double press_ref_trop = 9948.431564193395;
+
+    void read_and_set_vmr(
+            const std::string& gas_name, const int n_col, const int n_lay,
+            const Netcdf_handle& input_nc, Gas_concs<double>& gas_concs)
+    {
+        const std::string vmr_gas_name = "vmr_" + gas_name;
+
+        if (!input_nc.variable_exists(vmr_gas_name))
+            return;
+
+        const int n_dims = input_nc.get_variable_dimensions(vmr_gas_name).size();
+
+        if (n_dims == 0)
+            gas_concs.set_vmr(gas_name, input_nc.get_variable<double>(vmr_gas_name));
+        else if (n_dims == 1)
+            gas_concs.set_vmr(gas_name,
+                    Array<double,1>(input_nc.get_variable<double>(vmr_gas_name, {n_lay}), {n_lay}));
+        else
+            gas_concs.set_vmr(gas_name,
+                    Array<double,2>(input_nc.get_variable<double>(vmr_gas_name, {n_lay, n_col}), {n_col, n_lay}));
+    }
+
+    // Largest difference of two fields, relative to the value of the reference if relative is set.
+    template<typename T1, typename T2>
+    double max_error(const T1* data, const T2* data_ref, const size_t n, const bool relative)
+    {
+        double error = 0.;
+        for (size_t i=0; i<n; ++i)
+        {
+            const double diff = std::abs(double(data[i]) - double(data_ref[i]));
+            error = std::max(error, relative ? diff / std::max(std::abs(double(data_ref[i])), 1.e-30) : diff);
+        }
+        return error;
+    }
+
+    void check(const std::string& name, const double error, const double tolerance)
+    {
+        std::ostringstream ss;
+        ss << "  " << std::left << std::setw(36) << name << std::right
+           << std::scientific << std::setprecision(3) << error
+           << "  (tolerance " << tolerance << ")";
+        Status::print_message(ss.str());
+
+        if (!(error <= tolerance))
+            throw std::runtime_error(name + " exceeds its tolerance");
+    }
+
+    // Approximation of the logarithm that the networks are trained with.
+    float logarithm(float x)
+    {
+        x = std::sqrt(x);
+        x = std::sqrt(x);
+        x = std::sqrt(x);
+        x = std::sqrt(x);
+        return (x-1.f) * 16.f;
+    }
+
+    double vmr_at(const Array<double,2>& vmr, const int icol, const int ilay)
+    {
+        return vmr({(vmr.dim(1) == 1) ? 1 : icol, (vmr.dim(2) == 1) ? 1 : ilay});
+    }
+
+    // Reference implementation of the network gas optics as it was before the feature pipeline and
+    // the grouped inference: the inputs of each network are assembled feature by feature, and each
+    // network runs on its own, first on the lower and then on the upper atmosphere.
+    struct Reference_networks
+    {
+        Reference_networks(const std::string& file_name, const bool is_longwave)
+        {
+            Netcdf_file nc_wgth(file_name, Netcdf_mode::Read);
+
+            n_layers = nc_wgth.get_dimension_size("nlayers");
+            n_layer1 = nc_wgth.get_dimension_size("nlayer1");
+            n_layer2 = nc_wgth.get_dimension_size("nlayer2");
+            n_layer3 = nc_wgth.get_dimension_size("nlayer3");
+            n_o3 = nc_wgth.get_dimension_size("ngases");
+
+            const int n_in = 3 + n_o3;
+            const std::string name_tau = is_longwave ? "TLW" : "TSW";
+            const std::string name_2nd = is_longwave ? "Planck" : "SSA";
+            n_out = nc_wgth.get_dimension_size(is_longwave ? "nout_lw" : "nout_sw");
+
+            Netcdf_group grp_tau = nc_wgth.get_group(name_tau);
+            Netcdf_group grp_2nd = nc_wgth.get_group(name_2nd);
+
+            if (grp_tau.variable_exists("features") || grp_2nd.variable_exists("features"))
+                throw std::runtime_error("The reference only has the original features, the weights list their own");
+
+            nw_tau = Network(grp_tau, n_layers, n_layer1, n_layer2, n_layer3, n_out, n_in);
+            nw_2nd = is_longwave
+                ? Network(grp_2nd, n_layers, n_layer1, n_layer2, n_layer3, 3*n_out, n_in+2)
+                : Network(grp_2nd, n_layers, n_layer1, n_layer2, n_layer3, n_out, n_in);
+        }
+
+        // Inputs of the layers lay_s to lay_e, the Planck network has the temperatures of the levels below and above extra.
+        std::vector<float> assemble(
+                const Array<double,2>& p_lay, const Array<double,2>& t_lay, const Array<double,2>& t_lev,
+                const Gas_concs<double>& gas_concs, const int lay_s, const int lay_e, const bool with_lev) const
+        {
+            const int n_col = p_lay.dim(1);
+            const int n_batch = n_col*(lay_e-lay_s);
+            const int n_in = 3 + n_o3 + (with_lev ? 2 : 0);
+
+            const Array<double,2>& h2o = gas_concs.get_vmr("h2o");
+            const Array<double,2>& o3  = gas_concs.get_vmr("o3");
+
+            std::vector<float> input(size_t(n_batch)*n_in);
+
+            for (int ilay=lay_s+1; ilay<=lay_e; ++ilay)
+                for (int icol=1; icol<=n_col; ++icol)
+                {
+                    const int idx = (icol-1) + (ilay-1-lay_s)*n_col;
+                    int ifeat = 0;
+
+                    input[idx + (ifeat++)*n_batch] = logarithm(vmr_at(h2o, icol, ilay));
+                    if (n_o3 == 1)
+                        input[idx + (ifeat++)*n_batch] = logarithm(vmr_at(o3, icol, ilay));
+                    input[idx + (ifeat++)*n_batch] = logarithm(p_lay({icol, ilay}));
+                    input[idx + (ifeat++)*n_batch] = t_lay({icol, ilay});
+
+                    if (with_lev)
+                    {
+                        input[idx + (ifeat++)*n_batch] = t_lev({icol, ilay});
+                        input[idx + (ifeat++)*n_batch] = t_lev({icol, ilay+1});
+                    }
+                }
+
+            return input;
+        }
+
+        // Write the outputs of a network for the layers from lay_s upward into out, with the outputs in the slowest dimension.
+        Network::Output_epilogue store(std::vector<Array<double,3>*> out, const int lay_s) const
+        {
+            return [=](const int i_out, const float* data, const int j_start, const int n_batch)
+            {
+                Array<double,3>& a = *out[i_out / out[0]->dim(3)];
+                const int n_col = a.dim(1);
+                const int i_gpt = i_out % a.dim(3);
+                for (int j=j_start; j<j_start+n_batch; ++j)
+                    a({j%n_col + 1, j/n_col + lay_s + 1, i_gpt + 1}) = data[j-j_start];
+            };
+        }
+
+        void inference(
+                const Network& network, std::vector<float>& input, const Network::Output_epilogue& epilogue,
+                const int n_batch, const int lower, const int do_exp, const int do_norm) const
+        {
+            if (n_batch > 0)
+                network.inference(
+                        input.data(), epilogue, n_batch, lower, do_exp, do_norm,
+                        n_layers, n_layer1, n_layer2, n_layer3);
+        }
+
+        Network nw_tau;
+        Network nw_2nd;
+        int n_layers, n_layer1, n_layer2, n_layer3;
+        int n_o3;
+        int n_out;
+    };
+
+    int get_idx_tropo(const Array<double,2>& p_lay)
+    {
+        int idx_tropo = 0;
+        for (int ilay=1; ilay<=p_lay.dim(2); ++ilay)
+            if (p_lay({1, ilay}) > press_ref_trop)
+                ++idx_tropo;
+        return idx_tropo;
+    }
+
+    // Scale the optical depths, which the networks predict per unit of pressure, with the layer thickness.
+    void scale_with_dp(Array<double,3>& tau, const Array<double,2>& p_lev)
+    {
+        for (int igpt=1; igpt<=tau.dim(3); ++igpt)
+            for (int ilay=1; ilay<=tau.dim(2); ++ilay)
+                for (int icol=1; icol<=tau.dim(1); ++icol)
+                    tau({icol, ilay, igpt}) *= float(std::abs(p_lev({icol, ilay}) - p_lev({icol, ilay+1})));
+    }
+
+
+    // The longwave gas optics of the solver against the reference, and the fluxes that follow from them.
+    void check_longwave(
+            Radiation_solver_longwave<double>& rad_lw, const std::string& file_name_weights,
+            const Gas_concs<double>& gas_concs,
+            const Array<double,2>& p_lay, const Array<double,2>& p_lev,
+            const Array<double,2>& t_lay, const Array<double,2>& t_lev,
+            const Array<double,1>& t_sfc, const Array<double,2>& emis_sfc,
+            const int idx_tropo, Thread_pool* thread_pool)
+    {
+        const Gas_optics<double>& kdist = rad_lw.get_gas_optics();
+        const int n_col = p_lay.dim(1);
+        const int n_lay = p_lay.dim(2);
+        const int n_gpt = kdist.get_ngpt();
+        const BOOL_TYPE top_at_1 = p_lay({1, 1}) < p_lay({1, n_lay});
+
+        std::unique_ptr<Optical_props_arry<double>> optical_props =
+                std::make_unique<Optical_props_1scl<double>>(n_col, n_lay, kdist);
+        Source_func_lw<double> sources(n_col, n_lay, kdist);
+
+        rad_lw.set_thread_pool(thread_pool);
+        kdist.gas_optics(p_lay, p_lev, t_lay, t_sfc, gas_concs, optical_props, sources, Array<double,2>(), t_lev);
+        rad_lw.set_thread_pool(nullptr);
+
+        // The reference, of which the surface source, a function of the layer source, is taken from the solver.
+        const Reference_networks ref(file_name_weights, true);
+
+        std::unique_ptr<Optical_props_arry<double>> optical_props_ref =
+                std::make_unique<Optical_props_1scl<double>>(n_col, n_lay, kdist);
+        Source_func_lw<double> sources_ref(n_col, n_lay, kdist);
+        sources_ref.split_lev_source();
+        sources_ref.get_sfc_source() = sources.get_sfc_source();
+        sources_ref.get_sfc_source_jac() = sources.get_sfc_source_jac();
+
+        Array<double,3>& tau_ref = optical_props_ref->get_tau();
+        const std::vector<Array<double,3>*> plk_ref = {
+                &sources_ref.get_lay_source(), &sources_ref.get_lev_source_inc(), &sources_ref.get_lev_source_dec()};
+
+        for (const int lower : {1, 0})
+        {
+            const int lay_s = lower ? 0 : idx_tropo;
+            const int lay_e = lower ? idx_tropo : n_lay;
+            const int n_batch = n_col*(lay_e-lay_s);
+
+            std::vector<float> input_tau = ref.assemble(p_lay, t_lay, t_lev, gas_concs, lay_s, lay_e, false);
+            std::vector<float> input_plk = ref.assemble(p_lay, t_lay, t_lev, gas_concs, lay_s, lay_e, true);
+
+            ref.inference(ref.nw_tau, input_tau, ref.store({&tau_ref}, lay_s), n_batch, lower, 1, 1);
+            ref.inference(ref.nw_2nd, input_plk, ref.store(plk_ref, lay_s), n_batch, lower, 1, 1);
+        }
+        scale_with_dp(tau_ref, p_lev);
+
+        const size_t n = size_t(n_col)*n_lay*n_gpt;
+        check("optical depth", max_error(optical_props->get_tau().ptr(), tau_ref.ptr(), n, true), tol_optics);
+        check("layer source", max_error(sources.get_lay_source().ptr(), plk_ref[0]->ptr(), n, true), tol_optics);
+        check("level source inc", max_error(sources.get_lev_source_inc().ptr(), plk_ref[1]->ptr(), n, true), tol_optics);
+        check("level source dec", max_error(sources.get_lev_source_dec().ptr(), plk_ref[2]->ptr(), n, true), tol_optics);
+
+        auto solve = [&](const std::unique_ptr<Optical_props_arry<double>>& props, const Source_func_lw<double>& src)
+        {
+            Array<double,3> gpt_flux_up({n_col, n_lay+1, n_gpt});
+            Array<double,3> gpt_flux_dn({n_col, n_lay+1, n_gpt});
+            Rte_lw<double>::rte_lw(props, top_at_1, src, emis_sfc, Array<double,2>(), gpt_flux_up, gpt_flux_dn, 1);
+
+            Fluxes_broadband<double> fluxes(n_col, n_lay+1);
+            fluxes.reduce(gpt_flux_up, gpt_flux_dn, top_at_1);
+            return fluxes;
+        };
+
+        Fluxes_broadband<double> fluxes = solve(optical_props, sources);
+        Fluxes_broadband<double> fluxes_ref = solve(optical_props_ref, sources_ref);
+
+        const size_t n_flux = size_t(n_col)*(n_lay+1);
+        check("longwave flux up", max_error(fluxes.get_flux_up().ptr(), fluxes_ref.get_flux_up().ptr(), n_flux, false), tol_flux);
+        check("longwave flux down", max_error(fluxes.get_flux_dn().ptr(), fluxes_ref.get_flux_dn().ptr(), n_flux, false), tol_flux);
+    }
+
+
+    // The shortwave gas optics of the solver against the reference, and the fluxes that follow from them.
+    void check_shortwave(
+            Radiation_solver_shortwave<double>& rad_sw, const std::string& file_name_weights,
+            const Gas_concs<double>& gas_concs,
+            const Array<double,2>& p_lay, const Array<double,2>& p_lev, const Array<double,2>& t_lay,
+            const Array<double,1>& mu0, const Array<double,2>& sfc_alb_dir, const Array<double,2>& sfc_alb_dif,
+            const int idx_tropo, Thread_pool* thread_pool)
+    {
+        const Gas_optics<double>& kdist = rad_sw.get_gas_optics();
+        const int n_col = p_lay.dim(1);
+        const int n_lay = p_lay.dim(2);
+        const int n_gpt = kdist.get_ngpt();
+        const BOOL_TYPE top_at_1 = p_lay({1, 1}) < p_lay({1, n_lay});
+
+        std::unique_ptr<Optical_props_arry<double>> optical_props =
+                std::make_unique<Optical_props_2str<double>>(n_col, n_lay, kdist);
+        Array<double,2> toa_src({n_col, n_gpt});
+
+        rad_sw.set_thread_pool(thread_pool);
+        kdist.gas_optics(p_lay, p_lev, t_lay, gas_concs, optical_props, toa_src, Array<double,2>());
+        rad_sw.set_thread_pool(nullptr);
+
+        const Reference_networks ref(file_name_weights, false);
+
+        std::unique_ptr<Optical_props_arry<double>> optical_props_ref =
+                std::make_unique<Optical_props_2str<double>>(n_col, n_lay, kdist);
+        Array<double,3>& tau_ref = optical_props_ref->get_tau();
+        Array<double,3>& ssa_ref = optical_props_ref->get_ssa();
+
+        // The SSA network reads the input after the TSW network has normalized it.
+        for (const int lower : {1, 0})
+        {
+            const int lay_s = lower ? 0 : idx_tropo;
+            const int lay_e = lower ? idx_tropo : n_lay;
+            const int n_batch = n_col*(lay_e-lay_s);
+
+            std::vector<float> input = ref.assemble(p_lay, t_lay, Array<double,2>(), gas_concs, lay_s, lay_e, false);
+
+            ref.inference(ref.nw_tau, input, ref.store({&tau_ref}, lay_s), n_batch, lower, 1, 1);
+            ref.inference(ref.nw_2nd, input, ref.store({&ssa_ref}, lay_s), n_batch, lower, 0, 0);
+        }
+        scale_with_dp(tau_ref, p_lev);
+
+        const size_t n = size_t(n_col)*n_lay*n_gpt;
+        check("optical depth", max_error(optical_props->get_tau().ptr(), tau_ref.ptr(), n, true), tol_optics);
+        check("single scattering albedo", max_error(optical_props->get_ssa().ptr(), ssa_ref.ptr(), n, true), tol_optics);
+
+        auto solve = [&](const std::unique_ptr<Optical_props_arry<double>>& props)
+        {
+            Array<double,3> gpt_flux_up({n_col, n_lay+1, n_gpt});
+            Array<double,3> gpt_flux_dn({n_col, n_lay+1, n_gpt});
+            Array<double,3> gpt_flux_dn_dir({n_col, n_lay+1, n_gpt});
+            Rte_sw<double>::rte_sw(
+                    props, top_at_1, mu0, toa_src, sfc_alb_dir, sfc_alb_dif, Array<double,2>(),
+                    gpt_flux_up, gpt_flux_dn, gpt_flux_dn_dir);
+
+            Fluxes_broadband<double> fluxes(n_col, n_lay+1);
+            fluxes.reduce(gpt_flux_up, gpt_flux_dn, gpt_flux_dn_dir, top_at_1);
+            return fluxes;
+        };
+
+        Fluxes_broadband<double> fluxes = solve(optical_props);
+        Fluxes_broadband<double> fluxes_ref = solve(optical_props_ref);
+
+        const size_t n_flux = size_t(n_col)*(n_lay+1);
+        check("shortwave flux up", max_error(fluxes.get_flux_up().ptr(), fluxes_ref.get_flux_up().ptr(), n_flux, false), tol_flux);
+        check("shortwave flux down", max_error(fluxes.get_flux_dn().ptr(), fluxes_ref.get_flux_dn().ptr(), n_flux, false), tol_flux);
+        check("shortwave flux down direct", max_error(fluxes.get_flux_dn_dir().ptr(), fluxes_ref.get_flux_dn_dir().ptr(), n_flux, false), tol_flux);
+    }
+
+
+    // Prune a dense weight matrix of n_row x n_col to blocks of 4 x 4, keeping the quarter of the blocks with
+    // the largest norm, such that the network keeps them sparse. Returns false if the matrix is not tiled by the blocks.
+    bool prune(
+            std::vector<float>& dense, const int n_row, const int n_col,
+            std::vector<float>& values, std::vector<int>& block_col, std::vector<int>& block_row_start)
+    {
+        constexpr int n_br = 4;
+        constexpr int n_bc = 4;
+
+        if (n_row % n_br != 0 || n_col % n_bc != 0)
+            return false;
+
+        const int n_block_rows = n_row / n_br;
+        const int n_block_cols = n_col / n_bc;
+
+        std::vector<float> norms(n_block_rows*n_block_cols, 0.f);
+        for (int i=0; i<n_row; ++i)
+            for (int j=0; j<n_col; ++j)
+                norms[(i/n_br)*n_block_cols + j/n_bc] += dense[size_t(i)*n_col + j] * dense[size_t(i)*n_col + j];
+
+        std::vector<float> norms_sorted = norms;
+        const int n_keep = std::max(1, int(norms.size()) / 4);
+        std::nth_element(norms_sorted.begin(), norms_sorted.end() - n_keep, norms_sorted.end());
+        const float norm_min = *(norms_sorted.end() - n_keep);
+
+        values.clear();
+        block_col.clear();
+        block_row_start.assign(1, 0);
+
+        int n_kept = 0;
+        for (int i_br=0; i_br<n_block_rows; ++i_br)
+        {
+            for (int i_bc=0; i_bc<n_block_cols; ++i_bc)
+            {
+                const bool keep = norms[i_br*n_block_cols + i_bc] >= norm_min && n_kept < n_keep;
+                n_kept += keep;
+
+                if (keep)
+                    block_col.push_back(i_bc);
+
+                for (int r=0; r<n_br; ++r)
+                    for (int c=0; c<n_bc; ++c)
+                    {
+                        float& w = dense[size_t(i_br*n_br + r)*n_col + i_bc*n_bc + c];
+                        if (keep)
+                            values.push_back(w);
+                        else
+                            w = 0.f;
+                    }
+            }
+            block_row_start.push_back(block_col.size());
+        }
+
+        return true;
+    }
+
+    template<typename T>
+    void write_variable(
+            Netcdf_group& grp, const std::string& name, const std::vector<T>& data,
+            const std::vector<std::pair<std::string, int>>& dims)
+    {
+        std::vector<std::string> dim_names;
+        for (const auto& dim : dims)
+        {
+            grp.add_dimension(dim.first, dim.second);
+            dim_names.push_back(dim.first);
+        }
+
+        auto nc_var = grp.add_variable<T>(name, dim_names);
+        nc_var.insert(data, std::vector<int>(dims.size(), 0));
+    }
+
+
+    // A network of which the hidden and output layers are pruned, stored once dense with the pruned
+    // blocks set to zero and once block-sparse, has to give the same outputs in both forms.
+    void check_sparse(const std::string& file_name_weights, const std::string& group_name, Thread_pool* thread_pool)
+    {
+        const std::string file_name_pruned = "bench_nn_check_pruned.nc";
+
+        int n_layers, n_layer1, n_layer2, n_layer3;
+        int n_in, n_out;
+        bool has_sparse = false;
+
+        {
+            Netcdf_file nc_wgth(file_name_weights, Netcdf_mode::Read);
+            Netcdf_group grp = nc_wgth.get_group(group_name);
+
+            n_layers = nc_wgth.get_dimension_size("nlayers");
+            n_layer1 = nc_wgth.get_dimension_size("nlayer1");
+            n_layer2 = nc_wgth.get_dimension_size("nlayer2");
+            n_layer3 = nc_wgth.get_dimension_size("nlayer3");
+            n_in  = grp.get_variable_dimensions("Fmean_lower").begin()->second;
+            n_out = grp.get_variable_dimensions("Lmean_lower").begin()->second;
+
+            const std::vector<int> n_neurons = {n_in, n_layer1, n_layer2, n_layer3};
+
+            std::remove(file_name_pruned.c_str());
+            Netcdf_file nc_pruned(file_name_pruned, Netcdf_mode::Create);
+            Netcdf_group grp_dense  = nc_pruned.add_group("dense");
+            Netcdf_group grp_sparse = nc_pruned.add_group("sparse");
+
+            for (const std::string atmos : {"lower", "upper"})
+            {
+                for (const std::string norm : {"Fmean", "Fstdv", "Lmean", "Lstdv"})
+                {
+                    const std::string name = norm + "_" + atmos;
+                    const int n_var = (norm[0] == 'F') ? n_in : n_out;
+                    const std::vector<float> data = grp.get_variable<float>(name, {n_var});
+                    write_variable(grp_dense, name, data, {{"n" + name, n_var}});
+                    write_variable(grp_sparse, name, data, {{"n" + name, n_var}});
+                }
+
+                for (int i_layer=1; i_layer<=n_layers+1; ++i_layer)
+                {
+                    const std::string bias = "bias" + std::to_string(i_layer) + "_" + atmos;
+                    const std::string wgth = "wgth" + std::to_string(i_layer) + "_" + atmos;
+                    const int n_row = (i_layer == n_layers+1) ? n_out : n_neurons[i_layer];
+                    const int n_col = n_neurons[i_layer-1];
+
+                    const std::vector<float> data_bias = grp.get_variable<float>(bias, {n_row});
+                    write_variable(grp_dense, bias, data_bias, {{"n" + bias, n_row}});
+                    write_variable(grp_sparse, bias, data_bias, {{"n" + bias, n_row}});
+
+                    // The input layer is not pruned, as in prune_weights.py.
+                    std::vector<float> dense = grp.get_variable<float>(wgth, {n_row, n_col});
+                    std::vector<float> values;
+                    std::vector<int> block_col, block_row_start;
+
+                    const bool is_input_layer = (i_layer == 1) && (n_col < 16);
+                    if (!is_input_layer && prune(dense, n_row, n_col, values, block_col, block_row_start))
+                    {
+                        write_variable(grp_sparse, wgth + "_block_shape", std::vector<int>{4, 4}, {{"nshape_" + wgth, 2}});
+                        write_variable(grp_sparse, wgth + "_values", values,
+                                {{"nblock_" + wgth, int(block_col.size())}, {"nblock_row_" + wgth, 4}, {"nblock_col_" + wgth, 4}});
+                        write_variable(grp_sparse, wgth + "_block_col", block_col, {{"nblock_" + wgth, int(block_col.size())}});
+                        write_variable(grp_sparse, wgth + "_block_row_start", block_row_start,
+                                {{"nblock_row_start_" + wgth, int(block_row_start.size())}});
+                        has_sparse = true;
+                    }
+                    else
+                        write_variable(grp_sparse, wgth, dense, {{"nrow_" + wgth, n_row}, {"ncol_" + wgth, n_col}});
+
+                    write_variable(grp_dense, wgth, dense, {{"nrow_" + wgth, n_row}, {"ncol_" + wgth, n_col}});
+                }
+            }
+        }
+
+        if (!has_sparse)
+        {
+            Status::print_message("  " + group_name + " has no layers that can be pruned");
+            std::remove(file_name_pruned.c_str());
+            return;
+        }
+
+        Network nw_dense, nw_sparse;
+        {
+            Netcdf_file nc_pruned(file_name_pruned, Netcdf_mode::Read);
+            Netcdf_group grp_dense  = nc_pruned.get_group("dense");
+            Netcdf_group grp_sparse = nc_pruned.get_group("sparse");
+            nw_dense  = Network(grp_dense,  n_layers, n_layer1, n_layer2, n_layer3, n_out, n_in);
+            nw_sparse = Network(grp_sparse, n_layers, n_layer1, n_layer2, n_layer3, n_out, n_in);
+        }
+        std::remove(file_name_pruned.c_str());
+
+        // Random inputs around the mean of the training data, in batches that are smaller and larger than a tile.
+        std::mt19937 generator(1);
+        std::normal_distribution<float> distribution(0.f, 1.f);
+
+        for (const int lower : {1, 0})
+            for (const int n_batch : {1, 77, 4000})
+            {
+                std::vector<float> input(size_t(n_batch)*n_in);
+                for (float& x : input)
+                    x = distribution(generator);
+
+                std::vector<float> input_sparse = input;
+                std::vector<float> output_dense(size_t(n_batch)*n_out);
+                std::vector<float> output_sparse(size_t(n_batch)*n_out);
+
+                auto store = [n_batch](std::vector<float>& output)
+                {
+                    return [&output, n_batch](const int i_out, const float* data, const int j_start, const int n)
+                    {
+                        std::copy(data, data+n, output.begin() + size_t(i_out)*n_batch + j_start);
+                    };
+                };
+
+                // The inputs are already normalized, and the outputs are compared before the exponential.
+                nw_dense.inference(
+                        input.data(), store(output_dense), n_batch, lower, 0, 0,
+                        n_layers, n_layer1, n_layer2, n_layer3);
+                nw_sparse.inference(
+                        input_sparse.data(), store(output_sparse), n_batch, lower, 0, 0,
+                        n_layers, n_layer1, n_layer2, n_layer3, thread_pool);
+
+                double error = 0.;
+                double output_max = 0.;
+                for (size_t i=0; i<output_dense.size(); ++i)
+                {
+                    error = std::max(error, double(std::abs(output_sparse[i] - output_dense[i])));
+                    output_max = std::max(output_max, double(std::abs(output_dense[i])));
+                }
+
+                check(group_name + (lower ? " lower" : " upper") + ", batch " + std::to_string(n_batch),
+                      error / std::max(output_max, 1.e-30), tol_sparse);
+            }
+    }
+}
+
+
+// Regression check of the neural network gas optics. The gas optics of the solvers, with the feature
+// pipeline and the grouped inference of the lower and upper atmosphere, are compared against a plain
+// reference that assembles the inputs per feature and runs each network on its own, and the fluxes of
+// both are compared. This is done without and with a thread pool. The networks are then pruned, and a
+// pruned network that is read block-sparse is compared against the same network read dense.
+int main(int argc, char** argv)
+{
+    Status::print_message("###### Check of the neural network gas optics ######");
+
+    try
+    {
+        const std::string file_name = (argc > 1) ? argv[1] : "rte_rrtmgp_input.nc";
+        const std::string file_name_weights = (argc > 2) ? argv[2] : "weights.nc";
+        const int n_col_max = (argc > 3) ? std::stoi(argv[3]) : 128;
+        const int n_thread = std::max(2u, std::thread::hardware_concurrency());
+
+        Netcdf_file input_nc(file_name, Netcdf_mode::Read);
+
+        const int n_col_file = input_nc.get_dimension_size("col");
+        const int n_lay = input_nc.get_dimension_size("lay");
+        const int n_lev = input_nc.get_dimension_size("lev");
+
+        // The split between the lower and upper atmosphere follows from the first column of the file, as in Gas_optics_nn.
+        const Array<double,2> p_lay_file(input_nc.get_variable<double>("p_lay", {n_lay, n_col_file}), {n_col_file, n_lay});
+        const int idx_tropo = get_idx_tropo(p_lay_file);
+
+        Gas_concs<double> gas_concs_file;
+        for (const std::string gas_name : {
+                "h2o", "co2", "o3", "n2o", "co", "ch4", "o2", "n2",
+                "ccl4", "cfc11", "cfc12", "cfc22", "hfc143a", "hfc125", "hfc23", "hfc32", "hfc134a", "cf4", "no2" })
+            read_and_set_vmr(gas_name, n_col_file, n_lay, input_nc, gas_concs_file);
+
+        // The first columns of the file are enough to check the optics and keep the g-point fluxes small.
+        const int n_col = std::min(n_col_file, n_col_max);
+        auto read_2d = [&](const std::string& name, const int n_z)
+        {
+            return Array<double,2>(input_nc.get_variable<double>(name, {n_z, n_col_file}), {n_col_file, n_z}).subset({{ {1, n_col}, {1, n_z} }});
+        };
+        auto read_bnd = [&](const std::string& name, const int n_bnd)
+        {
+            return Array<double,2>(input_nc.get_variable<double>(name, {n_col_file, n_bnd}), {n_bnd, n_col_file}).subset({{ {1, n_bnd}, {1, n_col} }});
+        };
+        auto read_1d = [&](const std::string& name)
+        {
+            return Array<double,1>(input_nc.get_variable<double>(name, {n_col_file}), {n_col_file}).subset({{ {1, n_col} }});
+        };
+
+        const Gas_concs<double> gas_concs(gas_concs_file, 1, n_col);
+        const Array<double,2> p_lay = read_2d("p_lay", n_lay);
+        const Array<double,2> p_lev = read_2d("p_lev", n_lev);
+        const Array<double,2> t_lay = read_2d("t_lay", n_lay);
+        const Array<double,2> t_lev = read_2d("t_lev", n_lev);
+
+        Thread_pool thread_pool(n_thread);
+
+        Status::print_message("Longwave network gas optics and fluxes against the reference:");
+        {
+            Radiation_solver_longwave<double> rad_lw(
+                    gas_concs_file, "coefficients_lw.nc", "cloud_coefficients_lw.nc", file_name_weights,
+                    input_nc, false, true);
+
+            const int n_bnd = rad_lw.get_n_bnd();
+            const Array<double,1> t_sfc = read_1d("t_sfc");
+            const Array<double,2> emis_sfc = read_bnd("emis_sfc", n_bnd);
+
+            for (Thread_pool* pool : {static_cast<Thread_pool*>(nullptr), &thread_pool})
+            {
+                Status::print_message(pool ? " with " + std::to_string(n_thread) + " threads" : " without threads");
+                check_longwave(rad_lw, file_name_weights, gas_concs, p_lay, p_lev, t_lay, t_lev, t_sfc, emis_sfc, idx_tropo, pool);
+            }
+        }
+
+        Status::print_message("Shortwave network gas optics and fluxes against the reference:");
+        {
+            Radiation_solver_shortwave<double> rad_sw(
+                    gas_concs_file, "coefficients_sw.nc", "cloud_coefficients_sw.nc", file_name_weights,
+                    input_nc, false, true);
+
+            const int n_bnd = rad_sw.get_n_bnd();
+            const Array<double,1> mu0 = read_1d("mu0");
+            const Array<double,2> sfc_alb_dir = read_bnd("sfc_alb_dir", n_bnd);
+            const Array<double,2> sfc_alb_dif = read_bnd("sfc_alb_dif", n_bnd);
+
+            for (Thread_pool* pool : {static_cast<Thread_pool*>(nullptr), &thread_pool})
+            {
+                Status::print_message(pool ? " with " + std::to_string(n_thread) + " threads" : " without threads");
+                check_shortwave(rad_sw, file_name_weights, gas_concs, p_lay, p_lev, t_lay, mu0, sfc_alb_dir, sfc_alb_dif, idx_tropo, pool);
+            }
+        }
+
+        Status::print_message("Block-sparse pruned networks against their dense form:");
+        for (const std::string group_name : {"TLW", "Planck", "TSW", "SSA"})
+            check_sparse(file_name_weights, group_name, &thread_pool);
+
+        Status::print_message("All checks passed.");
+    }
+
+    catch (std::exception& e)
+    {
+        Status::print_message("EXCEPTION: " + std::string(e.what()));
+        return 1;
+    }
+
+    return 0;
+}
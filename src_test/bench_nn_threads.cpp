@@ -0,0 +1,211 @@
+/*
+ * This file is a stand-alone executable developed for the
+ * testing of the C++ interface to the RTE+RRTMGP radiation code.
+ *
+ * It is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <thread>
+
+#include "Status.h"
+#include "Netcdf_interface.h"
+#include "Array.h"
+#include "Gas_concs.h"
+#include "Radiation_solver.h"
+#include "Radiation_plan.h"
+#include "Thread_pool.h"
+
+
+namespace
+{
+    void read_and_set_vmr(
+            const std::string& gas_name, const int n_col, const int n_lay,
+            const Netcdf_handle& input_nc, Gas_concs<double>& gas_concs)
+    {
+        const std::string vmr_gas_name = "vmr_" + gas_name;
+
+        if (!input_nc.variable_exists(vmr_gas_name))
+            return;
+
+        const int n_dims = input_nc.get_variable_dimensions(vmr_gas_name).size();
+
+        if (n_dims == 0)
+            gas_concs.set_vmr(gas_name, input_nc.get_variable<double>(vmr_gas_name));
+        else if (n_dims == 1)
+            gas_concs.set_vmr(gas_name,
+                    Array<double,1>(input_nc.get_variable<double>(vmr_gas_name, {n_lay}), {n_lay}));
+        else
+            gas_concs.set_vmr(gas_name,
+                    Array<double,2>(input_nc.get_variable<double>(vmr_gas_name, {n_lay, n_col}), {n_col, n_lay}));
+    }
+
+    // Views on the columns col_s to col_s+n_col-1 (starting at 0) of arrays with the columns in the first dimension.
+    Array_view<double,2> columns(Array<double,2>& array, const int col_s, const int n_col)
+    {
+        return Array_view<double,2>(array.ptr() + col_s, {n_col, array.dim(2)}, {1, array.dim(1)});
+    }
+
+    Array_view<double,1> columns(Array<double,1>& array, const int col_s, const int n_col)
+    {
+        return Array_view<double,1>(array.ptr() + col_s, {n_col});
+    }
+
+    // Views on the columns of arrays with the columns in the second dimension.
+    Array_view<double,2> columns_dim2(Array<double,2>& array, const int col_s, const int n_col)
+    {
+        return Array_view<double,2>(array.ptr() + col_s*array.dim(1), {array.dim(1), n_col});
+    }
+
+    template<typename F>
+    double time_ms(F&& function, const int n_repeat)
+    {
+        function();
+        auto time_start = std::chrono::high_resolution_clock::now();
+        for (int n=0; n<n_repeat; ++n)
+            function();
+        auto time_end = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::milli>(time_end-time_start).count() / n_repeat;
+    }
+}
+
+
+// Scaling of the longwave solver with neural network gas optics over the number of threads. The
+// columns are split over n_block block threads, of which each solves its part as a single block,
+// and the network batches of all blocks are split over a shared thread pool. A topology of
+// n_block block threads and a pool of n_pool threads runs n_block + n_pool - 1 threads in total.
+int main(int argc, char** argv)
+{
+    Status::print_message("###### Benchmark of the neural network gas optics over threads ######");
+
+    try
+    {
+        const int n_repeat = (argc > 1) ? std::stoi(argv[1]) : 5;
+        const int n_thread_max = (argc > 2) ? std::stoi(argv[2]) : std::max(1u, std::thread::hardware_concurrency());
+        const std::string file_name = (argc > 3) ? argv[3] : "rte_rrtmgp_input_expt_00.nc";
+
+        Netcdf_file input_nc(file_name, Netcdf_mode::Read);
+
+        const int n_col = input_nc.get_dimension_size("col");
+        const int n_lay = input_nc.get_dimension_size("lay");
+        const int n_lev = input_nc.get_dimension_size("lev");
+
+        Array<double,2> p_lay(input_nc.get_variable<double>("p_lay", {n_lay, n_col}), {n_col, n_lay});
+        Array<double,2> t_lay(input_nc.get_variable<double>("t_lay", {n_lay, n_col}), {n_col, n_lay});
+        Array<double,2> p_lev(input_nc.get_variable<double>("p_lev", {n_lev, n_col}), {n_col, n_lev});
+        Array<double,2> t_lev(input_nc.get_variable<double>("t_lev", {n_lev, n_col}), {n_col, n_lev});
+        Array<double,1> t_sfc(input_nc.get_variable<double>("t_sfc", {n_col}), {n_col});
+
+        Gas_concs<double> gas_concs;
+        for (const std::string gas_name : {
+                "h2o", "co2", "o3", "n2o", "co", "ch4", "o2", "n2",
+                "ccl4", "cfc11", "cfc12", "cfc22", "hfc143a", "hfc125", "hfc23", "hfc32", "hfc134a", "cf4", "no2" })
+            read_and_set_vmr(gas_name, n_col, n_lay, input_nc, gas_concs);
+
+        Radiation_solver_longwave<double> rad_lw(
+                gas_concs, "coefficients_lw.nc", "cloud_coefficients_lw.nc", "weights.nc",
+                input_nc, false, true);
+
+        const int n_bnd = rad_lw.get_n_bnd();
+        Array<double,2> emis_sfc(input_nc.get_variable<double>("emis_sfc", {n_col, n_bnd}), {n_bnd, n_col});
+
+        Array<double,2> flux_up ({n_col, n_lev});
+        Array<double,2> flux_dn ({n_col, n_lev});
+        Array<double,2> flux_net({n_col, n_lev});
+
+        Status::print_message("Number of columns: " + std::to_string(n_col) + ", repeats: " + std::to_string(n_repeat));
+        Status::print_message("   threads   block threads   pool threads   time (ms)   speedup");
+
+        double duration_serial = 0.;
+
+        for (int n_thread=1; n_thread<=n_thread_max; n_thread*=2)
+            for (int n_block=1; n_block<=n_thread; n_block*=2)
+            {
+                const int n_pool = n_thread - n_block + 1;
+                const int n_col_part = n_col / n_block;
+                if (n_col_part == 0)
+                    continue;
+
+                Thread_pool thread_pool(n_pool);
+                rad_lw.set_thread_pool(&thread_pool);
+
+                // One plan for all parts, with a workspace per block thread.
+                Radiation_plan_options options;
+                options.n_col_block = n_col_part;
+                options.n_workspaces = n_block;
+
+                auto plan = Radiation_plan_lw<double>::make_plan(
+                        rad_lw.get_gas_optics(), nullptr, n_col_part, n_lay, options);
+
+                std::vector<Gas_concs<double>> gas_concs_parts;
+                std::vector<Radiation_inputs_lw<double>> inputs(n_block);
+                std::vector<Radiation_outputs_lw<double>> outputs(n_block);
+
+                for (int ipart=0; ipart<n_block; ++ipart)
+                    gas_concs_parts.emplace_back(gas_concs, ipart*n_col_part+1, n_col_part);
+
+                for (int ipart=0; ipart<n_block; ++ipart)
+                {
+                    const int col_s = ipart*n_col_part;
+                    inputs[ipart].gas_concs = &gas_concs_parts[ipart];
+                    inputs[ipart].p_lay = columns(p_lay, col_s, n_col_part);
+                    inputs[ipart].p_lev = columns(p_lev, col_s, n_col_part);
+                    inputs[ipart].t_lay = columns(t_lay, col_s, n_col_part);
+                    inputs[ipart].t_lev = columns(t_lev, col_s, n_col_part);
+                    inputs[ipart].t_sfc = columns(t_sfc, col_s, n_col_part);
+                    inputs[ipart].emis_sfc = columns_dim2(emis_sfc, col_s, n_col_part);
+
+                    outputs[ipart].flux_up  = columns(flux_up,  col_s, n_col_part);
+                    outputs[ipart].flux_dn  = columns(flux_dn,  col_s, n_col_part);
+                    outputs[ipart].flux_net = columns(flux_net, col_s, n_col_part);
+                }
+
+                auto solve = [&]()
+                {
+                    std::vector<std::thread> block_threads;
+                    for (int ipart=1; ipart<n_block; ++ipart)
+                        block_threads.emplace_back([&, ipart]{ plan->execute(inputs[ipart], outputs[ipart]); });
+                    plan->execute(inputs[0], outputs[0]);
+                    for (std::thread& block_thread : block_threads)
+                        block_thread.join();
+                };
+
+                const double duration = time_ms(solve, n_repeat) * n_col / (n_col_part*n_block);
+                if (n_thread == 1)
+                    duration_serial = duration;
+
+                std::ostringstream ss;
+                ss << std::setw(10) << n_thread
+                   << std::setw(16) << n_block
+                   << std::setw(15) << n_pool
+                   << std::setw(12) << std::fixed << std::setprecision(3) << duration
+                   << std::setw(10) << std::setprecision(2) << duration_serial / duration;
+                Status::print_message(ss.str());
+
+                rad_lw.set_thread_pool(nullptr);
+            }
+    }
+
+    catch (std::exception& e)
+    {
+        Status::print_message("EXCEPTION: " + std::string(e.what()));
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,190 @@
+/*
+ * This file is a stand-alone executable developed for the
+ * testing of the C++ interface to the RTE+RRTMGP radiation code.
+ *
+ * It is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+
+#include "Status.h"
+#include "Netcdf_interface.h"
+#include "Array.h"
+#include "Gas_concs.h"
+#include "Radiation_solver.h"
+
+
+namespace
+{
+    void read_and_set_vmr(
+            const std::string& gas_name, const int n_col, const int n_lay,
+            const Netcdf_handle& input_nc, Gas_concs<double>& gas_concs)
+    {
+        const std::string vmr_gas_name = "vmr_" + gas_name;
+
+        if (!input_nc.variable_exists(vmr_gas_name))
+            return;
+
+        const int n_dims = input_nc.get_variable_dimensions(vmr_gas_name).size();
+
+        if (n_dims == 0)
+            gas_concs.set_vmr(gas_name, input_nc.get_variable<double>(vmr_gas_name));
+        else if (n_dims == 1)
+            gas_concs.set_vmr(gas_name,
+                    Array<double,1>(input_nc.get_variable<double>(vmr_gas_name, {n_lay}), {n_lay}));
+        else
+            gas_concs.set_vmr(gas_name,
+                    Array<double,2>(input_nc.get_variable<double>(vmr_gas_name, {n_lay, n_col}), {n_col, n_lay}));
+    }
+
+    std::string to_string(const Precision precision)
+    {
+        return precision == Precision::Single ? "single" : "double";
+    }
+
+    // Heating rate in K/day from the net flux (down minus up) on the levels.
+    Array<double,2> heating_rate(const Array<double,2>& flux_net, const Array<double,2>& p_lev)
+    {
+        constexpr double g = 9.80665;
+        constexpr double cp = 1004.;
+        constexpr double seconds_per_day = 86400.;
+
+        const int n_col = flux_net.dim(1);
+        const int n_lay = flux_net.dim(2) - 1;
+
+        Array<double,2> hr({n_col, n_lay});
+        for (int ilay=1; ilay<=n_lay; ++ilay)
+            for (int icol=1; icol<=n_col; ++icol)
+                hr({icol, ilay}) = g / cp * seconds_per_day
+                        * (flux_net({icol, ilay+1}) - flux_net({icol, ilay}))
+                        / (p_lev({icol, ilay}) - p_lev({icol, ilay+1}));
+
+        return hr;
+    }
+
+    std::pair<double, double> max_and_rms_error(const Array<double,2>& data, const Array<double,2>& data_ref)
+    {
+        double max_error = 0.;
+        double sum_sq_error = 0.;
+        for (int i=0; i<data.size(); ++i)
+        {
+            const double error = std::abs(data.v()[i] - data_ref.v()[i]);
+            max_error = std::max(max_error, error);
+            sum_sq_error += error*error;
+        }
+        return std::make_pair(max_error, std::sqrt(sum_sq_error / data.size()));
+    }
+}
+
+
+// Benchmark and accuracy report of all combinations of precisions of the gas optics, the solver,
+// and the flux reduction, for clear-sky longwave radiation. The all double configuration is the reference.
+int main(int argc, char** argv)
+{
+    Status::print_message("###### Benchmark of mixed precision longwave radiation ######");
+
+    try
+    {
+        const int n_repeat = (argc > 1) ? std::stoi(argv[1]) : 5;
+
+        Netcdf_file input_nc("rte_rrtmgp_input.nc", Netcdf_mode::Read);
+
+        const int n_col = input_nc.get_dimension_size("col");
+        const int n_lay = input_nc.get_dimension_size("lay");
+        const int n_lev = input_nc.get_dimension_size("lev");
+
+        Array<double,2> p_lay(input_nc.get_variable<double>("p_lay", {n_lay, n_col}), {n_col, n_lay});
+        Array<double,2> t_lay(input_nc.get_variable<double>("t_lay", {n_lay, n_col}), {n_col, n_lay});
+        Array<double,2> p_lev(input_nc.get_variable<double>("p_lev", {n_lev, n_col}), {n_col, n_lev});
+        Array<double,2> t_lev(input_nc.get_variable<double>("t_lev", {n_lev, n_col}), {n_col, n_lev});
+
+        Gas_concs<double> gas_concs;
+        for (const std::string gas_name : {
+                "h2o", "co2", "o3", "n2o", "co", "ch4", "o2", "n2",
+                "ccl4", "cfc11", "cfc12", "cfc22", "hfc143a", "hfc125", "hfc23", "hfc32", "hfc134a", "cf4", "no2" })
+            read_and_set_vmr(gas_name, n_col, n_lay, input_nc, gas_concs);
+
+        Array<double,1> t_sfc(input_nc.get_variable<double>("t_sfc", {n_col}), {n_col});
+
+        Array<double,2> flux_net_ref;
+        Array<double,2> hr_ref;
+
+        Status::print_message(
+                "   gas  solver  fluxes   time (ms)   max|dF| (W/m2)   rms dF (W/m2)   max|dHR| (K/d)   rms dHR (K/d)");
+
+        for (const Precision precision_gas : {Precision::Double, Precision::Single})
+            for (const Precision precision_rte : {Precision::Double, Precision::Single})
+                for (const Precision precision_flux : {Precision::Double, Precision::Single})
+                {
+                    Radiation_solver_longwave_mixed rad_lw(
+                            gas_concs, "coefficients_lw.nc", {precision_gas, precision_rte, precision_flux});
+
+                    const int n_bnd = rad_lw.get_n_bnd();
+                    Array<double,2> emis_sfc(input_nc.get_variable<double>("emis_sfc", {n_col, n_bnd}), {n_bnd, n_col});
+
+                    Array<double,2> flux_up ({n_col, n_lev});
+                    Array<double,2> flux_dn ({n_col, n_lev});
+                    Array<double,2> flux_net({n_col, n_lev});
+
+                    auto solve = [&]()
+                    {
+                        rad_lw.solve(
+                                gas_concs, p_lay, p_lev, t_lay, t_lev, t_sfc, emis_sfc,
+                                flux_up, flux_dn, flux_net);
+                    };
+
+                    // Warm up, then time the average of the repetitions.
+                    solve();
+                    auto time_start = std::chrono::high_resolution_clock::now();
+                    for (int n=0; n<n_repeat; ++n)
+                        solve();
+                    auto time_end = std::chrono::high_resolution_clock::now();
+                    const double duration = std::chrono::duration<double, std::milli>(time_end-time_start).count() / n_repeat;
+
+                    Array<double,2> hr = heating_rate(flux_net, p_lev);
+
+                    // The first configuration is the all double reference.
+                    if (flux_net_ref.is_empty())
+                    {
+                        flux_net_ref = flux_net;
+                        hr_ref = hr;
+                    }
+
+                    const std::pair<double, double> error_flux = max_and_rms_error(flux_net, flux_net_ref);
+                    const std::pair<double, double> error_hr = max_and_rms_error(hr, hr_ref);
+
+                    std::ostringstream ss;
+                    ss << std::setw(6) << to_string(precision_gas)
+                       << std::setw(8) << to_string(precision_rte)
+                       << std::setw(8) << to_string(precision_flux)
+                       << std::setw(12) << std::fixed << std::setprecision(3) << duration
+                       << std::setw(17) << std::scientific << std::setprecision(3) << error_flux.first
+                       << std::setw(16) << error_flux.second
+                       << std::setw(17) << error_hr.first
+                       << std::setw(16) << error_hr.second;
+                    Status::print_message(ss.str());
+                }
+    }
+
+    catch (std::exception& e)
+    {
+        Status::print_message("EXCEPTION: " + std::string(e.what()));
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,322 @@
+/*
+ * This file is a stand-alone executable developed for the
+ * testing of the C++ interface to the RTE+RRTMGP radiation code.
+ *
+ * It is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+
+#include "Status.h"
+#include "Netcdf_interface.h"
+#include "Array.h"
+#include "Gas_concs.h"
+#include "Gas_optics_rrtmgp.h"
+#include "Optical_props.h"
+#include "Source_functions.h"
+#include "Radiation_solver.h"
+
+
+namespace
+{
+    struct Experiment
+    {
+        Array<double,2> p_lay;
+        Array<double,2> p_lev;
+        Array<double,2> t_lay;
+        Array<double,2> t_lev;
+        Array<double,1> t_sfc;
+        Array<double,2> col_dry;
+        Gas_concs<double> gas_concs;
+    };
+
+    void read_and_set_vmr(
+            const std::string& gas_name, const int n_col, const int n_lay,
+            const Netcdf_handle& input_nc, Gas_concs<double>& gas_concs)
+    {
+        const std::string vmr_gas_name = "vmr_" + gas_name;
+
+        if (!input_nc.variable_exists(vmr_gas_name))
+            return;
+
+        const int n_dims = input_nc.get_variable_dimensions(vmr_gas_name).size();
+
+        if (n_dims == 0)
+            gas_concs.set_vmr(gas_name, input_nc.get_variable<double>(vmr_gas_name));
+        else if (n_dims == 1)
+            gas_concs.set_vmr(gas_name,
+                    Array<double,1>(input_nc.get_variable<double>(vmr_gas_name, {n_lay}), {n_lay}));
+        else
+            gas_concs.set_vmr(gas_name,
+                    Array<double,2>(input_nc.get_variable<double>(vmr_gas_name, {n_lay, n_col}), {n_col, n_lay}));
+    }
+
+    Experiment read_experiment(const std::string& file_name)
+    {
+        Netcdf_file input_nc(file_name, Netcdf_mode::Read);
+
+        const int n_col = input_nc.get_dimension_size("col");
+        const int n_lay = input_nc.get_dimension_size("lay");
+        const int n_lev = input_nc.get_dimension_size("lev");
+
+        Experiment expt;
+        expt.p_lay = Array<double,2>(input_nc.get_variable<double>("p_lay", {n_lay, n_col}), {n_col, n_lay});
+        expt.t_lay = Array<double,2>(input_nc.get_variable<double>("t_lay", {n_lay, n_col}), {n_col, n_lay});
+        expt.p_lev = Array<double,2>(input_nc.get_variable<double>("p_lev", {n_lev, n_col}), {n_col, n_lev});
+        expt.t_lev = Array<double,2>(input_nc.get_variable<double>("t_lev", {n_lev, n_col}), {n_col, n_lev});
+        expt.t_sfc = Array<double,1>(input_nc.get_variable<double>("t_sfc", {n_col}), {n_col});
+
+        for (const std::string gas_name : {
+                "h2o", "co2", "o3", "n2o", "co", "ch4", "o2", "n2",
+                "ccl4", "cfc11", "cfc12", "cfc22", "hfc143a", "hfc125", "hfc23", "hfc32", "hfc134a", "cf4", "no2" })
+            read_and_set_vmr(gas_name, n_col, n_lay, input_nc, expt.gas_concs);
+
+        expt.col_dry = Array<double,2>({n_col, n_lay});
+        Gas_optics_rrtmgp<double>::get_col_dry(expt.col_dry, expt.gas_concs.get_vmr("h2o"), expt.p_lev);
+
+        return expt;
+    }
+
+    // Experiments can share the interpolation if their pressure and temperature are identical.
+    bool same_thermodynamic_state(const Experiment& a, const Experiment& b)
+    {
+        return a.p_lay.v() == b.p_lay.v() && a.p_lev.v() == b.p_lev.v()
+            && a.t_lay.v() == b.t_lay.v() && a.t_lev.v() == b.t_lev.v()
+            && a.t_sfc.v() == b.t_sfc.v();
+    }
+
+    double max_rel_error(const Array<double,3>& data, const Array<double,3>& data_ref)
+    {
+        double max_error = 0.;
+        for (int i=0; i<data.size(); ++i)
+            max_error = std::max(max_error,
+                    std::abs(data.v()[i] - data_ref.v()[i]) / std::max(std::abs(data_ref.v()[i]), 1.e-30));
+        return max_error;
+    }
+
+    template<typename F>
+    double time_ms(F&& function, const int n_repeat)
+    {
+        function();
+        auto time_start = std::chrono::high_resolution_clock::now();
+        for (int n=0; n<n_repeat; ++n)
+            function();
+        auto time_end = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::milli>(time_end-time_start).count() / n_repeat;
+    }
+
+    void print_result(
+            const std::string& name, const double duration_ref, const double duration,
+            const double error_tau, const double error_source)
+    {
+        std::ostringstream ss;
+        ss << std::setw(10) << name
+           << std::setw(17) << std::fixed << std::setprecision(3) << duration_ref
+           << std::setw(14) << duration
+           << std::setw(10) << std::setprecision(2) << duration_ref / duration
+           << std::setw(15) << std::scientific << std::setprecision(3) << error_tau
+           << std::setw(18) << error_source;
+        Status::print_message(ss.str());
+    }
+}
+
+
+// Benchmark of the gas optics of the RFMIP experiments. Experiments with the same pressure and
+// temperature profiles differ only in their gas concentrations, and are computed with a shared
+// pressure and temperature interpolation. The reference is an independent solve per experiment.
+int main(int argc, char** argv)
+{
+    Status::print_message("###### Benchmark of the gas optics of multiple gas scenarios ######");
+
+    try
+    {
+        const int n_repeat = (argc > 1) ? std::stoi(argv[1]) : 5;
+        const int n_expt = (argc > 2) ? std::stoi(argv[2]) : 18;
+
+        std::vector<Experiment> expts;
+        for (int iexpt=0; iexpt<n_expt; ++iexpt)
+        {
+            std::ostringstream file_name;
+            file_name << "rte_rrtmgp_input_expt_" << std::setw(2) << std::setfill('0') << iexpt << ".nc";
+            expts.push_back(read_experiment(file_name.str()));
+        }
+
+        // Group the experiments by thermodynamic state.
+        std::vector<std::vector<int>> groups;
+        for (int iexpt=0; iexpt<n_expt; ++iexpt)
+        {
+            auto it = std::find_if(groups.begin(), groups.end(),
+                    [&](const std::vector<int>& group) { return same_thermodynamic_state(expts[group[0]], expts[iexpt]); });
+
+            if (it != groups.end())
+                it->push_back(iexpt);
+            else
+                groups.push_back({iexpt});
+        }
+
+        Status::print_message("Number of experiments: " + std::to_string(n_expt)
+                + ", number of thermodynamic states: " + std::to_string(groups.size()));
+
+        const int n_col = expts[0].p_lay.dim(1);
+        const int n_lay = expts[0].p_lay.dim(2);
+
+        Gas_optics_rrtmgp<double> kdist_lw = load_and_init_gas_optics_rrtmgp<double>(expts[0].gas_concs, "coefficients_lw.nc");
+        Gas_optics_rrtmgp<double> kdist_sw = load_and_init_gas_optics_rrtmgp<double>(expts[0].gas_concs, "coefficients_sw.nc");
+
+        Status::print_message(
+                "     case   independent (ms)   shared (ms)   speedup   max rel dtau   max rel dsource");
+
+        // Longwave, the optical depths and the layer sources are compared.
+        {
+            std::vector<std::unique_ptr<Optical_props_arry<double>>> optical_props_ref;
+            std::vector<Source_func_lw<double>> sources_ref;
+            std::vector<std::unique_ptr<Optical_props_arry<double>>> optical_props;
+            std::vector<Source_func_lw<double>> sources;
+
+            for (int iexpt=0; iexpt<n_expt; ++iexpt)
+            {
+                optical_props_ref.push_back(std::make_unique<Optical_props_1scl<double>>(n_col, n_lay, kdist_lw));
+                sources_ref.emplace_back(n_col, n_lay, kdist_lw);
+                optical_props.push_back(std::make_unique<Optical_props_1scl<double>>(n_col, n_lay, kdist_lw));
+                sources.emplace_back(n_col, n_lay, kdist_lw);
+            }
+
+            auto solve_independent = [&]()
+            {
+                for (int iexpt=0; iexpt<n_expt; ++iexpt)
+                    kdist_lw.gas_optics(
+                            expts[iexpt].p_lay, expts[iexpt].p_lev, expts[iexpt].t_lay, expts[iexpt].t_sfc,
+                            expts[iexpt].gas_concs, optical_props_ref[iexpt], sources_ref[iexpt],
+                            expts[iexpt].col_dry, expts[iexpt].t_lev);
+            };
+
+            // The scenario vectors are built outside of the timing.
+            std::vector<std::vector<Gas_concs<double>>> gas_concs_groups;
+            std::vector<std::vector<Array<double,2>>> col_dry_groups;
+            std::vector<std::vector<std::unique_ptr<Optical_props_arry<double>>>> optical_props_groups(groups.size());
+            std::vector<std::vector<Source_func_lw<double>>> sources_groups(groups.size());
+
+            for (size_t igroup=0; igroup<groups.size(); ++igroup)
+            {
+                gas_concs_groups.emplace_back();
+                col_dry_groups.emplace_back();
+                for (const int iexpt : groups[igroup])
+                {
+                    gas_concs_groups.back().push_back(expts[iexpt].gas_concs);
+                    col_dry_groups.back().push_back(expts[iexpt].col_dry);
+                    optical_props_groups[igroup].push_back(std::make_unique<Optical_props_1scl<double>>(n_col, n_lay, kdist_lw));
+                    sources_groups[igroup].emplace_back(n_col, n_lay, kdist_lw);
+                }
+            }
+
+            auto solve_shared = [&]()
+            {
+                for (size_t igroup=0; igroup<groups.size(); ++igroup)
+                {
+                    const Experiment& expt = expts[groups[igroup][0]];
+                    kdist_lw.gas_optics_scenarios(
+                            expt.p_lay, expt.p_lev, expt.t_lay, expt.t_sfc,
+                            gas_concs_groups[igroup], optical_props_groups[igroup], sources_groups[igroup],
+                            col_dry_groups[igroup], expt.t_lev);
+                }
+            };
+
+            const double duration_ref = time_ms(solve_independent, n_repeat);
+            const double duration = time_ms(solve_shared, n_repeat);
+
+            double error_tau = 0.;
+            double error_source = 0.;
+            for (size_t igroup=0; igroup<groups.size(); ++igroup)
+                for (size_t i=0; i<groups[igroup].size(); ++i)
+                {
+                    const int iexpt = groups[igroup][i];
+                    error_tau = std::max(error_tau, max_rel_error(
+                            optical_props_groups[igroup][i]->get_tau(), optical_props_ref[iexpt]->get_tau()));
+                    error_source = std::max(error_source, max_rel_error(
+                            sources_groups[igroup][i].get_lay_source(), sources_ref[iexpt].get_lay_source()));
+                }
+
+            print_result("longwave", duration_ref, duration, error_tau, error_source);
+        }
+
+        // Shortwave, the optical depths are compared.
+        {
+            Array<double,2> toa_src({n_col, kdist_sw.get_ngpt()});
+
+            std::vector<std::unique_ptr<Optical_props_arry<double>>> optical_props_ref;
+            for (int iexpt=0; iexpt<n_expt; ++iexpt)
+                optical_props_ref.push_back(std::make_unique<Optical_props_2str<double>>(n_col, n_lay, kdist_sw));
+
+            auto solve_independent = [&]()
+            {
+                for (int iexpt=0; iexpt<n_expt; ++iexpt)
+                    kdist_sw.gas_optics(
+                            expts[iexpt].p_lay, expts[iexpt].p_lev, expts[iexpt].t_lay,
+                            expts[iexpt].gas_concs, optical_props_ref[iexpt], toa_src,
+                            expts[iexpt].col_dry);
+            };
+
+            std::vector<std::vector<Gas_concs<double>>> gas_concs_groups;
+            std::vector<std::vector<Array<double,2>>> col_dry_groups;
+            std::vector<std::vector<std::unique_ptr<Optical_props_arry<double>>>> optical_props_groups(groups.size());
+
+            for (size_t igroup=0; igroup<groups.size(); ++igroup)
+            {
+                gas_concs_groups.emplace_back();
+                col_dry_groups.emplace_back();
+                for (const int iexpt : groups[igroup])
+                {
+                    gas_concs_groups.back().push_back(expts[iexpt].gas_concs);
+                    col_dry_groups.back().push_back(expts[iexpt].col_dry);
+                    optical_props_groups[igroup].push_back(std::make_unique<Optical_props_2str<double>>(n_col, n_lay, kdist_sw));
+                }
+            }
+
+            auto solve_shared = [&]()
+            {
+                for (size_t igroup=0; igroup<groups.size(); ++igroup)
+                {
+                    const Experiment& expt = expts[groups[igroup][0]];
+                    kdist_sw.gas_optics_scenarios(
+                            expt.p_lay, expt.p_lev, expt.t_lay,
+                            gas_concs_groups[igroup], optical_props_groups[igroup], toa_src,
+                            col_dry_groups[igroup]);
+                }
+            };
+
+            const double duration_ref = time_ms(solve_independent, n_repeat);
+            const double duration = time_ms(solve_shared, n_repeat);
+
+            double error_tau = 0.;
+            for (size_t igroup=0; igroup<groups.size(); ++igroup)
+                for (size_t i=0; i<groups[igroup].size(); ++i)
+                    error_tau = std::max(error_tau, max_rel_error(
+                            optical_props_groups[igroup][i]->get_tau(), optical_props_ref[groups[igroup][i]]->get_tau()));
+
+            print_result("shortwave", duration_ref, duration, error_tau, 0.);
+        }
+    }
+
+    catch (std::exception& e)
+    {
+        Status::print_message("EXCEPTION: " + std::string(e.what()));
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,270 @@
+/*
+ * This file is a stand-alone executable developed for the
+ * testing of the C++ interface to the RTE+RRTMGP radiation code.
+ *
+ * It is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <mutex>
+#include <thread>
+
+#include "Status.h"
+#include "Netcdf_interface.h"
+#include "Array.h"
+#include "Gas_concs.h"
+#include "Radiation_service.h"
+
+
+namespace
+{
+    using namespace Radiation_service;
+
+    void read_and_set_vmr(
+            const std::string& gas_name, const int n_col, const int n_lay,
+            const Netcdf_handle& input_nc, Gas_concs<double>& gas_concs)
+    {
+        const std::string vmr_gas_name = "vmr_" + gas_name;
+
+        if (!input_nc.variable_exists(vmr_gas_name))
+            return;
+
+        const int n_dims = input_nc.get_variable_dimensions(vmr_gas_name).size();
+
+        if (n_dims == 0)
+            gas_concs.set_vmr(gas_name, input_nc.get_variable<double>(vmr_gas_name));
+        else if (n_dims == 1)
+            gas_concs.set_vmr(gas_name,
+                    Array<double,1>(input_nc.get_variable<double>(vmr_gas_name, {n_lay}), {n_lay}));
+        else
+            gas_concs.set_vmr(gas_name,
+                    Array<double,2>(input_nc.get_variable<double>(vmr_gas_name, {n_lay, n_col}), {n_col, n_lay}));
+    }
+
+    // Surface property of the first band, which the service uses in all bands.
+    Array<double,1> read_first_band(const std::string& name, const int n_col, const Netcdf_handle& input_nc)
+    {
+        int n_bnd = 1;
+        for (const auto& dim : input_nc.get_variable_dimensions(name))
+            if (dim.first != "col")
+                n_bnd = dim.second;
+
+        Array<double,2> data(input_nc.get_variable<double>(name, {n_col, n_bnd}), {n_bnd, n_col});
+
+        Array<double,1> data_first({n_col});
+        for (int icol=1; icol<=n_col; ++icol)
+            data_first({icol}) = data({1, icol});
+        return data_first;
+    }
+
+    struct Atmosphere
+    {
+        int n_col;
+        int n_lay;
+        Array<double,2> p_lay, p_lev, t_lay, t_lev;
+        Array<double,1> t_sfc, emis_sfc;
+        Array<double,1> sfc_alb_dir, sfc_alb_dif, mu0;
+        Gas_concs<double> gas_concs;
+        std::vector<std::string> gas_names;
+    };
+
+    // Fill the inputs of a request with the columns that start at col_start, wrapping around the columns of the file.
+    void fill_request(Client& client, const Request_type type, const Atmosphere& atmos, const int n_col_request, const int col_start)
+    {
+        auto column = [&](const int icol) { return (col_start + icol) % atmos.n_col + 1; };
+
+        auto fill_2d = [&](const std::string& name, const Array<double,2>& data)
+        {
+            double* field = client.field(name);
+            for (int ilay=0; ilay<data.dim(2); ++ilay)
+                for (int icol=0; icol<n_col_request; ++icol)
+                    field[icol + ilay*n_col_request] = data({column(icol), ilay+1});
+        };
+
+        auto fill_1d = [&](const std::string& name, const Array<double,1>& data)
+        {
+            double* field = client.field(name);
+            for (int icol=0; icol<n_col_request; ++icol)
+                field[icol] = data({column(icol)});
+        };
+
+        fill_2d("p_lay", atmos.p_lay);
+        fill_2d("p_lev", atmos.p_lev);
+        fill_2d("t_lay", atmos.t_lay);
+        fill_2d("t_lev", atmos.t_lev);
+
+        if (type == Request_type::Longwave)
+        {
+            fill_1d("t_sfc", atmos.t_sfc);
+            fill_1d("emis_sfc", atmos.emis_sfc);
+        }
+        else
+        {
+            fill_1d("sfc_alb_dir", atmos.sfc_alb_dir);
+            fill_1d("sfc_alb_dif", atmos.sfc_alb_dif);
+            fill_1d("mu0", atmos.mu0);
+            std::fill(client.field("tsi_scaling"), client.field("tsi_scaling") + n_col_request, 1.);
+        }
+
+        // Gases that are constant in a dimension are spread over it.
+        for (const std::string& gas_name : atmos.gas_names)
+        {
+            const Array<double,2>& vmr = atmos.gas_concs.get_vmr(gas_name);
+            double* field = client.gas(gas_name);
+            for (int ilay=1; ilay<=atmos.n_lay; ++ilay)
+                for (int icol=0; icol<n_col_request; ++icol)
+                    field[icol + (ilay-1)*n_col_request] = vmr({
+                            (vmr.dim(1) == 1) ? 1 : column(icol),
+                            (vmr.dim(2) == 1) ? 1 : ilay});
+        }
+    }
+
+    void run_phase(
+            const std::string& label, const Request_type type, const Atmosphere& atmos,
+            const std::string& socket_path, const int n_clients, const int n_requests, const int n_col_request)
+    {
+        std::vector<double> latencies;
+        std::mutex latencies_mutex;
+        std::string error;
+
+        auto run_client = [&](const int iclient)
+        {
+            try
+            {
+                Client client(socket_path);
+                client.prepare(type, n_col_request, atmos.n_lay, atmos.gas_names);
+
+                std::vector<double> latencies_client;
+                for (int ireq=0; ireq<n_requests; ++ireq)
+                {
+                    fill_request(client, type, atmos, n_col_request, (iclient*n_requests + ireq)*n_col_request);
+
+                    auto time_start = std::chrono::steady_clock::now();
+                    client.solve();
+                    auto time_end = std::chrono::steady_clock::now();
+
+                    latencies_client.push_back(std::chrono::duration<double, std::milli>(time_end-time_start).count());
+                }
+
+                std::lock_guard<std::mutex> lock(latencies_mutex);
+                latencies.insert(latencies.end(), latencies_client.begin(), latencies_client.end());
+            }
+            catch (std::exception& e)
+            {
+                std::lock_guard<std::mutex> lock(latencies_mutex);
+                error = e.what();
+            }
+        };
+
+        auto time_start = std::chrono::steady_clock::now();
+
+        std::vector<std::thread> clients;
+        for (int iclient=0; iclient<n_clients; ++iclient)
+            clients.emplace_back(run_client, iclient);
+        for (std::thread& client : clients)
+            client.join();
+
+        auto time_end = std::chrono::steady_clock::now();
+
+        if (!error.empty())
+            throw std::runtime_error(error);
+
+        const double duration = std::chrono::duration<double>(time_end-time_start).count();
+
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&](const double p)
+        {
+            const size_t i = std::min(latencies.size()-1, size_t(p * latencies.size()));
+            return latencies[i];
+        };
+
+        std::ostringstream ss;
+        ss << std::setw(10) << label
+           << std::setw(15) << std::fixed << std::setprecision(1) << latencies.size() * n_col_request / duration
+           << std::setw(15) << latencies.size() / duration
+           << std::setw(11) << std::setprecision(3) << percentile(0.5)
+           << std::setw(11) << percentile(0.9)
+           << std::setw(11) << percentile(0.99)
+           << std::setw(11) << latencies.back();
+        Status::print_message(ss.str());
+    }
+}
+
+
+// Load generator for the local radiation service. A number of clients concurrently submit small
+// requests of RFMIP columns, first longwave and then shortwave, and the throughput and the
+// percentiles of the latency of a request are reported.
+int main(int argc, char** argv)
+{
+    Status::print_message("###### Benchmark of the local radiation service ######");
+
+    try
+    {
+        const int n_clients = (argc > 1) ? std::stoi(argv[1]) : 4;
+        const int n_requests = (argc > 2) ? std::stoi(argv[2]) : 100;
+        const int n_col_request = (argc > 3) ? std::stoi(argv[3]) : 4;
+        const std::string socket_path = (argc > 4) ? argv[4] : "/tmp/rrtmgp.sock";
+        const std::string file_name = (argc > 5) ? argv[5] : "rte_rrtmgp_input_expt_00.nc";
+
+        if (n_clients < 1 || n_requests < 1 || n_col_request < 1)
+            throw std::runtime_error("Clients, requests and columns must be positive");
+
+        Netcdf_file input_nc(file_name, Netcdf_mode::Read);
+
+        Atmosphere atmos;
+        atmos.n_col = input_nc.get_dimension_size("col");
+        atmos.n_lay = input_nc.get_dimension_size("lay");
+        const int n_col = atmos.n_col;
+        const int n_lay = atmos.n_lay;
+        const int n_lev = input_nc.get_dimension_size("lev");
+
+        atmos.p_lay = Array<double,2>(input_nc.get_variable<double>("p_lay", {n_lay, n_col}), {n_col, n_lay});
+        atmos.t_lay = Array<double,2>(input_nc.get_variable<double>("t_lay", {n_lay, n_col}), {n_col, n_lay});
+        atmos.p_lev = Array<double,2>(input_nc.get_variable<double>("p_lev", {n_lev, n_col}), {n_col, n_lev});
+        atmos.t_lev = Array<double,2>(input_nc.get_variable<double>("t_lev", {n_lev, n_col}), {n_col, n_lev});
+
+        atmos.t_sfc = Array<double,1>(input_nc.get_variable<double>("t_sfc", {n_col}), {n_col});
+        atmos.emis_sfc = read_first_band("emis_sfc", n_col, input_nc);
+        atmos.sfc_alb_dir = read_first_band("sfc_alb_dir", n_col, input_nc);
+        atmos.sfc_alb_dif = read_first_band("sfc_alb_dif", n_col, input_nc);
+        atmos.mu0 = Array<double,1>(input_nc.get_variable<double>("mu0", {n_col}), {n_col});
+
+        for (const std::string gas_name : {
+                "h2o", "co2", "o3", "n2o", "co", "ch4", "o2", "n2",
+                "ccl4", "cfc11", "cfc12", "cfc22", "hfc143a", "hfc125", "hfc23", "hfc32", "hfc134a", "cf4", "no2" })
+            read_and_set_vmr(gas_name, n_col, n_lay, input_nc, atmos.gas_concs);
+        atmos.gas_names = atmos.gas_concs.get_gas_names();
+
+        Status::print_message("Clients: " + std::to_string(n_clients)
+                + ", requests per client: " + std::to_string(n_requests)
+                + ", columns per request: " + std::to_string(n_col_request));
+        Status::print_message(
+                "             columns/s     requests/s   p50 (ms)   p90 (ms)   p99 (ms)   max (ms)");
+
+        run_phase("longwave", Request_type::Longwave, atmos, socket_path, n_clients, n_requests, n_col_request);
+        run_phase("shortwave", Request_type::Shortwave, atmos, socket_path, n_clients, n_requests, n_col_request);
+    }
+
+    catch (std::exception& e)
+    {
+        Status::print_message("EXCEPTION: " + std::string(e.what()));
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,191 @@
+/*
+ * This file is a stand-alone executable developed for the
+ * testing of the C++ interface to the RTE+RRTMGP radiation code.
+ *
+ * It is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+
+#include "Status.h"
+#include "Netcdf_interface.h"
+#include "Array.h"
+#include "Gas_concs.h"
+#include "Radiation_solver.h"
+
+
+namespace
+{
+    void read_and_set_vmr(
+            const std::string& gas_name, const int n_col, const int n_lay,
+            const Netcdf_handle& input_nc, Gas_concs<double>& gas_concs)
+    {
+        const std::string vmr_gas_name = "vmr_" + gas_name;
+
+        if (!input_nc.variable_exists(vmr_gas_name))
+            return;
+
+        const int n_dims = input_nc.get_variable_dimensions(vmr_gas_name).size();
+
+        if (n_dims == 0)
+            gas_concs.set_vmr(gas_name, input_nc.get_variable<double>(vmr_gas_name));
+        else if (n_dims == 1)
+            gas_concs.set_vmr(gas_name,
+                    Array<double,1>(input_nc.get_variable<double>(vmr_gas_name, {n_lay}), {n_lay}));
+        else
+            gas_concs.set_vmr(gas_name,
+                    Array<double,2>(input_nc.get_variable<double>(vmr_gas_name, {n_lay, n_col}), {n_col, n_lay}));
+    }
+
+    double max_abs_error(const std::vector<Array<double,2>>& data, const std::vector<Array<double,2>>& data_ref)
+    {
+        double max_error = 0.;
+        for (size_t i=0; i<data.size(); ++i)
+            for (int n=0; n<data[i].size(); ++n)
+                max_error = std::max(max_error, std::abs(data[i].v()[n] - data_ref[i].v()[n]));
+        return max_error;
+    }
+
+    template<typename F>
+    double time_ms(F&& function, const int n_repeat)
+    {
+        function();
+        auto time_start = std::chrono::high_resolution_clock::now();
+        for (int n=0; n<n_repeat; ++n)
+            function();
+        auto time_end = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::milli>(time_end-time_start).count() / n_repeat;
+    }
+}
+
+
+// Benchmark of the clear-sky shortwave fluxes of one RFMIP experiment at a number of solar zenith
+// angles. The reference is a full solve per angle, which is compared to a single solve of all angles
+// that shares the gas optics and the diffuse layer properties.
+int main(int argc, char** argv)
+{
+    Status::print_message("###### Benchmark of the shortwave solver at multiple solar angles ######");
+
+    try
+    {
+        const int n_repeat = (argc > 1) ? std::stoi(argv[1]) : 5;
+        const int n_mu0 = (argc > 2) ? std::stoi(argv[2]) : 24;
+        const std::string file_name = (argc > 3) ? argv[3] : "rte_rrtmgp_input_expt_00.nc";
+
+        Netcdf_file input_nc(file_name, Netcdf_mode::Read);
+
+        const int n_col = input_nc.get_dimension_size("col");
+        const int n_lay = input_nc.get_dimension_size("lay");
+        const int n_lev = input_nc.get_dimension_size("lev");
+
+        Array<double,2> p_lay(input_nc.get_variable<double>("p_lay", {n_lay, n_col}), {n_col, n_lay});
+        Array<double,2> t_lay(input_nc.get_variable<double>("t_lay", {n_lay, n_col}), {n_col, n_lay});
+        Array<double,2> p_lev(input_nc.get_variable<double>("p_lev", {n_lev, n_col}), {n_col, n_lev});
+        Array<double,2> t_lev(input_nc.get_variable<double>("t_lev", {n_lev, n_col}), {n_col, n_lev});
+
+        Gas_concs<double> gas_concs;
+        for (const std::string gas_name : {
+                "h2o", "co2", "o3", "n2o", "co", "ch4", "o2", "n2",
+                "ccl4", "cfc11", "cfc12", "cfc22", "hfc143a", "hfc125", "hfc23", "hfc32", "hfc134a", "cf4", "no2" })
+            read_and_set_vmr(gas_name, n_col, n_lay, input_nc, gas_concs);
+
+        Radiation_solver_shortwave<double> rad_sw(
+                gas_concs, "coefficients_sw.nc", "cloud_coefficients_sw.nc", "weights.nc",
+                input_nc, false, false);
+
+        const int n_bnd = rad_sw.get_n_bnd();
+
+        Array<double,2> sfc_alb_dir(input_nc.get_variable<double>("sfc_alb_dir", {n_col, n_bnd}), {n_bnd, n_col});
+        Array<double,2> sfc_alb_dif(input_nc.get_variable<double>("sfc_alb_dif", {n_col, n_bnd}), {n_bnd, n_col});
+
+        Array<double,1> tsi_scaling({n_col});
+        tsi_scaling.fill(1.);
+
+        // Solar zenith angles spread evenly over the sunlit part of the diurnal cycle.
+        std::vector<Array<double,1>> mu0(n_mu0, Array<double,1>({n_col}));
+        for (int imu0=0; imu0<n_mu0; ++imu0)
+            mu0[imu0].fill(std::cos((imu0 + 0.5) / n_mu0 * M_PI / 2.));
+
+        std::vector<Array<double,2>> flux_up_ref    (n_mu0, Array<double,2>({n_col, n_lev}));
+        std::vector<Array<double,2>> flux_dn_ref    (n_mu0, Array<double,2>({n_col, n_lev}));
+        std::vector<Array<double,2>> flux_dn_dir_ref(n_mu0, Array<double,2>({n_col, n_lev}));
+        std::vector<Array<double,2>> flux_net_ref   (n_mu0, Array<double,2>({n_col, n_lev}));
+
+        auto solve_independent = [&]()
+        {
+            for (int imu0=0; imu0<n_mu0; ++imu0)
+                rad_sw.solve(
+                        true, false, false, false,
+                        gas_concs,
+                        p_lay, p_lev, t_lay, t_lev, Array<double,2>(),
+                        sfc_alb_dir, sfc_alb_dif, tsi_scaling, mu0[imu0],
+                        Array<double,2>(), Array<double,2>(), Array<double,2>(), Array<double,2>(),
+                        Array<double,3>(), Array<double,3>(), Array<double,3>(), Array<double,2>(),
+                        flux_up_ref[imu0], flux_dn_ref[imu0], flux_dn_dir_ref[imu0], flux_net_ref[imu0],
+                        Array<double,3>(), Array<double,3>(), Array<double,3>(), Array<double,3>());
+        };
+
+        std::vector<Array<double,2>> flux_up    (n_mu0, Array<double,2>({n_col, n_lev}));
+        std::vector<Array<double,2>> flux_dn    (n_mu0, Array<double,2>({n_col, n_lev}));
+        std::vector<Array<double,2>> flux_dn_dir(n_mu0, Array<double,2>({n_col, n_lev}));
+        std::vector<Array<double,2>> flux_net   (n_mu0, Array<double,2>({n_col, n_lev}));
+
+        const std::vector<Array_view<double,1>> mu0_views(mu0.begin(), mu0.end());
+        std::vector<Array_view<double,2>> flux_up_views    (flux_up.begin(), flux_up.end());
+        std::vector<Array_view<double,2>> flux_dn_views    (flux_dn.begin(), flux_dn.end());
+        std::vector<Array_view<double,2>> flux_dn_dir_views(flux_dn_dir.begin(), flux_dn_dir.end());
+        std::vector<Array_view<double,2>> flux_net_views   (flux_net.begin(), flux_net.end());
+
+        auto solve_shared = [&]()
+        {
+            rad_sw.solve_mu0s(
+                    false,
+                    gas_concs,
+                    p_lay, p_lev, t_lay, t_lev, Array<double,2>(),
+                    sfc_alb_dir, sfc_alb_dif, tsi_scaling, mu0_views,
+                    Array<double,2>(), Array<double,2>(), Array<double,2>(), Array<double,2>(),
+                    flux_up_views, flux_dn_views, flux_dn_dir_views, flux_net_views);
+        };
+
+        const double duration_ref = time_ms(solve_independent, n_repeat);
+        const double duration = time_ms(solve_shared, n_repeat);
+
+        Status::print_message("Number of columns: " + std::to_string(n_col)
+                + ", number of solar angles: " + std::to_string(n_mu0));
+        Status::print_message(
+                "   independent (ms)   shared (ms)   speedup   max dflux_up   max dflux_dn   max dflux_dn_dir (W m-2)");
+
+        std::ostringstream ss;
+        ss << std::setw(19) << std::fixed << std::setprecision(3) << duration_ref
+           << std::setw(14) << duration
+           << std::setw(10) << std::setprecision(2) << duration_ref / duration
+           << std::setw(15) << std::scientific << std::setprecision(3) << max_abs_error(flux_up, flux_up_ref)
+           << std::setw(15) << max_abs_error(flux_dn, flux_dn_ref)
+           << std::setw(19) << max_abs_error(flux_dn_dir, flux_dn_dir_ref);
+        Status::print_message(ss.str());
+    }
+
+    catch (std::exception& e)
+    {
+        Status::print_message("EXCEPTION: " + std::string(e.what()));
+        return 1;
+    }
+
+    return 0;
+}
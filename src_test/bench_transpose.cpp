@@ -0,0 +1,106 @@
+/*
+ * This file is a stand-alone executable developed for the
+ * testing of the C++ interface to the RTE+RRTMGP radiation code.
+ *
+ * It is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <chrono>
+#include <iomanip>
+#include <random>
+
+#include "Status.h"
+#include "Array.h"
+#include "define_bool.h"
+#include "rrtmgp_kernels.h"
+#include "transpose_kernels.h"
+
+
+// Microbenchmark of the cache-blocked reorder against the Fortran reorder_123x321_kernel.
+template<typename TF>
+void bench_reorder(const int ngpt, const int nlay, const int ncol, const int n_repeat)
+{
+    Array<TF,3> data({ngpt, nlay, ncol});
+    Array<TF,3> data_out_ref({ncol, nlay, ngpt});
+    Array<TF,3> data_out({ncol, nlay, ngpt});
+
+    std::mt19937 mt(1);
+    std::uniform_real_distribution<TF> dist(0., 1.);
+    for (TF& d : data.v())
+        d = dist(mt);
+
+    auto time = [&](auto&& kernel)
+    {
+        kernel();
+        auto time_start = std::chrono::high_resolution_clock::now();
+        for (int n=0; n<n_repeat; ++n)
+            kernel();
+        auto time_end = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::milli>(time_end-time_start).count() / n_repeat;
+    };
+
+    int d1 = ngpt, d2 = nlay, d3 = ncol;
+    const double duration_ref = time([&]()
+    {
+        rrtmgp_kernels::reorder_123x321_kernel(&d1, &d2, &d3, data.ptr(), data_out_ref.ptr());
+    });
+
+    const double duration = time([&]()
+    {
+        transpose_kernels::reorder_123x321(data_out.ptr(), data.ptr(), ngpt, nlay, ncol);
+    });
+
+    if (data_out.v() != data_out_ref.v())
+        throw std::runtime_error("Reordered arrays differ");
+
+    // Bytes moved per reorder: one read and one write of each element.
+    const double gbytes = 2.*data.size()*sizeof(TF) / 1.e9;
+
+    std::ostringstream ss;
+    ss << std::setw(5) << ngpt << std::setw(5) << nlay << std::setw(6) << ncol
+       << ", fortran: " << std::setw(9) << std::fixed << std::setprecision(4) << duration_ref << " ms"
+       << " (" << std::setw(6) << std::setprecision(2) << gbytes/(duration_ref*1.e-3) << " GB/s)"
+       << ", blocked: " << std::setw(9) << std::setprecision(4) << duration << " ms"
+       << " (" << std::setw(6) << std::setprecision(2) << gbytes/(duration*1.e-3) << " GB/s)";
+    Status::print_message(ss.str());
+}
+
+int main()
+{
+    Status::print_message("###### Benchmark of reorder_123x321 (ngpt, nlay, ncol) ######");
+
+    try
+    {
+        constexpr int nlay = 60;
+
+        Status::print_message("Single precision, tile size: " + std::to_string(transpose_kernels::tile_size<float>()));
+        for (const int ngpt : {224, 256})
+            for (const int ncol : {1, 8, 64, 512})
+                bench_reorder<float>(ngpt, nlay, ncol, 20);
+
+        Status::print_message("Double precision, tile size: " + std::to_string(transpose_kernels::tile_size<double>()));
+        for (const int ngpt : {224, 256})
+            for (const int ncol : {1, 8, 64, 512})
+                bench_reorder<double>(ngpt, nlay, ncol, 20);
+    }
+
+    catch (std::exception& e)
+    {
+        Status::print_message("EXCEPTION: " + std::string(e.what()));
+        return 1;
+    }
+
+    return 0;
+}
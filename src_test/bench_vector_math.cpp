@@ -0,0 +1,103 @@
+/*
+ * This file is a stand-alone executable developed for the
+ * testing of the C++ interface to the RTE+RRTMGP radiation code.
+ *
+ * It is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <random>
+#include <vector>
+
+#include "Status.h"
+#include "vector_math.h"
+
+
+// Comparison of vector_math::pow against std::pow for the surface source factor of Gas_optics_nn,
+// which raises a ratio of linear functions of the surface and layer temperatures to a band exponent.
+void bench_pow(const double coef, const double exponent, const int n, const int n_repeat)
+{
+    std::vector<double> base(n);
+    std::vector<double> out_ref(n);
+    std::vector<double> out(n);
+
+    std::mt19937 mt(1);
+    std::uniform_real_distribution<double> dist_t(180., 330.);
+    for (double& b : base)
+        b = (coef*dist_t(mt) - 1.) / (coef*dist_t(mt) - 1.);
+
+    auto time = [&](auto&& kernel)
+    {
+        kernel();
+        auto time_start = std::chrono::high_resolution_clock::now();
+        for (int i=0; i<n_repeat; ++i)
+            kernel();
+        auto time_end = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::milli>(time_end-time_start).count() / n_repeat;
+    };
+
+    const double duration_ref = time([&]()
+    {
+        for (int i=0; i<n; ++i)
+            out_ref[i] = std::pow(base[i], exponent);
+    });
+
+    const double duration = time([&]()
+    {
+        double* __restrict__ const out_ptr = out.data();
+        const double* __restrict__ const base_ptr = base.data();
+        #pragma ivdep
+        for (int i=0; i<n; ++i)
+            out_ptr[i] = vector_math::pow(base_ptr[i], exponent);
+    });
+
+    double max_error = 0.;
+    for (int i=0; i<n; ++i)
+        max_error = std::max(max_error, std::abs(out[i] - out_ref[i]) / out_ref[i]);
+
+    // The rounding error of the logarithm is amplified by the exponent.
+    if (max_error > 1.e-14)
+        throw std::runtime_error("vector_math::pow differs from std::pow by " + std::to_string(max_error));
+
+    std::ostringstream ss;
+    ss << "exponent: " << std::setw(6) << std::fixed << std::setprecision(3) << exponent
+       << ", std::pow: " << std::setw(8) << std::setprecision(4) << duration_ref << " ms"
+       << ", vector_math::pow: " << std::setw(8) << std::setprecision(4) << duration << " ms"
+       << ", max relative error: " << std::scientific << std::setprecision(2) << max_error;
+    Status::print_message(ss.str());
+}
+
+int main()
+{
+    Status::print_message("###### Benchmark of vector_math::pow against std::pow ######");
+
+    try
+    {
+        // Lowest, middle and highest band of the default surface factor tables.
+        bench_pow(0.0131757912608200, 1.1209724347746475, 1<<16, 20);
+        bench_pow(0.0074105017545267, 2.9950297268205865, 1<<16, 20);
+        bench_pow(0.0074129528692143, 7.579678774748928, 1<<16, 20);
+    }
+
+    catch (std::exception& e)
+    {
+        Status::print_message("EXCEPTION: " + std::string(e.what()));
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,538 @@
+/*
+ * This file is a stand-alone executable developed for the
+ * testing of the C++ interface to the RTE+RRTMGP radiation code.
+ *
+ * It is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "Status.h"
+#include "Netcdf_interface.h"
+#include "Array.h"
+#include "Gas_concs.h"
+#include "Radiation_solver.h"
+#include "Radiation_plan.h"
+#include "Radiation_service.h"
+#include "Cpu_dispatch.h"
+
+
+namespace
+{
+    using namespace Radiation_service;
+    using Clock = std::chrono::steady_clock;
+
+    void read_and_set_vmr(
+            const std::string& gas_name, const int n_col, const int n_lay,
+            const Netcdf_handle& input_nc, Gas_concs<double>& gas_concs)
+    {
+        const std::string vmr_gas_name = "vmr_" + gas_name;
+
+        if (!input_nc.variable_exists(vmr_gas_name))
+            return;
+
+        const int n_dims = input_nc.get_variable_dimensions(vmr_gas_name).size();
+
+        if (n_dims == 0)
+            gas_concs.set_vmr(gas_name, input_nc.get_variable<double>(vmr_gas_name));
+        else if (n_dims == 1)
+            gas_concs.set_vmr(gas_name,
+                    Array<double,1>(input_nc.get_variable<double>(vmr_gas_name, {n_lay}), {n_lay}));
+        else
+            gas_concs.set_vmr(gas_name,
+                    Array<double,2>(input_nc.get_variable<double>(vmr_gas_name, {n_lay, n_col}), {n_col, n_lay}));
+    }
+
+    // Request of one client, which is solved as part of one or more batches.
+    struct Job
+    {
+        Shared_segment* segment;
+        const Segment_layout* layout;
+        Request_type type;
+        Clock::time_point time_queued;
+        std::string error;
+        std::promise<void> done;
+    };
+
+    // Columns of a job that are staged in a batch.
+    struct Piece
+    {
+        Job* job;
+        int col_job;
+        int col_batch;
+        int n_col;
+    };
+
+    // Block of n_col_batch columns with the layout of a request, on which a plan is executed.
+    struct Batch
+    {
+        Batch(const Request_type type, const int n_col_batch, const int n_lay,
+              const std::vector<std::string>& gas_names,
+              const Radiation_solver_longwave<double>& rad_lw,
+              const Radiation_solver_shortwave<double>& rad_sw) :
+            layout(type, n_col_batch, n_lay, gas_names),
+            data(layout.get_n_values())
+        {
+            Radiation_plan_options options;
+            options.n_col_block = n_col_batch;
+
+            if (type == Request_type::Longwave)
+            {
+                plan_lw = Radiation_plan_lw<double>::make_plan(
+                        rad_lw.get_gas_optics(), nullptr, n_col_batch, n_lay, options);
+
+                inputs_lw.p_lay = view_2d("p_lay");
+                inputs_lw.p_lev = view_2d("p_lev");
+                inputs_lw.t_lay = view_2d("t_lay");
+                inputs_lw.t_lev = view_2d("t_lev");
+                inputs_lw.t_sfc = view_1d("t_sfc");
+                inputs_lw.emis_sfc = view_bands("emis_sfc");
+                for (const std::string& gas_name : gas_names)
+                    inputs_lw.gas_vmr[gas_name] = view_2d(gas_name);
+
+                outputs_lw.flux_up = view_2d("flux_up");
+                outputs_lw.flux_dn = view_2d("flux_dn");
+                outputs_lw.flux_net = view_2d("flux_net");
+            }
+            else
+            {
+                plan_sw = Radiation_plan_sw<double>::make_plan(
+                        rad_sw.get_gas_optics(), nullptr, n_col_batch, n_lay, options);
+
+                inputs_sw.p_lay = view_2d("p_lay");
+                inputs_sw.p_lev = view_2d("p_lev");
+                inputs_sw.t_lay = view_2d("t_lay");
+                inputs_sw.t_lev = view_2d("t_lev");
+                inputs_sw.sfc_alb_dir = view_bands("sfc_alb_dir");
+                inputs_sw.sfc_alb_dif = view_bands("sfc_alb_dif");
+                inputs_sw.tsi_scaling = view_1d("tsi_scaling");
+                inputs_sw.mu0 = view_1d("mu0");
+                for (const std::string& gas_name : gas_names)
+                    inputs_sw.gas_vmr[gas_name] = view_2d(gas_name);
+
+                outputs_sw.flux_up = view_2d("flux_up");
+                outputs_sw.flux_dn = view_2d("flux_dn");
+                outputs_sw.flux_dn_dir = view_2d("flux_dn_dir");
+                outputs_sw.flux_net = view_2d("flux_net");
+            }
+        }
+
+        Array_view<double,2> view_2d(const std::string& name)
+        {
+            const Field& field = layout.get_field(name);
+            return Array_view<double,2>(data.data() + field.offset, {layout.get_n_col(), field.n_per_col});
+        }
+
+        Array_view<double,1> view_1d(const std::string& name)
+        {
+            const Field& field = layout.get_field(name);
+            return Array_view<double,1>(data.data() + field.offset, {layout.get_n_col()});
+        }
+
+        // One value per column, which the plan spreads over the bands.
+        Array_view<double,2> view_bands(const std::string& name)
+        {
+            const Field& field = layout.get_field(name);
+            return Array_view<double,2>(data.data() + field.offset, {1, layout.get_n_col()});
+        }
+
+        // Copy n_col columns of all inputs between a request and the batch, or the fluxes back.
+        void copy(const Piece& piece, const bool to_batch)
+        {
+            const int n_col_batch = layout.get_n_col();
+            const int n_col_job = piece.job->layout->get_n_col();
+            double* data_job = piece.job->segment->get_data();
+
+            for (const Field& field : layout.get_fields())
+            {
+                if ((field.kind == Field_kind::Output) == to_batch)
+                    continue;
+
+                const Field& field_job = piece.job->layout->get_field(field.name);
+                for (int i=0; i<field.n_per_col; ++i)
+                {
+                    double* batch = data.data() + field.offset + size_t(i)*n_col_batch + piece.col_batch;
+                    double* job = data_job + field_job.offset + size_t(i)*n_col_job + piece.col_job;
+
+                    if (to_batch)
+                        std::copy(job, job + piece.n_col, batch);
+                    else
+                        std::copy(batch, batch + piece.n_col, job);
+                }
+            }
+        }
+
+        // Repeat the last staged column in the remainder of the batch, so that it holds valid atmospheres.
+        void pad(const int n_col_staged)
+        {
+            const int n_col_batch = layout.get_n_col();
+
+            for (const Field& field : layout.get_fields())
+            {
+                if (field.kind == Field_kind::Output)
+                    continue;
+
+                for (int i=0; i<field.n_per_col; ++i)
+                {
+                    double* batch = data.data() + field.offset + size_t(i)*n_col_batch;
+                    std::fill(batch + n_col_staged, batch + n_col_batch, batch[n_col_staged-1]);
+                }
+            }
+        }
+
+        void execute()
+        {
+            if (plan_lw)
+                plan_lw->execute(inputs_lw, outputs_lw);
+            else
+                plan_sw->execute(inputs_sw, outputs_sw);
+        }
+
+        Segment_layout layout;
+        std::vector<double> data;
+
+        std::unique_ptr<Radiation_plan_lw<double>> plan_lw;
+        Radiation_inputs_lw<double> inputs_lw;
+        Radiation_outputs_lw<double> outputs_lw;
+
+        std::unique_ptr<Radiation_plan_sw<double>> plan_sw;
+        Radiation_inputs_sw<double> inputs_sw;
+        Radiation_outputs_sw<double> outputs_sw;
+    };
+
+    // Queue of requests, which a single worker coalesces into batches of n_col_batch columns. A
+    // request waits at most max_wait for other requests to share its batch.
+    class Server
+    {
+        public:
+            Server(const Radiation_solver_longwave<double>& rad_lw,
+                   const Radiation_solver_shortwave<double>& rad_sw,
+                   const std::vector<std::string>& gas_names,
+                   const int n_col_batch, const Clock::duration max_wait) :
+                rad_lw(rad_lw), rad_sw(rad_sw), gas_names(gas_names),
+                n_col_batch(n_col_batch), max_wait(max_wait), n_col_queued(0)
+            {}
+
+            // Solve the request in a segment, which blocks until its batches are done.
+            void solve(Shared_segment& segment, const Segment_layout& layout)
+            {
+                if (segment.get_n_bytes() < layout.get_n_bytes())
+                    throw std::runtime_error("Shared memory segment is smaller than its fields");
+
+                for (const std::string& gas_name : gas_names)
+                    if (!layout.has_field(gas_name) || layout.get_field(gas_name).kind != Field_kind::Gas)
+                        throw std::runtime_error("Request has no gas " + gas_name);
+
+                Job job;
+                job.segment = &segment;
+                job.layout = &layout;
+                job.type = segment.get_header().type;
+                std::future<void> done = job.done.get_future();
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    job.time_queued = Clock::now();
+                    queue.push_back(&job);
+                    n_col_queued += layout.get_n_col();
+                }
+                queued.notify_one();
+
+                done.wait();
+
+                if (!job.error.empty())
+                    throw std::runtime_error(job.error);
+            }
+
+            void run()
+            {
+                while (true)
+                {
+                    std::vector<Job*> jobs;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        queued.wait(lock, [&]{ return !queue.empty(); });
+                        queued.wait_until(
+                                lock, queue.front()->time_queued + max_wait,
+                                [&]{ return n_col_queued >= n_col_batch; });
+
+                        jobs.assign(queue.begin(), queue.end());
+                        queue.clear();
+                        n_col_queued = 0;
+                    }
+
+                    // Requests of the same kind and number of layers share batches.
+                    std::map<std::pair<Request_type, int>, std::vector<Job*>> groups;
+                    for (Job* job : jobs)
+                        groups[{job->type, job->layout->get_n_lay()}].push_back(job);
+
+                    for (auto& group : groups)
+                        solve_group(group.first.first, group.first.second, group.second);
+
+                    for (Job* job : jobs)
+                        job->done.set_value();
+                }
+            }
+
+        private:
+            void solve_group(const Request_type type, const int n_lay, std::vector<Job*>& jobs)
+            {
+                Batch* batch = nullptr;
+                try
+                {
+                    auto it = batches.find({type, n_lay});
+                    if (it == batches.end())
+                        it = batches.emplace(
+                                std::make_pair(type, n_lay),
+                                std::unique_ptr<Batch>(new Batch(type, n_col_batch, n_lay, gas_names, rad_lw, rad_sw))).first;
+                    batch = it->second.get();
+                }
+                catch (std::exception& e)
+                {
+                    for (Job* job : jobs)
+                        job->error = e.what();
+                    return;
+                }
+
+                std::vector<Piece> pieces;
+                int n_col_staged = 0;
+
+                for (Job* job : jobs)
+                {
+                    const int n_col_job = job->layout->get_n_col();
+                    for (int col_job=0; col_job<n_col_job; )
+                    {
+                        const int n_col = std::min(n_col_job - col_job, n_col_batch - n_col_staged);
+                        pieces.push_back({job, col_job, n_col_staged, n_col});
+                        batch->copy(pieces.back(), true);
+
+                        col_job += n_col;
+                        n_col_staged += n_col;
+
+                        if (n_col_staged == n_col_batch)
+                        {
+                            solve_batch(*batch, pieces, n_col_staged);
+                            pieces.clear();
+                            n_col_staged = 0;
+                        }
+                    }
+                }
+
+                if (n_col_staged > 0)
+                    solve_batch(*batch, pieces, n_col_staged);
+            }
+
+            void solve_batch(Batch& batch, const std::vector<Piece>& pieces, const int n_col_staged)
+            {
+                try
+                {
+                    if (n_col_staged < n_col_batch)
+                        batch.pad(n_col_staged);
+
+                    batch.execute();
+
+                    for (const Piece& piece : pieces)
+                        batch.copy(piece, false);
+                }
+                catch (std::exception& e)
+                {
+                    for (const Piece& piece : pieces)
+                        piece.job->error = e.what();
+                }
+            }
+
+            const Radiation_solver_longwave<double>& rad_lw;
+            const Radiation_solver_shortwave<double>& rad_sw;
+            const std::vector<std::string> gas_names;
+            const int n_col_batch;
+            const Clock::duration max_wait;
+
+            std::mutex mutex;
+            std::condition_variable queued;
+            std::deque<Job*> queue;
+            int n_col_queued;
+
+            // Only used by the worker.
+            std::map<std::pair<Request_type, int>, std::unique_ptr<Batch>> batches;
+    };
+
+    // Answer the requests of one client. The segment stays mapped while the client reuses it.
+    void serve_connection(Server& server, const int socket_fd)
+    {
+        std::unique_ptr<Shared_segment> segment;
+        Request_message request;
+
+        try
+        {
+            while (receive_message(socket_fd, &request, sizeof(request)))
+            {
+                request.segment_name[segment_name_length-1] = '\0';
+                Response_message response = {0};
+
+                try
+                {
+                    if (!segment || segment->get_name() != request.segment_name)
+                    {
+                        segment.reset();
+                        segment = Shared_segment::open(request.segment_name);
+                    }
+
+                    const Segment_layout layout(segment->get_header());
+                    server.solve(*segment, layout);
+                    segment->get_header().status = 0;
+                }
+                catch (std::exception& e)
+                {
+                    if (segment)
+                    {
+                        Segment_header& header = segment->get_header();
+                        header.status = 1;
+                        std::strncpy(header.error, e.what(), error_length-1);
+                        header.error[error_length-1] = '\0';
+                    }
+                    response.status = 1;
+                }
+
+                send_message(socket_fd, &response, sizeof(response));
+            }
+        }
+        catch (std::exception& e)
+        {
+            Status::print_warning("Connection closed: " + std::string(e.what()));
+        }
+
+        close(socket_fd);
+    }
+
+    char socket_path_signal[sizeof(sockaddr_un::sun_path)];
+
+    extern "C" void remove_socket(int)
+    {
+        unlink(socket_path_signal);
+        _exit(0);
+    }
+}
+
+
+// Local radiation service that keeps the solvers initialized. Clients submit their columns through
+// shared memory, see Radiation_service.h, and concurrent requests are coalesced into batches.
+int main(int argc, char** argv)
+{
+    Status::print_message("###### Local radiation service ######");
+    Cpu_dispatch::print_variant();
+
+    try
+    {
+        const std::string socket_path = (argc > 1) ? argv[1] : "/tmp/rrtmgp.sock";
+        const int n_col_batch = (argc > 2) ? std::stoi(argv[2]) : 256;
+        const double max_wait_ms = (argc > 3) ? std::stod(argv[3]) : 2.;
+        const std::string file_name = (argc > 4) ? argv[4] : "rte_rrtmgp_input_expt_00.nc";
+        const bool switch_nn_gas_optics = (argc > 5) ? std::stoi(argv[5]) : false;
+
+        if (n_col_batch < 1)
+            throw std::runtime_error("The batch needs at least one column");
+
+        // The gases of the input file set the gases that every request has to provide.
+        Netcdf_file input_nc(file_name, Netcdf_mode::Read);
+
+        const int n_col = input_nc.get_dimension_size("col");
+        const int n_lay = input_nc.get_dimension_size("lay");
+
+        Gas_concs<double> gas_concs;
+        for (const std::string gas_name : {
+                "h2o", "co2", "o3", "n2o", "co", "ch4", "o2", "n2",
+                "ccl4", "cfc11", "cfc12", "cfc22", "hfc143a", "hfc125", "hfc23", "hfc32", "hfc134a", "cf4", "no2" })
+            read_and_set_vmr(gas_name, n_col, n_lay, input_nc, gas_concs);
+
+        const std::vector<std::string> gas_names = gas_concs.get_gas_names();
+
+        Radiation_solver_longwave<double> rad_lw(
+                gas_concs, "coefficients_lw.nc", "cloud_coefficients_lw.nc", "weights.nc",
+                input_nc, false, switch_nn_gas_optics);
+
+        Radiation_solver_shortwave<double> rad_sw(
+                gas_concs, "coefficients_sw.nc", "cloud_coefficients_sw.nc", "weights.nc",
+                input_nc, false, switch_nn_gas_optics);
+
+        Server server(
+                rad_lw, rad_sw, gas_names, n_col_batch,
+                std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(max_wait_ms)));
+
+        // Set up the socket, replacing the one of an earlier server.
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (socket_path.size() >= sizeof(address.sun_path))
+            throw std::runtime_error("Socket path " + socket_path + " is too long");
+        std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path)-1);
+        std::strncpy(socket_path_signal, socket_path.c_str(), sizeof(socket_path_signal)-1);
+
+        const int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listen_fd == -1)
+            throw std::runtime_error("Cannot create socket");
+
+        unlink(socket_path.c_str());
+        if (bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1 || listen(listen_fd, 64) == -1)
+            throw std::runtime_error("Cannot listen on " + socket_path);
+
+        std::signal(SIGINT, remove_socket);
+        std::signal(SIGTERM, remove_socket);
+
+        std::thread worker([&]{ server.run(); });
+        worker.detach();
+
+        std::string gas_list;
+        for (const std::string& gas_name : gas_names)
+            gas_list += " " + gas_name;
+
+        Status::print_message("Listening on " + socket_path + ", batch of " + std::to_string(n_col_batch)
+                + " columns, maximum wait of " + std::to_string(max_wait_ms) + " ms");
+        Status::print_message("Gases:" + gas_list);
+
+        while (true)
+        {
+            const int socket_fd = accept(listen_fd, nullptr, nullptr);
+            if (socket_fd == -1)
+            {
+                if (errno == EINTR)
+                    continue;
+                throw std::runtime_error("Cannot accept connection");
+            }
+
+            std::thread(serve_connection, std::ref(server), socket_fd).detach();
+        }
+    }
+
+    catch (std::exception& e)
+    {
+        Status::print_message("EXCEPTION: " + std::string(e.what()));
+        return 1;
+    }
+
+    return 0;
+}
@@ -24,6 +24,7 @@
 #include "Netcdf_interface.h"
 #include "Array.h"
 #include "Radiation_solver.h"
+#include "Cpu_dispatch.h"
 
 
 #ifdef FLOAT_SINGLE_RRTMGP
@@ -32,6 +33,9 @@
 #define FLOAT_TYPE double
 #endif
 
+// Relative quantization of the inputs for the merging of near-duplicate columns.
+constexpr double dedup_quantization = 1.e-4;
+
 
 template<typename TF>
 void read_and_set_vmr(
@@ -162,10 +166,16 @@ void solve_radiation(int argc, char** argv, int iinp)
         {"shortwave"        , { true,  "Enable computation of shortwave radiation." }},
         {"longwave"         , { true,  "Enable computation of longwave radiation."  }},
         {"nn-gas-optics"    , { false, "Enable neural network solver for gas optics"}},
+        {"hybrid-gas-optics", { false, "Enable neural network gas optics within its training envelope, RRTMGP elsewhere."}},
+        {"float-storage"    , { false, "Compute the optics in double, solve and store the g-point fluxes in single precision."}},
+        {"column-dedup"     , { false, "Solve only the columns with a unique input state."}},
+        {"near-dedup"       , { false, "Merge columns of which the inputs differ less than the dedup quantization."}},
         {"fluxes"           , { true,  "Enable computation of fluxes."              }},
         {"cloud-optics"     , { false, "Enable cloud optics."                       }},
         {"output-optical"   , { false, "Enable output of optical properties."       }},
-        {"output-bnd-fluxes", { false, "Enable output of band fluxes."              }} };
+        {"output-bnd-fluxes", { false, "Enable output of band fluxes."              }},
+        {"output-flux-jac"  , { false, "Enable output of the longwave upward flux derivative to the surface temperature."}},
+        {"output-clear-sky" , { false, "Enable output of the clear-sky fluxes."     }} };
 
     if (parse_command_line_options(command_line_options, argc, argv))
         return;
@@ -173,13 +183,20 @@ void solve_radiation(int argc, char** argv, int iinp)
     const bool switch_shortwave         = command_line_options.at("shortwave"        ).first;
     const bool switch_longwave          = command_line_options.at("longwave"         ).first;
     const bool switch_nn_gas_optics     = command_line_options.at("nn-gas-optics"    ).first;
+    const bool switch_hybrid_gas_optics = command_line_options.at("hybrid-gas-optics").first;
+    const bool switch_float_storage     = command_line_options.at("float-storage"    ).first;
+    const bool switch_column_dedup      = command_line_options.at("column-dedup"     ).first;
+    const bool switch_near_dedup        = command_line_options.at("near-dedup"       ).first;
     const bool switch_fluxes            = command_line_options.at("fluxes"           ).first;
     const bool switch_cloud_optics      = command_line_options.at("cloud-optics"     ).first;
     const bool switch_output_optical    = command_line_options.at("output-optical"   ).first;
     const bool switch_output_bnd_fluxes = command_line_options.at("output-bnd-fluxes").first;
+    const bool switch_output_flux_jac   = command_line_options.at("output-flux-jac"  ).first;
+    const bool switch_output_clear_sky  = command_line_options.at("output-clear-sky" ).first;
 
     // Print the options to the screen.
     print_command_line_options(command_line_options);
+    Cpu_dispatch::print_variant();
 
 
     ////// READ THE ATMOSPHERIC DATA //////
@@ -282,7 +299,11 @@ void solve_radiation(int argc, char** argv, int iinp)
         Status::print_message("Initializing the longwave solver.");
         Radiation_solver_longwave<TF> rad_lw(
                 gas_concs, "coefficients_lw.nc", "cloud_coefficients_lw.nc", "weights.nc",
-                input_nc, switch_cloud_optics, switch_nn_gas_optics);
+                input_nc, switch_cloud_optics, switch_nn_gas_optics, switch_hybrid_gas_optics,
+                switch_float_storage);
+
+        if (switch_column_dedup || switch_near_dedup)
+            rad_lw.set_column_dedup(true, switch_near_dedup ? TF(dedup_quantization) : TF(0.));
 
         // Read the boundary conditions.
         const int n_bnd_lw = rad_lw.get_n_bnd();
@@ -310,12 +331,26 @@ void solve_radiation(int argc, char** argv, int iinp)
         Array<TF,2> lw_flux_up;
         Array<TF,2> lw_flux_dn;
         Array<TF,2> lw_flux_net;
+        Array<TF,2> lw_flux_up_jac;
+        Array<TF,2> lw_flux_up_clear;
+        Array<TF,2> lw_flux_dn_clear;
+        Array<TF,2> lw_flux_net_clear;
 
         if (switch_fluxes)
         {
             lw_flux_up .set_dims({n_col, n_lev});
             lw_flux_dn .set_dims({n_col, n_lev});
             lw_flux_net.set_dims({n_col, n_lev});
+
+            if (switch_output_flux_jac)
+                lw_flux_up_jac.set_dims({n_col, n_lev});
+
+            if (switch_output_clear_sky)
+            {
+                lw_flux_up_clear .set_dims({n_col, n_lev});
+                lw_flux_dn_clear .set_dims({n_col, n_lev});
+                lw_flux_net_clear.set_dims({n_col, n_lev});
+            }
         }
 
         Array<TF,3> lw_bnd_flux_up;
@@ -349,13 +384,23 @@ void solve_radiation(int argc, char** argv, int iinp)
                 rel, rei,
                 lw_tau, lay_source, lev_source_inc, lev_source_dec, sfc_source,
                 lw_flux_up, lw_flux_dn, lw_flux_net,
-                lw_bnd_flux_up, lw_bnd_flux_dn, lw_bnd_flux_net);
+                lw_bnd_flux_up, lw_bnd_flux_dn, lw_bnd_flux_net,
+                lw_flux_up_jac,
+                lw_flux_up_clear, lw_flux_dn_clear, lw_flux_net_clear);
 
         auto time_end = std::chrono::high_resolution_clock::now();
         auto duration = std::chrono::duration<double, std::milli>(time_end-time_start).count();
 
         Status::print_message("Duration longwave solver: " + std::to_string(duration) + " (ms)");
 
+        if (switch_hybrid_gas_optics)
+            Status::print_message("Fraction of longwave columns with neural network gas optics: "
+                    + std::to_string(rad_lw.get_nn_column_fraction()));
+
+        if (switch_column_dedup || switch_near_dedup)
+            Status::print_message("Number of longwave columns per unique column: "
+                    + std::to_string(rad_lw.get_dedup_ratio()));
+
 
         // Store the output.
         Status::print_message("Storing the longwave output.");
@@ -397,6 +442,23 @@ void solve_radiation(int argc, char** argv, int iinp)
             nc_lw_flux_dn .insert(lw_flux_dn .v(), {0, 0});
             nc_lw_flux_net.insert(lw_flux_net.v(), {0, 0});
 
+            if (switch_output_flux_jac)
+            {
+                auto nc_lw_flux_up_jac = output_nc.add_variable<TF>("lw_flux_up_jac", {"lev", "col"});
+                nc_lw_flux_up_jac.insert(lw_flux_up_jac.v(), {0, 0});
+            }
+
+            if (switch_output_clear_sky)
+            {
+                auto nc_lw_flux_up_clear  = output_nc.add_variable<TF>("lw_flux_up_clear" , {"lev", "col"});
+                auto nc_lw_flux_dn_clear  = output_nc.add_variable<TF>("lw_flux_dn_clear" , {"lev", "col"});
+                auto nc_lw_flux_net_clear = output_nc.add_variable<TF>("lw_flux_net_clear", {"lev", "col"});
+
+                nc_lw_flux_up_clear .insert(lw_flux_up_clear .v(), {0, 0});
+                nc_lw_flux_dn_clear .insert(lw_flux_dn_clear .v(), {0, 0});
+                nc_lw_flux_net_clear.insert(lw_flux_net_clear.v(), {0, 0});
+            }
+
             if (switch_output_bnd_fluxes)
             {
                 auto nc_lw_bnd_flux_up  = output_nc.add_variable<TF>("lw_bnd_flux_up" , {"band_lw", "lev", "col"});
@@ -419,7 +481,11 @@ void solve_radiation(int argc, char** argv, int iinp)
 
         Radiation_solver_shortwave<TF> rad_sw(
                 gas_concs, "coefficients_sw.nc", "cloud_coefficients_sw.nc", "weights.nc",
-                input_nc, switch_cloud_optics, switch_nn_gas_optics);
+                input_nc, switch_cloud_optics, switch_nn_gas_optics, switch_hybrid_gas_optics,
+                switch_float_storage);
+
+        if (switch_column_dedup || switch_near_dedup)
+            rad_sw.set_column_dedup(true, switch_near_dedup ? TF(dedup_quantization) : TF(0.));
 
         // Read the boundary conditions.
         const int n_bnd_sw = rad_sw.get_n_bnd();
@@ -470,6 +536,19 @@ void solve_radiation(int argc, char** argv, int iinp)
             sw_flux_net   .set_dims({n_col, n_lev});
         }
 
+        Array<TF,2> sw_flux_up_clear;
+        Array<TF,2> sw_flux_dn_clear;
+        Array<TF,2> sw_flux_dn_dir_clear;
+        Array<TF,2> sw_flux_net_clear;
+
+        if (switch_fluxes && switch_output_clear_sky)
+        {
+            sw_flux_up_clear    .set_dims({n_col, n_lev});
+            sw_flux_dn_clear    .set_dims({n_col, n_lev});
+            sw_flux_dn_dir_clear.set_dims({n_col, n_lev});
+            sw_flux_net_clear   .set_dims({n_col, n_lev});
+        }
+
         Array<TF,3> sw_bnd_flux_up;
         Array<TF,3> sw_bnd_flux_dn;
         Array<TF,3> sw_bnd_flux_dn_dir;
@@ -507,13 +586,23 @@ void solve_radiation(int argc, char** argv, int iinp)
                 sw_flux_up, sw_flux_dn,
                 sw_flux_dn_dir, sw_flux_net,
                 sw_bnd_flux_up, sw_bnd_flux_dn,
-                sw_bnd_flux_dn_dir, sw_bnd_flux_net);
+                sw_bnd_flux_dn_dir, sw_bnd_flux_net,
+                sw_flux_up_clear, sw_flux_dn_clear,
+                sw_flux_dn_dir_clear, sw_flux_net_clear);
 
         auto time_end = std::chrono::high_resolution_clock::now();
         auto duration = std::chrono::duration<double, std::milli>(time_end-time_start).count();
 
         Status::print_message("Duration shortwave solver: " + std::to_string(duration) + " (ms)");
 
+        if (switch_hybrid_gas_optics)
+            Status::print_message("Fraction of shortwave columns with neural network gas optics: "
+                    + std::to_string(rad_sw.get_nn_column_fraction()));
+
+        if (switch_column_dedup || switch_near_dedup)
+            Status::print_message("Number of shortwave columns per unique column: "
+                    + std::to_string(rad_sw.get_dedup_ratio()));
+
 
         // Store the output.
         Status::print_message("Storing the shortwave output.");
@@ -553,6 +642,19 @@ void solve_radiation(int argc, char** argv, int iinp)
             nc_sw_flux_dn_dir.insert(sw_flux_dn_dir.v(), {0, 0});
             nc_sw_flux_net   .insert(sw_flux_net   .v(), {0, 0});
 
+            if (switch_output_clear_sky)
+            {
+                auto nc_sw_flux_up_clear     = output_nc.add_variable<TF>("sw_flux_up_clear"    , {"lev", "col"});
+                auto nc_sw_flux_dn_clear     = output_nc.add_variable<TF>("sw_flux_dn_clear"    , {"lev", "col"});
+                auto nc_sw_flux_dn_dir_clear = output_nc.add_variable<TF>("sw_flux_dn_dir_clear", {"lev", "col"});
+                auto nc_sw_flux_net_clear    = output_nc.add_variable<TF>("sw_flux_net_clear"   , {"lev", "col"});
+
+                nc_sw_flux_up_clear    .insert(sw_flux_up_clear    .v(), {0, 0});
+                nc_sw_flux_dn_clear    .insert(sw_flux_dn_clear    .v(), {0, 0});
+                nc_sw_flux_dn_dir_clear.insert(sw_flux_dn_dir_clear.v(), {0, 0});
+                nc_sw_flux_net_clear   .insert(sw_flux_net_clear   .v(), {0, 0});
+            }
+
             if (switch_output_bnd_fluxes)
             {
                 auto nc_sw_bnd_flux_up     = output_nc.add_variable<TF>("sw_bnd_flux_up"    , {"band_sw", "lev", "col"});